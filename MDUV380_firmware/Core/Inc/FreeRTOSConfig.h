@@ -119,6 +119,7 @@ to exclude the API function. */
 #define INCLUDE_uxTaskGetStackHighWaterMark  1
 #define INCLUDE_xTaskGetCurrentTaskHandle    1
 #define INCLUDE_eTaskGetState                1
+#define INCLUDE_xTaskGetIdleTaskHandle       1
 
 /*
  * The CMSIS-RTOS V2 FreeRTOS wrapper is dependent on the heap implementation used
@@ -168,6 +169,26 @@ standard names. */
 
 /* USER CODE BEGIN Defines */
 /* Section where parameter definitions can be added (for instance, to override default ones in FreeRTOS.h) */
+
+/* Tickless idle: the sleep is only allowed by the clock manager while the power saving has suspended the radio tasks */
+#define configUSE_TICKLESS_IDLE                  1
+#define configEXPECTED_IDLE_TIME_BEFORE_SLEEP    2
+
+/* Run time statistics, counter is TIM5 (see runTimeStats.c) */
+#define configGENERATE_RUN_TIME_STATS            1
+#define configUSE_STATS_FORMATTING_FUNCTIONS     0
+
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+void runTimeStatsTimerInit(void);
+uint32_t runTimeStatsGetCounter(void);
+void clockManagerPreSleepProcessing(uint32_t *expectedIdleTime);
+void clockManagerPostSleepProcessing(uint32_t expectedIdleTime);
+#endif
+
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() runTimeStatsTimerInit()
+#define portGET_RUN_TIME_COUNTER_VALUE()         runTimeStatsGetCounter()
+#define configPRE_SLEEP_PROCESSING(x)            clockManagerPreSleepProcessing(&(x))
+#define configPOST_SLEEP_PROCESSING(x)           clockManagerPostSleepProcessing(x)
 /* USER CODE END Defines */
 
 #endif /* FREERTOS_CONFIG_H */
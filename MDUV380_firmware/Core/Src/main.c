@@ -57,6 +57,8 @@ RTC_HandleTypeDef hrtc;
 
 SPI_HandleTypeDef hspi1;
 SPI_HandleTypeDef hspi2;
+DMA_HandleTypeDef hdma_spi1_rx;
+DMA_HandleTypeDef hdma_spi1_tx;
 
 TIM_HandleTypeDef htim1;
 TIM_HandleTypeDef htim2;
@@ -933,9 +935,15 @@ static void MX_DMA_Init(void)
   /* DMA2_Stream2_IRQn interrupt configuration */
   HAL_NVIC_SetPriority(DMA2_Stream2_IRQn, 7, 0);
   HAL_NVIC_EnableIRQ(DMA2_Stream2_IRQn);
+  /* DMA2_Stream3_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA2_Stream3_IRQn, 7, 0);
+  HAL_NVIC_EnableIRQ(DMA2_Stream3_IRQn);
   /* DMA2_Stream4_IRQn interrupt configuration */
   HAL_NVIC_SetPriority(DMA2_Stream4_IRQn, 7, 0);
   HAL_NVIC_EnableIRQ(DMA2_Stream4_IRQn);
+  /* DMA2_Stream5_IRQn interrupt configuration */
+  HAL_NVIC_SetPriority(DMA2_Stream5_IRQn, 7, 0);
+  HAL_NVIC_EnableIRQ(DMA2_Stream5_IRQn);
 
 }
 
@@ -989,10 +997,15 @@ static void MX_GPIO_Init(void)
   /*Configure GPIO pin Output Level */
   HAL_GPIO_WritePin(CTC_DCS_PWM_GPIO_Port, CTC_DCS_PWM_Pin, GPIO_PIN_SET);
 
-  /*Configure GPIO pins : DMR_SPI_CS_Pin DMR_SPI_CLK_Pin DMR_SPI_MOSI_Pin C6000_PWD_Pin
-                           LED_GREEN_Pin LED_RED_Pin */
-  GPIO_InitStruct.Pin = DMR_SPI_CS_Pin|DMR_SPI_CLK_Pin|DMR_SPI_MOSI_Pin|C6000_PWD_Pin
-                          |LED_GREEN_Pin|LED_RED_Pin;
+  /*Configure GPIO pins : DMR_SPI_CS_Pin DMR_SPI_CLK_Pin DMR_SPI_MOSI_Pin */
+  GPIO_InitStruct.Pin = DMR_SPI_CS_Pin|DMR_SPI_CLK_Pin|DMR_SPI_MOSI_Pin;
+  GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
+  GPIO_InitStruct.Pull = GPIO_NOPULL;
+  GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_MEDIUM;
+  HAL_GPIO_Init(GPIOE, &GPIO_InitStruct);
+
+  /*Configure GPIO pins : C6000_PWD_Pin LED_GREEN_Pin LED_RED_Pin */
+  GPIO_InitStruct.Pin = C6000_PWD_Pin|LED_GREEN_Pin|LED_RED_Pin;
   GPIO_InitStruct.Mode = GPIO_MODE_OUTPUT_PP;
   GPIO_InitStruct.Pull = GPIO_NOPULL;
   GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
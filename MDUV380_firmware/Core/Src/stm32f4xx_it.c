@@ -30,6 +30,7 @@
 #include "functions/trx.h"
 #include "interfaces/gps.h"
 #include "functions/aprs.h"
+#include "interfaces/trace.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -67,6 +68,8 @@ extern DMA_HandleTypeDef hdma_adc1;
 extern DAC_HandleTypeDef hdac;
 extern DMA_HandleTypeDef hdma_i2s3_ext_tx;
 extern DMA_HandleTypeDef hdma_spi3_rx;
+extern DMA_HandleTypeDef hdma_spi1_rx;
+extern DMA_HandleTypeDef hdma_spi1_tx;
 extern DMA_HandleTypeDef hdma_tim1_ch1;
 extern TIM_HandleTypeDef htim6;
 extern DMA_HandleTypeDef hdma_usart1_rx;
@@ -323,12 +326,26 @@ void DMA2_Stream2_IRQHandler(void)
   /* USER CODE BEGIN DMA2_Stream2_IRQn 0 */
 
   /* USER CODE END DMA2_Stream2_IRQn 0 */
-  HAL_DMA_IRQHandler(&hdma_usart1_rx);
+  HAL_DMA_IRQHandler(&hdma_spi1_rx);
   /* USER CODE BEGIN DMA2_Stream2_IRQn 1 */
 
   /* USER CODE END DMA2_Stream2_IRQn 1 */
 }
 
+/**
+  * @brief This function handles DMA2 stream3 global interrupt.
+  */
+void DMA2_Stream3_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA2_Stream3_IRQn 0 */
+
+  /* USER CODE END DMA2_Stream3_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_spi1_tx);
+  /* USER CODE BEGIN DMA2_Stream3_IRQn 1 */
+
+  /* USER CODE END DMA2_Stream3_IRQn 1 */
+}
+
 /**
   * @brief This function handles DMA2 stream4 global interrupt.
   */
@@ -343,6 +360,20 @@ void DMA2_Stream4_IRQHandler(void)
   /* USER CODE END DMA2_Stream4_IRQn 1 */
 }
 
+/**
+  * @brief This function handles DMA2 stream5 global interrupt.
+  */
+void DMA2_Stream5_IRQHandler(void)
+{
+  /* USER CODE BEGIN DMA2_Stream5_IRQn 0 */
+
+  /* USER CODE END DMA2_Stream5_IRQn 0 */
+  HAL_DMA_IRQHandler(&hdma_usart1_rx);
+  /* USER CODE BEGIN DMA2_Stream5_IRQn 1 */
+
+  /* USER CODE END DMA2_Stream5_IRQn 1 */
+}
+
 /**
   * @brief This function handles USB On The Go FS global interrupt.
   */
@@ -367,13 +398,17 @@ void HAL_GPIO_EXTI_Callback(uint16_t GPIO_Pin)
 		if (GPIO_Pin == GPIO_PIN_0)
 		{
 			hrc6000SetInIRQHandler(true);
+			TRACE_BEGIN(TRACE_ID_HRC6000_TS_IRQ);
 			hrc6000TimeslotInterruptHandler();
+			TRACE_END(TRACE_ID_HRC6000_TS_IRQ);
 			hrc6000SetInIRQHandler(false);
 		}
 		else if (GPIO_Pin == GPIO_PIN_1)
 		{
 			hrc6000SetInIRQHandler(true);
+			TRACE_BEGIN(TRACE_ID_HRC6000_SYS_IRQ);
 			hrc6000SysInterruptHandler();
+			TRACE_END(TRACE_ID_HRC6000_SYS_IRQ);
 			hrc6000SetInIRQHandler(false);
 		}
 		else if (GPIO_Pin == GPIO_PIN_2)
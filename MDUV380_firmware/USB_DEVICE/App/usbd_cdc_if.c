@@ -25,6 +25,7 @@
 /* USER CODE BEGIN INCLUDE */
 #include "usb/usb_com.h"
 #include "functions/hotspot.h"
+#include "functions/eventBus.h"
 #if defined(HAS_GPS)
 #include "user_interface/uiGlobals.h"
 #include "interfaces/gps.h"
@@ -106,6 +107,7 @@ uint8_t UserTxBufferFS[APP_TX_DATA_SIZE];
 /* USER CODE BEGIN PRIVATE_VARIABLES */
 volatile static uint32_t s_receivingBufferOffset = 0;
 volatile static int32_t s_recvCount = 0;
+volatile static bool s_receivePaused = false; // OUT endpoint is NAKing until the pending pipelined CPS request is handled
 
 /* USER CODE END PRIVATE_VARIABLES */
 
@@ -173,6 +175,7 @@ static int8_t CDC_Init_FS(void)
   com_request = 0;
   s_recvCount = 0;
   s_receivingBufferOffset = 0;
+  s_receivePaused = false;
   comRecvMMDVMIndexIn = comRecvMMDVMIndexOut = 0;
 
   return (USBD_OK);
@@ -285,46 +288,17 @@ static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
 
 	if (recvSize > 0)
 	{
+		eventBusPost(EVENT_BUS_USB_DATA, 0); // The requests are handled by the main loop
+
 		if (settingsUsbMode == USB_MODE_HOTSPOT)
 		{
 			if (Buf[0] == MMDVM_FRAME_START)
 			{
 				if (recvSize >= 3) // The shortest MMDVMHost frame length is 3U
 				{
-					uint8_t frameLength = (uint8_t)recvSize;
-
 					s_recvCount = recvSize;
 
-					// We can't rely on the MMDVMHost's frame size, so we're managing
-					// the block size ourselves.
-					com_requestbuffer[comRecvMMDVMIndexIn++] = frameLength + 1;
-
-					// Make sure the index stays within limits.
-					if (comRecvMMDVMIndexIn >= COM_REQUESTBUFFER_SIZE)
-					{
-						comRecvMMDVMIndexIn = 0;
-					}
-
-					// Copy the MMDVMHost data
-					for (uint8_t i = 0; i < frameLength; i++)
-					{
-						com_requestbuffer[comRecvMMDVMIndexIn++] = Buf[i];
-
-						// Make sure the index stays within limits.
-						if (comRecvMMDVMIndexIn >= COM_REQUESTBUFFER_SIZE)
-						{
-							comRecvMMDVMIndexIn = 0;
-						}
-					}
-
-					// Make sure the index stays within limits.
-					if (comRecvMMDVMIndexIn >= COM_REQUESTBUFFER_SIZE)
-					{
-						comRecvMMDVMIndexIn = 0;
-					}
-
-					// Increment the frame counter
-					comRecvMMDVMFrameCount++;
+					usbComMMDVMFrameStore(Buf, (uint8_t)recvSize);
 				}
 			}
 		}
@@ -402,6 +376,18 @@ static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
 									}
 									break;
 
+								case 'P': // Pipelined transfer
+									if (recvSize >= 10)
+									{
+										// Read requests don't carry any data
+										s_recvCount = 14 + ((Buf[1] == 3) ? 0 : ((Buf[8] << 8) + (Buf[9] << 0)));
+									}
+									else
+									{
+										// Problem
+									}
+									break;
+
 								case 'C':
 									// Clamp commands, it may not exceed 5 + 16
 									s_recvCount = recvSize;
@@ -459,6 +445,13 @@ static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
 							comRecvMMDVMIndexIn = mmdvmLen;
 							comRecvMMDVMFrameCount = 1;
 						}
+						else if ((settingsUsbMode == USB_MODE_CPS) && (com_requestbuffer[0] == 'P'))
+						{
+							// Pipelined transfer: don't accept anything else until this request is replied, the host
+							// can queue its next requests meanwhile (see CDC_ResumeReceive_FS()).
+							// The legacy requests are one at a time, the endpoint isn't paused for them.
+							s_receivePaused = true;
+						}
 
 						s_receivingBufferOffset = 0;
 						s_recvCount = 0;
@@ -481,8 +474,11 @@ static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
 		}
 	}
 
-	USBD_CDC_SetRxBuffer(&hUsbDeviceFS, UserRxBufferFS); // Reset the RX buffer.
-	USBD_CDC_ReceivePacket(&hUsbDeviceFS); // Prepare for the next reception.
+	if (s_receivePaused == false)
+	{
+		USBD_CDC_SetRxBuffer(&hUsbDeviceFS, UserRxBufferFS); // Reset the RX buffer.
+		USBD_CDC_ReceivePacket(&hUsbDeviceFS); // Prepare for the next reception.
+	}
 
 	return (USBD_OK);
   /* USER CODE END 6 */
@@ -537,11 +533,63 @@ static int8_t CDC_TransmitCplt_FS(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
   UNUSED(Buf);
   UNUSED(Len);
   UNUSED(epnum);
+
+  // Send the next batch of MMDVMHost frames, if any
+  if (settingsUsbMode == USB_MODE_HOTSPOT)
+  {
+	  hotspotUSBTransmitComplete();
+  }
   /* USER CODE END 13 */
   return result;
 }
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
+/**
+  * @brief  CDC_AcquireTxBuffer_FS
+  *         Get the IN transfer buffer, to fill it in place before calling CDC_TransmitTxBuffer_FS().
+  *         It has to be called with the USB interrupt masked (task critical section), or from the USB ISR.
+  * @retval The buffer (APP_TX_DATA_SIZE bytes), NULL if a transfer is in progress
+  */
+uint8_t *CDC_AcquireTxBuffer_FS(void)
+{
+	USBD_CDC_HandleTypeDef *hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
+
+	if ((hcdc == NULL) || (hcdc->TxState != 0))
+	{
+		return NULL;
+	}
+
+	return UserTxBufferFS;
+}
+
+/**
+  * @brief  CDC_TransmitTxBuffer_FS
+  *         Send the content of the IN transfer buffer, filled in place.
+  * @param  Len: Number of data to be sent (in bytes)
+  * @retval USBD_OK if all operations are OK else USBD_FAIL or USBD_BUSY
+  */
+uint8_t CDC_TransmitTxBuffer_FS(uint16_t Len)
+{
+	USBD_CDC_SetTxBuffer(&hUsbDeviceFS, UserTxBufferFS, SAFE_MIN(Len, sizeof(UserTxBufferFS)));
+
+	return USBD_CDC_TransmitPacket(&hUsbDeviceFS);
+}
+
+/**
+  * @brief  CDC_ResumeReceive_FS
+  *         Re-arm the OUT endpoint once the pending CPS request has been handled.
+  *         It has to be called with the USB interrupt masked (task critical section).
+  * @retval None
+  */
+void CDC_ResumeReceive_FS(void)
+{
+	if (s_receivePaused)
+	{
+		s_receivePaused = false;
+		USBD_CDC_SetRxBuffer(&hUsbDeviceFS, UserRxBufferFS);
+		USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+	}
+}
 
 /* USER CODE END PRIVATE_FUNCTIONS_IMPLEMENTATION */
 
@@ -109,6 +109,9 @@ extern USBD_CDC_ItfTypeDef USBD_Interface_fops_FS;
 uint8_t CDC_Transmit_FS(uint8_t* Buf, uint16_t Len);
 
 /* USER CODE BEGIN EXPORTED_FUNCTIONS */
+uint8_t *CDC_AcquireTxBuffer_FS(void);
+uint8_t CDC_TransmitTxBuffer_FS(uint16_t Len);
+void CDC_ResumeReceive_FS(void);
 
 /* USER CODE END EXPORTED_FUNCTIONS */
 
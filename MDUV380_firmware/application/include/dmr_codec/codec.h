@@ -59,11 +59,26 @@
 extern uint8_t ambebuffer_decode[CODEC_DECODE_CONFIG_DATA_LENGTH];
 extern uint8_t ambebuffer_encode[CODEC_ENCODE_CONFIG_DATA_LENGTH];
 extern uint8_t ambebuffer_encode_ecc[CODEC_ECC_CONFIG_DATA_LENGTH];
+extern volatile bool codecDecoderIsDirty;
+extern volatile bool codecEncoderIsDirty;
+
+// PTT to first encoded AMBE frame latency
+typedef struct __attribute__((__packed__))
+{
+	uint32_t count;
+	uint32_t lastLatencyUs;
+	uint32_t maxLatencyUs;
+} codecLatencyStats_t;
 
 void initFrame(uint8_t *indata, uint16_t bitbufferDecode[49]);
 void codecInit(bool fromVoicePrompts);
 bool codecIsAvailable(void);
 void codecInitInternalBuffers(void);
+void codecResetDecoder(void);
+void codecResetEncoder(void);
+void codecLatencyProbeStart(void);
+void codecLatencyProbeStop(void);
+const codecLatencyStats_t *codecGetLatencyStats(void);
 void codecDecode(uint8_t *indata_ptr, int numbBlocks);
 void codecEncode(uint8_t *outdata_ptr, int numbBlocks);
 void codecEncodeBlock(uint8_t *outdata_ptr);
@@ -33,6 +33,7 @@
 #include <stdbool.h>
 
 extern const int CODEPLUG_ADDR_CHANNEL_HEADER_EEPROM;
+extern const int CODEPLUG_ADDR_CHANNEL_HEADER_FLASH;
 
 extern const int CODEPLUG_MAX_VARIABLE_SQUELCH;
 extern const int CODEPLUG_MIN_VARIABLE_SQUELCH;
@@ -188,6 +189,22 @@ typedef struct
 	int			NOT_IN_CODEPLUGDATA_indexNumber;// This property is not part of the codeplug data, its initialised by the code. Index >= 0 are real zone. -1 indicates the virtual "All channels" zone
 } struct_codeplugZone_t;
 
+// Decoded zone properties, without the channels list (cached, used by the zone list)
+typedef struct
+{
+	char		name[16];
+	int			numChannelsInZone;
+	int			highestIndex;
+	int			indexNumber;// Same as struct_codeplugZone_t's NOT_IN_CODEPLUGDATA_indexNumber
+} codeplugZoneHeader_t;
+
+typedef struct __attribute__((__packed__))
+{
+	uint32_t	hits;
+	uint32_t	misses;
+	uint32_t	invalidations;
+} codeplugChannelCacheStats_t;
+
 typedef struct
 {
 	char name[16];
@@ -377,6 +394,7 @@ void codeplugZoneSetSelected(int selectedZone,int selectedChannel);
 void codeplugZonesInitCache(void);
 int codeplugZonesGetCount(void);
 bool codeplugZoneGetDataForNumber(int indexNum,struct_codeplugZone_t *returnBuf);
+bool codeplugZoneGetHeaderForNumber(int zoneNum, codeplugZoneHeader_t *header);
 uint32_t codeplugChannelGetOptionalDMRID(struct_codeplugChannel_t *channelBuf);
 void codeplugChannelSetOptionalDMRID(struct_codeplugChannel_t *channelBuf, uint32_t dmrID);
 uint8_t codeplugChannelGetFlag(struct_codeplugChannel_t *channelBuf, ChannelFlag_t flag);
@@ -424,6 +442,8 @@ bool codeplugGetOpenGD77CustomData(codeplugCustomDataType_t dataType, uint8_t *d
 bool codeplugSetOpenGD77CustomData(codeplugCustomDataType_t dataType, uint8_t *dataBuf, int len);
 
 void codeplugAllChannelsInitCache(void);
+void codeplugChannelCacheInvalidate(void);
+const codeplugChannelCacheStats_t *codeplugChannelCacheGetStats(void);
 void codeplugInitCaches(void);
 
 bool codeplugContactsContainsPC(uint32_t pc);
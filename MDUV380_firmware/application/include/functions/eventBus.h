@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _OPENGD77_EVENT_BUS_H_
+#define _OPENGD77_EVENT_BUS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <FreeRTOS.h>
+
+//
+// Events posted by the interrupt handlers and the other tasks, waking up the main loop,
+// which receives and dispatches them on its next iteration (rotary steps to the keyboard,
+// DMR calls to the current menu, GPS lines to the parser).
+// Keyboard and buttons are still scanned by the main loop.
+//
+typedef enum
+{
+	EVENT_BUS_ROTARY = 0,     // data is the direction (int8_t)
+	EVENT_BUS_SQUELCH,        // DMR carrier detected/lost
+	EVENT_BUS_DMR_CALL_START,
+	EVENT_BUS_DMR_CALL_END,
+	EVENT_BUS_GPS_DATA,       // A NMEA sentence is waiting to be parsed
+	EVENT_BUS_USB_DATA,       // Data received from the host
+	EVENT_BUS_NUM_TYPES
+} eventBusType_t;
+
+typedef struct __attribute__((__packed__))
+{
+	uint16_t loopsPerSecond;
+	uint16_t latencyAvgUs;    // during the last second
+	uint16_t latencyMaxUs;
+	uint16_t queueMaxDepth;
+	uint32_t dropped;
+	uint32_t events[EVENT_BUS_NUM_TYPES];
+} eventBusStats_t;
+
+typedef struct
+{
+	eventBusType_t type;
+	uint8_t        data;
+} eventBusEvent_t;
+
+void eventBusInit(void);
+void eventBusPost(eventBusType_t type, uint8_t data);
+void eventBusWait(TickType_t timeout);
+bool eventBusReceive(eventBusEvent_t *event);
+void eventBusLoopIteration(void);
+void eventBusGetStats(eventBusStats_t *stats);
+
+#endif /* _OPENGD77_EVENT_BUS_H_ */
@@ -157,9 +157,40 @@ void hotspotRxFrameHandler(uint8_t *frameBuf);
 void cwProcess(void);
 void cwReset(void);
 
+#define HOTSPOT_USB_TX_DEPTH_BINS      8
+#define HOTSPOT_USB_TX_LATENCY_BINS   12
+
+// USB IN transfers (hotspot mode)
+typedef struct __attribute__((__packed__))
+{
+	uint32_t transfers;
+	uint32_t frames;
+	uint16_t maxDepth;
+	uint32_t depth[HOTSPOT_USB_TX_DEPTH_BINS];     // queued frames when a transfer starts: 1, 2-3, 4-7, ... 128+
+	uint32_t latency[HOTSPOT_USB_TX_LATENCY_BINS]; // enqueuing to transfer start: < 64us, 64-127us, ... 65ms+
+} hotspotUSBTxStats_t;
+
+// Network to RF TX buffering
+typedef struct __attribute__((__packed__))
+{
+	uint16_t jitterMs;         // network frames inter-arrival jitter estimate
+	uint8_t  prebufferFrames;  // frames buffered before starting to transmit
+	uint32_t frames;
+	uint32_t late;             // arrived after its slot has been concealed
+	uint32_t dropped;          // TX buffer full
+	uint32_t concealedRepeat;  // missing frame replaced by the previous one
+	uint32_t concealedSilence; // missing frame replaced by silence
+} hotspotJitterStats_t;
+
 void handleHotspotRequest(void);
+bool hotspotTxFrameIsMissing(bool canRepeat);
+const hotspotJitterStats_t *hotspotGetJitterStats(void);
 void processUSBDataQueue(void);
 void enqueueUSBData(uint8_t *data, uint8_t length);
+#if defined(STM32F405xx)
+void hotspotUSBTransmitComplete(void);
+const hotspotUSBTxStats_t *hotspotGetUSBTxStats(void);
+#endif
 void hotspotStateMachine(void);
 void hotspotInit(void);
 
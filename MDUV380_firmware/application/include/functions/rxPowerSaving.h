@@ -45,4 +45,5 @@ void rxPowerSavingSetLevel(int newLevel);
 void rxPowerSavingSetState(ecoPhase_t newState);
 bool rxPowerSavingIsRxOn(void);
 int rxPowerSavingGetLevel(void);
+uint32_t rxPowerSavingGetMainLoopIdleTicks(void);
 #endif
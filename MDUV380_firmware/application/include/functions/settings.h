@@ -151,7 +151,7 @@ typedef struct
 	uint32_t		bitfieldOptions; // see bitfieldOptions_t
 	uint32_t		aprsBeaconingSettingsPart1[2];
 #if defined(LOG_GPS_DATA)
-	uint32_t		gpsLogMemOffset; // Current offset from the NMEA logging flash memory address start.
+	uint32_t		gpsLogMemOffset; // Unused, the GPS track log head is recovered from the Flash content.
 #endif
 	int16_t			currentIndexInTRxGroupList[3]; // Current Channel, VFO A and VFO B
 	int16_t			currentZone;
@@ -355,6 +355,7 @@ void settingsSetDirty(void);
 void settingsSetVFODirty(void);
 void settingsSaveIfNeeded(bool immediately);
 bool settingsSaveSettings(bool includeVFOs);
+bool settingsCommitSettings(bool includeVFOs);
 bool settingsLoadSettings(bool reset);
 bool settingsRestoreDefaultSettings(void);
 void settingsEraseCustomContent(void);
@@ -178,4 +178,17 @@ uint8_t trxGetNoiseRaw(RadioDevice_t deviceId);
 void trxSelectVoiceChannel(uint8_t channel);
 void trxConfigurePA_DAC_ForFrequencyBand(void);
 
+// Retune instrumentation (trxSetFrequency() duration, tuning plans LRU usage)
+typedef struct __attribute__((__packed__))
+{
+	uint32_t count;
+	uint32_t lastDurationUs;
+	uint32_t maxDurationUs;
+	uint32_t planHits;
+	uint32_t planMisses;
+} trxRetuneStats_t;
+
+const trxRetuneStats_t *trxGetRetuneStats(void);
+void trxTuningPlansInvalidate(void);
+
 #endif /* _OPENGD77_TRX_H_ */
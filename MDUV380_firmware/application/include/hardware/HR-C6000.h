@@ -85,6 +85,17 @@ typedef struct
 } HRC6000_Tone1Config_t;
 #endif
 
+// Mode switches and TX/RX transitions register scripts
+typedef struct __attribute__((__packed__))
+{
+	uint32_t runs;
+	uint32_t written;   // Registers written
+	uint32_t skipped;   // Registers already holding the value
+	uint32_t transfers; // SPI0 transactions
+	uint32_t lastUs;
+	uint32_t maxUs;
+} hrc6000ScriptStats_t;
+
 void PORTC_IRQHandler(void);
 
 void HRC6000Init(void);
@@ -138,6 +149,7 @@ void hrc6000SetInIRQHandler(bool in);
 void HRC6000SendTone(int tonefreq);
 void HRC6000MuteFmAudio(bool ismute);
 void HRC6000SetMic(bool isOn);
+const hrc6000ScriptStats_t *HRC6000GetScriptStats(void);
 #endif
 
 
@@ -177,6 +177,20 @@ extern uint16_t themeItems[NIGHT + 1][THEME_ITEM_MAX]; // Theme storage
 #define DISPLAY_SIZE_X                          160
 #define DISPLAY_NUMBER_OF_ROWS  (DISPLAY_SIZE_Y / 8)
 
+// Palette indexed framebuffer (1, 2 or 4 bits per pixel), expanded to the native colour format while rendering.
+// When not defined, the framebuffer holds native colour pixels (the host build sets it with DISPLAY_BPP=N).
+//#define DISPLAY_INDEXED_FRAMEBUFFER_BPP         4
+#if defined(DISPLAY_INDEXED_FRAMEBUFFER_BPP)
+#if (DISPLAY_INDEXED_FRAMEBUFFER_BPP != 1) && (DISPLAY_INDEXED_FRAMEBUFFER_BPP != 2) && (DISPLAY_INDEXED_FRAMEBUFFER_BPP != 4)
+#error DISPLAY_INDEXED_FRAMEBUFFER_BPP has to be 1, 2 or 4
+#endif
+#define DISPLAY_BITS_PER_PIXEL                  DISPLAY_INDEXED_FRAMEBUFFER_BPP
+#define DISPLAY_PALETTE_SIZE                    (1 << DISPLAY_INDEXED_FRAMEBUFFER_BPP)
+#else
+#define DISPLAY_BITS_PER_PIXEL                  16
+#endif
+#define DISPLAY_SCREEN_BUFFER_SIZE              ((DISPLAY_SIZE_X * DISPLAY_SIZE_Y * DISPLAY_BITS_PER_PIXEL) / 8) // in bytes
+
 #if defined(HAS_COLOURS)
 // Platform format could be RGB565 or BGR565
 #define RGB888_TO_PLATFORM_COLOUR_FORMAT(x) ((displayLCD_Type & DIPLAYLCD_TYPE_RGB) \
@@ -246,6 +260,7 @@ uint16_t *displayGetScreenBuffer(void);
 void displayRestorePrimaryScreenBuffer(void);
 uint16_t *displayGetPrimaryScreenBuffer(void);
 void displayOverrideScreenBuffer(uint16_t *buffer);
+void displayCopyPrimaryScreenBufferNative(uint8_t *dest, uint32_t offset, uint32_t length);
 
 void displayConvertGD77ImageData(uint8_t *dataBuf);
 
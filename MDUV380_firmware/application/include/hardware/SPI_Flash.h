@@ -58,15 +58,43 @@
 #define SR_DRV1         0x00400000 // Output Driver Strength 1       // S22
 #define SR_HOLD_RST     0x00800000 // /HOLD or /RESET Function       // S23
 
+typedef struct __attribute__((__packed__))
+{
+	uint32_t reads;                // SPI_Flash_read() calls
+	uint32_t hits;                 // Pages found in the cache
+	uint32_t misses;
+	uint32_t hitRatePermille;
+	uint32_t readAheadPages;       // Pages fetched ahead on sequential misses
+	uint32_t dmaTransfers;
+	uint32_t invalidations;        // Cached pages dropped by a page program or a sector erase
+	uint32_t flashBytes;           // Read from the chip
+	uint32_t servedBytes;          // Returned to the callers
+	uint32_t flashBytesPerSecond;  // Bus throughput, while reading
+	uint32_t servedBytesPerSecond; // Seen by the callers, cache hits included
+	uint32_t writes;               // SPI_Flash_write(), SPI_Flash_writePage() and SPI_Flash_eraseSector() calls
+	uint32_t foregroundErases;     // Sector erases the callers had to wait for
+	uint32_t erasesAvoided;        // Pre-erased sectors taken from the pool, sector writes not needing an erase
+	uint32_t backgroundErases;     // Done by the maintenance task
+	uint32_t eraseSuspends;        // Background erases suspended by a read
+	uint32_t stallUsLast;          // Time the caller was blocked by the last write
+	uint32_t stallUsMax;
+	uint32_t stallUsPerWrite;      // Mean
+} spiFlashStats_t;
+
 extern uint8_t SPI_Flash_sectorbuffer[4096];
 extern uint32_t flashChipPartNumber;
 
 // Public functions
 bool SPI_Flash_init(void);
 bool SPI_Flash_read(uint32_t addrress,uint8_t *buf,int size);
+const spiFlashStats_t *SPI_Flash_getStats(void);
 bool SPI_Flash_write(uint32_t addr, uint8_t *dataBuf, int size);
 bool SPI_Flash_writePage(uint32_t address,uint8_t *dataBuf);// page is 256 bytes
 bool SPI_Flash_eraseSector(uint32_t address);// sector is 16 pages  = 4k bytes
+bool SPI_Flash_eraseSectorInBackground(uint32_t address);// Pre-erase, for a later SPI_Flash_eraseSector() or write
+void SPI_Flash_maintenanceSetRadioIdle(bool isIdle);
+bool SPI_Flash_maintenanceRadioIsIdle(void);
+void SPI_Flash_initMaintenanceTask(void);
 uint8_t SPI_Flash_readManufacturer(void);// Not necessarily Winbond !
 uint32_t SPI_Flash_readPartID(void);// Should be 4014 for 1M or 4017 for 8M
 uint32_t SPI_Flash_readStatusRegisters(void);// May come in handy
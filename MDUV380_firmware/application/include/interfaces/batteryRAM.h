@@ -29,6 +29,6 @@
 
 bool batteryRAM_Read(uint32_t offset,uint8_t *buf, uint32_t size);
 bool batteryRAM_Write(uint32_t offset,uint8_t *buf, uint32_t size);
-void batteryRAM_Init(void);
+void batteryRAM_Init(bool retainOnVBAT);
 
 #endif
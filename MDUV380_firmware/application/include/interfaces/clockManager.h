@@ -31,6 +31,7 @@
 #define _POWER_MANAGER_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
 /*******************************************************************************
  * Definitions
@@ -87,10 +88,45 @@ typedef enum
 	CLOCK_MANAGER_SPEED_HS_RUN        = 0x0205,
 	CLOCK_MANAGER_RUN_SUSPEND_MODE    = 0x1F00,
 	CLOCK_MANAGER_RUN_ECO_POWER_MODE  = 0x1F00,
+	CLOCK_MANAGER_RUN_MID_POWER_MODE  = 0x0F00,
 } clockManagerSpeedSetting_t;
 
+// Clock levels, from the slowest to the fastest
+typedef enum
+{
+	CLOCK_MANAGER_LEVEL_ECO = 0, // 24MHz, only while the RX power saving has the RX off
+	CLOCK_MANAGER_LEVEL_MID,     // 36MHz
+	CLOCK_MANAGER_LEVEL_RUN,     // 72MHz
+	CLOCK_MANAGER_LEVEL_NUM
+} clockManagerLevel_t;
+
+// Activities and heavy jobs that keep the governor at full speed
+#define CLOCK_MANAGER_DEMAND_PREDICTION    0x01U // Satellite predictions
+#define CLOCK_MANAGER_DEMAND_CPS           0x04U // USB connected to a host (CPS, hotspot), set by the clock manager itself
+#define CLOCK_MANAGER_DEMAND_DMR           0x08U // Digital RX
+#define CLOCK_MANAGER_DEMAND_AUDIO         0x10U // Audio amp on (RF audio, beeps, voice prompts)
+#define CLOCK_MANAGER_DEMAND_TX            0x20U
+
+typedef struct __attribute__((__packed__))
+{
+	uint32_t residency[CLOCK_MANAGER_LEVEL_NUM]; // Time spent at each level, in ms
+	uint32_t levelChanges;
+	uint16_t idlePermille;                       // Idle task share of the last governor sample
+	uint8_t  level;                              // clockManagerLevel_t
+	uint8_t  demand;                             // CLOCK_MANAGER_DEMAND_* bits
+} clockManagerGovernorStats_t;
+
 void clockManagerInit(void);
 void clockManagerSetRunMode(uint8_t targetConfigIndex, clockManagerSpeedSetting_t clockSpeedSetting);
 clockManagerSpeedSetting_t clockManagerGetRunMode(void);
+void clockManagerSetTicklessIdleAllowed(bool allowed);
+bool clockManagerIsTicklessIdleAllowed(void);
+void clockManagerPreSleepProcessing(uint32_t *expectedIdleTime);
+void clockManagerPostSleepProcessing(uint32_t expectedIdleTime);
+void clockManagerGovernorTick(uint32_t activeDemand);
+void clockManagerGovernorSetDemand(uint32_t demand, bool active);
+void clockManagerGovernorSetEcoAllowed(bool allowed);
+void clockManagerTimersRescale(void);
+const clockManagerGovernorStats_t *clockManagerGovernorGetStats(void);
 
 #endif /* _POWER_MANAGER_H_ */
@@ -88,6 +88,7 @@ typedef struct
 extern gpsData_t gpsData;
 
 void gpsTick(void);
+void gpsProcessData(void);
 void gpsOn(void);
 void gpsOff(void);
 void gpsOnUsingQuickKey(bool on);
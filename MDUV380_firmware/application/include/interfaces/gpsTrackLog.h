@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _OPENGD77_GPSTRACKLOG_H_
+#define _OPENGD77_GPSTRACKLOG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "user_interface/uiGlobals.h"
+#include "interfaces/gps.h"
+
+#if defined(HAS_GPS) && defined(LOG_GPS_DATA)
+
+//
+// Binary GPS track log.
+//
+// The log area is a ring of 4K sectors, each one starts with a header (magic, sequence number),
+// followed by the records. A record never crosses a 256 bytes page, the end of a page is padded.
+//
+// Records:
+//   GPS_TRACK_LOG_TAG_SESSION                         new track segment (logging started)
+//   GPS_TRACK_LOG_TAG_KEYFRAME, time(4), latitude(4), longitude(4), altitude(2), speed(2), course(2) (little endian)
+//   GPS_TRACK_LOG_TAG_DELTA | flags, [time delta], latitude delta, longitude delta, [altitude delta], [speed delta], [course delta]
+//      the deltas are varints (zigzag for the signed ones), the time delta defaults to 1s.
+//
+// Latitude/longitude are in 1e-5 degree (~1.1m), altitude in meter, speed in hundredth of knot, course in hundredth of degree.
+// Each sector starts with a keyframe, so it can be decoded on its own when the oldest sectors are recycled.
+//
+#define GPS_TRACK_LOG_SECTOR_MAGIC          0x314C5447U // "GTL1"
+#define GPS_TRACK_LOG_SECTOR_HEADER_SIZE    8U
+#define GPS_TRACK_LOG_RECORD_MAX_SIZE       25U
+
+#define GPS_TRACK_LOG_TAG_PADDING           0x00 // the rest of the page is unused
+#define GPS_TRACK_LOG_TAG_SESSION           0x01
+#define GPS_TRACK_LOG_TAG_KEYFRAME          0x02
+#define GPS_TRACK_LOG_TAG_DELTA             0x80
+#define GPS_TRACK_LOG_TAG_ERASED            0xFF // end of the log
+
+#define GPS_TRACK_LOG_DELTA_HAS_TIME        0x01
+#define GPS_TRACK_LOG_DELTA_HAS_ALTITUDE    0x02
+#define GPS_TRACK_LOG_DELTA_HAS_SPEED       0x04
+#define GPS_TRACK_LOG_DELTA_HAS_COURSE      0x08
+
+typedef enum
+{
+	GPS_TRACK_LOG_EXPORT_GPX = 0,
+	GPS_TRACK_LOG_EXPORT_NMEA
+} gpsTrackLogExportFormat_t;
+
+void gpsTrackLogInit(uint32_t startAddress, uint32_t size);
+void gpsTrackLogStartSession(void);
+void gpsTrackLogAddPoint(const gpsData_t *data);
+void gpsTrackLogFlush(void);
+void gpsTrackLogClear(void);
+int gpsTrackLogExportRead(gpsTrackLogExportFormat_t format, uint32_t position, uint8_t *dest, int length);
+
+#endif // HAS_GPS && LOG_GPS_DATA
+
+#endif /* _OPENGD77_GPSTRACKLOG_H_ */
@@ -29,6 +29,7 @@
 #ifndef _OPENGD77_SPI_H_
 #define _OPENGD77_SPI_H_
 
+#include <stdbool.h>
 #include <FreeRTOS.h>
 #include <task.h>
 
@@ -43,6 +44,15 @@ enum _generic_status
     kStatus_NoTransferInProgress,
 };
 
+typedef struct __attribute__((__packed__))
+{
+	uint32_t timeslots;
+	uint32_t lastTimeslotUs; // Time spent on SPI0 and SPI1 between the last two timeslot interrupts
+	uint32_t maxTimeslotUs;
+	uint32_t meanTimeslotUs;
+	uint32_t transfers;      // SPI0 transactions
+	uint32_t collisions;     // SPI0 accesses refused as the bus was already in use
+} spiBusStats_t;
 
 void SPIInit(void);
 void SPI0Read(uint8_t *txBuf,uint8_t *rxBuf,uint8_t length);
@@ -53,11 +63,16 @@ int SPI0ReadPageRegByte(uint8_t page, uint8_t reg, volatile uint8_t *val);
 int SPI0ClearPageRegByteWithMask(uint8_t page, uint8_t reg, uint8_t mask, uint8_t val);
 int SPI0WritePageRegByteArray(uint8_t page, uint8_t reg, const uint8_t *values, uint8_t length);
 int SPI0ReadPageRegByteArray(uint8_t page, uint8_t reg, volatile uint8_t *values, uint8_t length);
+int SPI0WritePageRegByteList(uint8_t page, const uint8_t regValues[][2], uint8_t length);
+bool SPI0ShadowGet(uint8_t page, uint8_t reg, uint8_t *val);
+void SPI0ShadowInvalidate(void);
 
 int SPI1WritePageRegByteArray(uint8_t page, uint8_t reg, const uint8_t *values, uint8_t length);
 int SPI1ReadPageRegByteArray(uint8_t page, uint8_t reg, volatile uint8_t *values, uint8_t length);
 
 void SPI0Setup(void);
 void SPI1Setup(void);
+void SPIBusTimeslotTick(void);
+const spiBusStats_t *SPIGetBusStats(void);
 
 #endif /* _OPENGD77_SPI_H_ */
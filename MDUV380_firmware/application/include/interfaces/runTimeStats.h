@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _OPENGD77_RUN_TIME_STATS_H_
+#define _OPENGD77_RUN_TIME_STATS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <FreeRTOS.h>
+#include <task.h>
+
+// Frequency of the free running counter used by FreeRTOS to account the tasks run time.
+// It's kept constant whatever the current clock manager setting is.
+#define RUN_TIME_STATS_COUNTER_HZ     10000U
+#define RUN_TIME_STATS_MAX_TASKS      10
+
+typedef struct __attribute__((__packed__))
+{
+	char     name[configMAX_TASK_NAME_LEN];
+	uint16_t cpuPermille;          // CPU usage since the previous update, in 1/1000
+	uint16_t stackHighWaterMark;   // Minimum amount of stack that remained available, in words
+	uint8_t  state;                // eTaskState
+	uint8_t  priority;
+} runTimeStatsTask_t;
+
+typedef struct __attribute__((__packed__))
+{
+	uint8_t            numTasks;
+	uint16_t           idlePermille;
+	uint32_t           sampleDuration; // in RUN_TIME_STATS_COUNTER_HZ units
+	runTimeStatsTask_t tasks[RUN_TIME_STATS_MAX_TASKS];
+} runTimeStats_t;
+
+// Each reader gets the usage since its own previous update
+typedef enum
+{
+	RUN_TIME_STATS_WINDOW_UI = 0, // Radio infos CPU page
+	RUN_TIME_STATS_WINDOW_CPS,    // CPS_ACCESS_RUN_TIME_STATS
+	RUN_TIME_STATS_NUM_WINDOWS
+} runTimeStatsWindow_t;
+
+void runTimeStatsTimerInit(void);
+uint32_t runTimeStatsGetCounter(void);
+uint32_t runTimeStatsGetCycles(void);
+uint32_t runTimeStatsCyclesToMicroseconds(uint32_t cycles);
+void runTimeStatsClockHasChanged(void);
+void runTimeStatsUpdate(runTimeStatsWindow_t window);
+const runTimeStats_t *runTimeStatsGet(runTimeStatsWindow_t window);
+
+#endif /* _OPENGD77_RUN_TIME_STATS_H_ */
@@ -29,8 +29,15 @@
 #define _SETTINGS_STORAGE_H_
 
 #include "main.h"
+#include "functions/codeplug.h"
+
+#define SETTINGS_STORAGE_ADDRESS         (0x6000 + 0x4B /* After "Last Used Channel In Zone" */)
+#define SETTINGS_STORAGE_VFOS_SIZE       (2 * CODEPLUG_CHANNEL_DATA_STRUCT_SIZE) // VFO A and B, codeplug format
 
 bool settingsStorageRead(uint8_t *buf, uint32_t size);
-bool settingsStorageWrite(uint8_t *buf, uint32_t size);
+bool settingsStorageWrite(uint8_t *buf, uint32_t size, uint8_t *vfos);
+bool settingsStorageFlushIsDue(void);
+bool settingsStorageFlush(uint8_t *buf, uint32_t size);
+void settingsStorageDiscardBackup(void);
 
 #endif
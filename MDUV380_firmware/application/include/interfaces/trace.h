@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _OPENGD77_TRACE_H_
+#define _OPENGD77_TRACE_H_
+
+#include <stdint.h>
+
+//
+// Hot path tracing.
+//
+// TRACE_BEGIN()/TRACE_END() store the DWT cycles counter in a dedicated RTT up-buffer,
+// as 8 bytes binary events, without any allocation or formatting on the radio side.
+// The stream is decoded by tools/trace_decode.py (latency histograms, Chrome trace timeline).
+//
+// Everything is compiled out unless USING_TRACE is defined.
+//
+
+#define TRACE_RTT_CHANNEL        1
+#if !defined(TRACE_RTT_BUFFER_SIZE)
+#define TRACE_RTT_BUFFER_SIZE    4096
+#endif
+
+// Keep TRACE_NAMES, in tools/trace_decode.py, in sync.
+typedef enum
+{
+	TRACE_ID_HRC6000_TS_IRQ = 0,
+	TRACE_ID_HRC6000_SYS_IRQ,
+	TRACE_ID_CODEC_DECODE,
+	TRACE_ID_CODEC_ENCODE,
+	TRACE_ID_DISPLAY_RENDER,
+	TRACE_ID_SPI_FLASH_READ,
+	TRACE_ID_SPI_FLASH_WRITE,
+	TRACE_ID_I2C_WRITE,
+	TRACE_ID_I2C_READ,
+	TRACE_ID_MAX
+} traceId_t;
+
+typedef enum
+{
+	TRACE_EVENT_BEGIN = 0,
+	TRACE_EVENT_END,
+	TRACE_EVENT_CLOCK // id holds the new core clock, in MHz
+} traceEventType_t;
+
+typedef struct __attribute__((__packed__))
+{
+	uint32_t cycles;
+	uint16_t sequence; // Incremented even when the RTT buffer is full, so the host can detect the lost events
+	uint8_t  id;
+	uint8_t  type;
+} traceEvent_t;
+
+#if defined(USING_TRACE)
+
+#define TRACE_BEGIN(id)            traceEvent((id), TRACE_EVENT_BEGIN)
+#define TRACE_END(id)              traceEvent((id), TRACE_EVENT_END)
+#define TRACE_CLOCK_HAS_CHANGED()  traceClockHasChanged()
+
+void traceInit(void);
+void traceEvent(uint8_t id, uint8_t type);
+void traceClockHasChanged(void);
+
+#else
+
+#define TRACE_BEGIN(id)            do {} while (0)
+#define TRACE_END(id)              do {} while (0)
+#define TRACE_CLOCK_HAS_CHANGED()  do {} while (0)
+
+#endif
+
+#endif /* _OPENGD77_TRACE_H_ */
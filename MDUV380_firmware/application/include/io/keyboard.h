@@ -150,6 +150,9 @@ bool keyboardKeyIsDTMFKey(char key);
 void keyboardCheckKeyEvent(keyboardCode_t *keys, int *event);
 bool keyboardScanKey(uint32_t scancode, char *keycode);
 
+void keyboardRotaryStep(int8_t direction);
+bool keyboardRotaryHasPendingSteps(void);
+
 void rotaryEncoderISR(void);
 
 
@@ -51,9 +51,17 @@ extern volatile int com_buffer_cnt;
 extern volatile int comRecvMMDVMIndexIn;
 extern volatile int comRecvMMDVMIndexOut;
 extern volatile int comRecvMMDVMFrameCount;
+extern volatile uint32_t comRecvMMDVMOverruns;
 extern volatile int com_request;
 extern volatile uint8_t com_requestbuffer[COM_REQUESTBUFFER_SIZE];
 
+// One MMDVMHost frame, in place in the circular com_requestbuffer (the second segment is only used when the frame wraps)
+typedef struct
+{
+	const uint8_t *segment[2];
+	uint16_t       length[2];
+} usbComFrameView_t;
+
 #if defined(PLATFORM_MD9600) || defined(PLATFORM_MDUV380)  || defined(PLATFORM_MD380) || defined(PLATFORM_RT84_DM1701)
 extern volatile uint8_t usbComSendBuf[COM_BUFFER_SIZE];
 #else
@@ -69,6 +77,11 @@ void send_packet_big(uint8_t val_0x82, uint8_t val_0x86, int ram1, int ram2);
 void add_to_commbuffer(uint8_t value);
 bool USB_DeviceIsResetting(void);
 
+bool usbComMMDVMFrameStore(const uint8_t *data, uint8_t length);
+bool usbComMMDVMFramePeek(usbComFrameView_t *view);
+void usbComMMDVMFrameRelease(const usbComFrameView_t *view);
+void usbComFrameViewCopy(const usbComFrameView_t *view, uint16_t offset, uint8_t *dest, uint16_t length);
+
 void USB_DEBUG_PRINT(char *str);
 void USB_DEBUG_printf(const char *format, ...) __attribute__((format(__printf__, 1, 2)));
 
@@ -321,6 +321,7 @@ const stringsTable_t germanLanguage =
 .auto_lock				= "Auto Lock", // MaxLen 16 (with ':' + .off or 0.5..15 (.5 step) + 'min')
 .trackball				= "Trackball", // MaxLen 16 (with ':' + .on or .off)
 .dmr_force_dmo				= "DMO Zwang", // MaxLen 16 (with ':' + .n_a or .on or .off)
+.cpu_load					= "CPU Last", // MaxLen 16
 };
 /********************************************************************
  *
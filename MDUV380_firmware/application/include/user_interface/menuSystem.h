@@ -65,12 +65,14 @@
 
 typedef enum
 {
-	NO_EVENT        = 0,
-	KEY_EVENT       = (1 << 0),
-	BUTTON_EVENT    = (1 << 1),
-	FUNCTION_EVENT  = (1 << 2),
-	ROTARY_EVENT    = (1 << 3),
-	SYNTHETIC_EVENT = (1 << 7)
+	NO_EVENT             = 0,
+	KEY_EVENT            = (1 << 0),
+	BUTTON_EVENT         = (1 << 1),
+	FUNCTION_EVENT       = (1 << 2),
+	ROTARY_EVENT         = (1 << 3),
+	DMR_CALL_START_EVENT = (1 << 4), // From the event bus, hasEvent isn't set
+	DMR_CALL_END_EVENT   = (1 << 5),
+	SYNTHETIC_EVENT      = (1 << 7)
 } uiEventInput_t;
 
 typedef enum
@@ -414,6 +416,7 @@ enum
 	RADIO_INFOS_LOCATION,
 	RADIO_INFOS_TEMPERATURE_LEVEL,
 	RADIO_INFOS_BATTERY_GRAPH,
+	RADIO_INFOS_CPU_LOAD,
 	NUM_RADIO_INFOS_MENU_ITEMS,
 	RADIO_INFOS_UP_TIME,
 	RADIO_INFOS_TIME_ALARM
@@ -176,10 +176,37 @@ typedef struct
 {
 	uint32_t			entries;
 	uint8_t				contactLength;
-	uint32_t			slices[ID_SLICES]; // [0] is min availabel ID, [ID_SLICES - 1] is max available ID
+	uint8_t				version; // 1: fixed length records, 2: dmrIDv2Header_t
+	uint32_t			slices[ID_SLICES]; // [0] is min availabel ID, [ID_SLICES - 1] is max available ID (v2: only these two)
 	uint32_t			IDsPerSlice;
 } dmrIDsCache_t;
 
+// DMR ID database version 2 (built by tools/dmrid_db_builder.py).
+// The header is followed by the block index (first ID of each block, uint32_t), then by the blocks, page aligned.
+// A block starts with its number of records, then for each record:
+//   - the ID delta from the previous record (from the block index for the first one), LEB128 encoded
+//   - the text length, in bytes
+// The texts (canonical Huffman coded, ended by the symbol 0) are stored backwards from the end of the block:
+// the first record's text ends the block. A lookup only reads the IDs and the text it's after.
+// Blocks fill the first DMR ID area, then the second one.
+#define DMRID_V2_BLOCK_SIZE                  256
+#define DMRID_V2_MAX_CODE_LENGTH             15
+#define DMRID_V2_MAX_SYMBOLS                 96
+#define DMRID_V2_FLAG_OVERWRITE_VP           0x01
+
+typedef struct __attribute__((__packed__))
+{
+	uint8_t				magic[4]; // "IDv2"
+	uint32_t			entries;
+	uint32_t			blocks;
+	uint32_t			lastId;
+	uint16_t			blockSize;
+	uint8_t				flags;
+	uint8_t				numSymbols;
+	uint8_t				codeLengthCounts[DMRID_V2_MAX_CODE_LENGTH + 1]; // number of codes of each length ([0] is unused)
+	uint8_t				symbols[DMRID_V2_MAX_SYMBOLS]; // in canonical codes order
+} dmrIDv2Header_t;
+
 
 #define TS_NO_OVERRIDE  0
 void tsSetManualOverride(Channel_t chan, int8_t ts);
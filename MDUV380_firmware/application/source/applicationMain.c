@@ -51,6 +51,9 @@
 #include "interfaces/settingsStorage.h"
 #include "interfaces/adc.h"
 #include "functions/rxPowerSaving.h"
+#include "interfaces/clockManager.h"
+#include "functions/eventBus.h"
+#include "interfaces/trace.h"
 
 #if defined(USING_EXTERNAL_DEBUGGER)
 #include "SeggerRTT/RTT/SEGGER_RTT.h"
@@ -333,7 +336,9 @@ void applicationMainTask(void)
 	bool forceSafeBootMode = false;
 
 	HAL_GPIO_WritePin(PWR_SW_GPIO_Port, PWR_SW_Pin, GPIO_PIN_SET);// keep the power on
-	//batteryRAM_Init(); // Unused, save power
+	//batteryRAM_Init(true); // Retention on VBAT is unused, save power (settingsStorage enables the access)
+
+	eventBusInit();
 
 	adcStartDMA();
 
@@ -410,6 +415,10 @@ void applicationMainTask(void)
 	SEGGER_RTT_printf(0,"Segger RTT initialised\n");
 #endif
 
+#if defined(USING_TRACE)
+	traceInit();
+#endif
+
 	buttonsInit();
 	keyboardInit();
 
@@ -449,6 +458,8 @@ void applicationMainTask(void)
 
 	soundInitBeepTask();
 
+	SPI_Flash_initMaintenanceTask();
+
 	// Clear boot melody and image
 #if defined(PLATFORM_MD9600)
 	if ((buttonsFrontPanelRead() & (FRONT_KEY_P3 | FRONT_KEY_DOWN)) == (FRONT_KEY_P3 | FRONT_KEY_DOWN))
@@ -510,9 +521,8 @@ void applicationMainTask(void)
 #if defined(LOG_GPS_DATA)
 	if (((buttons & BUTTON_SK1) == BUTTON_SK1) && (keyboardRead() == KEY_5))
 	{
-		uiNotificationShow(NOTIFICATION_TYPE_MESSAGE, NOTIFICATION_ID_MESSAGE, 1500, "NMEA Clearing", true);
+		uiNotificationShow(NOTIFICATION_TYPE_MESSAGE, NOTIFICATION_ID_MESSAGE, 1500, "GPS log clearing", true);
 		gpsLoggingClear();
-		settingsSet(nonVolatileSettings.gpsLogMemOffset, 0U);
 	}
 #endif
 
@@ -544,10 +554,37 @@ void applicationMainTask(void)
 	{
 		uint32_t startTime = ticksGetMillis();
 		bool syntheticEvent = false; // used to not trigger the backlight on faked key/button events
+		uiEventInput_t callEvents = NO_EVENT;
+		bool gpsHasData = false;
+		eventBusEvent_t busEvent;
 
 		mainIsRunning = true;
 		keyOrButtonChanged = false;
 
+		eventBusLoopIteration();
+
+		// Dispatch the events posted since the previous iteration
+		while (eventBusReceive(&busEvent))
+		{
+			switch (busEvent.type)
+			{
+				case EVENT_BUS_ROTARY:
+					keyboardRotaryStep((int8_t)busEvent.data);
+					break;
+				case EVENT_BUS_DMR_CALL_START:
+					callEvents |= DMR_CALL_START_EVENT;
+					break;
+				case EVENT_BUS_DMR_CALL_END:
+					callEvents |= DMR_CALL_END_EVENT;
+					break;
+				case EVENT_BUS_GPS_DATA:
+					gpsHasData = true;
+					break;
+				default: // Squelch and USB data only wake the loop up, their handlers poll
+					break;
+			}
+		}
+
 		tick_com_request();
 		handleTimerCallbacks();
 		batteryUpdate();
@@ -1227,7 +1264,7 @@ void applicationMainTask(void)
 		ev.buttons = buttons;
 		ev.keys = keys;
 		ev.rotary = rotary;
-		ev.events = function_event | (button_event << 1) | (rotary_event << 3) | key_event | (syntheticEvent ? SYNTHETIC_EVENT : 0);
+		ev.events = function_event | (button_event << 1) | (rotary_event << 3) | key_event | callEvents | (syntheticEvent ? SYNTHETIC_EVENT : 0);
 		ev.hasEvent = keyOrButtonChanged || (function_event != NO_EVENT);
 		ev.time = ticksGetMillis();
 
@@ -1344,6 +1381,10 @@ void applicationMainTask(void)
 		soundTickMelody();
 		voxTick();
 		gpsTick();
+		if (gpsHasData)
+		{
+			gpsProcessData();
+		}
 		aprsBeaconingTick(&ev);
 		settingsSaveIfNeeded(false);
 
@@ -1391,9 +1432,22 @@ void applicationMainTask(void)
 			updateVolumeGain(currentMenu);
 		}
 
-		while(ticksGetMillis() < startTime + 1)				// ensure this Task runs at 1ms intervals. Regardless of clock speed.
+		uint32_t radioDemand = ((((trxGetMode() == RADIO_MODE_DIGITAL) && rxPowerSavingIsRxOn()) ? CLOCK_MANAGER_DEMAND_DMR : 0U) |
+				((getAudioAmpStatus() != 0) ? CLOCK_MANAGER_DEMAND_AUDIO : 0U) |
+				((trxTransmissionEnabled || trxIsTransmitting) ? CLOCK_MANAGER_DEMAND_TX : 0U));
+
+		clockManagerGovernorTick(radioDemand);
+		SPI_Flash_maintenanceSetRadioIdle(radioDemand == 0U); // Background sector erases
+
+		// Sleep until the next iteration, an event (rotary, DMR call, USB, etc) wakes the loop up earlier.
+		uint32_t idleTicks = rxPowerSavingGetMainLoopIdleTicks();
+		if ((idleTicks > 0) && (keyboardRotaryHasPendingSteps() == false)) // One rotary step is given per iteration
+		{
+			eventBusWait(idleTicks); // RX is off, let the idle task put the MCU asleep
+		}
+		else if (ticksGetMillis() < (startTime + 1)) // ensure this Task runs at 1ms intervals. Regardless of clock speed.
 		{
-			vTaskDelay(0);
+			eventBusWait(1);
 		}
 	}
 }
@@ -28,6 +28,8 @@
 
 #include "dmr_codec/codec.h"
 #include "functions/voicePrompts.h"
+#include "interfaces/trace.h"
+#include "interfaces/runTimeStats.h"
 #include <string.h>
 
 static const uint8_t ambebuffer_decode_init[] = { 0xb0, 0x18, 0x00, 0x00, 0x7a, 0x15, 0x00, 0x00, 0x7a, 0x15, 0x00, 0x00, 0x60, 0x11, 0x00, 0x00,
@@ -732,6 +734,14 @@ uint8_t ambebuffer_decode[CODEC_DECODE_CONFIG_DATA_LENGTH];
 uint8_t ambebuffer_encode[CODEC_ENCODE_CONFIG_DATA_LENGTH];
 uint8_t ambebuffer_encode_ecc[CODEC_ECC_CONFIG_DATA_LENGTH];
 
+// Set by codecDecode()/codecEncodeBlock(), the working buffers only need to be restored from their init images when used
+volatile bool codecDecoderIsDirty = true;
+volatile bool codecEncoderIsDirty = true;
+
+static codecLatencyStats_t codecLatencyStats;
+static uint32_t codecLatencyStartCycles;
+static bool codecLatencyProbeArmed = false;
+
 
 static const uint32_t CREATOR_DATA_ARRAY[12] = { 0x063A, 0x031D, 0x07B4, 0x03DA, 0x01ED, 0x06CC, 0x0366, 0x01B3, 0x06E3, 0x054B, 0x049F, 0x0475};
 
@@ -1224,14 +1234,32 @@ static void codecRLE32_Decode(uint8_t *dest, const uint8_t *src, int len)
 	}
 }
 
+void codecResetDecoder(void)
+{
+	if (codecDecoderIsDirty)
+	{
+		memcpy(ambebuffer_decode, ambebuffer_decode_init, 0x07ec);
+		codecDecoderIsDirty = false;
+	}
+}
+
+void codecResetEncoder(void)
+{
+	if (codecEncoderIsDirty)
+	{
+		// 8 bits:  ~44 PITCounters, 1388 bytes, 694 pairs
+		// 16 bits: ~21 PITCounters, 501 bytes,  167 pairs
+		// 32 bits: ~11 PITCounters, 650 bytes,  130 pairs
+		codecRLE32_Decode(ambebuffer_encode, ambebuffer_encode_init_RLE32, 0x2000); // memcpy(ambebuffer_encode, ambebuffer_encode_init, 0x2000);
+		memcpy(ambebuffer_encode_ecc, ambebuffer_encode_ecc_init, 0x0100);
+		codecEncoderIsDirty = false;
+	}
+}
+
 void codecInitInternalBuffers(void)
 {
-	memcpy(ambebuffer_decode, ambebuffer_decode_init, 0x07ec);
-	// 8 bits:  ~44 PITCounters, 1388 bytes, 694 pairs
-	// 16 bits: ~21 PITCounters, 501 bytes,  167 pairs
-	// 32 bits: ~11 PITCounters, 650 bytes,  130 pairs
-	codecRLE32_Decode(ambebuffer_encode, ambebuffer_encode_init_RLE32, 0x2000); // memcpy(ambebuffer_encode, ambebuffer_encode_init, 0x2000);
-	memcpy(ambebuffer_encode_ecc, ambebuffer_encode_ecc_init, 0x0100);
+	codecResetDecoder();
+	codecResetEncoder();
 }
 
 void codecInit(bool fromVoicePrompts)
@@ -1246,6 +1274,33 @@ void codecInit(bool fromVoicePrompts)
 	soundInit();
 }
 
+// PTT to first AMBE frame latency probe
+void codecLatencyProbeStart(void)
+{
+	codecLatencyStartCycles = runTimeStatsGetCycles();
+	codecLatencyProbeArmed = true;
+}
+
+void codecLatencyProbeStop(void)
+{
+	if (codecLatencyProbeArmed)
+	{
+		codecLatencyProbeArmed = false;
+
+		codecLatencyStats.count++;
+		codecLatencyStats.lastLatencyUs = runTimeStatsCyclesToMicroseconds(runTimeStatsGetCycles() - codecLatencyStartCycles);
+		if (codecLatencyStats.lastLatencyUs > codecLatencyStats.maxLatencyUs)
+		{
+			codecLatencyStats.maxLatencyUs = codecLatencyStats.lastLatencyUs;
+		}
+	}
+}
+
+const codecLatencyStats_t *codecGetLatencyStats(void)
+{
+	return &codecLatencyStats;
+}
+
 bool codecIsAvailable(void)
 {
 	uint32_t *p1 = (uint32_t *)CODEC_LOCATION_1;
@@ -1261,9 +1316,11 @@ void codecEncodeInit(uint8_t *outdata_ptr)
 
 void codecEncode(uint8_t *outdata_ptr, int numbBlocks)
 {
+	TRACE_BEGIN(TRACE_ID_CODEC_ENCODE);
 	for (int i = 0; i < numbBlocks; i++)
 	{
 		codecEncodeBlock(outdata_ptr);
 		outdata_ptr += 9;
 	}
+	TRACE_END(TRACE_ID_CODEC_ENCODE);
 }
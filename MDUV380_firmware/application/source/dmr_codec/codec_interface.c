@@ -28,6 +28,7 @@
 
 #include "dmr_codec/codec.h"
 #include "functions/voicePrompts.h"
+#include "interfaces/trace.h"
 #include <string.h>
 
 static uint16_t bitbuffer_encode[72];
@@ -41,6 +42,9 @@ void codecDecode(uint8_t *indata_ptr, int numbBlocks)
 	register int r1 asm ("r1") __attribute__((unused));
 	register int r2 asm ("r2") __attribute__((unused));
 
+	TRACE_BEGIN(TRACE_ID_CODEC_DECODE);
+	codecDecoderIsDirty = true;
+
     for (int idx = 0; idx < numbBlocks; idx++)
     {
 		initFrame(indata_ptr, bitbuffer_decode);
@@ -90,6 +94,8 @@ void codecDecode(uint8_t *indata_ptr, int numbBlocks)
 
 		soundStoreBuffer();
     }
+
+	TRACE_END(TRACE_ID_CODEC_DECODE);
 }
 
 void codecEncodeBlock(uint8_t *outdata_ptr)
@@ -98,6 +104,8 @@ void codecEncodeBlock(uint8_t *outdata_ptr)
 	register int r1 asm ("r1") __attribute__((unused));
 	register int r2 asm ("r2") __attribute__((unused));
 
+	codecEncoderIsDirty = true;
+
 	memset((uint8_t *)outdata_ptr, 0, 9);// fills with zeros
 	memset(bitbuffer_encode, 0, sizeof(bitbuffer_encode));// faster to call memset as it will be compiled as optimised code
 
@@ -743,6 +743,9 @@ static bool aprsSendPacket(codeplugAPRS_Config_t *config, aprsBeaconingLocation_
 		Error_Handler();
 	}
 
+	// The period above is for the full speed clock
+	clockManagerTimersRescale();
+
 	TIM_MasterConfigTypeDef sMasterConfig = { 0 };
 	sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
 	sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
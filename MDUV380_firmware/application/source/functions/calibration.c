@@ -182,11 +182,13 @@ void calibrationInit(void)
 
 void calibrationReadLocal(void)
 {
+	trxTuningPlansInvalidate();
 	(void)SPI_Flash_read(CALIBRATION_TABLE_LOCAL_COPY_ADDRESS , (uint8_t *)&calibrationData, CALIBRATION_TABLE_LENGTH);
 }
 
 void calibrationSaveLocal(void)
 {
+	trxTuningPlansInvalidate();
 	(void)SPI_Flash_write(CALIBRATION_TABLE_LOCAL_COPY_ADDRESS , (uint8_t *)&calibrationData, CALIBRATION_TABLE_LENGTH);
 }
 
@@ -210,6 +212,7 @@ void calibrationReadFactory(bool applyConversion)
 #endif
 	};//fractionalPowers
 
+	trxTuningPlansInvalidate();
 	(void)SPI_Flash_readSecurityRegisters(0, (uint8_t *)&calibrationData, CALIBRATION_TABLE_LENGTH);
 
     memcpy(calibrationData.UHFCalFreqs[0] , MARKER_BYTES , MARKER_BYTES_LENGTH);
@@ -676,6 +679,8 @@ uint8_t calibrationGetPower(int freqindex, int powerindex)
 
 void calibrationPutPower(int freqindex, int powerindex, uint8_t val)
 {
+	trxTuningPlansInvalidate();
+
 	if (freqindex < 5)			//VHF calibration values
 	{
 		switch(powerindex)
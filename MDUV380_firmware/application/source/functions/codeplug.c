@@ -137,7 +137,18 @@ __attribute__((section(".data.$RAM2"))) codeplugContactsCache_t codeplugContacts
 __attribute__((section(".data.$RAM2"))) uint8_t codeplugRXGroupCache[CODEPLUG_RX_GROUPLIST_MAX];
 __attribute__((section(".data.$RAM2"))) uint8_t codeplugAllChannelsCache[128];
 __attribute__((section(".data.$RAM2"))) uint8_t codeplugZonesInUseCache[CODEPLUG_EX_ZONE_INUSE_PACKED_DATA_SIZE];
+// Rank/select over the in use bitmap, built by codeplugZonesInitCache() (CCM content isn't initialized at startup)
+__attribute__((section(".ccmram"))) uint8_t codeplugZonesIndexCache[CODEPLUG_EX_ZONE_INUSE_PACKED_DATA_SIZE * 8]; // zone number -> index in the zone list
+__attribute__((section(".ccmram"))) uint8_t codeplugZonesRankCache[CODEPLUG_EX_ZONE_INUSE_PACKED_DATA_SIZE]; // number of zones in use before each byte of the bitmap
+static int codeplugZonesCount = 1; // 'All Channels' included
+__attribute__((section(".ccmram"))) codeplugZoneHeader_t codeplugZoneHeadersCache[CODEPLUG_ZONES_MAX];
+static uint8_t codeplugZoneHeadersCacheValid[(CODEPLUG_ZONES_MAX + 7) / 8]; // In the zeroed .bss, a slot is only read once flagged here
 __attribute__((section(".data.$RAM2"))) uint16_t quickKeysCache[CODEPLUG_QUICKKEYS_SIZE];
+// Decoded channels, direct mapped on the channel index (consecutive channels never collide while browsing)
+#define CODEPLUG_CHANNEL_CACHE_SIZE 32
+__attribute__((section(".ccmram"))) struct_codeplugChannel_t codeplugChannelCache[CODEPLUG_CHANNEL_CACHE_SIZE]; // Cleared by codeplugAllChannelsInitCache()
+static uint16_t codeplugChannelCacheIndex[CODEPLUG_CHANNEL_CACHE_SIZE]; // 0: empty slot. In the zeroed .bss, as the slots are only read once flagged here
+static codeplugChannelCacheStats_t codeplugChannelCacheStats;
 
 __attribute__((section(".data.$RAM2"))) uint8_t lastUsedChannelInZoneData[CODEPLUG_ALL_ZONES_MAX + 1]; // All zones (0..79) + AllChannel 0..1023 (hence one extra byte to store this value)
 static bool lastUsedChannelInZoneHasChanged = false;
@@ -277,24 +288,62 @@ void codeplugUtilConvertStringToBuf(char *inBuf, char *outBuf, int len)
 
 void codeplugZonesInitCache(void)
 {
+	int count = 0;
+
+	memset(codeplugZonesIndexCache, 0, sizeof(codeplugZonesIndexCache));
+	memset(codeplugZoneHeadersCache, 0, sizeof(codeplugZoneHeadersCache));
 	EEPROM_Read(CODEPLUG_ADDR_EX_ZONE_INUSE_PACKED_DATA, (uint8_t *)&codeplugZonesInUseCache, CODEPLUG_EX_ZONE_INUSE_PACKED_DATA_SIZE);
+
+	for(int i = 0; i < CODEPLUG_EX_ZONE_INUSE_PACKED_DATA_SIZE; i++)
+	{
+		codeplugZonesRankCache[i] = count;
+
+		for(int j = 0; j < 8; j++)
+		{
+			if (((codeplugZonesInUseCache[i] >> j) & 0x01) == 0x01)
+			{
+				codeplugZonesIndexCache[count++] = (i * 8) + j;
+			}
+		}
+	}
+
+	codeplugZonesCount = count + 1;// Add one extra zone to allow for the special 'All Channels' Zone
+	memset(codeplugZoneHeadersCacheValid, 0, sizeof(codeplugZoneHeadersCacheValid));
 }
 
 int codeplugZonesGetCount(void)
 {
-	int numZones = 1;// Add one extra zone to allow for the special 'All Channels' Zone
+	return codeplugZonesCount;
+}
 
-	for(int i = 0; i < CODEPLUG_EX_ZONE_INUSE_PACKED_DATA_SIZE; i++)
+// Zone number of a zone list index, or -1 if that zone is not in use
+static int codeplugZoneGetNumberForIndex(int index)
+{
+	if ((index < 0) || (index >= (CODEPLUG_EX_ZONE_INUSE_PACKED_DATA_SIZE * 8)) || (((codeplugZonesInUseCache[index / 8] >> (index % 8)) & 0x01) == 0))
 	{
-		numZones += __builtin_popcount(codeplugZonesInUseCache[i]);
+		return -1;
 	}
 
-	return numZones;
+	return (codeplugZonesRankCache[index / 8] + __builtin_popcount(codeplugZonesInUseCache[index / 8] & ((1U << (index % 8)) - 1)));
+}
+
+static void codeplugZoneHeaderCacheStore(int zoneNum, struct_codeplugZone_t *zoneBuf)
+{
+	if ((zoneNum >= 0) && (zoneNum < CODEPLUG_ZONES_MAX))
+	{
+		codeplugZoneHeader_t *header = &codeplugZoneHeadersCache[zoneNum];
+
+		memcpy(header->name, zoneBuf->name, sizeof(header->name));
+		header->numChannelsInZone = zoneBuf->NOT_IN_CODEPLUGDATA_numChannelsInZone;
+		header->highestIndex = zoneBuf->NOT_IN_CODEPLUGDATA_highestIndex;
+		header->indexNumber = zoneBuf->NOT_IN_CODEPLUGDATA_indexNumber;
+		codeplugZoneHeadersCacheValid[zoneNum / 8] |= (1U << (zoneNum % 8));
+	}
 }
 
 bool codeplugZoneGetDataForNumber(int zoneNum, struct_codeplugZone_t *returnBuf)
 {
-	if (zoneNum == (codeplugZonesGetCount() - 1)) //special case: return a special Zone called 'All Channels'
+	if (zoneNum == (codeplugZonesCount - 1)) //special case: return a special Zone called 'All Channels'
 	{
 		int nameLen = SAFE_MIN(((int)sizeof(returnBuf->name)), ((int)strlen(currentLanguage->all_channels)));
 
@@ -310,60 +359,60 @@ bool codeplugZoneGetDataForNumber(int zoneNum, struct_codeplugZone_t *returnBuf)
 		returnBuf->NOT_IN_CODEPLUGDATA_indexNumber = -1;// Set as -1 as this is not a real zone. Its the "All Channels" zone
 		return true;
 	}
-	else
+	else if ((zoneNum >= 0) && (zoneNum < (codeplugZonesCount - 1)))
 	{
-		// Need to find the index into the Zones data for the specific Zone number.
-		// Because the Zones data is not guaranteed to be packed by the CPS (though we should attempt to make the CPS always pack the Zones)
-		int count = -1;// Need to start counting at -1 because the Zone number is zero indexed
-		int foundIndex = -1;
+		// The Zones data is not guaranteed to be packed by the CPS (though we should attempt to make the CPS always pack the Zones),
+		// hence the zone number to index lookup.
+		int foundIndex = codeplugZonesIndexCache[zoneNum];
+
+		// Save this in case we need to add channels to a zone and hence need the index number so it can be saved back to the codeplug memory
+		returnBuf->NOT_IN_CODEPLUGDATA_indexNumber = foundIndex;
+
+		// IMPORTANT. Write size is different from the size of the data, because it the zone struct contains properties not in the codeplug data
+		EEPROM_Read(CODEPLUG_ADDR_EX_ZONE_LIST + (foundIndex * (16 + (sizeof(uint16_t) * codeplugChannelsPerZone))),
+				(uint8_t *)returnBuf, ((codeplugChannelsPerZone == 16) ? CODEPLUG_ZONE_DATA_ORIGINAL_STRUCT_SIZE : CODEPLUG_ZONE_DATA_OPENGD77_STRUCT_SIZE));
+
 
-		// Go though each byte in the In Use table
-		for(int i = 0; i < CODEPLUG_EX_ZONE_INUSE_PACKED_DATA_SIZE; i++)
+		for(int i = 0; i < codeplugChannelsPerZone; i++)
 		{
-			// Go though each binary bit, counting them one by one
-			for(int j = 0; j < 8; j++)
+			// Empty channels seem to be filled with zeros, and zone could be full of channels.
+			if ((returnBuf->channels[i] == 0) || (i == (codeplugChannelsPerZone - 1)))
 			{
-				if (((codeplugZonesInUseCache[i] >> j) & 0x01) == 0x01)
-				{
-					count++;
-
-					if (count == zoneNum)
-					{
-						// found it. So save the index before we exit the "for" loops
-						foundIndex = (i * 8) + j;
-						break;// Will break out of this loop, but the outer loop breaks because it also checks for foundIndex
-					}
-				}
+				returnBuf->NOT_IN_CODEPLUGDATA_highestIndex = returnBuf->NOT_IN_CODEPLUGDATA_numChannelsInZone = (i + ((returnBuf->channels[i] == 0) ? 0 : 1));
+				codeplugZoneHeaderCacheStore(zoneNum, returnBuf);
+				return true;
 			}
 		}
+	}
 
-		if (foundIndex != -1)
-		{
-			// Save this in case we need to add channels to a zone and hence need the index number so it can be saved back to the codeplug memory
-			returnBuf->NOT_IN_CODEPLUGDATA_indexNumber = foundIndex;
+	memset(returnBuf->channels, 0, codeplugChannelsPerZone);
+	returnBuf->NOT_IN_CODEPLUGDATA_highestIndex = returnBuf->NOT_IN_CODEPLUGDATA_numChannelsInZone = 0;
+	returnBuf->NOT_IN_CODEPLUGDATA_indexNumber = -2; // we could not use '-1' on error, as -1 is All Channel zone
 
-			// IMPORTANT. Write size is different from the size of the data, because it the zone struct contains properties not in the codeplug data
-			EEPROM_Read(CODEPLUG_ADDR_EX_ZONE_LIST + (foundIndex * (16 + (sizeof(uint16_t) * codeplugChannelsPerZone))),
-					(uint8_t *)returnBuf, ((codeplugChannelsPerZone == 16) ? CODEPLUG_ZONE_DATA_ORIGINAL_STRUCT_SIZE : CODEPLUG_ZONE_DATA_OPENGD77_STRUCT_SIZE));
+	return false;
+}
 
+// Same as codeplugZoneGetDataForNumber(), without the channels list, but the flash is only read once per zone
+bool codeplugZoneGetHeaderForNumber(int zoneNum, codeplugZoneHeader_t *header)
+{
+	if ((zoneNum >= 0) && (zoneNum < CODEPLUG_ZONES_MAX) && (zoneNum < (codeplugZonesCount - 1)) &&
+			(codeplugZoneHeadersCacheValid[zoneNum / 8] & (1U << (zoneNum % 8))))
+	{
+		memcpy(header, &codeplugZoneHeadersCache[zoneNum], sizeof(codeplugZoneHeader_t));
+		return true;
+	}
+	else
+	{
+		struct_codeplugZone_t zoneBuf;
+		bool result = codeplugZoneGetDataForNumber(zoneNum, &zoneBuf);
 
-			for(int i = 0; i < codeplugChannelsPerZone; i++)
-			{
-				// Empty channels seem to be filled with zeros, and zone could be full of channels.
-				if ((returnBuf->channels[i] == 0) || (i == (codeplugChannelsPerZone - 1)))
-				{
-					returnBuf->NOT_IN_CODEPLUGDATA_highestIndex = returnBuf->NOT_IN_CODEPLUGDATA_numChannelsInZone = (i + ((returnBuf->channels[i] == 0) ? 0 : 1));
-					return true;
-				}
-			}
-		}
+		memcpy(header->name, zoneBuf.name, sizeof(header->name));
+		header->numChannelsInZone = zoneBuf.NOT_IN_CODEPLUGDATA_numChannelsInZone;
+		header->highestIndex = zoneBuf.NOT_IN_CODEPLUGDATA_highestIndex;
+		header->indexNumber = zoneBuf.NOT_IN_CODEPLUGDATA_indexNumber;
 
-		memset(returnBuf->channels, 0, codeplugChannelsPerZone);
-		returnBuf->NOT_IN_CODEPLUGDATA_highestIndex = returnBuf->NOT_IN_CODEPLUGDATA_numChannelsInZone = 0;
-		returnBuf->NOT_IN_CODEPLUGDATA_indexNumber = -2; // we could not use '-1' on error, as -1 is All Channel zone
+		return result;
 	}
-
-	return false;
 }
 
 bool codeplugZoneAddChannelToZoneAndSave(int channelIndex, struct_codeplugZone_t *zoneBuf)
@@ -372,6 +421,7 @@ bool codeplugZoneAddChannelToZoneAndSave(int channelIndex, struct_codeplugZone_t
 	{
 		zoneBuf->channels[zoneBuf->NOT_IN_CODEPLUGDATA_numChannelsInZone++] = channelIndex;// add channel to zone, and increment numb channels in zone
 		zoneBuf->NOT_IN_CODEPLUGDATA_highestIndex = zoneBuf->NOT_IN_CODEPLUGDATA_numChannelsInZone;
+		codeplugZoneHeaderCacheStore(codeplugZoneGetNumberForIndex(zoneBuf->NOT_IN_CODEPLUGDATA_indexNumber), zoneBuf);
 
 		// IMPORTANT. Write size is different from the size of the data, because it the zone struct contains properties not in the codeplug data
 		return EEPROM_Write(CODEPLUG_ADDR_EX_ZONE_LIST + (zoneBuf->NOT_IN_CODEPLUGDATA_indexNumber * (16 + (sizeof(uint16_t) * codeplugChannelsPerZone))),
@@ -447,6 +497,9 @@ void codeplugAllChannelsIndexSetUsed(int index)
 
 void codeplugAllChannelsInitCache(void)
 {
+	memset(codeplugChannelCache, 0, sizeof(codeplugChannelCache)); // CCM isn't initialized at startup
+	codeplugChannelCacheInvalidate();
+
 	// There are 8 banks
 	for (uint16_t bank = 0; bank < CODEPLUG_CHANNELS_BANKS_MAX; bank++)
 	{
@@ -604,8 +657,40 @@ void codeplugChannelGetDataWithOffsetAndLengthForIndex(int index, struct_codeplu
 	}
 }
 
+static void codeplugChannelCacheStore(int index, const struct_codeplugChannel_t *channelBuf)
+{
+	int slot = (index % CODEPLUG_CHANNEL_CACHE_SIZE);
+
+	memcpy(&codeplugChannelCache[slot], channelBuf, sizeof(struct_codeplugChannel_t));
+	codeplugChannelCache[slot].NOT_IN_CODEPLUG_flag = 0x00;
+	codeplugChannelCache[slot].NOT_IN_CODEPLUG_CALCULATED_DISTANCE_X10 = -1;
+	codeplugChannelCacheIndex[slot] = index;
+}
+
+void codeplugChannelCacheInvalidate(void)
+{
+	memset(codeplugChannelCacheIndex, 0, sizeof(codeplugChannelCacheIndex));
+	codeplugChannelCacheStats.invalidations++;
+}
+
+const codeplugChannelCacheStats_t *codeplugChannelCacheGetStats(void)
+{
+	return &codeplugChannelCacheStats;
+}
+
 void codeplugChannelGetDataForIndex(int index, struct_codeplugChannel_t *channelBuf)
 {
+	int slot = (index % CODEPLUG_CHANNEL_CACHE_SIZE);
+
+	if ((index >= CODEPLUG_CHANNELS_MIN) && (codeplugChannelCacheIndex[slot] == index))
+	{
+		memcpy(channelBuf, &codeplugChannelCache[slot], sizeof(struct_codeplugChannel_t));
+		codeplugChannelCacheStats.hits++;
+		return;
+	}
+
+	codeplugChannelCacheStats.misses++;
+
 	// Read the whole channel
 	codeplugChannelGetDataWithOffsetAndLengthForIndex(index, channelBuf, 0, CODEPLUG_CHANNEL_DATA_STRUCT_SIZE);
 
@@ -624,6 +709,12 @@ void codeplugChannelGetDataForIndex(int index, struct_codeplugChannel_t *channel
 	{
 		channelBuf->sql = 10;
 	}
+
+	if ((index >= CODEPLUG_CHANNELS_MIN) && (index <= CODEPLUG_CHANNELS_MAX))
+	{
+		codeplugChannelCacheStore(index, channelBuf);
+	}
+
 	/* 2020.10.27 vk3kyy - I don't think this is necessary as the function which loads the contact treats index = 0 as a special case and always loads TG 9
 	 *
 	// Sanity check the digital contact and set it to 1 is its not been assigned, even for FM channels, as the user could switch to DMR on this channel
@@ -636,6 +727,7 @@ void codeplugChannelGetDataForIndex(int index, struct_codeplugChannel_t *channel
 bool codeplugChannelSaveDataForIndex(int index, struct_codeplugChannel_t *channelBuf)
 {
 	bool retVal = true;
+	int channelIndex = index;
 #if defined(PLATFORM_MD9600)
 	bool outOfBandFlag = ((channelBuf->LibreDMR_flag1 & CODEPLUG_CHANNEL_LIBREDMR_FLAG1_OUT_OF_BAND) != 0);
 
@@ -739,6 +831,22 @@ errorExit:
 	channelBuf->txTone = codeplugCSSToInt(channelBuf->txTone);
 	channelBuf->rxTone = codeplugCSSToInt(channelBuf->rxTone);
 
+	// Write-through
+	if ((channelIndex >= CODEPLUG_CHANNELS_MIN) && (channelIndex <= CODEPLUG_CHANNELS_MAX))
+	{
+		if (retVal)
+		{
+			codeplugChannelCacheStore(channelIndex, channelBuf);
+#if defined(PLATFORM_MD9600)
+			codeplugChannelCache[channelIndex % CODEPLUG_CHANNEL_CACHE_SIZE].LibreDMR_flag1 &= ~CODEPLUG_CHANNEL_LIBREDMR_FLAG1_OUT_OF_BAND; // never saved
+#endif
+		}
+		else
+		{
+			codeplugChannelCacheIndex[channelIndex % CODEPLUG_CHANNEL_CACHE_SIZE] = 0;
+		}
+	}
+
 	return retVal;
 }
 
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <string.h>
+#include <FreeRTOS.h>
+#include <task.h>
+#include <queue.h>
+#include "functions/eventBus.h"
+#include "functions/ticks.h"
+#include "interfaces/runTimeStats.h"
+
+#define EVENT_BUS_QUEUE_LENGTH     16
+#define EVENT_BUS_STATS_PERIOD     1000U // ms
+
+typedef struct
+{
+	uint8_t  type;
+	uint8_t  data;
+	uint32_t postedCycles; // DWT cycles counter, for the latency statistics
+} eventBusQueuedEvent_t;
+
+static QueueHandle_t eventBusQueue = NULL;
+static eventBusStats_t eventBusStats;
+static uint32_t eventBusStatsStart = 0;
+static uint32_t eventBusLoopCount = 0;
+static uint32_t eventBusLatencySum = 0;
+static uint32_t eventBusLatencyCount = 0;
+static uint16_t eventBusDepth = 0; // Events received during the current iteration
+
+
+void eventBusInit(void)
+{
+	memset(&eventBusStats, 0, sizeof(eventBusStats));
+	eventBusStatsStart = ticksGetMillis();
+	eventBusQueue = xQueueCreate(EVENT_BUS_QUEUE_LENGTH, sizeof(eventBusQueuedEvent_t));
+}
+
+// Could be called from an interrupt handler or a task
+void eventBusPost(eventBusType_t type, uint8_t data)
+{
+	eventBusQueuedEvent_t event = { .type = type, .data = data, .postedCycles = runTimeStatsGetCycles() };
+	BaseType_t posted;
+
+	if (eventBusQueue == NULL)
+	{
+		return;
+	}
+
+	if (xPortIsInsideInterrupt())
+	{
+		BaseType_t higherPriorityTaskWoken = pdFALSE;
+
+		posted = xQueueSendFromISR(eventBusQueue, &event, &higherPriorityTaskWoken);
+
+		if (posted != pdTRUE)
+		{
+			UBaseType_t savedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+			eventBusStats.dropped++;
+			taskEXIT_CRITICAL_FROM_ISR(savedInterruptStatus);
+		}
+
+		portYIELD_FROM_ISR(higherPriorityTaskWoken);
+	}
+	else
+	{
+		posted = xQueueSend(eventBusQueue, &event, 0);
+
+		// The main loop is busy, it will run again anyway.
+		// A higher priority interrupt could post (and drop) at the same time.
+		if (posted != pdTRUE)
+		{
+			taskENTER_CRITICAL();
+			eventBusStats.dropped++;
+			taskEXIT_CRITICAL();
+		}
+	}
+}
+
+// Blocks the main loop until an event is posted, or the timeout has elapsed.
+// The events are left in the queue, eventBusReceive() gets them.
+void eventBusWait(TickType_t timeout)
+{
+	eventBusQueuedEvent_t event;
+
+	if (eventBusQueue == NULL)
+	{
+		vTaskDelay(timeout);
+		return;
+	}
+
+	xQueuePeek(eventBusQueue, &event, timeout);
+}
+
+// Gets the next pending event, without blocking. Main loop only.
+bool eventBusReceive(eventBusEvent_t *event)
+{
+	eventBusQueuedEvent_t queuedEvent;
+	uint32_t latencyUs;
+
+	if ((eventBusQueue == NULL) || (xQueueReceive(eventBusQueue, &queuedEvent, 0) != pdTRUE))
+	{
+		return false;
+	}
+
+	latencyUs = runTimeStatsCyclesToMicroseconds(runTimeStatsGetCycles() - queuedEvent.postedCycles);
+
+	if (queuedEvent.type < EVENT_BUS_NUM_TYPES)
+	{
+		eventBusStats.events[queuedEvent.type]++;
+	}
+
+	eventBusLatencySum += latencyUs;
+	eventBusLatencyCount++;
+
+	if (latencyUs > eventBusStats.latencyMaxUs)
+	{
+		eventBusStats.latencyMaxUs = ((latencyUs > UINT16_MAX) ? UINT16_MAX : latencyUs);
+	}
+
+	eventBusDepth++;
+	if (eventBusDepth > eventBusStats.queueMaxDepth)
+	{
+		eventBusStats.queueMaxDepth = eventBusDepth;
+	}
+
+	event->type = (eventBusType_t)queuedEvent.type;
+	event->data = queuedEvent.data;
+
+	return true;
+}
+
+void eventBusLoopIteration(void)
+{
+	uint32_t now = ticksGetMillis();
+	uint32_t elapsed = (now - eventBusStatsStart);
+
+	eventBusLoopCount++;
+	eventBusDepth = 0;
+
+	if (elapsed >= EVENT_BUS_STATS_PERIOD)
+	{
+		uint32_t loopsPerSecond = ((eventBusLoopCount * 1000U) / elapsed);
+		uint32_t latencyAvgUs = ((eventBusLatencyCount > 0) ? (eventBusLatencySum / eventBusLatencyCount) : 0);
+
+		eventBusStats.loopsPerSecond = ((loopsPerSecond > UINT16_MAX) ? UINT16_MAX : loopsPerSecond);
+		eventBusStats.latencyAvgUs = ((latencyAvgUs > UINT16_MAX) ? UINT16_MAX : latencyAvgUs);
+
+		eventBusLoopCount = 0;
+		eventBusLatencySum = 0;
+		eventBusLatencyCount = 0;
+		eventBusStatsStart = now;
+	}
+}
+
+// Consistent copy, the counters are updated by the main loop and the interrupt handlers
+void eventBusGetStats(eventBusStats_t *stats)
+{
+	taskENTER_CRITICAL();
+	memcpy(stats, &eventBusStats, sizeof(eventBusStats_t));
+	taskEXIT_CRITICAL();
+}
@@ -52,6 +52,7 @@
 #include "usb/usb_com.h"
 #include "functions/rxPowerSaving.h"
 #include "user_interface/uiHotspot.h"
+#include "interfaces/runTimeStats.h"
 #if defined(PLATFORM_MD9600) || defined(PLATFORM_MD380) || defined(PLATFORM_MDUV380) || defined(PLATFORM_RT84_DM1701) || defined(PLATFORM_MD2017)
 #include "hardware/radioHardwareInterface.h"
 #endif
@@ -81,6 +82,11 @@ static uint8_t setFreq(const uint8_t *data, uint8_t length);
 static void sendNAK(uint8_t cmd, uint8_t err);
 static void sendACK(uint8_t cmd);
 static uint8_t hotspotModeReceiveNetFrame(const uint8_t *comBuffer, uint8_t timeSlot);
+#if defined(STM32F405xx)
+static void hotspotUSBTransmitFrames(void);
+#endif
+static void hotspotNetFrameArrival(void);
+static int hotspotGetPrebufferFrames(void);
 static bool voiceLCHeaderDecode(const uint8_t *data, uint8_t type, DMRLC_t *lc);
 static bool DMRFullLC_encode(DMRLC_t *lc, uint8_t *data, uint8_t type);
 static void embeddedDataBuffersInt(void);
@@ -104,7 +110,10 @@ static const uint8_t MS_SOURCED_AUDIO_SYNC[]   = { 0x07, 0xF7, 0xD5, 0xDD, 0x57,
 static const uint8_t SYNC_MASK[]               = { 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 };
 static const uint8_t MMDVM_VOICE_SYNC_PATTERN = 0x20;
 static const int EMBEDDED_DATA_OFFSET = 13;
-static const int TX_BUFFER_MIN_BEFORE_TRANSMISSION = 4;
+static const int TX_BUFFER_MIN_BEFORE_TRANSMISSION = 1;
+static const int TX_BUFFER_MAX_BEFORE_TRANSMISSION = (HOTSPOT_BUFFER_COUNT / 2);
+static const uint32_t NET_FRAME_PERIOD = 60; // ms, one DMR voice burst
+static const uint32_t NET_JITTER_INITIAL = (60 << 4); // ms * 16, gives the former fixed prebuffering (5 frames) until the first measurements
 static const uint8_t START_FRAME_PATTERN[]  = { 0xFF,0x57,0xD7,0x5D,0xF5,0xD9 };
 static const uint8_t END_FRAME_PATTERN[]    = { 0x5D,0x7F,0x77,0xFD,0x75,0x79 };
 static const uint8_t VOICE_LC_SYNC_FULL[]       = { 0x04, 0x6D, 0x5D, 0x7F, 0x77, 0xFD, 0x75, 0x7E, 0x30 };
@@ -185,9 +194,21 @@ static uint8_t hotspotTxLC[9];
 static bool startedEmbeddedSearch = false;
 
 // USB TX read/write positions and count
+#if defined(STM32F405xx)
+#define USB_QUEUE_HEADER_SIZE (1 + sizeof(uint32_t)) // length, enqueuing time (in CPU cycles)
+#else
+#define USB_QUEUE_HEADER_SIZE 1
+#endif
 static volatile uint16_t usbComSendBufWritePosition = 0;
 static volatile uint16_t usbComSendBufReadPosition = 0;
 static volatile uint16_t usbComSendBufCount = 0;
+#if defined(STM32F405xx)
+static hotspotUSBTxStats_t usbTxStats;
+#if defined(MMDVM_SEND_DEBUG)
+static uint8_t usbDebugSendBuf[512];
+static uint16_t usbDebugSendBufLength = 0;
+#endif
+#endif
 
 // RF data read/write positions and count
 static volatile uint32_t rfFrameBufReadIdx = 0;
@@ -198,6 +219,11 @@ static uint8_t lastRxState = HOTSPOT_RX_IDLE;
 static const int TX_BUFFERING_TIMEOUT = 360;
 static const int RX_NET_FRAME_TIMEOUT = 360;
 static int timeoutCounter;
+static hotspotJitterStats_t jitterStats;
+static uint32_t netJitter = NET_JITTER_INITIAL; // ms * 16
+static uint32_t netFrameLastArrival = 0;
+static bool netFrameHasArrived = false;
+static volatile bool netFrameIsConcealed = false;
 static uint32_t mmdvmHostLastActiveTime = 0; // store last activity time (ms)
 static const uint32_t MMDVMHOST_TIMEOUT = 20000; // 20s timeout (MMDVMHost mode only, there is no timeout for BlueDV)
 static volatile HOTSPOT_STATE hotspotState = HOTSPOT_STATE_NOT_CONNECTED;
@@ -1438,47 +1464,35 @@ void handleHotspotRequest(void)
 {
 	mmdvmHostLastActiveTime = ticksGetMillis(); // MMDVMHost sign of life.
 
-	// Rebuild the MMDVMHost frame stored in the USB (circular) buffer
-	uint8_t currentFrame[256]; // Absolute max frame length that MMDVMHost can send (+1)
-	uint8_t frameLength = (com_requestbuffer[comRecvMMDVMIndexOut++] - 1); // Remove our data block length header
+	// Parse the MMDVMHost frame in place in the USB (circular) buffer, it's only rebuilt when it wraps
+	uint8_t linearFrame[256]; // Absolute max frame length that MMDVMHost can send (+1)
+	const uint8_t *currentFrame;
+	usbComFrameView_t frameView;
+	uint8_t frameLength;
+	bool frameIsValid = false;
 
-	// Make sure the index stays within limits.
-	if (comRecvMMDVMIndexOut >= COM_REQUESTBUFFER_SIZE)
+	if (usbComMMDVMFramePeek(&frameView) == false)
 	{
-		comRecvMMDVMIndexOut = 0;
+		return;
 	}
 
-	// Extract the MMDVMHost frame
-	for (uint8_t i = 0; i < frameLength; i++)
-	{
-		currentFrame[i] = com_requestbuffer[comRecvMMDVMIndexOut++];
-
-		// Make sure the index stays within limits.
-		if (comRecvMMDVMIndexOut >= COM_REQUESTBUFFER_SIZE)
-		{
-			comRecvMMDVMIndexOut = 0;
-		}
-	}
+	frameLength = frameView.length[0] + frameView.length[1];
 
-	// Make sure the index stays within limits.
-	if (comRecvMMDVMIndexOut >= COM_REQUESTBUFFER_SIZE)
+	if (frameView.length[1] == 0)
 	{
-		comRecvMMDVMIndexOut = 0;
+		currentFrame = frameView.segment[0];
 	}
-
-	// Decrement the frame counter
-	comRecvMMDVMFrameCount--;
-
-	// Something went wrong, resync to the RX buffer
-	if (comRecvMMDVMFrameCount < 0)
+	else
 	{
-		comRecvMMDVMIndexIn = comRecvMMDVMIndexOut = 0; // Resync, it may skip few frames.
-		comRecvMMDVMFrameCount = 0;
+		usbComFrameViewCopy(&frameView, 0, linearFrame, frameLength);
+		currentFrame = linearFrame;
 	}
 
 	// Handle the frame, if valid.
 	if (currentFrame[0] == MMDVM_FRAME_START)
 	{
+		frameIsValid = true;
+
 		uint8_t err = 2;
 
 		switch(currentFrame[2])
@@ -1649,7 +1663,10 @@ void handleHotspotRequest(void)
 				break;
 		}
 	}
-	else
+
+	usbComMMDVMFrameRelease(&frameView);
+
+	if (frameIsValid == false)
 	{
 		// Invalid MMDVM header byte: resync (it may skip few frames).
 		comRecvMMDVMIndexIn = comRecvMMDVMIndexOut = 0;
@@ -1728,31 +1745,179 @@ void handleHotspotRequest(void)
 }
 
 
-// Queue system is a single byte header containing the length of the item, followed by the data
+// Queue system is a header containing the length of the item and its enqueuing time, followed by the data
 // if the block won't fit in the space between the current write location and the end of the buffer,
-// a zero is written to the length for that block and the data and its length byte is put at the beginning of the buffer
+// 0xFF is written to the length for that block and the data and its header is put at the beginning of the buffer
 void enqueueUSBData(uint8_t *data, uint8_t length)
 {
-	if ((usbComSendBufWritePosition + (length + 1)) > (COM_BUFFER_SIZE - 1))
+#if defined(STM32F405xx)
+	uint32_t enqueueTime = runTimeStatsGetCycles();
+
+	taskENTER_CRITICAL();
+
+#if defined(MMDVM_SEND_DEBUG)
+	// Debug frames only go out when all the other frames have been sent
+	if ((length >= 3) && (data[2] >= MMDVM_DEBUG1) && (data[2] <= MMDVM_DEBUG5))
+	{
+		if ((usbDebugSendBufLength + length) <= sizeof(usbDebugSendBuf))
+		{
+			memcpy(&usbDebugSendBuf[usbDebugSendBufLength], data, length);
+			usbDebugSendBufLength += length;
+		}
+
+		hotspotUSBTransmitFrames();
+		taskEXIT_CRITICAL();
+		return;
+	}
+#endif
+#endif
+
+	if ((usbComSendBufWritePosition + (length + USB_QUEUE_HEADER_SIZE)) > (COM_BUFFER_SIZE - 1))
 	{
 		usbComSendBuf[usbComSendBufWritePosition] = 0xFF; // flag that the data block won't fit and will be put at the start of the buffer
 		usbComSendBufWritePosition = 0;
 	}
 
 	usbComSendBuf[usbComSendBufWritePosition] = length;
-	memcpy((uint8_t *)&usbComSendBuf[usbComSendBufWritePosition + 1], data, length);
-	usbComSendBufWritePosition += (length + 1);
+#if defined(STM32F405xx)
+	memcpy((uint8_t *)&usbComSendBuf[usbComSendBufWritePosition + 1], &enqueueTime, sizeof(uint32_t));
+#endif
+	memcpy((uint8_t *)&usbComSendBuf[usbComSendBufWritePosition + USB_QUEUE_HEADER_SIZE], data, length);
+	usbComSendBufWritePosition += (length + USB_QUEUE_HEADER_SIZE);
 	usbComSendBufCount++;
 
-	if (length <= 1)
+#if defined(STM32F405xx)
+	// Start a transfer right away if the IN endpoint is idle, otherwise the transfer complete callback will do it
+	hotspotUSBTransmitFrames();
+	taskEXIT_CRITICAL();
+#endif
+}
+
+#if defined(STM32F405xx)
+static uint8_t hotspotLog2Bin(uint32_t value, uint8_t firstBit, uint8_t numBins)
+{
+	uint8_t bit;
+
+	if (value < (1U << firstBit))
 	{
-		// Blah
+		return 0;
 	}
 
+	bit = (31 - __builtin_clz(value)) - firstBit;
+
+	return ((bit < (numBins - 1)) ? bit + 1 : (numBins - 1));
 }
 
+// Pack as many queued frames as possible into one CDC IN transfer.
+// It has to be called with the USB interrupt masked, or from the USB ISR.
+static void hotspotUSBTransmitFrames(void)
+{
+	uint8_t *txBuf;
+	uint16_t txLength = 0;
+	uint32_t now;
+
+#if defined(MMDVM_SEND_DEBUG)
+	if (((usbComSendBufCount == 0) && (usbDebugSendBufLength == 0)) || ((txBuf = CDC_AcquireTxBuffer_FS()) == NULL))
+#else
+	if ((usbComSendBufCount == 0) || ((txBuf = CDC_AcquireTxBuffer_FS()) == NULL))
+#endif
+	{
+		return;
+	}
+
+	now = runTimeStatsGetCycles();
+
+	if (usbComSendBufCount > 0)
+	{
+		usbTxStats.depth[hotspotLog2Bin(usbComSendBufCount, 1, HOTSPOT_USB_TX_DEPTH_BINS)]++;
+		if (usbComSendBufCount > usbTxStats.maxDepth)
+		{
+			usbTxStats.maxDepth = usbComSendBufCount;
+		}
+	}
+
+	while (usbComSendBufCount > 0)
+	{
+		uint32_t enqueueTime;
+		uint8_t len;
+
+		if (usbComSendBuf[usbComSendBufReadPosition] == 0xFF) // End marker
+		{
+			usbComSendBuf[usbComSendBufReadPosition] = 0;
+			usbComSendBufReadPosition = 0;
+		}
+
+		len = usbComSendBuf[usbComSendBufReadPosition];
+
+		if (len >= 3) // the shortest MMDVM frame length (3 = DMRLost)
+		{
+			if ((txLength + len) > APP_TX_DATA_SIZE)
+			{
+				break;
+			}
+
+			memcpy(&txBuf[txLength], (uint8_t *)&usbComSendBuf[usbComSendBufReadPosition + USB_QUEUE_HEADER_SIZE], len);
+			txLength += len;
+
+			memcpy(&enqueueTime, (uint8_t *)&usbComSendBuf[usbComSendBufReadPosition + 1], sizeof(uint32_t));
+			usbTxStats.latency[hotspotLog2Bin(runTimeStatsCyclesToMicroseconds(now - enqueueTime), 6, HOTSPOT_USB_TX_LATENCY_BINS)]++;
+			usbTxStats.frames++;
+		}
+
+		usbComSendBufReadPosition += (len + USB_QUEUE_HEADER_SIZE);
+
+		if (usbComSendBufReadPosition >= (COM_BUFFER_SIZE - 1)) // reaching the end of the buffer
+		{
+			usbComSendBufReadPosition = 0;
+		}
+
+		usbComSendBufCount--;
+	}
+
+#if defined(MMDVM_SEND_DEBUG)
+	// Debug frames fill the remaining space
+	if (usbComSendBufCount == 0)
+	{
+		uint16_t debugLength = 0;
+
+		while ((debugLength < usbDebugSendBufLength) && ((txLength + usbDebugSendBuf[debugLength + 1]) <= APP_TX_DATA_SIZE))
+		{
+			memcpy(&txBuf[txLength], &usbDebugSendBuf[debugLength], usbDebugSendBuf[debugLength + 1]);
+			txLength += usbDebugSendBuf[debugLength + 1];
+			debugLength += usbDebugSendBuf[debugLength + 1];
+		}
+
+		usbDebugSendBufLength -= debugLength;
+		memmove(&usbDebugSendBuf[0], &usbDebugSendBuf[debugLength], usbDebugSendBufLength);
+	}
+#endif
+
+	if ((txLength > 0) && (CDC_TransmitTxBuffer_FS(txLength) == USBD_OK))
+	{
+		usbTxStats.transfers++;
+	}
+}
+
+// Called from the USB ISR, once the previous IN transfer is complete
+void hotspotUSBTransmitComplete(void)
+{
+	hotspotUSBTransmitFrames();
+}
+
+const hotspotUSBTxStats_t *hotspotGetUSBTxStats(void)
+{
+	return &usbTxStats;
+}
+#endif
+
 void processUSBDataQueue(void)
 {
+#if defined(STM32F405xx)
+	// Frames are normally sent from enqueueUSBData() and the transfer complete callback, this only restarts a stalled queue
+	taskENTER_CRITICAL();
+	hotspotUSBTransmitFrames();
+	taskEXIT_CRITICAL();
+#else
 	if (usbComSendBufCount > 0)
 	{
 		if (usbComSendBuf[usbComSendBufReadPosition] == 0xFF) // End marker
@@ -1761,23 +1926,17 @@ void processUSBDataQueue(void)
 			usbComSendBufReadPosition = 0;
 		}
 
-		uint8_t len = usbComSendBuf[usbComSendBufReadPosition] + 1;
+		uint8_t len = usbComSendBuf[usbComSendBufReadPosition] + USB_QUEUE_HEADER_SIZE;
 
-		if (len < (3 + 1)) // the shortest MMDVM frame length (3 = DMRLost)
+		if (len < (3 + USB_QUEUE_HEADER_SIZE)) // the shortest MMDVM frame length (3 = DMRLost)
 		{
 			usbComSendBufCount--;
 		}
 		else
 		{
-#if defined(STM32F405xx)
-			uint8_t status = CDC_Transmit_FS((uint8_t *)&usbComSendBuf[usbComSendBufReadPosition + 1], usbComSendBuf[usbComSendBufReadPosition]);
-
-			if (status == USBD_OK)
-#else
-			usb_status_t status = USB_DeviceCdcAcmSend(s_cdcVcom.cdcAcmHandle, USB_CDC_VCOM_BULK_IN_ENDPOINT, &usbComSendBuf[usbComSendBufReadPosition + 1], usbComSendBuf[usbComSendBufReadPosition]);
+			usb_status_t status = USB_DeviceCdcAcmSend(s_cdcVcom.cdcAcmHandle, USB_CDC_VCOM_BULK_IN_ENDPOINT, &usbComSendBuf[usbComSendBufReadPosition + USB_QUEUE_HEADER_SIZE], usbComSendBuf[usbComSendBufReadPosition]);
 
 			if (status == kStatus_USB_Success)
-#endif
 			{
 				usbComSendBufReadPosition += len;
 
@@ -1794,6 +1953,7 @@ void processUSBDataQueue(void)
 			}
 		}
 	}
+#endif
 }
 
 static void swapWithFakeTA(uint8_t *lc)
@@ -2023,6 +2183,72 @@ static bool getEmbeddedData(volatile const uint8_t *comBuffer)
 	return false;
 }
 
+// Network frames inter-arrival jitter (RFC 3550 like estimator), used to size the TX prebuffering
+static void hotspotNetFrameArrival(void)
+{
+	uint32_t now = ticksGetMillis();
+
+	if (netFrameHasArrived)
+	{
+		uint32_t interval = now - netFrameLastArrival;
+		uint32_t deviation = ((interval > NET_FRAME_PERIOD) ? (interval - NET_FRAME_PERIOD) : (NET_FRAME_PERIOD - interval)) << 4;
+
+		// Ignore the gaps between two streams
+		if (interval < (NET_FRAME_PERIOD * 20))
+		{
+			if (deviation > netJitter)
+			{
+				netJitter += (deviation - netJitter) / 4; // fast attack
+			}
+			else
+			{
+				netJitter -= (netJitter - deviation) / 16;
+			}
+		}
+	}
+
+	netFrameLastArrival = now;
+	netFrameHasArrived = true;
+
+	jitterStats.jitterMs = (netJitter >> 4);
+	jitterStats.prebufferFrames = hotspotGetPrebufferFrames();
+}
+
+// Number of frames to have in the TX buffer before starting to transmit, enough to absorb ~3 times the jitter
+static int hotspotGetPrebufferFrames(void)
+{
+	int frames = TX_BUFFER_MIN_BEFORE_TRANSMISSION + (((3 * netJitter) + ((NET_FRAME_PERIOD << 4) - 1)) / (NET_FRAME_PERIOD << 4));
+
+	return CLAMP(frames, TX_BUFFER_MIN_BEFORE_TRANSMISSION, TX_BUFFER_MAX_BEFORE_TRANSMISSION);
+}
+
+// Called from the timeslot ISR when no network frame is ready to be sent.
+// Returns true if the previous frame has to be repeated (first missing frame), otherwise silence is sent.
+bool hotspotTxFrameIsMissing(bool canRepeat)
+{
+	if (hotspotState != HOTSPOT_STATE_TRANSMITTING)
+	{
+		netFrameIsConcealed = false;
+		return false;
+	}
+
+	netFrameIsConcealed = true;
+
+	if (canRepeat)
+	{
+		jitterStats.concealedRepeat++;
+		return true;
+	}
+
+	jitterStats.concealedSilence++;
+	return false;
+}
+
+const hotspotJitterStats_t *hotspotGetJitterStats(void)
+{
+	return &jitterStats;
+}
+
 static void storeNetFrame(volatile const uint8_t *comBuffer)
 {
 	bool foundEmbedded;
@@ -2051,11 +2277,24 @@ static void storeNetFrame(volatile const uint8_t *comBuffer)
 		hotspotState == HOTSPOT_STATE_TX_SHUTDOWN  ||
 		hotspotState == HOTSPOT_STATE_TX_START_BUFFERING)
 	{
+		hotspotNetFrameArrival();
+
 		if (wavbuffer_count >= HOTSPOT_BUFFER_COUNT)
 		{
 			// Buffer overflow
+			jitterStats.dropped++;
+			return;
 		}
 
+		if (netFrameIsConcealed)
+		{
+			// This frame slot has already been concealed
+			jitterStats.late++;
+			netFrameIsConcealed = false;
+		}
+
+		jitterStats.frames++;
+
 		taskENTER_CRITICAL();
 		memcpy((uint8_t *)&audioAndHotspotDataBuffer.hotspotBuffer[wavbuffer_write_idx][LC_DATA_LENGTH], (uint8_t *)comBuffer + 4, 13);//copy the first 13, whole bytes of audio
 		audioAndHotspotDataBuffer.hotspotBuffer[wavbuffer_write_idx][LC_DATA_LENGTH + 13] = (comBuffer[17] & 0xF0) | (comBuffer[23] & 0x0F);
@@ -2490,7 +2729,7 @@ void hotspotStateMachine(void)
 			}
 			else
 			{
-				if (wavbuffer_count > TX_BUFFER_MIN_BEFORE_TRANSMISSION)
+				if (wavbuffer_count > hotspotGetPrebufferFrames())
 				{
 					if (hotspotCwKeying == false)
 					{
@@ -2663,10 +2902,15 @@ void hotspotInit(void)
 	}
 
 	// Clear USB TX buffers
+	taskENTER_CRITICAL();
 	usbComSendBufWritePosition = 0;
 	usbComSendBufReadPosition = 0;
 	usbComSendBufCount = 0;
 	memset((uint8_t *)&usbComSendBuf, 0, sizeof(usbComSendBuf));
+#if defined(MMDVM_SEND_DEBUG) && defined(STM32F405xx)
+	usbDebugSendBufLength = 0;
+#endif
+	taskEXIT_CRITICAL();
 
 	trxSetModeAndBandwidth(RADIO_MODE_DIGITAL, false);// hotspot mode is for DMR i.e Digital mode
 
@@ -31,14 +31,52 @@
 #include "functions/ticks.h"
 #include <interfaces/clockManager.h>
 #include "usb/usb_com.h"
+#include "hardware/HR-C6000.h"
 
 
 #define LOW_SPEED_CLOCK_ECO_THRESHOLD 2
+#define MAIN_LOOP_IDLE_TICKS          2 // Minimum value to let the tickless idle kick in (see configEXPECTED_IDLE_TIME_BEFORE_SLEEP)
 static ecoPhase_t rxPowerSavingState = ECOPHASE_POWERSAVE_INACTIVE;
 static ticksTimer_t ecoPhaseTimer = { 0, 0 };
 volatile static int powerSavingLevel = 1;
 static bool hrc6000IsPoweredOff = false;
 
+//
+// Channel activity statistics, used to adapt the RX off period: longer on a quiet channel, shorter on a busy one.
+// One entry per receive frequency (and TG, in DMR), the least recently used one is recycled.
+// The off period is a scale (in 1/8) of the level's fixed period. It's only lengthened up to the worst case
+// latency to catch a transmission start (power up and RSSI/noise sampling included), so the levels
+// which are already above it can only be shortened. tools/rx_power_saving_sim.py mirrors this policy.
+//
+#define RX_ACTIVITY_CHANNELS_MAX               8
+#define RX_ACTIVITY_SCORE_EVENT              256 // added on each carrier or DMR sync start
+#define RX_ACTIVITY_SCORE_DECAY_PERIOD     60000 // ms, the score loses 1/16 each period (~11 minutes half-life)
+#define RX_ACTIVITY_RECENT_PERIOD          30000 // ms, a reply is likely to follow
+#define RX_ACTIVITY_OFF_SCALE_MIN              4 // x0.5, busy channel
+#define RX_ACTIVITY_OFF_SCALE_BASE             8 // x1, new channel
+#define RX_ACTIVITY_OFF_SCALE_MAX             32 // x4, long quiet time
+#define RX_ACTIVITY_OFF_SCALE_QUIET_STEP       2 // added for each quiet minute
+#define RX_ACTIVITY_MAX_LATENCY             1000 // ms
+#define RX_ACTIVITY_MAX_OFF_PERIOD          (RX_ACTIVITY_MAX_LATENCY - (2 * RSSI_NOISE_SAMPLE_PERIOD_PIT))
+
+typedef struct
+{
+	uint32_t frequency;
+	uint32_t talkGroup;
+	uint32_t lastActivityTime; // ms, or when the entry has been created
+	uint32_t lastDecayTime;
+	uint32_t lastUsedTime;
+	uint16_t score;
+	uint16_t carrierCount;
+	uint16_t syncCount;
+	bool     hasActivity;
+} rxActivityChannel_t;
+
+static rxActivityChannel_t rxActivityChannels[RX_ACTIVITY_CHANNELS_MAX];
+static rxActivityChannel_t *rxActivityCurrent = NULL;
+static bool rxActivityHadCarrier = false;
+static bool rxActivityHadSync = false;
+
 
 
 bool rxPowerSavingIsRxOn(void)
@@ -72,6 +110,7 @@ static void resumeBeepAndC6000Tasks(void)
 	vTaskResume(beepTask.Handle);
 	beepTask.Running = true;
 	beepTask.AliveCount = TASK_FLAGGED_ALIVE;
+	clockManagerSetTicklessIdleAllowed(false);
 	//HRC6000FlushMusic();							//G4EML   Needed after restarting the HRC6000 Task to prevent missing DMR audio;
 }
 
@@ -81,6 +120,124 @@ static void suspendBeepAndC6000Tasks(void)
 	beepTask.Running = false;
 	vTaskSuspend(hrc6000Task.Handle);
 	hrc6000Task.Running = false;
+	clockManagerSetTicklessIdleAllowed(true);
+}
+
+// Returns the number of ticks the main loop can block, giving the CPU to the idle task.
+// This only happens while the RX is powered off and the radio tasks are suspended.
+uint32_t rxPowerSavingGetMainLoopIdleTicks(void)
+{
+	if ((rxPowerSavingState == ECOPHASE_POWERSAVE_ACTIVE___RX_IS_OFF) && clockManagerIsTicklessIdleAllowed() &&
+			(ticksTimerRemaining(&ecoPhaseTimer) > MAIN_LOOP_IDLE_TICKS))
+	{
+		return MAIN_LOOP_IDLE_TICKS;
+	}
+
+	return 0;
+}
+
+static rxActivityChannel_t *rxActivityGetChannel(uint32_t now)
+{
+	uint32_t frequency = currentChannelData->rxFreq;
+	uint32_t talkGroup = ((trxGetMode() == RADIO_MODE_DIGITAL) ? trxTalkGroupOrPcId : 0U);
+	rxActivityChannel_t *channel = rxActivityCurrent;
+
+	if ((channel == NULL) || (channel->frequency != frequency) || (channel->talkGroup != talkGroup))
+	{
+		channel = &rxActivityChannels[0];
+
+		for (int i = 0; i < RX_ACTIVITY_CHANNELS_MAX; i++)
+		{
+			if ((rxActivityChannels[i].frequency == frequency) && (rxActivityChannels[i].talkGroup == talkGroup))
+			{
+				channel = &rxActivityChannels[i];
+				break;
+			}
+
+			if ((now - rxActivityChannels[i].lastUsedTime) > (now - channel->lastUsedTime))
+			{
+				channel = &rxActivityChannels[i];
+			}
+		}
+
+		if ((channel->frequency != frequency) || (channel->talkGroup != talkGroup))
+		{
+			memset(channel, 0, sizeof(rxActivityChannel_t));
+			channel->frequency = frequency;
+			channel->talkGroup = talkGroup;
+			channel->lastActivityTime = now;
+			channel->lastDecayTime = now;
+		}
+
+		rxActivityCurrent = channel;
+	}
+
+	channel->lastUsedTime = now;
+
+	return channel;
+}
+
+// Count the carrier and DMR sync starts of the current channel, and when it was last active
+static void rxActivityUpdate(bool hasSignal)
+{
+	uint32_t now = ticksGetMillis();
+	rxActivityChannel_t *channel = rxActivityGetChannel(now);
+	bool hasSync = ((trxGetMode() == RADIO_MODE_DIGITAL) && (slotState != DMR_STATE_IDLE));
+	uint32_t decayPeriods = ((now - channel->lastDecayTime) / RX_ACTIVITY_SCORE_DECAY_PERIOD);
+
+	if (decayPeriods > 0)
+	{
+		while ((decayPeriods-- > 0) && (channel->score > 0))
+		{
+			channel->score -= ((channel->score + 15) >> 4);
+		}
+		channel->lastDecayTime = now;
+	}
+
+	if ((hasSignal && (rxActivityHadCarrier == false)) || (hasSync && (rxActivityHadSync == false)))
+	{
+		channel->score = MIN((channel->score + RX_ACTIVITY_SCORE_EVENT), UINT16_MAX);
+		channel->hasActivity = true;
+
+		if (hasSync && (rxActivityHadSync == false))
+		{
+			channel->syncCount++;
+		}
+		else
+		{
+			channel->carrierCount++;
+		}
+	}
+
+	if (hasSignal || hasSync)
+	{
+		channel->lastActivityTime = now;
+	}
+
+	rxActivityHadCarrier = hasSignal;
+	rxActivityHadSync = hasSync;
+}
+
+static uint32_t rxActivityGetOffPeriod(uint32_t fixedPeriod, uint32_t onPeriod)
+{
+	int scale = RX_ACTIVITY_OFF_SCALE_BASE;
+
+	if (rxActivityCurrent != NULL)
+	{
+		uint32_t quietTime = (ticksGetMillis() - rxActivityCurrent->lastActivityTime);
+
+		if (rxActivityCurrent->hasActivity && (quietTime < RX_ACTIVITY_RECENT_PERIOD))
+		{
+			scale = RX_ACTIVITY_OFF_SCALE_MIN;
+		}
+		else
+		{
+			scale = MIN((RX_ACTIVITY_OFF_SCALE_BASE + ((quietTime / 60000) * RX_ACTIVITY_OFF_SCALE_QUIET_STEP)), RX_ACTIVITY_OFF_SCALE_MAX);
+			scale -= MIN((rxActivityCurrent->score / RX_ACTIVITY_SCORE_EVENT), (scale - RX_ACTIVITY_OFF_SCALE_MIN));
+		}
+	}
+
+	return CLAMP(((fixedPeriod * scale) / RX_ACTIVITY_OFF_SCALE_BASE), onPeriod, MAX(fixedPeriod, RX_ACTIVITY_MAX_OFF_PERIOD));
 }
 
 void rxPowerSavingSetState(ecoPhase_t newState)
@@ -99,7 +256,7 @@ void rxPowerSavingSetState(ecoPhase_t newState)
 		{
 			if (powerSavingLevel >= LOW_SPEED_CLOCK_ECO_THRESHOLD)
 			{
-				clockManagerSetRunMode(kAPP_PowerModeRun, CLOCK_MANAGER_SPEED_RUN);
+				clockManagerGovernorSetEcoAllowed(false);
 				resumeBeepAndC6000Tasks();
 			}
 
@@ -112,6 +269,8 @@ void rxPowerSavingTick(uiEvent_t *ev, bool hasSignal)
 {
 	if ((settingsUsbMode != USB_MODE_HOTSPOT) || (rxPowerSavingState != ECOPHASE_POWERSAVE_INACTIVE))
 	{
+		rxActivityUpdate(hasSignal);
+
 		if (USB_DeviceIsResetting() || isCompressingAMBE || hasSignal || trxTransmissionEnabled || trxIsTransmitting ||
 				(menuSystemGetCurrentMenuNumber() == UI_TX_SCREEN) || (menuSystemGetCurrentMenuNumber() == UI_CPS) ||
 				(uiDataGlobal.Scan.active && uiDataGlobal.Scan.scanType == SCAN_TYPE_NORMAL_STEP) || ev->hasEvent)
@@ -125,7 +284,7 @@ void rxPowerSavingTick(uiEvent_t *ev, bool hasSignal)
 
 				if (powerSavingLevel >= LOW_SPEED_CLOCK_ECO_THRESHOLD)
 				{
-					clockManagerSetRunMode(kAPP_PowerModeRun, CLOCK_MANAGER_SPEED_RUN);
+					clockManagerGovernorSetEcoAllowed(false);
 					resumeBeepAndC6000Tasks();
 				}
 
@@ -159,7 +318,7 @@ void rxPowerSavingTick(uiEvent_t *ev, bool hasSignal)
 						if ((powerSavingLevel >= LOW_SPEED_CLOCK_ECO_THRESHOLD) && (nonVolatileSettings.gps <= GPS_MODE_OFF))
 						{
 							suspendBeepAndC6000Tasks();
-							clockManagerSetRunMode(kAPP_PowerModeRun, CLOCK_MANAGER_RUN_ECO_POWER_MODE);
+							clockManagerGovernorSetEcoAllowed(true); // Applied by the governor, from the main loop
 						}
 
 						rxPowerSavingState = ECOPHASE_POWERSAVE_ACTIVE___RX_IS_ON;
@@ -167,7 +326,7 @@ void rxPowerSavingTick(uiEvent_t *ev, bool hasSignal)
 
 					case ECOPHASE_POWERSAVE_ACTIVE___RX_IS_ON:
 						hrc6000IsPoweredOff = trxPowerUpDownRxAndC6000(false, (powerSavingLevel > 1), false);// Power down AT1846S, C6000 and preamp
-						ticksTimerStart(&ecoPhaseTimer, (rxDuration * (1 << (powerSavingLevel - 1))));
+						ticksTimerStart(&ecoPhaseTimer, rxActivityGetOffPeriod((rxDuration * (1 << (powerSavingLevel - 1))), rxDuration));
 						rxPowerSavingState = ECOPHASE_POWERSAVE_ACTIVE___RX_IS_OFF;
 						break;
 
@@ -64,11 +64,11 @@ static uint32_t dirtyTime = 0;
 static bool settingsDirty = false;
 static bool settingsVFODirty = false;
 settingsStruct_t nonVolatileSettings;
-struct_codeplugChannel_t *currentChannelData;
 struct_codeplugChannel_t channelScreenChannelData = { .rxFreq = 0 };
 struct_codeplugContact_t contactListContactData;
 struct_codeplugDTMFContact_t contactListDTMFContactData;
 struct_codeplugChannel_t settingsVFOChannel[2];// VFO A and VFO B from the codeplug.
+struct_codeplugChannel_t *currentChannelData = &settingsVFOChannel[CHANNEL_VFO_A];// Already used by the splash screen (beep flag), before the VFO or Channel screen sets it
 volatile int settingsUsbMode = USB_MODE_CPS;
 
 int16_t *nextKeyBeepMelody = (int16_t *)MELODY_KEY_BEEP;
@@ -82,6 +82,8 @@ static void settingsVFOSanityCheck(struct_codeplugChannel_t *vfo, Channel_t VFON
 
 bool settingsSaveSettings(bool includeVFOs)
 {
+	struct_codeplugChannel_t vfos[2];
+
 	if (spiFlashInitHasFailed) // Never save the settings if the flash initialization failed
 	{
 		return false;
@@ -89,10 +91,12 @@ bool settingsSaveSettings(bool includeVFOs)
 
 	if (includeVFOs)
 	{
-		codeplugSetVFO_ChannelData(&settingsVFOChannel[CHANNEL_VFO_A], CHANNEL_VFO_A);
-		codeplugSetVFO_ChannelData(&settingsVFOChannel[CHANNEL_VFO_B], CHANNEL_VFO_B);
-
-		settingsVFODirty = false;
+		// Codeplug format, the storage writes them along with the settings
+		for (int i = CHANNEL_VFO_A; i <= CHANNEL_VFO_B; i++)
+		{
+			memcpy(&vfos[i], &settingsVFOChannel[i], CODEPLUG_CHANNEL_DATA_STRUCT_SIZE);
+			codeplugConvertChannelInternalToCodeplug(&vfos[i], &settingsVFOChannel[i]);
+		}
 	}
 
 	// Never reset this setting (as voicePromptsCacheInit() can change it if voice data are missing)
@@ -100,16 +104,40 @@ bool settingsSaveSettings(bool includeVFOs)
 	nonVolatileSettings.audioPromptMode = AUDIO_PROMPT_MODE_VOICE_LEVEL_3;
 #endif
 
-	bool ret = settingsStorageWrite((uint8_t *)&nonVolatileSettings, sizeof(settingsStruct_t));
+	bool ret = settingsStorageWrite((uint8_t *)&nonVolatileSettings, sizeof(settingsStruct_t), (includeVFOs ? (uint8_t *)vfos : NULL));
 
 	if (ret)
 	{
 		settingsDirty = false;
+
+		if (includeVFOs)
+		{
+			settingsVFODirty = false;
+		}
 	}
 
 	return ret;
 }
 
+// Same as settingsSaveSettings(), but the settings are also committed to the flash right away
+// (used when the backup SRAM content won't survive, e.g. power off).
+bool settingsCommitSettings(bool includeVFOs)
+{
+	// Not loaded yet (e.g. die() on the safe boot path), nothing to commit
+	if (nonVolatileSettings.magicNumber != STORAGE_MAGIC_NUMBER)
+	{
+		return false;
+	}
+
+	// Unchanged settings and VFOs aren't saved again, then the flush has nothing to write
+	if (settingsSaveSettings(includeVFOs))
+	{
+		return settingsStorageFlush((uint8_t *)&nonVolatileSettings, sizeof(settingsStruct_t));
+	}
+
+	return false;
+}
+
 bool settingsLoadSettings(bool reset)
 {
 	if (!settingsStorageRead((uint8_t *)&nonVolatileSettings, sizeof(settingsStruct_t)))
@@ -592,6 +620,8 @@ void settingsSetVFODirty(void)
 
 #if defined(PLATFORM_RD5R)
 	dirtyTime = ticksGetMillis();
+#elif defined(STM32F405xx)
+	settingsDirty = true; // (Re)arm the deferred flash commit, which also writes the VFOs
 #endif
 }
 
@@ -607,6 +637,22 @@ void settingsSaveIfNeeded(bool immediately)
 	{
 		settingsSaveSettings(settingsVFODirty);
 	}
+#elif defined(STM32F405xx)
+	UNUSED_PARAMETER(immediately);
+
+	// Cheap, only goes to the backup SRAM
+	if (settingsDirty || settingsVFODirty)
+	{
+		settingsSaveSettings(settingsVFODirty);
+	}
+
+	// Flash commit, once nothing changed for a while (an erase stalls the main loop).
+	// The timer only runs while the backup SRAM holds changes the flash doesn't have.
+	if (settingsStorageFlushIsDue() && (trxTransmissionEnabled == false) &&
+			((uiDataGlobal.Scan.active == false) || (menuSystemGetCurrentMenuNumber() != UI_CHANNEL_MODE)))
+	{
+		settingsCommitSettings(true);
+	}
 #endif
 }
 
@@ -37,6 +37,7 @@
 #include "functions/aprs.h"
 #include "user_interface/menuSystem.h"
 #include "user_interface/uiUtilities.h"
+#include "interfaces/runTimeStats.h"
 #include <FreeRTOS.h>
 #include <string.h>
 
@@ -197,9 +198,32 @@ volatile bool trxDMRSynchronisedRSSIReadPending = false;
 static uint8_t trxSaveVoiceGainTx = 0xff;
 static uint16_t trxSaveDeviation = 0xff;
 
+//
+// Tuning plans: the calibration values interpolated for a Tx frequency, kept in a small LRU,
+// hence scan and dual watch hops don't compute them again and again.
+//
+#define TRX_TUNING_PLANS_NUM   8
+
+typedef struct
+{
+	uint32_t                 frequency;
+	uint32_t                 lastUse; // 0: free entry
+	uint8_t                  analogIGain;
+	uint8_t                  analogQGain;
+	uint8_t                  digitalIGain;
+	uint8_t                  digitalQGain;
+	bool                     hasPowerSettings; // only computed on transmission
+	calibrationPowerValues_t powerSettings;
+} trxTuningPlan_t;
+
+static trxTuningPlan_t trxTuningPlans[TRX_TUNING_PLANS_NUM];
+static uint32_t trxTuningPlansUseCounter = 0;
+static trxRetuneStats_t trxRetuneStats;
+
 
 static void trxUpdateC6000Calibration(void);
 static void trxUpdateRadioCalibration(void);
+static trxTuningPlan_t *trxGetTuningPlan(uint32_t frequency);
 
 //
 // =================================================================
@@ -678,11 +702,15 @@ void trxSetFrequency(uint32_t fRx, uint32_t fTx, int dmrMode)
 
 	if ((currentRadioDevice->currentRxFrequency != fRx) || (currentRadioDevice->currentTxFrequency != fTx))
 	{
+		uint32_t retuneStart;
+
 		if (rxPowerSavingIsRxOn() == false)
 		{
 			rxPowerSavingSetState(ECOPHASE_POWERSAVE_INACTIVE);
 		}
 
+		retuneStart = runTimeStatsGetCycles();
+
 		taskENTER_CRITICAL();
 		currentRadioDevice->trxCurrentBand[TRX_RX_FREQ_BAND] = trxGetBandFromFrequency(fRx);
 
@@ -709,6 +737,10 @@ void trxSetFrequency(uint32_t fRx, uint32_t fTx, int dmrMode)
 		ticksTimerStart((ticksTimer_t *)&trxNextRssiNoiseSampleTimer, RSSI_NOISE_SAMPLE_PERIOD_PIT);
 		ticksTimerStart((ticksTimer_t *)&trxNextSquelchCheckingTimer, RSSI_NOISE_SAMPLE_PERIOD_PIT);
 		taskEXIT_CRITICAL();
+
+		trxRetuneStats.lastDurationUs = runTimeStatsCyclesToMicroseconds(runTimeStatsGetCycles() - retuneStart);
+		trxRetuneStats.maxDurationUs = SAFE_MAX(trxRetuneStats.maxDurationUs, trxRetuneStats.lastDurationUs);
+		trxRetuneStats.count++;
 	}
 }
 
@@ -732,8 +764,16 @@ void trxSetRX(void)
 
 void trxConfigurePA_DAC_ForFrequencyBand(void)
 {
+	trxTuningPlan_t *plan = trxGetTuningPlan(currentRadioDevice->currentTxFrequency);
+
+	if (plan->hasPowerSettings == false)
+	{
+		calibrationGetPowerForFrequency(currentRadioDevice->currentTxFrequency, &plan->powerSettings);
+		plan->hasPowerSettings = true;
+	}
+
 	currentRadioDevice->trxCurrentBand[TRX_TX_FREQ_BAND] = trxGetBandFromFrequency(currentRadioDevice->currentTxFrequency);
-	calibrationGetPowerForFrequency(currentRadioDevice->currentTxFrequency, &trxPowerSettings);
+	trxPowerSettings = plan->powerSettings;
 	currentRadioDevice->lastSetTxFrequency = currentRadioDevice->currentTxFrequency;
 	currentRadioDevice->lastSetTxPowerLevel = currentRadioDevice->txPowerLevel;
 
@@ -967,12 +1007,60 @@ static void trxUpdateC6000Calibration(void)
 	SPI0WritePageRegByte(0x04, 0x04, cal);									//Set MOD 2 Offset (Cal Value)
 }
 
+static trxTuningPlan_t *trxGetTuningPlan(uint32_t frequency)
+{
+	trxTuningPlan_t *plan = &trxTuningPlans[0];
+
+	for (int i = 0; i < TRX_TUNING_PLANS_NUM; i++)
+	{
+		if ((trxTuningPlans[i].lastUse != 0) && (trxTuningPlans[i].frequency == frequency))
+		{
+			trxRetuneStats.planHits++;
+			trxTuningPlans[i].lastUse = ++trxTuningPlansUseCounter;
+			return &trxTuningPlans[i];
+		}
+
+		// Least recently used (or free) entry
+		if (trxTuningPlans[i].lastUse < plan->lastUse)
+		{
+			plan = &trxTuningPlans[i];
+		}
+	}
+
+	trxRetuneStats.planMisses++;
+	plan->frequency = frequency;
+	plan->lastUse = ++trxTuningPlansUseCounter;
+	plan->analogIGain = calibrationGetAnalogIGainForFrequency(frequency);
+	plan->analogQGain = calibrationGetAnalogQGainForFrequency(frequency);
+	plan->digitalIGain = calibrationGetDigitalIGainForFrequency(frequency);
+	plan->digitalQGain = calibrationGetDigitalQGainForFrequency(frequency);
+	plan->hasPowerSettings = false;
+
+	return plan;
+}
+
+// Needs to be called each time the calibration data is modified
+void trxTuningPlansInvalidate(void)
+{
+	for (int i = 0; i < TRX_TUNING_PLANS_NUM; i++)
+	{
+		trxTuningPlans[i].lastUse = 0;
+	}
+}
+
+const trxRetuneStats_t *trxGetRetuneStats(void)
+{
+	return &trxRetuneStats;
+}
+
 static void trxUpdateRadioCalibration(void)
 {
-	analogIGain = calibrationGetAnalogIGainForFrequency(currentRadioDevice->currentTxFrequency);
-	analogQGain = calibrationGetAnalogQGainForFrequency(currentRadioDevice->currentTxFrequency);
-	digitalIGain = calibrationGetDigitalIGainForFrequency(currentRadioDevice->currentTxFrequency);
-	digitalQGain = calibrationGetDigitalQGainForFrequency(currentRadioDevice->currentTxFrequency);
+	trxTuningPlan_t *plan = trxGetTuningPlan(currentRadioDevice->currentTxFrequency);
+
+	analogIGain = plan->analogIGain;
+	analogQGain = plan->analogQGain;
+	digitalIGain = plan->digitalIGain;
+	digitalQGain = plan->digitalQGain;
 	Mod2Offset = calibrationGetMod2Offset(currentRadioDevice->trxCurrentBand[trxTransmissionEnabled ? TRX_TX_FREQ_BAND : TRX_RX_FREQ_BAND]);
 }
 
@@ -1237,6 +1325,7 @@ bool trxPowerUpDownRxAndC6000(bool powerUp, bool includeC6000, bool includeMic)
 				while (HRC6000IRQHandlerIsRunning());
 
 				HAL_GPIO_WritePin(C6000_PWD_GPIO_Port, C6000_PWD_Pin, GPIO_PIN_SET); // Power Up the C6000
+				SPI0ShadowInvalidate();
 				status = true;
 			}
 		}
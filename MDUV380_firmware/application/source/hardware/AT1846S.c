@@ -30,6 +30,7 @@
 
 #include "hardware/AT1846S.h"
 #include "hardware/radioHardwareInterface.h"
+#include "interfaces/trace.h"
 
 
 #define DCS_PACKED_DATA_NUM          83
@@ -294,6 +295,7 @@ bool radioWriteReg2byte(uint8_t reg, uint8_t val1, uint8_t val2)
 	int8_t retries = 3;
 	bool ret = false;
 
+	TRACE_BEGIN(TRACE_ID_I2C_WRITE);
 	do
 	{
 		ret = (HAL_I2C_Master_Transmit(&hi2c3, AT1846S_I2C_MASTER_SLAVE_ADDR_7BIT, data, 3, HAL_MAX_DELAY) == HAL_OK);
@@ -313,6 +315,7 @@ bool radioWriteReg2byte(uint8_t reg, uint8_t val1, uint8_t val2)
 			registerCache[currentRadioDeviceId][reg].lowByte[currentRegisterBank[currentRadioDeviceId]] = val2;
 		}
 	}
+	TRACE_END(TRACE_ID_I2C_WRITE);
 
 	return ret;
 }
@@ -323,6 +326,7 @@ bool radioReadReg2byte(uint8_t reg, uint8_t *val1, uint8_t *val2)
 	int8_t retries = 3;
 	bool ret = false;
 
+	TRACE_BEGIN(TRACE_ID_I2C_READ);
 	do
 	{
 		ret = (HAL_I2C_Master_Transmit(&hi2c3, AT1846S_I2C_MASTER_SLAVE_ADDR_7BIT, data, 1, HAL_MAX_DELAY) == HAL_OK);
@@ -352,6 +356,8 @@ bool radioReadReg2byte(uint8_t reg, uint8_t *val1, uint8_t *val2)
 			*val2 = data[1];
 		}
 	}
+	TRACE_END(TRACE_ID_I2C_READ);
+
 	return ret;
 }
 
@@ -568,6 +574,7 @@ bool AT1846sWriteTone1Reg(uint16_t toneFreqVal)
 	int8_t retries = 3;
 	bool ret = false;
 
+	TRACE_BEGIN(TRACE_ID_I2C_WRITE);
 	do
 	{
 		ret = (HAL_I2C_Master_Transmit(&hi2c3, AT1846S_I2C_MASTER_SLAVE_ADDR_7BIT, data, 3, HAL_MAX_DELAY) == HAL_OK);
@@ -577,6 +584,7 @@ bool AT1846sWriteTone1Reg(uint16_t toneFreqVal)
 			osDelay(1U);
 		}
 	} while ((ret == false) && (retries-- > 0));
+	TRACE_END(TRACE_ID_I2C_WRITE);
 
 	return ret;
 }
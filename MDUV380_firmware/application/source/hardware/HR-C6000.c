@@ -40,7 +40,9 @@
 #include "interfaces/interrupts.h"
 #include "functions/rxPowerSaving.h"
 #include "functions/ticks.h"
+#include "functions/eventBus.h"
 #include "interfaces/gps.h"
+#include "interfaces/runTimeStats.h"
 #if defined(PLATFORM_MD9600) || defined(PLATFORM_MD380) || defined(PLATFORM_MDUV380) || defined(PLATFORM_RT84_DM1701) || defined(PLATFORM_MD2017)
 #include "hardware/radioHardwareInterface.h"
 #endif
@@ -114,6 +116,103 @@ static const uint8_t spi_init_values_5[] = { 0x00, 0x08, 0xeb, 0x78, 0x67 };
 static const uint8_t spi_init_values_6[] = { 0x32, 0xef, 0x00, 0x31, 0xef, 0x00, 0x12, 0xef, 0x00, 0x13, 0xef, 0x00, 0x14, 0xef, 0x00, 0x15, 0xef, 0x00, 0x16, 0xef, 0x00, 0x17, 0xef, 0x00, 0x18, 0xef, 0x00, 0x19, 0xef, 0x00, 0x1a, 0xef, 0x00, 0x1b, 0xef, 0x00, 0x1c, 0xef, 0x00, 0x1d, 0xef, 0x00, 0x1e, 0xef, 0x00, 0x1f, 0xef, 0x00, 0x20, 0xef, 0x00, 0x21, 0xef, 0x00, 0x22, 0xef, 0x00, 0x23, 0xef, 0x00, 0x24, 0xef, 0x00, 0x25, 0xef, 0x00, 0x26, 0xef, 0x00, 0x27, 0xef, 0x00, 0x28, 0xef, 0x00, 0x29, 0xef, 0x00, 0x2a, 0xef, 0x00, 0x2b, 0xef, 0x00, 0x2c, 0xef, 0x00, 0x2d, 0xef, 0x00, 0x2e, 0xef, 0x00, 0x2f, 0xef, 0x00 };
 */
 
+//
+// Register scripts, run by hrc6000RunScript(): the steps are written in order, consecutive registers of a page
+// in a single burst transfer, and the configuration registers already holding the value (SPI0 shadow) are skipped.
+//
+#define SCRIPT_VOLATILE                  0x01 // Command or chip updated register, always written
+#define SCRIPT_ARG                       0x02 // The value is an index in the script arguments
+
+#define SCRIPT_MAX_BURST                   16
+
+typedef struct
+{
+	uint8_t page;
+	uint8_t reg;
+	uint8_t value;
+	uint8_t flags;
+} hrc6000ScriptStep_t;
+
+#define SCRIPT_LENGTH(script)    (sizeof(script) / sizeof(script[0]))
+
+static const hrc6000ScriptStep_t scriptSyncReset[] = {
+		{0x04, 0x41, 0x20, SCRIPT_VOLATILE}, // Set Sync Fail Bit (Reset?)
+		{0x04, 0x41, 0x00, SCRIPT_VOLATILE}, // Reset
+		{0x04, 0x41, 0x20, SCRIPT_VOLATILE}, // Set Sync Fail Bit (Reset?)
+		{0x04, 0x41, 0x50, SCRIPT_VOLATILE}  // Receive during next Timeslot
+};
+
+static const hrc6000ScriptStep_t scriptDigitalDmrRx[] = {
+		{0x04, 0x40, 0xC3, SCRIPT_VOLATILE}, // Enable DMR Tx, DMR Rx, Passive Timing, Normal mode
+		{0x04, 0x41, 0x20, SCRIPT_VOLATILE}, // Set Sync Fail Bit (Reset?)
+		{0x04, 0x41, 0x00, SCRIPT_VOLATILE}, // Reset
+		{0x04, 0x41, 0x20, SCRIPT_VOLATILE}, // Set Sync Fail Bit (Reset?)
+		{0x04, 0x41, 0x50, SCRIPT_VOLATILE}  // Receive during next Timeslot
+};
+
+static const hrc6000ScriptStep_t scriptVocoderEncodeStart[] = {
+		{0x04, 0x21, 0xA2, SCRIPT_VOLATILE}, // Set Polite to Color Code and Reset vocoder encodingbuffer
+		{0x04, 0x22, 0x86, SCRIPT_VOLATILE}  // Start Vocoder Encode, I2S mode
+};
+
+static const hrc6000ScriptStep_t scriptTransitionToTx[] = {
+		{0x04, 0x21, 0xA2, SCRIPT_VOLATILE}, // Set Polite to Color Code and Reset vocoder encodingbuffer
+		{0x04, 0x22, 0x86, SCRIPT_VOLATILE}, // Start Vocoder Encode, I2S mode
+		{0x04, 0x41, 0x00, SCRIPT_VOLATILE}  // Do nothing on the next TS
+};
+
+enum { FM_TX_ARG_MIC_GAIN, FM_TX_ARG_I_GAIN, FM_TX_ARG_Q_GAIN, FM_TX_ARG_MOD2_OFFSET, FM_TX_ARG_DEVIATION, FM_TX_ARG_TONE_DEVIATION, FM_TX_ARG_NUM };
+
+static const hrc6000ScriptStep_t scriptFMTx[] = {
+		{0x04, 0x10, 0x80, 0},                                   // Switch to FM Mode
+		{0x04, 0xE0, 0xC9, 0},                                   // CPU Controls Codec, Line in 1,LineOut2, I2S Slave Mode
+		{0x04, 0xE4, FM_TX_ARG_MIC_GAIN, SCRIPT_ARG},            // Mic Gain
+		{0x04, 0xC2, 0x00, 0},                                   // Mic AGC Off
+		{0x04, 0xE5, 0x1A, 0},                                   // Unknown (Default value = 0A)
+		{0x04, 0x25, 0x0E, 0},                                   // Undocumented Register
+		{0x04, 0x26, 0xFE, 0},                                   // Undocumented register Turns off FM receive
+		{0x04, 0x83, 0xFF, SCRIPT_VOLATILE},                     // Clear aLL Interrupts
+		{0x04, 0x87, 0x00, 0},                                   // Clear Int Masks
+		{0x04, 0x45, FM_TX_ARG_I_GAIN, SCRIPT_ARG},              // Set MOD2 Level (from cal table)
+		{0x04, 0x46, FM_TX_ARG_Q_GAIN, SCRIPT_ARG},              // Set MOD1 Level (from cal table)
+		{0x04, 0x48, 0x00, 0},                                   // Two Point Mod Bias =0
+		{0x04, 0x04, FM_TX_ARG_MOD2_OFFSET, SCRIPT_ARG},         // Set MOD 2 Offset (Cal Value)
+		{0x04, 0x49, 0xFF, 0},                                   // set mod limit registers to max
+		{0x04, 0x4A, 0xFF, 0},
+		{0x04, 0x35, FM_TX_ARG_DEVIATION, SCRIPT_ARG},           // FM Deviation Coefficient
+		{0x04, 0xA0, FM_TX_ARG_TONE_DEVIATION, SCRIPT_ARG},      // CTCSS or DCS Deviation level
+		{0x04, 0x3F, 0x04, 0},                                   // Set FM Limiting Modulation Factor
+		{0x04, 0x34, 0x3C, 0},                                   // Compressor off, Pre-Emph on 3KHz Audio Filter
+		{0x04, 0x3E, 0x08, 0},                                   // Rx FM Deviation Coefficient
+		{0x01, 0x50, 0x00, 0},                                   // Aux Register 0x50 Undocumented
+		{0x01, 0x51, 0x00, 0},                                   // Aux Register 0x51 Undocumented
+		{0x04, 0x60, 0x80, SCRIPT_VOLATILE}                      // Set Tx to Analogue Voice Sending mode
+};
+
+static const hrc6000ScriptStep_t scriptFMRx[] = {
+		{0x04, 0x60, 0x00, SCRIPT_VOLATILE},                     // FM Voice Tx Mode Off
+		{0x04, 0xE0, 0x89, 0},                                   // Turn off Microphone input
+		{0x04, 0x10, 0x80, 0},                                   // Mod Mode FM
+		{0x04, 0x34, 0x3C, 0},                                   // Compressor off, de-Emph on 3KHz Audio Filter
+		{0x04, 0x81, 0x19, 0},                                   // Interrupt Masks (for DMR?)
+		{0x04, 0x85, 0x00, 0},                                   // Interrupt Masks )For DMR?)
+		{0x04, 0x26, 0xFD, 0}                                    // Undocumented register Turns on FM receive
+};
+
+enum { DMR_ARG_I_GAIN, DMR_ARG_Q_GAIN, DMR_ARG_MIC_GAIN, DMR_ARG_NUM };
+
+static const hrc6000ScriptStep_t scriptDMR[] = {
+		{0x04, 0x01, 0xF0, 0},                                   // set 2 point Mod, receive mode IF (UHF and VHF)
+		{0x04, 0x45, DMR_ARG_I_GAIN, SCRIPT_ARG},                // Set MOD2 Level (from cal table)
+		{0x04, 0x46, DMR_ARG_Q_GAIN, SCRIPT_ARG},                // Set MOD1 Level (from cal table)
+		{0x04, 0x10, 0x6E, 0},                                   // Set mode to DMR,Tier2,Timeslot Mode, Layer 2, Repeater, Aligned, Slot1
+		{0x04, 0xE0, 0xC9, 0},                                   // CODEC under MCU Control, LineOut2 Enabled, Mic_p Enabled,  I2S Slave Mode
+		{0x04, 0xE4, DMR_ARG_MIC_GAIN, SCRIPT_ARG},              // Mic Gain
+		{0x04, 0x26, 0xFD, 0}                                    // Undocumented register believed to control IF ADC
+};
+
+static hrc6000ScriptStats_t scriptStats;
+
 static const uint8_t spiInitReg0x04_PLL[7][2] = {
 		{0x0A, 0x80}, //internal clock
 		{0x0B, 0x28}, //Set PLL M Register    Changed to suit MD9600 Clock
@@ -251,6 +350,7 @@ static struct
 	volatile uint32_t ccHoldReleaseTickTime;
 	int wakeTriesCount;
 	int hotspotPostponedFrameHandling;
+	int hotspotMissingFrames;
 	char talkAliasText[33];
 	uint8_t talkAliasLocation[7];
 } hrc = {
@@ -298,6 +398,7 @@ static struct
 		.ccHoldReleaseTickTime = 0,
 		.wakeTriesCount = 0,
 		.hotspotPostponedFrameHandling = 0,
+		.hotspotMissingFrames = 0,
 		.talkAliasText = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 		.talkAliasLocation = { 0, 0, 0, 0, 0, 0, 0}
 };
@@ -350,10 +451,68 @@ uint8_t getCurrentTATxFlag(void)
 
 static void hrc6000WriteSPIRegister0x04Multi(const uint8_t values[][2], uint8_t length)
 {
-	for(uint8_t i = 0; i < length; i++)
+	SPI0WritePageRegByteList(0x04, values, length);
+}
+
+static bool hrc6000ScriptStepIsNeeded(const hrc6000ScriptStep_t *step, uint8_t value)
+{
+	uint8_t shadowValue;
+
+	return ((step->flags & SCRIPT_VOLATILE) || (SPI0ShadowGet(step->page, step->reg, &shadowValue) == false) || (shadowValue != value));
+}
+
+// Runs of consecutive registers are written in one transfer, without their unchanged first and last registers
+// (an unchanged register inside a run costs less than another transfer).
+static void hrc6000RunScript(const hrc6000ScriptStep_t *script, uint8_t length, const uint8_t *args)
+{
+	uint32_t startCycles = runTimeStatsGetCycles();
+	uint8_t values[SCRIPT_MAX_BURST];
+	int i = 0;
+
+	while (i < length)
 	{
-		SPI0WritePageRegByte(0x04, values[i][0], values[i][1]);
+		const hrc6000ScriptStep_t *first = &script[i];
+		int runLength = 0;
+		int start;
+		int end;
+
+		do
+		{
+			values[runLength] = ((script[i].flags & SCRIPT_ARG) ? args[script[i].value] : script[i].value);
+			runLength++;
+			i++;
+		} while ((i < length) && (runLength < SCRIPT_MAX_BURST) &&
+				(script[i].page == first->page) && (script[i].reg == (uint8_t)(first->reg + runLength)));
+
+		for (start = 0; (start < runLength) && (hrc6000ScriptStepIsNeeded(&first[start], values[start]) == false); start++);
+		for (end = runLength; (end > start) && (hrc6000ScriptStepIsNeeded(&first[end - 1], values[end - 1]) == false); end--);
+
+		scriptStats.skipped += (runLength - (end - start));
+
+		if (end > start)
+		{
+			if ((end - start) == 1)
+			{
+				SPI0WritePageRegByte(first->page, first[start].reg, values[start]);
+			}
+			else
+			{
+				SPI0WritePageRegByteArray(first->page, first[start].reg, &values[start], (end - start));
+			}
+
+			scriptStats.written += (end - start);
+			scriptStats.transfers++;
+		}
 	}
+
+	scriptStats.runs++;
+	scriptStats.lastUs = runTimeStatsCyclesToMicroseconds(runTimeStatsGetCycles() - startCycles);
+	scriptStats.maxUs = ((scriptStats.lastUs > scriptStats.maxUs) ? scriptStats.lastUs : scriptStats.maxUs);
+}
+
+const hrc6000ScriptStats_t *HRC6000GetScriptStats(void)
+{
+	return &scriptStats;
 }
 
 //Updated by G4EML to reflect the sequence used by the official TYT firmware on the MD-9600
@@ -365,6 +524,7 @@ void HRC6000Init(void)
 	// Wake up C6000
 	HAL_GPIO_WritePin(C6000_PWD_GPIO_Port, C6000_PWD_Pin, 0);
 	vTaskDelay((10 / portTICK_PERIOD_MS));
+	SPI0ShadowInvalidate();
 
 	// initialise clocks
 	hrc6000WriteSPIRegister0x04Multi(spiInitReg0x04_PLL, (sizeof(spiInitReg0x04_PLL) / sizeof(spiInitReg0x04_PLL[0])));
@@ -718,6 +878,7 @@ static void hrc6000HandleLCData(void)
 									if ((uiDataGlobal.rxBeepState & RX_BEEP_TALKER_HAS_STARTED) && ((uiDataGlobal.rxBeepState & RX_BEEP_TALKER_HAS_ENDED) == 0))
 									{
 										uiDataGlobal.rxBeepState |= (RX_BEEP_TALKER_HAS_ENDED | RX_BEEP_TALKER_HAS_ENDED_EXEC);
+										eventBusPost(EVENT_BUS_DMR_CALL_END, 0);
 									}
 
 									// Clearing this bit, as we don't want the qso info timeout trigger that beep again.
@@ -730,6 +891,7 @@ static void hrc6000HandleLCData(void)
 									if ((uiDataGlobal.rxBeepState & RX_BEEP_TALKER_HAS_STARTED) == 0)
 									{
 										uiDataGlobal.rxBeepState |= (RX_BEEP_TALKER_HAS_STARTED | RX_BEEP_TALKER_HAS_STARTED_EXEC);
+										eventBusPost(EVENT_BUS_DMR_CALL_START, 0);
 									}
 								}
 							}
@@ -766,6 +928,7 @@ static void hrc6000HandleLCData(void)
 								if ((uiDataGlobal.rxBeepState & RX_BEEP_TALKER_HAS_STARTED) == 0)
 								{
 									uiDataGlobal.rxBeepState |= (RX_BEEP_TALKER_HAS_STARTED | RX_BEEP_TALKER_HAS_STARTED_EXEC);
+									eventBusPost(EVENT_BUS_DMR_CALL_START, 0);
 								}
 							}
 						}
@@ -1306,10 +1469,7 @@ void hrc6000SysInterruptHandler(void)
 
 							if (currentRadioDevice->trxDMRModeTx == DMR_MODE_RMO) // we need to do extra config while in RMO, otherwise the chip will get stuck on a wrong CC
 							{
-								SPI0WritePageRegByte(0x04, 0x41, 0x20);  // Set Sync Fail Bit (Reset?))
-								SPI0WritePageRegByte(0x04, 0x41, 0x00);  // Reset
-								SPI0WritePageRegByte(0x04, 0x41, 0x20);  // Set Sync Fail Bit (Reset?)
-								SPI0WritePageRegByte(0x04, 0x41, 0x50);  // Receive during next Timeslot
+								hrc6000RunScript(scriptSyncReset, SCRIPT_LENGTH(scriptSyncReset), NULL);
 							}
 
 							// Give the HR-C6000 a bit of time.
@@ -1462,9 +1622,7 @@ static void hrc6000TransitionToTx(void)
 		codecInit(false);
 	}
 
-	SPI0WritePageRegByte(0x04, 0x21, 0xA2); // Set Polite to Color Code and Reset vocoder encodingbuffer
-	SPI0WritePageRegByte(0x04, 0x22, 0x86); // Start Vocoder Encode, I2S mode
-	SPI0WritePageRegByte(0x04, 0x41, 0x00); // Do nothing on the next TS
+	hrc6000RunScript(scriptTransitionToTx, SCRIPT_LENGTH(scriptTransitionToTx), NULL); // Start vocoder encode, do nothing on the next TS
 
 	slotState = DMR_STATE_TX_START_1;
 	hrc.txSequence = 0;
@@ -1488,6 +1646,8 @@ void hrc6000TimeslotInterruptHandler(void)
 		hrc6000RxInterruptHandler();
 	}
 
+	SPIBusTimeslotTick();
+
 	uint8_t reg0x52;
 	bool reg52Result = (SPI0ReadPageRegByte(0x04, 0x52, &reg0x52) == kStatus_Success);  // Read CACH Register to get the timecode (TS number)
 
@@ -1663,6 +1823,7 @@ void hrc6000TimeslotInterruptHandler(void)
 				{
 					uiDataGlobal.rxBeepState |= (RX_BEEP_CARRIER_HAS_STARTED | RX_BEEP_CARRIER_HAS_STARTED_EXEC);
 					uiDataGlobal.rxBeepState &= ~(RX_BEEP_TALKER_IDENTIFIED | RX_BEEP_TALKER_HAS_ENDED_EXEC);
+					eventBusPost(EVENT_BUS_SQUELCH, 1);
 				}
 
 				SPI0WritePageRegByte(0x04, 0x41, 0x00); // No Transmit or receive in next timeslot
@@ -1695,12 +1856,14 @@ void hrc6000TimeslotInterruptHandler(void)
 			if (uiDataGlobal.rxBeepState & RX_BEEP_CARRIER_HAS_STARTED)
 			{
 				uiDataGlobal.rxBeepState |= RX_BEEP_CARRIER_HAS_ENDED;
+				eventBusPost(EVENT_BUS_SQUELCH, 0);
 
 				// In DMO (HT to HT), otherwise Talker end beep won't be played.
 				// The beep will be played first, followed 100ms later with carrier ending beep
 				if ((uiDataGlobal.rxBeepState & RX_BEEP_TALKER_HAS_STARTED) && ((uiDataGlobal.rxBeepState & RX_BEEP_TALKER_HAS_ENDED) == 0))
 				{
 					uiDataGlobal.rxBeepState |= (RX_BEEP_TALKER_HAS_ENDED | RX_BEEP_TALKER_HAS_ENDED_EXEC);
+					eventBusPost(EVENT_BUS_DMR_CALL_END, 0);
 				}
 			}
 
@@ -1776,6 +1939,12 @@ void hrc6000TimeslotInterruptHandler(void)
 					{
 						SPI1WritePageRegByteArray(0x03, 0x00, (uint8_t*)(deferredUpdateBuffer + LC_DATA_LENGTH), AMBE_AUDIO_LENGTH); // send the audio bytes to the hardware
 						hrc.hotspotDMRTxFrameBufferEmpty = true; // we have finished with the current frame data from the hotspot
+						hrc.hotspotMissingFrames = 0;
+					}
+					else if ((hrc.hotspotPostponedFrameHandling == 0) && hotspotTxFrameIsMissing(hrc.hotspotMissingFrames++ == 0))
+					{
+						// Late or lost network frame: the previous one is repeated once
+						SPI1WritePageRegByteArray(0x03, 0x00, (uint8_t*)(deferredUpdateBuffer + LC_DATA_LENGTH), AMBE_AUDIO_LENGTH);
 					}
 					else
 					{
@@ -1953,12 +2122,14 @@ void hrc6000TimeslotInterruptHandler(void)
 			if (uiDataGlobal.rxBeepState & RX_BEEP_CARRIER_HAS_STARTED)
 			{
 				uiDataGlobal.rxBeepState |= RX_BEEP_CARRIER_HAS_ENDED;
+				eventBusPost(EVENT_BUS_SQUELCH, 0);
 
 				// In DMO (HT to HT), otherwise Talker end beep won't be played.
 				// The beep will be played first, followed 100ms later with carrier ending beep
 				if ((uiDataGlobal.rxBeepState & RX_BEEP_TALKER_HAS_STARTED) && ((uiDataGlobal.rxBeepState & RX_BEEP_TALKER_HAS_ENDED) == 0))
 				{
 					uiDataGlobal.rxBeepState |= (RX_BEEP_TALKER_HAS_ENDED | RX_BEEP_TALKER_HAS_ENDED_EXEC);
+					eventBusPost(EVENT_BUS_DMR_CALL_END, 0);
 				}
 			}
 
@@ -2045,11 +2216,7 @@ void HRC6000InitDigitalDmrRx(void)
 {
 	HRC6000SetDMR();						 // ensure any registers changed by FM use are restored to DMR settings
 
-	SPI0WritePageRegByte(0x04, 0x40, 0xC3);  // Enable DMR Tx, DMR Rx, Passive Timing, Normal mode
-	SPI0WritePageRegByte(0x04, 0x41, 0x20);  // Set Sync Fail Bit (Reset?))
-	SPI0WritePageRegByte(0x04, 0x41, 0x00);  // Reset
-	SPI0WritePageRegByte(0x04, 0x41, 0x20);  // Set Sync Fail Bit (Reset?)
-	SPI0WritePageRegByte(0x04, 0x41, 0x50);  // Receive during next Timeslot
+	hrc6000RunScript(scriptDigitalDmrRx, SCRIPT_LENGTH(scriptDigitalDmrRx), NULL); // DMR Tx/Rx enable, passive timing, sync reset
 
 	hrc.hasEncodedAudio = false;
 	hrc.receivedFramesCount = -1;
@@ -2257,6 +2424,11 @@ static void hrc6000Tick(void)
 			// Ensure the ISR has exited
 			while (hrc.inIRQHandler);
 
+			if (settingsUsbMode != USB_MODE_HOTSPOT)
+			{
+				codecLatencyProbeStart();
+			}
+
 			if (currentRadioDevice->trxDMRModeTx == DMR_MODE_DMO)
 			{
 				if (settingsUsbMode != USB_MODE_HOTSPOT)
@@ -2266,6 +2438,7 @@ static void hrc6000Tick(void)
 				else
 				{
 					hrc.hotspotPostponedFrameHandling = (HS_NUM_OF_SILENCE_SEQ_ON_STARTUP * 6);
+					hrc.hotspotMissingFrames = 0;
 					// LC and Frame data will be uplodaded in hrc6000TimeslotInterruptHandler(), DMR_STATE_TX_2 case.
 					memcpy((uint8_t *)deferredUpdateBuffer, (uint8_t *)&audioAndHotspotDataBuffer.hotspotBuffer[wavbuffer_read_idx], AMBE_AUDIO_LENGTH + LC_DATA_LENGTH);
 					// Note:
@@ -2308,8 +2481,7 @@ static void hrc6000Tick(void)
 			hrc.qsoDataTimeout = 0;
 			hrc.skipOneTS = false;
 
-			SPI0WritePageRegByte(0x04, 0x21, 0xA2); // Set Polite to Color Code and Reset vocoder encodingbuffer
-			SPI0WritePageRegByte(0x04, 0x22, 0x86); // Start Vocoder Encode, I2S mode
+			hrc6000RunScript(scriptVocoderEncodeStart, SCRIPT_LENGTH(scriptVocoderEncodeStart), NULL);
 
 			interruptsEnableC6000Interrupts();//			NVIC_EnableIRQ(PORTC_IRQn);
 
@@ -2408,8 +2580,7 @@ static void hrc6000Tick(void)
 					hrc.qsoDataTimeout = 0;
 					hrc.skipOneTS = false;
 
-					SPI0WritePageRegByte(0x04, 0x21, 0xA2); // Set Polite to Color Code and Reset vocoder encodingbuffer
-					SPI0WritePageRegByte(0x04, 0x22, 0x86); // Start Vocoder Encode, I2S mode
+					hrc6000RunScript(scriptVocoderEncodeStart, SCRIPT_LENGTH(scriptVocoderEncodeStart), NULL);
 
 					interruptsEnableC6000Interrupts();//					NVIC_EnableIRQ(PORTC_IRQn);
 
@@ -2441,6 +2612,7 @@ static void hrc6000Tick(void)
 				if (wavbuffer_count >= 2)
 				{
 					codecEncodeBlock((uint8_t *)hrc.deferredUpdateBufferInPtr);
+					codecLatencyProbeStop();
 
 					hrc.deferredUpdateBufferInPtr += LENGTH_AMBE_BLOCK;
 
@@ -2560,6 +2732,7 @@ static void hrc6000Tick(void)
 							(uiDataGlobal.rxBeepState & RX_BEEP_TALKER_HAS_STARTED) && ((uiDataGlobal.rxBeepState & RX_BEEP_TALKER_HAS_ENDED) == 0))
 					{
 						uiDataGlobal.rxBeepState |= (RX_BEEP_TALKER_HAS_ENDED | RX_BEEP_TALKER_HAS_ENDED_EXEC);
+						eventBusPost(EVENT_BUS_DMR_CALL_END, 0);
 					}
 				}
 
@@ -2773,24 +2946,7 @@ void HRC6000SetMicGainFM(uint8_t gain)
 
 void HRC6000SetFMTx(void)
 {
-	SPI0WritePageRegByte(0x04, 0x10, 0x80);											//Switch to FM Mode
-//	SPI0WritePageRegByte(0x04, 0xE2, 0x00);											//configure ADC and DAc
-	SPI0WritePageRegByte(0x04, 0xE0, 0xC9);											//CPU Controls Codec, Line in 1,LineOut2, I2S Slave Mode
-	SPI0WritePageRegByte(0x04, 0xE4, 0x20 + (nonVolatileSettings.micGainFM));       //Mic Gain
-	SPI0WritePageRegByte(0x04, 0xC2, 0x00);											//Mic AGC Off
-	SPI0WritePageRegByte(0x04, 0xE5, 0x1A);											//Unknown (Default value = 0A)
-	SPI0WritePageRegByte(0x04, 0x25, 0x0E);											//Undocumented Register
-	SPI0WritePageRegByte(0x04, 0x26, 0xFE);											//Undocumented register Turns off FM receive
-	SPI0WritePageRegByte(0x04, 0x83, 0xFF);											//Clear aLL Interrupts
-	SPI0WritePageRegByte(0x04, 0x87, 0x00);											//Clear Int Masks
-	SPI0WritePageRegByte(0x04, 0x45, analogIGain);									//Set MOD2 Level (from cal table)
-	SPI0WritePageRegByte(0x04, 0x46, analogQGain);									//Set MOD1 Level (from cal table)
-	SPI0WritePageRegByte(0x04, 0x48, 0x00);											//Two Point Mod Bias =0
-	SPI0WritePageRegByte(0x04, 0x04, Mod2Offset);									//Set MOD 2 Offset (Cal Value)
-	SPI0WritePageRegByte(0x04, 0x49, 0xFF);											//set mod limit registers to max
-	SPI0WritePageRegByte(0x04, 0x4A, 0xFF);
-
-	uint8_t deviation;
+	uint8_t args[FM_TX_ARG_NUM];
 	uint8_t CTCdeviation;
 	uint8_t DCSdeviation;
 
@@ -2798,13 +2954,13 @@ void HRC6000SetFMTx(void)
 	{
 		if(trxGetBandwidthIs25kHz())
 		{
-			deviation = 0x24;                                                           //FM Deviation Coefficients for UHF 25KHz Channel Spacing
+			args[FM_TX_ARG_DEVIATION] = 0x24;                                           //FM Deviation Coefficients for UHF 25KHz Channel Spacing
 			CTCdeviation = 0x09;
 			DCSdeviation = 0x02;
 		}
 		else
 		{
-			deviation = 0x12;															//FM Deviation Coefficients for UHF 12.5KHz Channel Spacing
+			args[FM_TX_ARG_DEVIATION] = 0x12;											//FM Deviation Coefficients for UHF 12.5KHz Channel Spacing
 			CTCdeviation = 0x06;
 			DCSdeviation = 0x01;
 		}
@@ -2813,65 +2969,42 @@ void HRC6000SetFMTx(void)
 	{
 		if(trxGetBandwidthIs25kHz())
 		{
-			deviation = 0x73;                                                           //FM Deviation Coefficients for VHF 25KHz Channel Spacing (Warning 0x68 seems to be the maximum before distortion)
+			args[FM_TX_ARG_DEVIATION] = 0x73;                                           //FM Deviation Coefficients for VHF 25KHz Channel Spacing (Warning 0x68 seems to be the maximum before distortion)
 			CTCdeviation = 0x18;
 			DCSdeviation = 0x06;
 		}
 		else
 		{
-			deviation = 0x37;															//FM Deviation Coefficients for VHF 12.5KHz Channel Spacing
+			args[FM_TX_ARG_DEVIATION] = 0x37;											//FM Deviation Coefficients for VHF 12.5KHz Channel Spacing
 			CTCdeviation = 0x10;
 			DCSdeviation = 0x04;
 		}
 	}
 
-	SPI0WritePageRegByte(0x04, 0x35, deviation);									    //FM Deviation Coefficient
+	args[FM_TX_ARG_MIC_GAIN] = 0x20 + (nonVolatileSettings.micGainFM);
+	args[FM_TX_ARG_I_GAIN] = analogIGain;
+	args[FM_TX_ARG_Q_GAIN] = analogQGain;
+	args[FM_TX_ARG_MOD2_OFFSET] = Mod2Offset;
+	args[FM_TX_ARG_TONE_DEVIATION] = (sendingDCS ? DCSdeviation : CTCdeviation);
 
-	if(sendingDCS)
-	{
-		SPI0WritePageRegByte(0x04, 0xA0, DCSdeviation);									//set the DCS deviation level
-	}
-	else
-	{
-		SPI0WritePageRegByte(0x04, 0xA0, CTCdeviation);									//Set CTCSS Deviation level
-	}
-	SPI0WritePageRegByte(0x04, 0x3F, 0x04);											//Set FM Limiting Modulation Factor
-	SPI0WritePageRegByte(0x04, 0x34, 0x3C);											//Compressor off, Pre-Emph on 3KHz Audio Filter
-	SPI0WritePageRegByte(0x04, 0x3E, 0x08);											//Rx FM Deviation Coefficient
-	SPI0WritePageRegByte(0x01, 0x50, 0x00);											//Aux Register 0x50 Undocumented
-	SPI0WritePageRegByte(0x01, 0x51, 0x00);											//Aux Register 0x51 Undocumented
-	SPI0WritePageRegByte(0x04, 0x60, 0x80);											//Set Tx to Analogue Voice Sending mode
+	hrc6000RunScript(scriptFMTx, SCRIPT_LENGTH(scriptFMTx), args);
 }
 
 void HRC6000SetFMRx(void)
 {
-	SPI0WritePageRegByte(0x04, 0x60, 0x00);							//FM Voice Tx Mode Off
-	SPI0WritePageRegByte(0x04, 0xE0, 0x89);							//Turn off Microphone input
-	SPI0WritePageRegByte(0x04, 0x10, 0x80);							//Mod Mode FM
-	SPI0WritePageRegByte(0x04, 0x34, 0x3C);							//Compressor off, de-Emph on 3KHz Audio Filter
-	SPI0WritePageRegByte(0x04, 0x81, 0x19);							//Interrupt Masks (for DMR?)
-	SPI0WritePageRegByte(0x04, 0x85, 0x00);							//Interrupt Masks )For DMR?)
-	SPI0WritePageRegByte(0x04, 0x26, 0xFD);							//Undocumented register Turns on FM receive
+	hrc6000RunScript(scriptFMRx, SCRIPT_LENGTH(scriptFMRx), NULL);
 }
 
 //restore all important registers that may have been changed by FM mode
 void HRC6000SetDMR(void)
 {
-	if(trxGetFrequency() > 30000000)
-	{
-		SPI0WritePageRegByte(0x04, 0x01, 0xF0);										//set 2 point Mod, receive mode IF, non inverted (for UHF)
-	}
-	else
-	{
-		SPI0WritePageRegByte(0x04, 0x01, 0xF0);                                     //set 2 point Mod, receive mode IF, inverted (for VHF)
-	}
+	uint8_t args[DMR_ARG_NUM];
+
+	args[DMR_ARG_I_GAIN] = digitalIGain;
+	args[DMR_ARG_Q_GAIN] = digitalQGain;
+	args[DMR_ARG_MIC_GAIN] = 0x20 + (nonVolatileSettings.micGainDMR);
 
-	SPI0WritePageRegByte(0x04, 0x45, digitalIGain);									//Set MOD2 Level (from cal table)
-	SPI0WritePageRegByte(0x04, 0x46, digitalQGain);									//Set MOD1 Level (from cal table)
-	SPI0WritePageRegByte(0x04, 0x10, 0x6E);											//Set mode to DMR,Tier2,Timeslot Mode, Layer 2, Repeater, Aligned, Slot1
-	SPI0WritePageRegByte(0x04, 0xE0, 0xC9);   										//CODEC under MCU Control, LineOut2 Enabled, Mic_p Enabled,  I2S Slave Mode
-	SPI0WritePageRegByte(0x04, 0xE4, 0x20 + (nonVolatileSettings.micGainDMR));		//Mic Gain
-	SPI0WritePageRegByte(0x04, 0x26, 0xFD);											//Undocumented register believed to control IF ADC
+	hrc6000RunScript(scriptDMR, SCRIPT_LENGTH(scriptDMR), args);
 }
 
 void HRC6000SetTxCTCSS(uint8_t index)
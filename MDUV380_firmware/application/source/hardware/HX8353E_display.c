@@ -39,6 +39,7 @@
 #include "user_interface/uiLocalisation.h"
 #include "user_interface/menuSystem.h"
 #include "utils.h"
+#include "interfaces/trace.h"
 #include "stm32f4xx_hal.h"
 
 // number representing the maximum angle (e.g. if 100, then if you pass in start=0 and end=50, you get a half circle)
@@ -65,8 +66,23 @@ static uint16_t foregroundColour = 0x0000U;
 static uint16_t backgroundColour = 0xFFFFU;
 #endif
 
+#if defined(DISPLAY_INDEXED_FRAMEBUFFER_BPP)
+#define PIXELS_PER_BYTE             (8 / DISPLAY_INDEXED_FRAMEBUFFER_BPP)
+#define PIXEL_INDEX_MASK            ((1 << DISPLAY_INDEXED_FRAMEBUFFER_BPP) - 1)
+#define EXPANSION_LINES             4 // display lines expanded per DMA transfer
+
+static uint8_t screenBufData[DISPLAY_SCREEN_BUFFER_SIZE] __attribute__((aligned(4)));
+uint16_t *screenBuf = (uint16_t *)screenBufData; // points to a native colour buffer when overridden
+
+static uint16_t palette[DISPLAY_PALETTE_SIZE];
+static uint8_t paletteUsed = 0;
+static uint16_t paletteLastColour;
+static uint8_t paletteLastIndex = 0xFF;
+static uint16_t expansionBuf[2][EXPANSION_LINES * DISPLAY_SIZE_X];
+#else
 static uint16_t screenBufData[DISPLAY_SIZE_X * DISPLAY_SIZE_Y];
 uint16_t *screenBuf = screenBufData;
+#endif
 //#define DISPLAY_CHECK_BOUNDS
 
 #ifdef DISPLAY_CHECK_BOUNDS
@@ -78,6 +94,159 @@ DayTime_t themeDaytime = DAY;
 uint16_t themeItems[NIGHT + 1][THEME_ITEM_MAX]; // Theme storage
 #endif
 
+#if defined(DISPLAY_INDEXED_FRAMEBUFFER_BPP)
+static void paletteReset(uint16_t nativeColour)
+{
+	palette[0] = nativeColour;
+	paletteUsed = 1;
+	paletteLastColour = nativeColour;
+	paletteLastIndex = 0;
+}
+
+// Used when the palette is full: weighted distance in RGB565 space, 5 bits components are scaled to 6 bits.
+static uint8_t paletteGetNearestIndex(uint16_t nativeColour)
+{
+	uint16_t colour = __builtin_bswap16(nativeColour);
+	uint32_t bestDistance = UINT32_MAX;
+	uint8_t bestIndex = 0;
+
+	for (uint8_t i = 0; i < paletteUsed; i++)
+	{
+		uint16_t entry = __builtin_bswap16(palette[i]);
+		int32_t d1 = (int32_t)(colour >> 11) - (int32_t)(entry >> 11);
+		int32_t d2 = (int32_t)((colour >> 5) & 0x3F) - (int32_t)((entry >> 5) & 0x3F);
+		int32_t d3 = (int32_t)(colour & 0x1F) - (int32_t)(entry & 0x1F);
+		uint32_t distance = (uint32_t)((d1 * d1 * 4) + (d2 * d2) + (d3 * d3 * 4));
+
+		if (distance < bestDistance)
+		{
+			bestDistance = distance;
+			bestIndex = i;
+		}
+	}
+
+	return bestIndex;
+}
+
+static uint8_t paletteGetIndex(uint16_t nativeColour)
+{
+	if ((paletteLastIndex < paletteUsed) && (nativeColour == paletteLastColour))
+	{
+		return paletteLastIndex;
+	}
+
+	uint8_t index = 0;
+
+	while ((index < paletteUsed) && (palette[index] != nativeColour))
+	{
+		index++;
+	}
+
+	if (index == paletteUsed)
+	{
+		if (paletteUsed < DISPLAY_PALETTE_SIZE)
+		{
+			palette[paletteUsed++] = nativeColour;
+		}
+		else
+		{
+			index = paletteGetNearestIndex(nativeColour);
+		}
+	}
+
+	paletteLastColour = nativeColour;
+	paletteLastIndex = index;
+
+	return index;
+}
+
+static inline bool screenBufIsIndexed(void)
+{
+	return (screenBuf == (uint16_t *)screenBufData);
+}
+
+static inline uint8_t screenBufGetIndex(uint32_t i)
+{
+	return ((screenBufData[i / PIXELS_PER_BYTE] >> ((i % PIXELS_PER_BYTE) * DISPLAY_INDEXED_FRAMEBUFFER_BPP)) & PIXEL_INDEX_MASK);
+}
+#endif
+
+static inline void screenBufSetPixel(uint32_t i, uint16_t nativeColour)
+{
+#if defined(DISPLAY_INDEXED_FRAMEBUFFER_BPP)
+	if (screenBufIsIndexed())
+	{
+		uint8_t shift = (i % PIXELS_PER_BYTE) * DISPLAY_INDEXED_FRAMEBUFFER_BPP;
+		uint8_t *p = &screenBufData[i / PIXELS_PER_BYTE];
+
+		*p = (*p & ~(PIXEL_INDEX_MASK << shift)) | (paletteGetIndex(nativeColour) << shift);
+		return;
+	}
+#endif
+	screenBuf[i] = nativeColour;
+}
+
+// Fill a pixel range, whole bytes of an indexed buffer are filled in one go
+static void screenBufFill(uint32_t start, uint32_t end, uint16_t nativeColour)
+{
+	if (end <= start)
+	{
+		return;
+	}
+
+#if defined(DISPLAY_INDEXED_FRAMEBUFFER_BPP)
+	if (screenBufIsIndexed())
+	{
+		uint8_t index = paletteGetIndex(nativeColour);
+		uint8_t packed = 0;
+
+		for (int i = 0; i < PIXELS_PER_BYTE; i++)
+		{
+			packed |= (index << (i * DISPLAY_INDEXED_FRAMEBUFFER_BPP));
+		}
+
+		while ((start < end) && (start % PIXELS_PER_BYTE))
+		{
+			screenBufSetPixel(start++, nativeColour);
+		}
+
+		uint32_t wholeBytes = (end - start) / PIXELS_PER_BYTE;
+		memset(&screenBufData[start / PIXELS_PER_BYTE], packed, wholeBytes);
+		start += (wholeBytes * PIXELS_PER_BYTE);
+
+		while (start < end)
+		{
+			screenBufSetPixel(start++, nativeColour);
+		}
+		return;
+	}
+#endif
+
+	// Native buffer: two pixels per write once the pointer is word aligned
+	uint16_t *p = &screenBuf[start];
+	uint32_t len = (end - start);
+
+	if (((uint32_t)p & 0x02) != 0)
+	{
+		*p++ = nativeColour;
+		len--;
+	}
+
+	uint32_t *p32 = (uint32_t *)p;
+	uint32_t colour32 = ((uint32_t)nativeColour << 16) | nativeColour;
+
+	while (len >= 2)
+	{
+		*p32++ = colour32;
+		len -= 2;
+	}
+
+	if (len)
+	{
+		*((uint16_t *)p32) = nativeColour;
+	}
+}
+
 int16_t displaySetPixel(int16_t x, int16_t y, bool isInverted)
 {
 	int16_t i = (y * DISPLAY_SIZE_X) + x;
@@ -87,7 +256,7 @@ int16_t displaySetPixel(int16_t x, int16_t y, bool isInverted)
 		return -1;// off the screen
 	}
 
-	screenBuf[i] = isInverted ? foregroundColour : backgroundColour;
+	screenBufSetPixel(i, (isInverted ? foregroundColour : backgroundColour));
 
 	return 0;
 }
@@ -167,21 +336,95 @@ static uint8_t *getUncompressedChar(uint8_t *dest, uint8_t *currentFont, uint8_t
 
 	return dest;
 }
+
+// Glyphs are converted from the column major font data to one bit mask per pixel row (bit 0 is the leftmost column),
+// which is then drawn as horizontal spans.
+#define GLYPH_MAX_WIDTH            16
+#define GLYPH_MAX_HEIGHT           32
+// Characters used by frequencies, times and counters in the two large fonts stay converted.
+#define GLYPH_CACHE_FIRST_CHAR     '-'
+#define GLYPH_CACHE_LAST_CHAR      ':'
+#define GLYPH_CACHE_NUM_CHARS      ((GLYPH_CACHE_LAST_CHAR - GLYPH_CACHE_FIRST_CHAR) + 1)
+#define GLYPH_CACHE_NUM_FONTS      2 // FONT_SIZE_3 and FONT_SIZE_4
+
+static __attribute__((section(".ccmram"))) uint16_t glyphCacheRows[GLYPH_CACHE_NUM_FONTS][GLYPH_CACHE_NUM_CHARS][GLYPH_MAX_HEIGHT];
+static uint16_t glyphCacheValid[GLYPH_CACHE_NUM_FONTS]; // one bit per cached character, CCM RAM isn't cleared at startup
+
+static void convertGlyphToRows(const uint8_t *charData, int16_t charWidthPixels, int16_t charHeightPixels, uint16_t *rows)
+{
+	memset(rows, 0, (charHeightPixels * sizeof(uint16_t)));
+
+	for (int16_t page = 0; (page * 8) < charHeightPixels; page++)
+	{
+		const uint8_t *pageData = &charData[page * charWidthPixels];
+
+		for (int16_t x = 0; x < charWidthPixels; x++)
+		{
+			uint8_t bits = pageData[x];
+
+			while (bits)
+			{
+				int16_t y = (page * 8) + __builtin_ctz(bits);
+
+				if (y < charHeightPixels)
+				{
+					rows[y] |= (1U << x);
+				}
+				bits &= (bits - 1);
+			}
+		}
+	}
+}
+
+static const uint16_t *getGlyphRows(uint8_t *currentFont, ucFont_t fontSize, uint32_t charOffset, uint16_t *rowsBuf)
+{
+	int16_t charWidthPixels = currentFont[4];
+	int16_t charHeightPixels = currentFont[5];
+	uint32_t code = charOffset + currentFont[2];
+	int cacheFont = ((fontSize == FONT_SIZE_3) ? 0 : ((fontSize == FONT_SIZE_4) ? 1 : -1));
+	uint16_t *rows = rowsBuf;
+	uint8_t *charData;
+	uint8_t uncompressChar[(GLYPH_MAX_WIDTH * GLYPH_MAX_HEIGHT) / 8];
+
+	if ((cacheFont >= 0) && (code >= GLYPH_CACHE_FIRST_CHAR) && (code <= GLYPH_CACHE_LAST_CHAR))
+	{
+		uint32_t cacheIndex = (code - GLYPH_CACHE_FIRST_CHAR);
+
+		rows = glyphCacheRows[cacheFont][cacheIndex];
+
+		if (glyphCacheValid[cacheFont] & (1U << cacheIndex))
+		{
+			return rows;
+		}
+
+		glyphCacheValid[cacheFont] |= (1U << cacheIndex);
+	}
+
+	if (currentFont[0] & 0x01)
+	{
+		charData = getUncompressedChar(&uncompressChar[0], currentFont, charOffset);
+	}
+	else
+	{
+		charData = &currentFont[8 + (charOffset * currentFont[7])];
+	}
+
+	convertGlyphToRows(charData, charWidthPixels, charHeightPixels, rows);
+
+	return rows;
+}
 #endif
 
 int displayPrintCore(int16_t xPos, int16_t yPos, const char *szMsg, ucFont_t fontSize, ucTextAlign_t alignment, bool isInverted)
 {
 #if ! defined(PLATFORM_GD77S)
 	int16_t sLen;
-	uint8_t *currentCharData;
 	int16_t charWidthPixels;
 	int16_t charHeightPixels;
-	int16_t bytesPerChar;
 	int16_t startCode;
 	int16_t endCode;
 	uint8_t *currentFont;
-	bool fontIsCompressed = false;
-	uint8_t uncompressChar[64];
+	uint16_t glyphRows[GLYPH_MAX_HEIGHT];
 
 	sLen = strlen(szMsg);
 
@@ -225,12 +468,10 @@ int displayPrintCore(int16_t xPos, int16_t yPos, const char *szMsg, ucFont_t fon
 			break;
 	}
 
-	fontIsCompressed	= (currentFont[0] & 0x01); // does the current font is compressed ?
 	startCode   		= currentFont[2];  // get first defined character
 	endCode 	  		= currentFont[3];  // get last defined character
 	charWidthPixels   	= currentFont[4];  // width in pixel of one char
 	charHeightPixels  	= currentFont[5];  // page count per char
-	bytesPerChar 		= currentFont[7];  // bytes per char
 
 	if ((charWidthPixels * sLen) + xPos > DISPLAY_SIZE_X)
 	{
@@ -255,7 +496,12 @@ int displayPrintCore(int16_t xPos, int16_t yPos, const char *szMsg, ucFont_t fon
 			break;
 	}
 
-	for (int16_t i = 0; i < sLen; i++)
+	// Vertical clipping, once for the whole string
+	int16_t firstRow = MAX(0, -yPos);
+	int16_t lastRow = MIN(charHeightPixels, (DISPLAY_SIZE_Y - yPos));
+	uint16_t colour = (isInverted ? backgroundColour : foregroundColour);
+
+	for (int16_t i = 0; (i < sLen) && (firstRow < lastRow); i++)
 	{
 		// Skip space character as it's empty (and no more part of the fonts).
 		if (szMsg[i] == ' ')
@@ -263,39 +509,50 @@ int displayPrintCore(int16_t xPos, int16_t yPos, const char *szMsg, ucFont_t fon
 			continue;
 		}
 
-		uint32_t charOffset = (szMsg[i] - startCode);
+		int16_t charX = xPos + (i * charWidthPixels);
+		uint32_t columnMask = ((1U << charWidthPixels) - 1);
 
-		// End boundary checking.
-		if (charOffset > endCode)
+		// Horizontal clipping, only the characters on the screen edges are concerned
+		if (charX < 0)
 		{
-			charOffset = ('?' - startCode); // Substitute unsupported ASCII code by a question mark
+			if ((charX + charWidthPixels) <= 0)
+			{
+				continue;
+			}
+			columnMask &= (columnMask << -charX);
 		}
 
-		if (fontIsCompressed)
+		if ((charX + charWidthPixels) > DISPLAY_SIZE_X)
 		{
-			currentCharData = getUncompressedChar(&uncompressChar[0], currentFont, charOffset);
+			if (charX >= DISPLAY_SIZE_X)
+			{
+				break;
+			}
+			columnMask &= ((1U << (DISPLAY_SIZE_X - charX)) - 1);
 		}
-		else
+
+		uint32_t charOffset = (szMsg[i] - startCode);
+
+		// End boundary checking.
+		if (charOffset > endCode)
 		{
-			currentCharData = (uint8_t *)&currentFont[8 + (charOffset * bytesPerChar)];
+			charOffset = ('?' - startCode); // Substitute unsupported ASCII code by a question mark
 		}
 
-		uint32_t charPixelOffset = (i * charWidthPixels);
+		const uint16_t *rows = getGlyphRows(currentFont, fontSize, charOffset, glyphRows);
+		int32_t lineOffset = ((yPos + firstRow) * DISPLAY_SIZE_X) + charX;
 
-		for(int x = 0; x <  charWidthPixels; x++)
+		for (int16_t y = firstRow; y < lastRow; y++, lineOffset += DISPLAY_SIZE_X)
 		{
-			int xp = x + xPos;
+			uint32_t mask = (rows[y] & columnMask);
 
-			for(int y =  0; y < charHeightPixels; y++)
+			while (mask)
 			{
-				uint8_t rowData = currentCharData[x + ((y / 8) * charWidthPixels)];
-				int32_t bOffset = xp + ((yPos + y) * DISPLAY_SIZE_X) + charPixelOffset;
-
-				if ((rowData >> (y % 8) & 0x01) && (bOffset < (DISPLAY_SIZE_X * DISPLAY_SIZE_Y)))
-				{
-					screenBuf[xp + ((yPos + y) * DISPLAY_SIZE_X) + charPixelOffset] =  isInverted ? backgroundColour : foregroundColour;
-				}
+				uint32_t spanStart = __builtin_ctz(mask);
+				uint32_t spanLength = __builtin_ctz(~(mask >> spanStart));
 
+				screenBufFill((lineOffset + spanStart), (lineOffset + spanStart + spanLength), colour);
+				mask &= ~(((1U << spanLength) - 1) << spanStart);
 			}
 		}
 	}
@@ -305,11 +562,15 @@ int displayPrintCore(int16_t xPos, int16_t yPos, const char *szMsg, ucFont_t fon
 
 void displayClearBuf(void)
 {
-	// may be able to do this using DMA
-	for(int i = 0; i < DISPLAY_SIZE_X * DISPLAY_SIZE_Y; i++)
+#if defined(DISPLAY_INDEXED_FRAMEBUFFER_BPP)
+	// Nothing else than the background remains in use, so the palette can start over
+	if (screenBufIsIndexed())
 	{
-		screenBuf[i] = backgroundColour;
+		paletteReset(backgroundColour);
 	}
+#endif
+	// may be able to do this using DMA
+	screenBufFill(0, (DISPLAY_SIZE_X * DISPLAY_SIZE_Y), backgroundColour);
 }
 
 void displayClearRows(int16_t startRow, int16_t endRow, bool isInverted)
@@ -328,12 +589,7 @@ void displayClearRows(int16_t startRow, int16_t endRow, bool isInverted)
 	startRow *= (8 * DISPLAY_SIZE_X);
 	endRow *= (8 * DISPLAY_SIZE_X);
 
-	uint16_t fillColour = (isInverted ? foregroundColour : backgroundColour);
-
-	for(int i = startRow; i < endRow; i++)
-	{
-		screenBuf[i] = fillColour;
-	}
+	screenBufFill(startRow, endRow, (isInverted ? foregroundColour : backgroundColour));
 
 }
 
@@ -1024,11 +1280,8 @@ void displayFillRect(int16_t x, int16_t y, int16_t width, int16_t height, bool i
 
 	for(int yp = 0; yp < height; yp++)
 	{
-		lineStartOffset = (y + yp) * DISPLAY_SIZE_X;
-		for(int xp = 0; xp < width; xp++)
-		{
-			screenBuf[lineStartOffset + x + xp] = isInverted ? backgroundColour : foregroundColour;
-		}
+		lineStartOffset = ((y + yp) * DISPLAY_SIZE_X) + x;
+		screenBufFill(lineStartOffset, (lineStartOffset + width), (isInverted ? backgroundColour : foregroundColour));
 	}
 }
 
@@ -1203,12 +1456,12 @@ uint16_t *displayGetScreenBuffer(void)
 
 void displayRestorePrimaryScreenBuffer(void)
 {
-	screenBuf = screenBufData;
+	screenBuf = (uint16_t *)screenBufData;
 }
 
 uint16_t *displayGetPrimaryScreenBuffer(void)
 {
-	return &screenBufData[0];
+	return (uint16_t *)&screenBufData[0];
 }
 
 void displayOverrideScreenBuffer(uint16_t *buffer)
@@ -1216,6 +1469,23 @@ void displayOverrideScreenBuffer(uint16_t *buffer)
 	screenBuf = buffer;
 }
 
+// Copy a byte range of the primary screen buffer, as if it was stored in the native colour format.
+void displayCopyPrimaryScreenBufferNative(uint8_t *dest, uint32_t offset, uint32_t length)
+{
+#if defined(DISPLAY_INDEXED_FRAMEBUFFER_BPP)
+	while (length--)
+	{
+		uint32_t i = (offset >> 1);
+		uint16_t colour = ((i < (DISPLAY_SIZE_X * DISPLAY_SIZE_Y)) ? palette[screenBufGetIndex(i)] : 0xFFFF);
+
+		*dest++ = ((offset & 0x01) ? (colour >> 8) : (colour & 0xFF));
+		offset++;
+	}
+#else
+	memcpy(dest, ((uint8_t *)screenBufData + offset), length);
+#endif
+}
+
 static bool isAwake = true;
 
 #if 0
@@ -1227,10 +1497,60 @@ static void dmaCompleteCallback(DMA_HandleTypeDef *hdma)
 }
 #endif
 
+#if defined(DISPLAY_INDEXED_FRAMEBUFFER_BPP)
+static void expandIndexedLines(uint16_t *dest, uint32_t firstLine, uint32_t numLines)
+{
+	const uint8_t *src = &screenBufData[(firstLine * DISPLAY_SIZE_X) / PIXELS_PER_BYTE];
+	uint32_t numBytes = (numLines * DISPLAY_SIZE_X) / PIXELS_PER_BYTE;
+
+	while (numBytes--)
+	{
+		uint8_t packed = *src++;
+
+		for (int i = 0; i < PIXELS_PER_BYTE; i++)
+		{
+			*dest++ = palette[packed & PIXEL_INDEX_MASK];
+			packed >>= DISPLAY_INDEXED_FRAMEBUFFER_BPP;
+		}
+	}
+}
+
+// Expand a few lines into one buffer while the other one is sent to the display
+static void renderIndexedLines(uint32_t startLine, uint32_t endLine)
+{
+	bool dmaActive = false;
+	int bufIndex = 0;
+
+	while (startLine < endLine)
+	{
+		uint32_t numLines = MIN(EXPANSION_LINES, (endLine - startLine));
+
+		expandIndexedLines(expansionBuf[bufIndex], startLine, numLines);
+
+		if (dmaActive)
+		{
+			HAL_DMA_PollForTransfer(&hdma_memtomem_dma2_stream0, HAL_DMA_FULL_TRANSFER, HAL_MAX_DELAY);
+		}
+
+		dmaActive = (HAL_DMA_Start(&hdma_memtomem_dma2_stream0, (uint32_t)expansionBuf[bufIndex], LCD_FSMC_ADDR_DATA, (numLines * DISPLAY_SIZE_X * sizeof(uint16_t))) == HAL_OK);
+
+		bufIndex ^= 1;
+		startLine += numLines;
+	}
+
+	if (dmaActive)
+	{
+		HAL_DMA_PollForTransfer(&hdma_memtomem_dma2_stream0, HAL_DMA_FULL_TRANSFER, HAL_MAX_DELAY);
+	}
+}
+#endif
+
 void displayRenderRows(int16_t startRow, int16_t endRow)
 {
 	GPIO_InitTypeDef GPIO_InitStruct = {0};
 
+	TRACE_BEGIN(TRACE_ID_DISPLAY_RENDER);
+
 	// GD77 display controller has 8 lines per row.
 	startRow *= 8;
 	endRow *= 8;
@@ -1261,20 +1581,28 @@ void displayRenderRows(int16_t startRow, int16_t endRow)
 
 	displayWriteCmd(HX8583_CMD_RAMWR);
 
-	uint8_t *framePtr = (uint8_t *)screenBuf + (DISPLAY_SIZE_X * startRow * sizeof(uint16_t));
-
-	//if (HAL_DMA_RegisterCallback(&hdma_memtomem_dma2_stream0, HAL_DMA_XFER_CPLT_CB_ID, dmaCompleteCallback)== HAL_OK)
+#if defined(DISPLAY_INDEXED_FRAMEBUFFER_BPP)
+	if (screenBufIsIndexed())
+	{
+		renderIndexedLines(startRow, endRow);
+	}
+	else
+#endif
 	{
-		HAL_StatusTypeDef status = HAL_DMA_Start(&hdma_memtomem_dma2_stream0, (uint32_t)framePtr, LCD_FSMC_ADDR_DATA, (endRow - startRow) * DISPLAY_SIZE_X * sizeof(uint16_t));
-		if (status == HAL_OK)
+		uint8_t *framePtr = (uint8_t *)screenBuf + (DISPLAY_SIZE_X * startRow * sizeof(uint16_t));
+
+		//if (HAL_DMA_RegisterCallback(&hdma_memtomem_dma2_stream0, HAL_DMA_XFER_CPLT_CB_ID, dmaCompleteCallback)== HAL_OK)
 		{
-			HAL_DMA_PollForTransfer(&hdma_memtomem_dma2_stream0, HAL_DMA_FULL_TRANSFER, HAL_MAX_DELAY);
-			// need to wait for completion otherwise we CS gets disabled immediately.
-			// This could be done using a transfer complete callback
+			HAL_StatusTypeDef status = HAL_DMA_Start(&hdma_memtomem_dma2_stream0, (uint32_t)framePtr, LCD_FSMC_ADDR_DATA, (endRow - startRow) * DISPLAY_SIZE_X * sizeof(uint16_t));
+			if (status == HAL_OK)
+			{
+				HAL_DMA_PollForTransfer(&hdma_memtomem_dma2_stream0, HAL_DMA_FULL_TRANSFER, HAL_MAX_DELAY);
+				// need to wait for completion otherwise we CS gets disabled immediately.
+				// This could be done using a transfer complete callback
+			}
 		}
 	}
 
-
 #if false
 	// fallback
 	for(int y = 0; y < (endRow - startRow) * DISPLAY_SIZE_X * sizeof(uint16_t); y++)
@@ -1286,6 +1614,8 @@ void displayRenderRows(int16_t startRow, int16_t endRow)
 	HAL_GPIO_WritePin(LCD_CS_GPIO_Port, LCD_CS_Pin, GPIO_PIN_SET);
 
 	*((volatile uint8_t*) LCD_FSMC_ADDR_DATA) = 0;// write 0 to the display pins , to pull them all low, so keyboard reads don't need to
+
+	TRACE_END(TRACE_ID_DISPLAY_RENDER);
 }
 
 void displaySetInverseVideo(bool isInverted)
@@ -1319,24 +1649,31 @@ void displaySetDisplayPowerMode(bool wake)
 
 void displayConvertGD77ImageData(uint8_t *dataBuf)
 {
-	const uint32_t startOffset = (32 * DISPLAY_SIZE_X) + (DISPLAY_SIZE_X - 128) / 2;
+	const uint32_t startX = (DISPLAY_SIZE_X - 128) / 2;
+	const uint32_t startOffset = (32 * DISPLAY_SIZE_X) + startX;
 
-	for(int y = 0; y < 8; y++ )
+	// Bottom to top, so a packed (indexed) screen buffer doesn't overwrite image data that hasn't been read yet
+	for(int y = 7; y >= 0; y-- )
 	{
 		for(int x = 0; x < 128; x++)
 		{
 			uint8_t d = dataBuf[(y * 128) + x];
 			for(int r = 0; r < 8; r++)
 			{
-				screenBuf[startOffset + (((y * 8) + r) * DISPLAY_SIZE_X) + x] = ((d >> r) & 0x01) ? backgroundColour : foregroundColour;
+				screenBufSetPixel(startOffset + (((y * 8) + r) * DISPLAY_SIZE_X) + x, (((d >> r) & 0x01) ? backgroundColour : foregroundColour));
 			}
 		}
 	}
 
 	// clear beginning of display buff used to store the image read from flash
-	for(int i = 0; i < (128 * 64 / 8 / 2); i++)
+	for(uint32_t i = 0; i < ((128 * 64 / 8) * 8 / DISPLAY_BITS_PER_PIXEL); i++)
 	{
-		screenBuf[i] = backgroundColour;
+		uint32_t x = (i % DISPLAY_SIZE_X);
+
+		if ((i < startOffset) || (x < startX) || (x >= (startX + 128)))
+		{
+			screenBufSetPixel(i, backgroundColour);
+		}
 	}
 }
 
@@ -27,11 +27,18 @@
 
 #include "hardware/SPI_Flash.h"
 #include "interfaces/gpio.h"
+#include "interfaces/trace.h"
+#include "interfaces/runTimeStats.h"
+#include "interfaces/wdog.h"
 #include <string.h>
+#include <semphr.h>
 #include "main.h"
 
 // private functions
 static bool spi_flash_busy(void);
+static void spi_flash_cacheInvalidateRange(uint32_t address, int size);
+static void spi_flash_eraseSuspend(uint32_t address, int size);
+static void spi_flash_eraseResume(void);
 
 static void spi_flash_setWriteEnable(bool cmd);
 static inline void spi_flash_enable(void);
@@ -80,6 +87,78 @@ __attribute__((section(".ccmram"))) uint8_t SPI_Flash_sectorbuffer[4096];
 
 #define WINBOND_MANUF   0xef
 
+//
+// Reads go through a LRU cache of 256 bytes pages, filled by DMA. A miss right after the previously filled pages
+// (sequential reads: voice prompts, DMR ID blocks, channels/contacts scans) also fetches the following pages,
+// within the same READ_DATA command. The cached pages are dropped by the page programs and the sector erases.
+// The DMA can't access the CCM RAM, small reads and reads to CCM RAM buffers are polled.
+//
+#define SPI_FLASH_SIZE                  (16 * 1024 * 1024)
+#define SPI_FLASH_PAGE_SIZE             256
+#define SPI_FLASH_NO_PAGE               0xFFFFFFFFU
+#define SPI_FLASH_CACHE_PAGES           8
+#define SPI_FLASH_READ_AHEAD_PAGES      2     // Extra pages read on a sequential miss
+#define SPI_FLASH_CACHE_MAX_READ_SIZE   1024  // Bigger reads (sectors, CPS) go straight to the caller buffer
+#define SPI_FLASH_DMA_MIN_SIZE          32    // Below that, setting up the DMA costs more than polling the bytes
+#define SPI_FLASH_DMA_TIMEOUT           100   // ms
+#define SPI_FLASH_IS_CCMRAM(p)          ((((uintptr_t)(p)) >= 0x10000000U) && (((uintptr_t)(p)) < 0x10010000U))
+
+//
+// Erase pool: append style consumers (logs) ask for the sectors they'll write next to be erased in the background,
+// by the maintenance task, while the radio is idle. SPI_Flash_eraseSector() then returns straight away for a pre-erased
+// sector. A read (cache miss) issued during a background erase suspends it, unless it's in the sector being erased.
+// The ID and security registers reads suspend it too (as a zero size read past the array).
+// SPI_Flash_write() only erases when some bits have to go back to 1, and only programs the modified pages.
+//
+#define SPI_FLASH_SECTOR_SIZE           4096
+#define SPI_FLASH_ERASE_POOL_SIZE       4
+#define SPI_FLASH_NO_ERASE              -1
+#define SPI_FLASH_SECTOR_ERASE_TIMEOUT  500   // ms
+#define SPI_FLASH_ERASE_POLL_PERIOD     2     // ms, background erase completion polling
+#define SPI_FLASH_ERASE_RESUME_MIN_US   25    // tSUS, minimum delay between a resume and the next suspend
+#define SPI_FLASH_SR2_SUS               0x80  // SR_SUS, in the status register 2
+
+typedef enum
+{
+	SPI_FLASH_POOL_FREE = 0,
+	SPI_FLASH_POOL_PENDING,
+	SPI_FLASH_POOL_ERASING,
+	SPI_FLASH_POOL_ERASED
+} spiFlashPoolState_t;
+
+typedef struct
+{
+	uint32_t address;
+	spiFlashPoolState_t state;
+} spiFlashPoolEntry_t;
+
+typedef struct
+{
+	uint32_t address; // SPI_FLASH_NO_PAGE if unused
+	uint32_t lastUse;
+} spiFlashCacheEntry_t;
+
+static uint8_t spiFlashCachePages[SPI_FLASH_CACHE_PAGES][SPI_FLASH_PAGE_SIZE] __attribute__((aligned(4)));
+static spiFlashCacheEntry_t spiFlashCacheEntries[SPI_FLASH_CACHE_PAGES];
+static uint32_t spiFlashCacheUseCounter = 0;
+static uint32_t spiFlashNextSequentialPage = SPI_FLASH_NO_PAGE;
+
+static SemaphoreHandle_t spiFlashMutex = NULL;
+static SemaphoreHandle_t spiFlashDmaDone = NULL;
+static volatile bool spiFlashDmaError = false;
+
+static spiFlashPoolEntry_t spiFlashErasePool[SPI_FLASH_ERASE_POOL_SIZE];
+static int spiFlashErasingEntry = SPI_FLASH_NO_ERASE; // Pool entry being erased in the background
+static bool spiFlashEraseIsSuspended = false;
+static uint32_t spiFlashEraseResumeCycles = 0;
+static volatile bool spiFlashRadioIsIdle = false;
+static SemaphoreHandle_t spiFlashMaintenanceWake = NULL;
+static Task_t spiFlashMaintenanceTask;
+
+static spiFlashStats_t spiFlashStats;
+static uint64_t spiFlashBusCycles = 0;
+static uint64_t spiFlashReadCycles = 0;
+static uint64_t spiFlashStallCycles = 0;
 
 uint32_t flashChipPartNumber;
 
@@ -87,6 +166,18 @@ bool SPI_Flash_init(void)
 {
 	HAL_GPIO_WritePin(SPI_Flash_CS_GPIO_Port, SPI_Flash_CS_Pin, GPIO_PIN_SET); // Disable
 
+	for (int i = 0; i < SPI_FLASH_CACHE_PAGES; i++)
+	{
+		spiFlashCacheEntries[i].address = SPI_FLASH_NO_PAGE;
+	}
+
+	if (spiFlashMutex == NULL)
+	{
+		spiFlashMutex = xSemaphoreCreateMutex();
+		spiFlashDmaDone = xSemaphoreCreateBinary();
+		spiFlashMaintenanceWake = xSemaphoreCreateBinary();
+	}
+
     flashChipPartNumber = SPI_Flash_readPartID();
 
     // 4014 25Q80 8M bits 1M bytes, used in the GD-77
@@ -96,91 +187,743 @@ bool SPI_Flash_init(void)
     return (flashChipPartNumber == 0x4018);
 }
 
+// The flash is used by several tasks (UI, GPS, USB), the mutex isn't taken before the scheduler is started,
+// or in an ISR/critical section (the DMA isn't used either then).
+static bool spi_flash_canWait(void)
+{
+	return ((spiFlashMutex != NULL) && (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING) &&
+			(xPortIsInsideInterrupt() == pdFALSE) && (__get_BASEPRI() == 0U) && (__get_PRIMASK() == 0U));
+}
+
+static bool spi_flash_lock(void)
+{
+	if (spi_flash_canWait())
+	{
+		xSemaphoreTake(spiFlashMutex, portMAX_DELAY);
+		return true;
+	}
+
+	return false;
+}
+
+static void spi_flash_unlock(bool locked)
+{
+	if (locked)
+	{
+		xSemaphoreGive(spiFlashMutex);
+	}
+}
+
+void HAL_SPI_RxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+	if (hspi == &HANDLE_SPI)
+	{
+		BaseType_t higherPriorityTaskWoken = pdFALSE;
+
+		xSemaphoreGiveFromISR(spiFlashDmaDone, &higherPriorityTaskWoken);
+		portYIELD_FROM_ISR(higherPriorityTaskWoken);
+	}
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
+{
+	if (hspi == &HANDLE_SPI)
+	{
+		spiFlashDmaError = true;
+		HAL_SPI_RxCpltCallback(hspi);
+	}
+}
+
+static bool spi_flash_receiveCanUseDma(uint8_t *dataBuf, int size)
+{
+	return ((size >= SPI_FLASH_DMA_MIN_SIZE) && (SPI_FLASH_IS_CCMRAM(dataBuf) == false) && spi_flash_canWait());
+}
+
+static bool spi_flash_receiveDmaStart(uint8_t *dataBuf, int size)
+{
+	spiFlashDmaError = false;
+	spiFlashStats.dmaTransfers++;
+
+	return (HAL_SPI_Receive_DMA(&HANDLE_SPI, dataBuf, size) == HAL_OK);
+}
+
+static bool spi_flash_receiveDmaWait(void)
+{
+	if (xSemaphoreTake(spiFlashDmaDone, pdMS_TO_TICKS(SPI_FLASH_DMA_TIMEOUT)) != pdTRUE)
+	{
+		HAL_SPI_Abort(&HANDLE_SPI);
+		return false;
+	}
+
+	return (spiFlashDmaError == false);
+}
+
+// Reads the data phase of a READ_DATA command (CS is low, command and address sent)
+static bool spi_flash_receive(uint8_t *dataBuf, int size)
+{
+	if (spi_flash_receiveCanUseDma(dataBuf, size))
+	{
+		return (spi_flash_receiveDmaStart(dataBuf, size) && spi_flash_receiveDmaWait());
+	}
+
+	return (HAL_SPI_Receive(&HANDLE_SPI, dataBuf, size, HAL_MAX_DELAY) == HAL_OK);
+}
+
+static void spi_flash_sendReadCommand(uint32_t addr, int size)
+{
+	uint8_t commandBuf[4]= { READ_DATA, addr >> 16, addr >> 8, addr };// command
+
+	spi_flash_eraseSuspend(addr, size);
+	spi_flash_enable();
+	HAL_SPI_Transmit(&HANDLE_SPI, commandBuf, 4, HAL_MAX_DELAY);
+}
+
+static bool spi_flash_readDirect(uint32_t addr, uint8_t *dataBuf, int size)
+{
+	uint32_t startCycles = runTimeStatsGetCycles();
+	bool retVal;
+
+	spi_flash_sendReadCommand(addr, size);
+	retVal = spi_flash_receive(dataBuf, size);
+	spi_flash_disable();
+
+	spiFlashBusCycles += (runTimeStatsGetCycles() - startCycles);
+	spiFlashStats.flashBytes += size;
+
+	return retVal;
+}
+
+// Returns the cached copy of a page, reading it (and the next ones if the reads are sequential) on a miss
+static uint8_t *spi_flash_cachePage(uint32_t pageAddress)
+{
+	int entries[1 + SPI_FLASH_READ_AHEAD_PAGES];
+	int numPages = 1;
+	uint32_t startCycles;
+	bool ok = true;
+
+	for (int i = 0; i < SPI_FLASH_CACHE_PAGES; i++)
+	{
+		if (spiFlashCacheEntries[i].address == pageAddress)
+		{
+			spiFlashCacheEntries[i].lastUse = ++spiFlashCacheUseCounter;
+			spiFlashStats.hits++;
+			return spiFlashCachePages[i];
+		}
+	}
+
+	spiFlashStats.misses++;
+
+	if (pageAddress == spiFlashNextSequentialPage)
+	{
+		// Up to the next already cached page
+		while ((numPages < (1 + SPI_FLASH_READ_AHEAD_PAGES)) && ((pageAddress + (numPages * SPI_FLASH_PAGE_SIZE)) < SPI_FLASH_SIZE))
+		{
+			uint32_t nextAddress = pageAddress + (numPages * SPI_FLASH_PAGE_SIZE);
+			bool isCached = false;
+
+			for (int i = 0; i < SPI_FLASH_CACHE_PAGES; i++)
+			{
+				if (spiFlashCacheEntries[i].address == nextAddress)
+				{
+					isCached = true;
+					break;
+				}
+			}
+
+			if (isCached)
+			{
+				break;
+			}
+
+			numPages++;
+		}
+	}
+
+	// Least recently used entries
+	for (int p = 0; p < numPages; p++)
+	{
+		int victim = 0;
+
+		for (int i = 1; i < SPI_FLASH_CACHE_PAGES; i++)
+		{
+			if (spiFlashCacheEntries[i].lastUse < spiFlashCacheEntries[victim].lastUse)
+			{
+				victim = i;
+			}
+		}
+
+		entries[p] = victim;
+		spiFlashCacheEntries[victim].address = SPI_FLASH_NO_PAGE;
+		spiFlashCacheEntries[victim].lastUse = ++spiFlashCacheUseCounter;
+	}
+
+	startCycles = runTimeStatsGetCycles();
+	spi_flash_sendReadCommand(pageAddress, (numPages * SPI_FLASH_PAGE_SIZE));
+	for (int p = 0; (p < numPages) && ok; p++)
+	{
+		ok = spi_flash_receive(spiFlashCachePages[entries[p]], SPI_FLASH_PAGE_SIZE);
+	}
+	spi_flash_disable();
+	spiFlashBusCycles += (runTimeStatsGetCycles() - startCycles);
+
+	if (ok == false)
+	{
+		spiFlashNextSequentialPage = SPI_FLASH_NO_PAGE;
+		return NULL;
+	}
+
+	for (int p = 0; p < numPages; p++)
+	{
+		spiFlashCacheEntries[entries[p]].address = pageAddress + (p * SPI_FLASH_PAGE_SIZE);
+	}
+	// The requested page is the most recently used
+	spiFlashCacheEntries[entries[0]].lastUse = ++spiFlashCacheUseCounter;
+
+	spiFlashStats.readAheadPages += (numPages - 1);
+	spiFlashStats.flashBytes += (numPages * SPI_FLASH_PAGE_SIZE);
+	spiFlashNextSequentialPage = pageAddress + (numPages * SPI_FLASH_PAGE_SIZE);
+
+	return spiFlashCachePages[entries[0]];
+}
+
+static void spi_flash_cacheInvalidateRange(uint32_t address, int size)
+{
+	for (int i = 0; i < SPI_FLASH_CACHE_PAGES; i++)
+	{
+		if ((spiFlashCacheEntries[i].address != SPI_FLASH_NO_PAGE) &&
+				(spiFlashCacheEntries[i].address < (address + size)) && ((spiFlashCacheEntries[i].address + SPI_FLASH_PAGE_SIZE) > address))
+		{
+			spiFlashCacheEntries[i].address = SPI_FLASH_NO_PAGE;
+			spiFlashCacheEntries[i].lastUse = 0; // Reused first
+			spiFlashStats.invalidations++;
+		}
+	}
+
+	if ((spiFlashNextSequentialPage >= address) && (spiFlashNextSequentialPage < (address + size)))
+	{
+		spiFlashNextSequentialPage = SPI_FLASH_NO_PAGE;
+	}
+}
+
+static void spi_flash_statsUpdate(uint32_t startCycles, int size)
+{
+	// Cycles per second at the current core clock
+	uint64_t cyclesPerSecond = 1000000ULL * (1000000U / runTimeStatsCyclesToMicroseconds(1000000U));
+
+	spiFlashReadCycles += (runTimeStatsGetCycles() - startCycles);
+	spiFlashStats.reads++;
+	spiFlashStats.servedBytes += size;
+
+	if ((spiFlashStats.hits + spiFlashStats.misses) > 0)
+	{
+		spiFlashStats.hitRatePermille = (uint32_t)(((uint64_t)spiFlashStats.hits * 1000U) / (spiFlashStats.hits + spiFlashStats.misses));
+	}
+
+	if (spiFlashBusCycles > 0)
+	{
+		spiFlashStats.flashBytesPerSecond = (uint32_t)(((uint64_t)spiFlashStats.flashBytes * cyclesPerSecond) / spiFlashBusCycles);
+	}
+
+	if (spiFlashReadCycles > 0)
+	{
+		spiFlashStats.servedBytesPerSecond = (uint32_t)(((uint64_t)spiFlashStats.servedBytes * cyclesPerSecond) / spiFlashReadCycles);
+	}
+}
+
 // Returns false for failed
 // Note. There is no error checking that the device is not initially busy.
 bool SPI_Flash_read(uint32_t addr, uint8_t *dataBuf, int size)
 {
-  uint8_t commandBuf[4]= { READ_DATA, addr >> 16, addr >> 8, addr };// command
+	uint32_t startCycles = runTimeStatsGetCycles();
+	bool retVal = true;
+	bool locked;
+
+	TRACE_BEGIN(TRACE_ID_SPI_FLASH_READ);
+	locked = spi_flash_lock();
+
+	if (size > SPI_FLASH_CACHE_MAX_READ_SIZE)
+	{
+		retVal = spi_flash_readDirect(addr, dataBuf, size);
+	}
+	else
+	{
+		uint32_t address = addr;
+		uint8_t *dest = dataBuf;
+		int remaining = size;
 
-  spi_flash_enable();
-  HAL_SPI_Transmit(&HANDLE_SPI, commandBuf, 4, HAL_MAX_DELAY);
-  HAL_SPI_Receive(&HANDLE_SPI, dataBuf, size, HAL_MAX_DELAY);
-  spi_flash_disable();
+		while (remaining > 0)
+		{
+			uint32_t pageAddress = (address & ~(SPI_FLASH_PAGE_SIZE - 1));
+			int offset = (address - pageAddress);
+			int length = (((SPI_FLASH_PAGE_SIZE - offset) < remaining) ? (SPI_FLASH_PAGE_SIZE - offset) : remaining);
+			uint8_t *page = spi_flash_cachePage(pageAddress);
 
-  return true;
+			if (page == NULL)
+			{
+				retVal = false;
+				break;
+			}
+
+			memcpy(dest, page + offset, length);
+			address += length;
+			dest += length;
+			remaining -= length;
+		}
+	}
+
+	spi_flash_statsUpdate(startCycles, size);
+	spi_flash_eraseResume();
+	spi_flash_unlock(locked);
+	TRACE_END(TRACE_ID_SPI_FLASH_READ);
+
+	return retVal;
 }
 
-bool SPI_Flash_write(uint32_t addr, uint8_t *dataBuf, int size)
+const spiFlashStats_t *SPI_Flash_getStats(void)
 {
-	bool retVal = true;
-	int flashWritePos = addr;
-	int flashSector;
-	int flashEndSector;
-	int bytesToWriteInCurrentSector = size;
+	return &spiFlashStats;
+}
+
+static uint8_t spi_flash_readStatusRegister(uint8_t command)
+{
+	uint8_t value;
+
+	spi_flash_enable();
+	HAL_SPI_Transmit(&HANDLE_SPI, &command, 1, HAL_MAX_DELAY);
+	HAL_SPI_Receive(&HANDLE_SPI, &value, 1, HAL_MAX_DELAY);
+	spi_flash_disable();
+
+	return value;
+}
+
+static void spi_flash_sendCommand(uint8_t command)
+{
+	spi_flash_enable();
+	HAL_SPI_Transmit(&HANDLE_SPI, &command, 1, HAL_MAX_DELAY);
+	spi_flash_disable();
+}
 
-	flashSector	= flashWritePos / 4096;
-	flashEndSector = (flashWritePos + size) / 4096;
+static bool spi_flash_waitReady(int timeout)
+{
+	bool isBusy;
 
-	if (flashSector != flashEndSector)
+	do
 	{
-		bytesToWriteInCurrentSector = (flashEndSector * 4096) - flashWritePos;
+		osDelay(1);
+		isBusy = spi_flash_busy();
+	} while ((timeout-- > 0) && isBusy);
+
+	return !isBusy;
+}
+
+static int spi_flash_poolFind(uint32_t sectorAddress)
+{
+	for (int i = 0; i < SPI_FLASH_ERASE_POOL_SIZE; i++)
+	{
+		if ((spiFlashErasePool[i].state != SPI_FLASH_POOL_FREE) && (spiFlashErasePool[i].address == sectorAddress))
+		{
+			return i;
+		}
 	}
 
-	if (bytesToWriteInCurrentSector != 4096)
+	return SPI_FLASH_NO_ERASE;
+}
+
+static void spi_flash_backgroundEraseDone(bool success)
+{
+	spiFlashErasePool[spiFlashErasingEntry].state = (success ? SPI_FLASH_POOL_ERASED : SPI_FLASH_POOL_FREE);
+	spiFlashErasingEntry = SPI_FLASH_NO_ERASE;
+	spiFlashEraseIsSuspended = false;
+
+	if (success)
 	{
-		SPI_Flash_read(flashSector * 4096, SPI_Flash_sectorbuffer, 4096);
+		spiFlashStats.backgroundErases++;
 	}
-	uint8_t *writePos = SPI_Flash_sectorbuffer + flashWritePos - (flashSector * 4096);
-	memcpy(writePos, dataBuf, bytesToWriteInCurrentSector);
+}
 
-	retVal = SPI_Flash_eraseSector(flashSector * 4096);
-	if (!retVal)
+// The chip can't program or erase anything else until the background erase is over (lock held)
+static void spi_flash_backgroundEraseWait(void)
+{
+	if (spiFlashErasingEntry != SPI_FLASH_NO_ERASE)
 	{
-		return false;
+		spi_flash_eraseResume();
+		spi_flash_backgroundEraseDone(spi_flash_waitReady(SPI_FLASH_SECTOR_ERASE_TIMEOUT));
 	}
+}
 
-	for (int i = 0; i < 16; i++)
+// Called before reading from the chip (lock held). The sector being erased can't be read before the end of the erase.
+static void spi_flash_eraseSuspend(uint32_t address, int size)
+{
+	uint32_t sectorAddress;
+	int timeout = 1000;
+
+	if ((spiFlashErasingEntry == SPI_FLASH_NO_ERASE) || spiFlashEraseIsSuspended)
 	{
-		retVal = SPI_Flash_writePage(flashSector * 4096 + i * 256, SPI_Flash_sectorbuffer + i * 256);
-		if (!retVal)
+		return;
+	}
+
+	sectorAddress = spiFlashErasePool[spiFlashErasingEntry].address;
+	if ((sectorAddress < (address + size)) && ((sectorAddress + SPI_FLASH_SECTOR_SIZE) > address))
+	{
+		spi_flash_backgroundEraseWait();
+		return;
+	}
+
+	if (spi_flash_busy() == false)
+	{
+		spi_flash_backgroundEraseDone(true);
+		return;
+	}
+
+	while (runTimeStatsCyclesToMicroseconds(runTimeStatsGetCycles() - spiFlashEraseResumeCycles) < SPI_FLASH_ERASE_RESUME_MIN_US)
+	{
+	}
+
+	spi_flash_sendCommand(E_SUSPEND);
+
+	while (spi_flash_busy() && (timeout-- > 0))
+	{
+	}
+
+	if (spi_flash_readStatusRegister(R_SR2) & SPI_FLASH_SR2_SUS)
+	{
+		spiFlashEraseIsSuspended = true;
+		spiFlashStats.eraseSuspends++;
+	}
+	else
+	{
+		// Completed before the suspend
+		spi_flash_backgroundEraseDone(true);
+	}
+}
+
+// Called once the read is over, before releasing the lock
+static void spi_flash_eraseResume(void)
+{
+	if (spiFlashEraseIsSuspended)
+	{
+		spi_flash_sendCommand(E_RESUME);
+		spiFlashEraseIsSuspended = false;
+		spiFlashEraseResumeCycles = runTimeStatsGetCycles();
+	}
+}
+
+// Lock held, no background erase in progress
+static bool spi_flash_programPage(uint32_t addr_start, uint8_t *dataBuf)
+{
+	uint8_t commandBuf[4]= { PAGE_PGM, addr_start >> 16, addr_start >> 8, 0x00 } ;
+	int entry = spi_flash_poolFind(addr_start & ~(SPI_FLASH_SECTOR_SIZE - 1));
+
+	// Not blank anymore, and a pending erase would now destroy the data
+	if (entry != SPI_FLASH_NO_ERASE)
+	{
+		spiFlashErasePool[entry].state = SPI_FLASH_POOL_FREE;
+	}
+
+	spi_flash_cacheInvalidateRange(addr_start & ~(SPI_FLASH_PAGE_SIZE - 1), SPI_FLASH_PAGE_SIZE);
+	spi_flash_setWriteEnable(true);
+
+	spi_flash_enable();
+
+	HAL_SPI_Transmit(&HANDLE_SPI, commandBuf, 4, HAL_MAX_DELAY);
+	HAL_SPI_Transmit(&HANDLE_SPI, dataBuf, 0x100, HAL_MAX_DELAY);
+
+	spi_flash_disable();
+
+	return spi_flash_waitReady(5);// Worst case is something like 3mS
+}
+
+// Lock held, no background erase in progress. Pre-erased sectors are taken from the pool.
+static bool spi_flash_eraseSector(uint32_t addr_start)
+{
+	uint8_t commandBuf[4] = { SECTOR_E, addr_start >> 16, addr_start >> 8, 0x00 };
+	uint32_t sectorAddress = (addr_start & ~(SPI_FLASH_SECTOR_SIZE - 1));
+	int entry = spi_flash_poolFind(sectorAddress);
+
+	if (entry != SPI_FLASH_NO_ERASE)
+	{
+		bool isErased = (spiFlashErasePool[entry].state == SPI_FLASH_POOL_ERASED);
+
+		spiFlashErasePool[entry].state = SPI_FLASH_POOL_FREE;
+
+		if (isErased)
 		{
-			return false;
+			spiFlashStats.erasesAvoided++;
+			return true;
 		}
 	}
 
-	if (flashSector != flashEndSector)
+	spiFlashStats.foregroundErases++;
+	spi_flash_cacheInvalidateRange(sectorAddress, SPI_FLASH_SECTOR_SIZE);
+	spi_flash_setWriteEnable(true); // it calls spi_flash_{enable/disable}() by itself
+
+	spi_flash_enable();
+	HAL_SPI_Transmit(&HANDLE_SPI, commandBuf, 4, HAL_MAX_DELAY);
+	spi_flash_disable();
+
+	return spi_flash_waitReady(SPI_FLASH_SECTOR_ERASE_TIMEOUT);// erase can take up to 500 mS
+}
+
+// Writes length bytes at offset within a sector. The sector is only erased if some bits have to go from 0 back to 1
+// (not when appending to an erased area, or when the content is unchanged), and only the modified pages are programmed.
+static bool spi_flash_writeSector(uint32_t sectorAddress, int offset, uint8_t *dataBuf, int length)
+{
+	uint32_t modifiedPages = 0;
+	bool needsErase = false;
+
+	if (spi_flash_readDirect(sectorAddress, SPI_Flash_sectorbuffer, SPI_FLASH_SECTOR_SIZE) == false)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < length; i++)
 	{
-		uint8_t *bufPusOffset = (uint8_t *) dataBuf + bytesToWriteInCurrentSector;
-		bytesToWriteInCurrentSector = size - bytesToWriteInCurrentSector;
+		uint8_t currentValue = SPI_Flash_sectorbuffer[offset + i];
 
-		SPI_Flash_read(flashEndSector * 4096, SPI_Flash_sectorbuffer, 4096);
-		memcpy(SPI_Flash_sectorbuffer, (uint8_t *) bufPusOffset, bytesToWriteInCurrentSector);
+		if (currentValue != dataBuf[i])
+		{
+			modifiedPages |= (1U << ((offset + i) / SPI_FLASH_PAGE_SIZE));
+			needsErase |= ((currentValue & dataBuf[i]) != dataBuf[i]);
+		}
+	}
+
+	if (modifiedPages == 0)
+	{
+		return true;
+	}
 
-		retVal = SPI_Flash_eraseSector(flashEndSector * 4096);
+	memcpy(SPI_Flash_sectorbuffer + offset, dataBuf, length);
 
-		if (!retVal)
+	if (needsErase)
+	{
+		if (spi_flash_eraseSector(sectorAddress) == false)
 		{
 			return false;
 		}
 
-		for (int i = 0; i < 16; i++)
+		// Everything has to be programmed back, except the blank pages
+		modifiedPages = 0;
+		for (int i = 0; i < SPI_FLASH_SECTOR_SIZE; i++)
 		{
-			retVal = SPI_Flash_writePage(flashEndSector * 4096 + i * 256, SPI_Flash_sectorbuffer + i * 256);
-
-			if (!retVal)
+			if (SPI_Flash_sectorbuffer[i] != 0xFF)
 			{
-				return false;
+				modifiedPages |= (1U << (i / SPI_FLASH_PAGE_SIZE));
+				i |= (SPI_FLASH_PAGE_SIZE - 1); // Next page
 			}
 		}
 	}
+	else
+	{
+		spiFlashStats.erasesAvoided++;
+	}
+
+	for (int i = 0; i < (SPI_FLASH_SECTOR_SIZE / SPI_FLASH_PAGE_SIZE); i++)
+	{
+		if ((modifiedPages & (1U << i)) &&
+				(spi_flash_programPage(sectorAddress + (i * SPI_FLASH_PAGE_SIZE), SPI_Flash_sectorbuffer + (i * SPI_FLASH_PAGE_SIZE)) == false))
+		{
+			return false;
+		}
+	}
 
 	return true;
 }
 
+// Foreground writes: the callers are blocked from the call until the lock is released
+static bool spi_flash_writeBegin(uint32_t *startCycles)
+{
+	bool locked;
+
+	*startCycles = runTimeStatsGetCycles();
+	locked = spi_flash_lock();
+	spi_flash_backgroundEraseWait();
+
+	return locked;
+}
+
+static void spi_flash_writeEnd(bool locked, uint32_t startCycles)
+{
+	uint32_t cycles = (runTimeStatsGetCycles() - startCycles);
+
+	spiFlashStallCycles += cycles;
+	spiFlashStats.writes++;
+	spiFlashStats.stallUsLast = runTimeStatsCyclesToMicroseconds(cycles);
+	spiFlashStats.stallUsPerWrite = runTimeStatsCyclesToMicroseconds((uint32_t)(spiFlashStallCycles / spiFlashStats.writes));
+
+	if (spiFlashStats.stallUsLast > spiFlashStats.stallUsMax)
+	{
+		spiFlashStats.stallUsMax = spiFlashStats.stallUsLast;
+	}
+
+	spi_flash_unlock(locked);
+}
+
+bool SPI_Flash_write(uint32_t addr, uint8_t *dataBuf, int size)
+{
+	uint32_t startCycles;
+	bool retVal = true;
+	bool locked;
+
+	TRACE_BEGIN(TRACE_ID_SPI_FLASH_WRITE);
+	locked = spi_flash_writeBegin(&startCycles);
+
+	while ((size > 0) && retVal)
+	{
+		uint32_t sectorAddress = (addr & ~(SPI_FLASH_SECTOR_SIZE - 1));
+		int offset = (addr - sectorAddress);
+		int length = (((SPI_FLASH_SECTOR_SIZE - offset) < size) ? (SPI_FLASH_SECTOR_SIZE - offset) : size);
+
+		retVal = spi_flash_writeSector(sectorAddress, offset, dataBuf, length);
+		addr += length;
+		dataBuf += length;
+		size -= length;
+	}
+
+	spi_flash_writeEnd(locked, startCycles);
+	TRACE_END(TRACE_ID_SPI_FLASH_WRITE);
+
+	return retVal;
+}
+
+// Queues the sector for an erase by the maintenance task, when the radio is idle. An erased sector nobody took
+// yet gives its entry away (it stays blank, its next SPI_Flash_eraseSector() will just be a real one).
+// Returns false if the pool is full of pending erases, the sector will then be erased by SPI_Flash_eraseSector()
+bool SPI_Flash_eraseSectorInBackground(uint32_t address)
+{
+	uint32_t sectorAddress = (address & ~(SPI_FLASH_SECTOR_SIZE - 1));
+	bool locked = spi_flash_lock();
+	bool retVal = (spi_flash_poolFind(sectorAddress) != SPI_FLASH_NO_ERASE);
+	spiFlashPoolState_t reusableStates[] = { SPI_FLASH_POOL_FREE, SPI_FLASH_POOL_ERASED };
+
+	for (int s = 0; (s < (sizeof(reusableStates) / sizeof(reusableStates[0]))) && (retVal == false); s++)
+	{
+		for (int i = 0; (i < SPI_FLASH_ERASE_POOL_SIZE) && (retVal == false); i++)
+		{
+			if (spiFlashErasePool[i].state == reusableStates[s])
+			{
+				spiFlashErasePool[i].address = sectorAddress;
+				spiFlashErasePool[i].state = SPI_FLASH_POOL_PENDING;
+				retVal = true;
+			}
+		}
+	}
+
+	spi_flash_unlock(locked);
+
+	if (retVal && spiFlashRadioIsIdle && (spiFlashMaintenanceWake != NULL))
+	{
+		xSemaphoreGive(spiFlashMaintenanceWake);
+	}
+
+	return retVal;
+}
+
+// Called from the main loop, the background erases only start while the radio isn't receiving, transmitting or playing audio
+void SPI_Flash_maintenanceSetRadioIdle(bool isIdle)
+{
+	if (isIdle && (spiFlashRadioIsIdle == false) && (spiFlashMaintenanceWake != NULL))
+	{
+		xSemaphoreGive(spiFlashMaintenanceWake);
+	}
+
+	spiFlashRadioIsIdle = isIdle;
+}
+
+// Other foreground erases (settings commit) follow the same policy
+bool SPI_Flash_maintenanceRadioIsIdle(void)
+{
+	return spiFlashRadioIsIdle;
+}
+
+// Sends the erase command for the next pending sector, the lock is released during the erase
+static bool spi_flash_backgroundEraseStart(void)
+{
+	bool locked = spi_flash_lock();
+	bool retVal = false;
+
+	for (int i = 0; (i < SPI_FLASH_ERASE_POOL_SIZE) && (spiFlashErasingEntry == SPI_FLASH_NO_ERASE); i++)
+	{
+		if (spiFlashErasePool[i].state == SPI_FLASH_POOL_PENDING)
+		{
+			uint32_t address = spiFlashErasePool[i].address;
+			uint8_t commandBuf[4] = { SECTOR_E, address >> 16, address >> 8, 0x00 };
+
+			spi_flash_cacheInvalidateRange(address, SPI_FLASH_SECTOR_SIZE);
+			spi_flash_setWriteEnable(true);
+
+			spi_flash_enable();
+			HAL_SPI_Transmit(&HANDLE_SPI, commandBuf, 4, HAL_MAX_DELAY);
+			spi_flash_disable();
+
+			spiFlashErasePool[i].state = SPI_FLASH_POOL_ERASING;
+			spiFlashErasingEntry = i;
+			spiFlashEraseIsSuspended = false;
+			spiFlashEraseResumeCycles = runTimeStatsGetCycles();
+			retVal = true;
+		}
+	}
+
+	spi_flash_unlock(locked);
+
+	return retVal;
+}
+
+// The erase may also be completed by a foreground write, or a read, meanwhile
+static bool spi_flash_backgroundEraseIsOver(void)
+{
+	bool locked = spi_flash_lock();
+
+	// Never suspended here, the readers resume the erase before releasing the lock
+	if ((spiFlashErasingEntry != SPI_FLASH_NO_ERASE) && (spi_flash_busy() == false))
+	{
+		spi_flash_backgroundEraseDone(true);
+	}
+
+	spi_flash_unlock(locked);
+
+	return (spiFlashErasingEntry == SPI_FLASH_NO_ERASE);
+}
+
+static void spiFlashMaintenanceTaskFunction(void *data)
+{
+	while (1U)
+	{
+		spiFlashMaintenanceTask.AliveCount = TASK_FLAGGED_ALIVE;
+
+		xSemaphoreTake(spiFlashMaintenanceWake, portMAX_DELAY);
+
+		while (spiFlashRadioIsIdle && spi_flash_backgroundEraseStart())
+		{
+			int timeout = (SPI_FLASH_SECTOR_ERASE_TIMEOUT / SPI_FLASH_ERASE_POLL_PERIOD);
+
+			do
+			{
+				vTaskDelay(pdMS_TO_TICKS(SPI_FLASH_ERASE_POLL_PERIOD));
+				spiFlashMaintenanceTask.AliveCount = TASK_FLAGGED_ALIVE;
+			} while ((spi_flash_backgroundEraseIsOver() == false) && (timeout-- > 0));
+		}
+	}
+}
+
+void SPI_Flash_initMaintenanceTask(void)
+{
+	xTaskCreate(spiFlashMaintenanceTaskFunction,   /* pointer to the task */
+			"flashTask",                           /* task name for kernel awareness debugging */
+			512L / sizeof(portSTACK_TYPE),         /* task stack size */
+			NULL,                                  /* optional task startup argument */
+			(UBaseType_t)osPriorityBelowNormal,    /* initial priority */
+			&spiFlashMaintenanceTask.Handle        /* optional task handle to create */
+	);
+
+	spiFlashMaintenanceTask.Running = true;
+	spiFlashMaintenanceTask.AliveCount = TASK_FLAGGED_ALIVE;
+}
+
 uint32_t SPI_Flash_readStatusRegisters(void)
 {
 	uint8_t cmdVal = R_SR1;
 	uint8_t r1 = 0x0, r2 = 0x0, r3 = 0x0;
+	bool locked = spi_flash_lock();
 
 	spi_flash_enable();
 	HAL_SPI_Transmit(&HANDLE_SPI, &cmdVal, 1, HAL_MAX_DELAY);
@@ -198,6 +941,7 @@ uint32_t SPI_Flash_readStatusRegisters(void)
 	HAL_SPI_Transmit(&HANDLE_SPI, &cmdVal, 1, HAL_MAX_DELAY);
 	HAL_SPI_Receive(&HANDLE_SPI, &r3, 1, HAL_MAX_DELAY);
 	spi_flash_disable();
+	spi_flash_unlock(locked);
 
 	return (r3 << 16) | (r2 << 8) | r1;
 }
@@ -206,10 +950,14 @@ uint8_t SPI_Flash_readManufacturer(void)
 {
 	uint8_t commandBuf[4] = { R_JEDEC_ID, 0x00, 0x00, 0x00 };
 	uint8_t recBuf[4];
+	bool locked = spi_flash_lock();
 
+	spi_flash_eraseSuspend(SPI_FLASH_SIZE, 0);
 	spi_flash_enable();
 	HAL_SPI_TransmitReceive(&HANDLE_SPI, commandBuf, recBuf, 4, HAL_MAX_DELAY);
 	spi_flash_disable();
+	spi_flash_eraseResume();
+	spi_flash_unlock(locked);
 
 	return recBuf[1];
 }
@@ -218,58 +966,39 @@ uint32_t SPI_Flash_readPartID(void)
 {
 	uint8_t commandBuf[4] = { R_JEDEC_ID, 0x00, 0x00, 0x00 };
 	uint8_t recBuf[4];
+	bool locked = spi_flash_lock();
 
+	spi_flash_eraseSuspend(SPI_FLASH_SIZE, 0);
 	spi_flash_enable();
 	HAL_SPI_TransmitReceive(&HANDLE_SPI, commandBuf, recBuf, 4, HAL_MAX_DELAY);
 	spi_flash_disable();
+	spi_flash_eraseResume();
+	spi_flash_unlock(locked);
 
 	return (recBuf[2] << 8) | recBuf[3];
 }
 
 bool SPI_Flash_writePage(uint32_t addr_start,uint8_t *dataBuf)
 {
-	bool isBusy;
-	int waitCounter = 5;// Worst case is something like 3mS
-	uint8_t commandBuf[4]= { PAGE_PGM, addr_start >> 16, addr_start >> 8, 0x00 } ;
-
-	spi_flash_setWriteEnable(true);
+	uint32_t startCycles;
+	bool locked = spi_flash_writeBegin(&startCycles);
+	bool retVal = spi_flash_programPage(addr_start, dataBuf);
 
-	spi_flash_enable();
+	spi_flash_writeEnd(locked, startCycles);
 
-	HAL_SPI_Transmit(&HANDLE_SPI, commandBuf, 4, HAL_MAX_DELAY);
-	HAL_SPI_Transmit(&HANDLE_SPI, dataBuf, 0x100, HAL_MAX_DELAY);
-
-	spi_flash_disable();
-
-	do
-	{
-		osDelay(1);
-		isBusy = spi_flash_busy();
-	} while ((waitCounter-- > 0) && isBusy);
-
-	return !isBusy;
+	return retVal;
 }
 
 // Returns true if erased and false if failed.
 bool SPI_Flash_eraseSector(uint32_t addr_start)
 {
-	int waitCounter = 500;// erase can take up to 500 mS
-	bool isBusy;
-	uint8_t commandBuf[4] = { SECTOR_E, addr_start >> 16, addr_start >> 8, 0x00 };
+	uint32_t startCycles;
+	bool locked = spi_flash_writeBegin(&startCycles);
+	bool retVal = spi_flash_eraseSector(addr_start);
 
-	spi_flash_setWriteEnable(true); // it calls spi_flash_{enable/disable}() by itself
+	spi_flash_writeEnd(locked, startCycles);
 
-	spi_flash_enable();
-	HAL_SPI_Transmit(&HANDLE_SPI, commandBuf, 4, HAL_MAX_DELAY);
-	spi_flash_disable();
-
-	do
-	{
-		osDelay(1);
-		isBusy = spi_flash_busy();
-	} while ((waitCounter-- > 0) && isBusy);
-
-	return !isBusy;// If still busy after
+	return retVal;// If still busy after
 }
 
 static inline void spi_flash_enable(void)
@@ -310,6 +1039,9 @@ bool SPI_Flash_readSecurityRegisters(int startBlock, uint8_t *dataBuf, int size)
 	const int securityBlockSize = 256;
 
 	int numberofblocks = size / securityBlockSize;
+	bool locked = spi_flash_lock();
+
+	spi_flash_eraseSuspend(SPI_FLASH_SIZE, 0);
 
 	for (uint8_t i = startBlock; i < numberofblocks + 1; i++)
 	{
@@ -322,6 +1054,9 @@ bool SPI_Flash_readSecurityRegisters(int startBlock, uint8_t *dataBuf, int size)
 		spi_flash_disable();
 	}
 
+	spi_flash_eraseResume();
+	spi_flash_unlock(locked);
+
 	return true;
 }
 
@@ -329,11 +1064,15 @@ uint8_t SPI_Flash_readSingleSecurityRegister(int addr)
 {
 	  uint8_t value;
 	  uint8_t commandBuf[5] = { R_SEC_REGS, ((addr >> 16) & 0xFF), ((addr >> 8) & 0xFF), (addr & 0xFF), 0x00 };
+	  bool locked = spi_flash_lock();
 
+	  spi_flash_eraseSuspend(SPI_FLASH_SIZE, 0);
 	  spi_flash_enable();
 	  HAL_SPI_Transmit(&HANDLE_SPI, commandBuf, 5, HAL_MAX_DELAY);
 	  HAL_SPI_Receive(&HANDLE_SPI, &value, 1, HAL_MAX_DELAY);
 	  spi_flash_disable();
+	  spi_flash_eraseResume();
+	  spi_flash_unlock(locked);
 
       return value;
 }
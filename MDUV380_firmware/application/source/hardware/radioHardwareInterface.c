@@ -127,6 +127,7 @@ void radioPowerOff(bool invalidateFrequency, bool includeMic)
 	}
 
 	HAL_GPIO_WritePin(C6000_PWD_GPIO_Port, C6000_PWD_Pin, GPIO_PIN_SET);// Power Down the C6000
+	SPI0ShadowInvalidate();
 
 	// Turn off Rx in AT1846S
 	if (currentRadioDevice->currentBandWidthIs25kHz)
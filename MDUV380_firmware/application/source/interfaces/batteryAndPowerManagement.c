@@ -286,7 +286,7 @@ void powerDown(bool doNotSavePowerOffState)
 #endif
 	}
 
-	settingsSaveSettings(true);
+	settingsCommitSettings(true);
 	codeplugSaveLastUsedChannelInZone();
 
 #if defined(HAS_GPS)
@@ -349,6 +349,9 @@ void die(bool usbMonitoring, bool maintainRTC, bool forceSuspend, bool safeBoot)
 	}
 #endif
 
+	// Nothing pending in the backup SRAM should depend on it surviving from here
+	settingsCommitSettings(true);
+
 	disableAudioAmp(AUDIO_AMP_MODE_RF);
 	disableAudioAmp(AUDIO_AMP_MODE_BEEP);
 	disableAudioAmp(AUDIO_AMP_MODE_PROMPT);
@@ -773,7 +776,7 @@ void powerOffFinalStage(bool maintainRTC, bool forceSuspend)
 #endif
 
 	m = ticksGetMillis();
-	settingsSaveSettings(true);
+	settingsCommitSettings(true);
 
 	// Give it a bit of time before pulling the plug as DM-1801 EEPROM looks slower
 	// than GD-77 to write, then quickly power cycling triggers settings reset.
@@ -67,12 +67,17 @@ bool batteryRAM_Write(uint32_t offset, uint8_t *buf, uint32_t size)
 	return false;
 }
 
-void batteryRAM_Init(void)
+// The backup SRAM content is kept across resets as long as VDD is present,
+// the backup regulator is only needed to retain it on VBAT (costs power).
+void batteryRAM_Init(bool retainOnVBAT)
 {
 	__HAL_RCC_PWR_CLK_ENABLE();
 	HAL_PWR_EnableBkUpAccess();
 	__HAL_RCC_BKPSRAM_CLK_ENABLE();
 
-	LL_PWR_EnableBkUpRegulator();
-	while (!LL_PWR_IsActiveFlag_BRR());
+	if (retainOnVBAT)
+	{
+		LL_PWR_EnableBkUpRegulator();
+		while (!LL_PWR_IsActiveFlag_BRR());
+	}
 }
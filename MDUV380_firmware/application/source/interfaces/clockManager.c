@@ -31,12 +31,18 @@
 #include <interfaces/clockManager.h>
 #include "interfaces/hr-c6000_spi.h"
 #include "interfaces/i2c.h"
+#include "interfaces/runTimeStats.h"
+#include "interfaces/trace.h"
+#include "utils.h"
 #include "usbd_def.h"
 
 extern USBD_HandleTypeDef hUsbDeviceFS;
 extern volatile bool usbIsResetting;
 
 volatile clockManagerSpeedSetting_t currentClockSpeedSetting = CLOCK_MANAGER_SPEED_UNDEF;
+static volatile bool ticklessIdleAllowed = false;
+static uint32_t sleepStartCounter;
+static uint32_t sleepCounterRemainder = 0;
 
 /*
 static void clockManagerSetHSI(void)
@@ -52,8 +58,47 @@ static void clockManagerSetHSI(void)
 }
  */
 
-static bool clockManagerSetHSE(bool isEco)
+// Only the PLL P divider changes between the levels: the VCO (144MHz) and the Q divider are kept, so the USB clock
+// stays at 48MHz, and so does PLLM which is shared with the I2S PLL. APB1 stays at 36MHz, except in eco.
+typedef struct
 {
+	uint32_t                   pllP;
+	uint32_t                   apb1Divider;
+	uint32_t                   flashLatency;
+	uint32_t                   tim1Period; // Backlight dimming DMA pacing
+	clockManagerSpeedSetting_t speedSetting;
+} clockManagerLevelConfig_t;
+
+static const clockManagerLevelConfig_t levelConfigs[CLOCK_MANAGER_LEVEL_NUM] =
+{
+	{ RCC_PLLP_DIV6, RCC_HCLK_DIV1, FLASH_LATENCY_0, 4000, CLOCK_MANAGER_RUN_ECO_POWER_MODE }, // change this to 4000 later to prevent display backlight flashing
+	{ RCC_PLLP_DIV4, RCC_HCLK_DIV1, FLASH_LATENCY_1, 3550, CLOCK_MANAGER_RUN_MID_POWER_MODE },
+	{ RCC_PLLP_DIV2, RCC_HCLK_DIV2, FLASH_LATENCY_3, 7100, CLOCK_MANAGER_SPEED_RUN }
+};
+
+// The timers prescalers set by CubeMX are for a 72MHz timers clock
+#define CLOCK_MANAGER_RUN_TIMERS_CLOCK           72000000U
+
+#define GOVERNOR_SAMPLE_PERIOD                   (RUN_TIME_STATS_COUNTER_HZ / 10U) // 100ms
+#define GOVERNOR_IDLE_DOWN_PERMILLE              700U // Load of 30% or less at 72MHz, 60% at 36MHz
+#define GOVERNOR_IDLE_UP_PERMILLE                300U
+#define GOVERNOR_DOWN_SAMPLES                    5U
+
+static volatile uint32_t governorDemand = 0U;
+static volatile bool governorEcoAllowed = false;
+static uint32_t governorSampleCounter = 0U;
+static uint32_t governorSampleIdle = 0U;
+static uint32_t governorQuietSamples = 0U;
+static uint32_t residencyCounter = 0U;
+static uint32_t residencyRemainder = 0U;
+static clockManagerGovernorStats_t governorStats = { .level = CLOCK_MANAGER_LEVEL_RUN, .idlePermille = 1000U };
+
+// Defined in the FreeRTOS port, computes the SysTick reload and the tickless idle constants from SystemCoreClock
+extern void vPortSetupTimerInterrupt(void);
+
+static bool clockManagerSetHSE(clockManagerLevel_t level)
+{
+	const clockManagerLevelConfig_t *config = &levelConfigs[level];
 	RCC_OscInitTypeDef RCC_OscInitStruct = { 0 };
 	RCC_ClkInitTypeDef RCC_ClkInitStruct = { 0 };
 
@@ -72,56 +117,108 @@ static bool clockManagerSetHSE(bool isEco)
 	htim1.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
 	htim1.Init.RepetitionCounter = 0;
 	htim1.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+	htim1.Init.Period = config->tim1Period;
 
 	RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK | RCC_CLOCKTYPE_SYSCLK | RCC_CLOCKTYPE_PCLK1 | RCC_CLOCKTYPE_PCLK2;
 	RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
 	RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
+	RCC_ClkInitStruct.APB1CLKDivider = config->apb1Divider;
 
 	RCC_OscInitStruct.PLL.PLLM = 4;
 	RCC_OscInitStruct.PLL.PLLN = 72;
+	RCC_OscInitStruct.PLL.PLLP = config->pllP;
 	RCC_OscInitStruct.PLL.PLLQ = 3;
 
-	if (isEco)
+	if (HAL_TIM_Base_Init(&htim1) != HAL_OK)
 	{
-		RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV6;
-		htim1.Init.Period = 4000;// change this to 4000 later to prevent display backlight flashing
+		return false;
 	}
-	else
+
+	if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
 	{
-		RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV2;
-		htim1.Init.Period = 7100;
+		return false;
 	}
 
-	if (HAL_TIM_Base_Init(&htim1) != HAL_OK)
+	//Initializes the CPU, AHB and APB buses clocks
+	if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, config->flashLatency) != HAL_OK)
 	{
 		return false;
 	}
 
-	if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
+	return true;
+}
+
+// Peripherals whose timings are derived from the APB clocks and have to be kept
+// the same at any level (the I2C and SPI clocks are only slower at lower levels).
+static void clockManagerPeripheralsClockHasChanged(void)
+{
+	clockManagerTimersRescale();
+
+	// GPS UART baudrate
+	if (huart1.Instance->CR1 & USART_CR1_UE)
 	{
-		return false;
+		huart1.Instance->BRR = UART_BRR_SAMPLING16(HAL_RCC_GetPCLK2Freq(), huart1.Init.BaudRate);
 	}
 
-	//Initializes the CPU, AHB and APB buses clocks
+	// Keep the RTOS tick at configTICK_RATE_HZ
+	if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED)
+	{
+		vPortSetupTimerInterrupt();
+	}
+}
 
-	if (isEco)
+// The APB1 timers are configured (htimX.Init) for CLOCK_MANAGER_RUN_TIMERS_CLOCK, scale them to the current clock.
+void clockManagerTimersRescale(void)
+{
+	uint32_t apb1TimersClock = HAL_RCC_GetPCLK1Freq();
+
+	// Timers clock is doubled when APB1 is divided
+	if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_HCLK_DIV1)
 	{
-		RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV1;
-		if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_0) != HAL_OK)
-		{
-			return false;
-		}
+		apb1TimersClock *= 2U;
 	}
-	else
+
+	// ADC trigger (battery voltage, VOX, etc). The new prescaler is loaded on the next update event.
+	TIM3->PSC = (uint32_t)((((uint64_t)htim3.Init.Prescaler + 1U) * apb1TimersClock) / CLOCK_MANAGER_RUN_TIMERS_CLOCK) - 1U;
+
+	// APRS AFSK baud timer. Its prescaler is too small to be scaled (1 at 1200 baud), the period is scaled instead.
+	if (htim6.Instance == TIM6)
 	{
-		RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV2;
-		if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_3) != HAL_OK)
+		uint32_t period = (uint32_t)((((uint64_t)htim6.Init.Period + 1U) * apb1TimersClock) / CLOCK_MANAGER_RUN_TIMERS_CLOCK) - 1U;
+
+		TIM6->ARR = period;
+		// Don't let the counter run up to 0xFFFF when the period gets shorter
+		if (TIM6->CNT > period)
 		{
-			return false;
+			TIM6->CNT = 0U;
 		}
 	}
+}
 
-	return true;
+static clockManagerLevel_t clockManagerSpeedSettingToLevel(clockManagerSpeedSetting_t clockSpeedSetting)
+{
+	switch(clockSpeedSetting)
+	{
+		case CLOCK_MANAGER_RUN_ECO_POWER_MODE:
+			return CLOCK_MANAGER_LEVEL_ECO;
+
+		case CLOCK_MANAGER_RUN_MID_POWER_MODE:
+			return CLOCK_MANAGER_LEVEL_MID;
+
+		default:
+			return CLOCK_MANAGER_LEVEL_RUN;
+	}
+}
+
+static void clockManagerAccountResidency(void)
+{
+	const uint32_t countsPerMs = (RUN_TIME_STATS_COUNTER_HZ / 1000U);
+	uint32_t counter = runTimeStatsGetCounter();
+
+	residencyRemainder += (counter - residencyCounter);
+	residencyCounter = counter;
+	governorStats.residency[governorStats.level] += (residencyRemainder / countsPerMs);
+	residencyRemainder %= countsPerMs;
 }
 
 clockManagerSpeedSetting_t clockManagerGetRunMode(void)
@@ -141,27 +238,180 @@ void clockManagerSetRunMode(uint8_t targetConfigIndex, clockManagerSpeedSetting_
 {
 	if (currentClockSpeedSetting != clockSpeedSetting)
 	{
-		if ((hUsbDeviceFS.dev_state == USBD_STATE_CONFIGURED) && (clockSpeedSetting == CLOCK_MANAGER_RUN_ECO_POWER_MODE))
+		clockManagerLevel_t level = clockManagerSpeedSettingToLevel(clockSpeedSetting);
+
+		if ((hUsbDeviceFS.dev_state == USBD_STATE_CONFIGURED) && (level != CLOCK_MANAGER_LEVEL_RUN))
 		{
 			return;
 		}
 
-		__HAL_RCC_SYSCLK_CONFIG(RCC_CFGR_SWS_HSI);//Switch clock to internal, as bootloader already set it to HSE and otherwise HSE can't be configured in SystemClock_Config()
-
-		switch(clockSpeedSetting)
+		if ((clockSpeedSetting != CLOCK_MANAGER_SPEED_UNDEF) &&
+				((level != governorStats.level) || (currentClockSpeedSetting == CLOCK_MANAGER_SPEED_UNDEF)))
 		{
-			case CLOCK_MANAGER_RUN_ECO_POWER_MODE:
-				clockManagerSetHSE(true);
-				break;
-
-			case CLOCK_MANAGER_SPEED_RUN:
-			case CLOCK_MANAGER_SPEED_HS_RUN:
-				clockManagerSetHSE(false);
-			default:
-				break;
+			__HAL_RCC_SYSCLK_CONFIG(RCC_CFGR_SWS_HSI);//Switch clock to internal, as bootloader already set it to HSE and otherwise HSE can't be configured in SystemClock_Config()
+
+			clockManagerSetHSE(level);
+
+			runTimeStatsClockHasChanged();
+			clockManagerPeripheralsClockHasChanged();
+			TRACE_CLOCK_HAS_CHANGED();
+
+			clockManagerAccountResidency();
+			governorStats.level = level;
+			governorStats.levelChanges++;
+
+			// Restart the idle sampling, at the new speed
+			if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED)
+			{
+				governorSampleCounter = runTimeStatsGetCounter();
+				governorSampleIdle = ulTaskGetIdleRunTimeCounter();
+			}
+			governorQuietSamples = 0U;
 		}
 
 		currentClockSpeedSetting = clockSpeedSetting;
 	}
 }
 
+// Called from the main loop. activeDemand is the CLOCK_MANAGER_DEMAND_* bits of the current radio state (DMR, audio, TX),
+// the heavy jobs are flagged using clockManagerGovernorSetDemand().
+void clockManagerGovernorTick(uint32_t activeDemand)
+{
+	uint32_t counter = runTimeStatsGetCounter();
+	uint32_t elapsed = (counter - governorSampleCounter);
+	uint32_t demand = governorDemand;
+	clockManagerLevel_t level = governorStats.level;
+	clockManagerLevel_t target = level;
+	bool hasSample = false;
+
+	if ((hUsbDeviceFS.dev_state == USBD_STATE_CONFIGURED) || usbIsResetting)
+	{
+		demand |= CLOCK_MANAGER_DEMAND_CPS;
+	}
+
+	if (elapsed >= GOVERNOR_SAMPLE_PERIOD)
+	{
+		uint32_t idle = ulTaskGetIdleRunTimeCounter();
+
+		governorStats.idlePermille = (uint16_t)MIN((((uint64_t)(idle - governorSampleIdle) * 1000U) / elapsed), 1000U);
+		governorSampleCounter = counter;
+		governorSampleIdle = idle;
+		hasSample = true;
+
+		if (governorStats.idlePermille >= GOVERNOR_IDLE_DOWN_PERMILLE)
+		{
+			governorQuietSamples++;
+		}
+		else
+		{
+			governorQuietSamples = 0U;
+		}
+	}
+
+	if (demand != 0U)
+	{
+		target = CLOCK_MANAGER_LEVEL_RUN;
+	}
+	else if (governorEcoAllowed)
+	{
+		// The RX power saving only allows it while nothing else is going on
+		target = CLOCK_MANAGER_LEVEL_ECO;
+	}
+	else if ((activeDemand != 0U) || (level == CLOCK_MANAGER_LEVEL_ECO))
+	{
+		target = CLOCK_MANAGER_LEVEL_RUN;
+	}
+	else if ((level == CLOCK_MANAGER_LEVEL_MID) && hasSample && (governorStats.idlePermille < GOVERNOR_IDLE_UP_PERMILLE))
+	{
+		target = CLOCK_MANAGER_LEVEL_RUN;
+	}
+	else if ((level == CLOCK_MANAGER_LEVEL_RUN) && (governorQuietSamples >= GOVERNOR_DOWN_SAMPLES))
+	{
+		target = CLOCK_MANAGER_LEVEL_MID;
+	}
+
+	governorStats.demand = (uint8_t)(demand | activeDemand);
+
+	if (target != level)
+	{
+		clockManagerSetRunMode(kAPP_PowerModeRun, levelConfigs[target].speedSetting);
+	}
+}
+
+void clockManagerGovernorSetDemand(uint32_t demand, bool active)
+{
+	if (active)
+	{
+		governorDemand |= demand;
+
+		// Don't wait for the next governor tick, the job is starting now
+		if (governorStats.level != CLOCK_MANAGER_LEVEL_RUN)
+		{
+			clockManagerSetRunMode(kAPP_PowerModeRun, CLOCK_MANAGER_SPEED_RUN);
+		}
+	}
+	else
+	{
+		governorDemand &= ~demand;
+	}
+}
+
+void clockManagerGovernorSetEcoAllowed(bool allowed)
+{
+	governorEcoAllowed = allowed;
+
+	// The RX is powered up again
+	if ((allowed == false) && (governorStats.level == CLOCK_MANAGER_LEVEL_ECO))
+	{
+		clockManagerSetRunMode(kAPP_PowerModeRun, CLOCK_MANAGER_SPEED_RUN);
+	}
+}
+
+const clockManagerGovernorStats_t *clockManagerGovernorGetStats(void)
+{
+	clockManagerAccountResidency();
+
+	return &governorStats;
+}
+
+void clockManagerSetTicklessIdleAllowed(bool allowed)
+{
+	ticklessIdleAllowed = allowed;
+}
+
+bool clockManagerIsTicklessIdleAllowed(void)
+{
+	return ticklessIdleAllowed;
+}
+
+// Called by FreeRTOS from the idle task, with interrupts disabled, right before WFI.
+void clockManagerPreSleepProcessing(uint32_t *expectedIdleTime)
+{
+	if ((ticklessIdleAllowed == false) || usbIsResetting)
+	{
+		*expectedIdleTime = 0; // Don't sleep
+		return;
+	}
+
+	// The HAL tick (ticksGetMillis()) would wake us up every millisecond, stop it
+	// while sleeping. Elapsed time is accounted using the run time statistics counter.
+	sleepStartCounter = runTimeStatsGetCounter();
+	HAL_SuspendTick();
+}
+
+void clockManagerPostSleepProcessing(uint32_t expectedIdleTime)
+{
+	const uint32_t countsPerMs = (RUN_TIME_STATS_COUNTER_HZ / 1000U);
+
+	if ((ticklessIdleAllowed == false) || usbIsResetting)
+	{
+		return;
+	}
+
+	HAL_ResumeTick();
+
+	sleepCounterRemainder += (runTimeStatsGetCounter() - sleepStartCounter);
+	uwTick += (sleepCounterRemainder / countsPerMs);
+	sleepCounterRemainder %= countsPerMs;
+}
+
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "interfaces/crc.h"
+#if defined(STM32F405xx) && !defined(PLATFORM_HOST)
+#include <string.h>
+#include "main.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#endif
+
+// One entry per nibble, it keeps the table small enough while being way faster than bitwise processing.
+static const uint32_t crc32NibbleTable[16] =
+{
+	0x00000000U, 0x1DB71064U, 0x3B6E20C8U, 0x26D930ACU, 0x76DC4190U, 0x6B6B51F4U, 0x4DB26158U, 0x5005713CU,
+	0xEDB88320U, 0xF00F9344U, 0xD6D6A3E8U, 0xCB61B38CU, 0x9B64C2B0U, 0x86D3D2D4U, 0xA00AE278U, 0xBDBDF21CU
+};
+
+static uint32_t crcCalc32Software(uint32_t crc, const uint8_t *data, uint32_t length)
+{
+	crc = ~crc;
+
+	while (length--)
+	{
+		crc ^= *data++;
+		crc = (crc >> 4) ^ crc32NibbleTable[crc & 0x0F];
+		crc = (crc >> 4) ^ crc32NibbleTable[crc & 0x0F];
+	}
+
+	return ~crc;
+}
+
+#if defined(STM32F405xx) && !defined(PLATFORM_HOST)
+//
+// The CRC unit computes the same polynomial, but MSB first, 32 bits at a time, and always starts from 0xFFFFFFFF.
+// Bit reversing the input words and the result gives the reflected (zlib) CRC, the remaining bytes are done in software.
+//
+// To continue from a previous result, the unit is seeded by writing the word which brings
+// its reset state to the wanted one: the CRC of one word is invertible, hence running it
+// backward (32 bit steps) from the wanted state gives that word.
+//
+static uint32_t crcHardwareSeedWord(uint32_t crc)
+{
+	uint32_t state = __RBIT(~crc);
+
+	for (int i = 0; i < 32; i++)
+	{
+		state = (state & 0x01) ? (((state ^ 0x04C11DB7U) >> 1) | 0x80000000U) : (state >> 1);
+	}
+
+	return (0xFFFFFFFFU ^ state);
+}
+
+uint32_t crcCalc32(uint32_t crc, const uint8_t *data, uint32_t length)
+{
+	uint32_t words = (length / 4);
+
+	if (words > 0)
+	{
+		uint32_t word;
+
+		taskENTER_CRITICAL();
+
+		if ((RCC->AHB1ENR & RCC_AHB1ENR_CRCEN) == 0)
+		{
+			__HAL_RCC_CRC_CLK_ENABLE();
+		}
+
+		CRC->CR = CRC_CR_RESET;
+
+		if (crc != 0) // 0 is the reset state
+		{
+			CRC->DR = crcHardwareSeedWord(crc);
+		}
+
+		while (words--)
+		{
+			memcpy(&word, data, 4); // the data may be unaligned
+			CRC->DR = __RBIT(word);
+			data += 4;
+		}
+
+		crc = ~__RBIT(CRC->DR);
+
+		taskEXIT_CRITICAL();
+	}
+
+	return crcCalc32Software(crc, data, (length & 0x03));
+}
+#else
+uint32_t crcCalc32(uint32_t crc, const uint8_t *data, uint32_t length)
+{
+	return crcCalc32Software(crc, data, length);
+}
+#endif
@@ -29,8 +29,10 @@
 #include "user_interface/uiGlobals.h"
 #include "user_interface/uiUtilities.h"
 #include "interfaces/gps.h"
+#include "interfaces/gpsTrackLog.h"
 #include "user_interface/uiLocalisation.h"
 #include "usb/usb_com.h"
+#include "functions/eventBus.h"
 #if defined(PLATFORM_MD9600)
 #include "interfaces/remoteHead.h"
 #endif
@@ -40,14 +42,6 @@
 #define GPS_RX_BUFFERS_MAX                  3U
 
 #if defined(LOG_GPS_DATA)
-#define LOG_RAM_BUF_SIZE                 4096U
-
-static
-#if ! (CPU_MK22FN512VLL12) // Doesn't fit on DM1801
-  __attribute__((section(".data.$RAM2")))
-#endif
-  uint8_t NMEARecordingBuffer[LOG_RAM_BUF_SIZE];
-
 #define LOG_FLASH_16MB_START_ADDRESS  (14 * 1024 * 1024) // Last 2MB
 #define LOG_FLASH_16MB_MEM_SIZE        (2 * 1024 * 1024)
 #if defined(CPU_MK22FN512VLL12)
@@ -59,7 +53,6 @@ static
 
 static uint32_t gpsLogFlashStartAddress = 0U;
 static uint32_t gpsLogFlashMemSize = 0U;
-static uint32_t gpsLogMemOffset = 0U;
 static bool gpsIsLogging = false;
 #endif // LOG_GPS_DATA
 
@@ -152,10 +145,6 @@ static bool gpsIrqIsEnabled = false;
 extern double round(double); // implementation in aprs.c
 #endif
 
-#if defined(LOG_GPS_DATA)
-static void gpsLogNMEAData(const char *nmea, uint8_t length);
-#endif
-
 
 void gpsInit(void)
 {
@@ -198,6 +187,7 @@ void gpsInit(void)
 	}
 #endif
 
+	gpsTrackLogInit(gpsLogFlashStartAddress, gpsLogFlashMemSize);
 #endif // LOG_GPS_DATA
 
 #if defined(CPU_MK22FN512VLL12)
@@ -348,6 +338,8 @@ void gpsProcessChar(uint8_t rxchar)
 		gpsRxData.bufferIndex = (gpsRxData.bufferIndex + 1) % GPS_RX_BUFFERS_MAX;
 		gpsRxData.rxBuffers[gpsRxData.bufferIndex].length = 0U;
 		gpsRxData.charPosition = 0U;
+
+		eventBusPost(EVENT_BUS_GPS_DATA, 0);
 	}
 }
 
@@ -733,12 +725,6 @@ static uint16_t fletcher16(const uint8_t *data, uint8_t len)
 
 void gpsTick(void)
 {
-	char gpsLine[GPS_LINE_LENGTH] = { 0 };
-	char param[6][20];
-	char line[20];
-	char *p;
-	uint8_t lineLength = 0U;
-
 	if ((menuSystemGetCurrentMenuNumber() != UI_TX_SCREEN) &&
 			(nonVolatileSettings.gps >= GPS_MODE_OFF) &&
 			((ticksGetMillis() % 500) == 0)
@@ -751,6 +737,15 @@ void gpsTick(void)
 	{
 		gpsDataInputStartStop(true);
 	}
+}
+
+static void gpsProcessLine(void)
+{
+	char gpsLine[GPS_LINE_LENGTH] = { 0 };
+	char param[6][20];
+	char line[20];
+	char *p;
+	uint8_t lineLength = 0U;
 
 	if (gpsRxData.linesCount > 0U)
 	{
@@ -789,14 +784,6 @@ void gpsTick(void)
 				if (nonVolatileSettings.gps >= GPS_MODE_ON_NMEA)
 				{
 					USB_DEBUG_printf("%s\r\n", gpsLine);// Note. NMEA protocol requires CR LF
-
-#if defined(LOG_GPS_DATA)
-					// log everything once per minute
-					if ((gpsData.Time % 60) == 0)
-					{
-						gpsLogNMEAData(gpsLine, lineLength);
-					}
-#endif
 				}
 
 				if (memcmp(&gpsLine[3], "GGA", 3) == 0)// message that contains accuracy (HDOP) and altitude
@@ -829,12 +816,6 @@ void gpsTick(void)
 					char statusLetter[20];
 					int currentMenu = menuSystemGetCurrentMenuNumber();
 
-#if defined(LOG_GPS_DATA)
-					if ((gpsData.Time % 60) != 0)
-					{
-						gpsLogNMEAData(gpsLine, lineLength);
-					}
-#endif
 					// check if it has the date and time.
 					getParam(gpsLine, param[0], 2, 20);			//get parameter 2 which is GMT Time as hhmmss.sss
 					getParam(gpsLine, statusLetter, 3, 20);
@@ -974,6 +955,14 @@ void gpsTick(void)
 						gpsData.Status &= ~GPS_STATUS_HAS_COURSE;
 						gpsData.Status |= GPS_STATUS_COURSE_UPDATED;
 					}
+
+#if defined(LOG_GPS_DATA)
+					// One track point per fix, the altitude comes from the last GGA
+					if ((nonVolatileSettings.gps == GPS_MODE_ON_LOG) && gpsIsLogging && (gpsData.Status & GPS_STATUS_HAS_TIME))
+					{
+						gpsTrackLogAddPoint(&gpsData);
+					}
+#endif
 				}
 				else if (memcmp(&gpsLine[3], "GSA", 3) == 0) // DOP and active satellites
 				{
@@ -1069,30 +1058,16 @@ void gpsTick(void)
 	}
 }
 
-#if defined(LOG_GPS_DATA)
-static void gpsLogByte(char data)
+// Called on EVENT_BUS_GPS_DATA, one event is posted per received line
+void gpsProcessData(void)
 {
-	NMEARecordingBuffer[gpsLogMemOffset % LOG_RAM_BUF_SIZE] = data;
-	gpsLogMemOffset++;
-
-	if ((gpsLogMemOffset % LOG_RAM_BUF_SIZE) == 0)
+	while (gpsRxData.linesCount > 0U)
 	{
-		SPI_Flash_write((gpsLogFlashStartAddress + (((gpsLogMemOffset / LOG_RAM_BUF_SIZE) - 1) * LOG_RAM_BUF_SIZE)), NMEARecordingBuffer, LOG_RAM_BUF_SIZE);
-		gpsLogMemOffset %= gpsLogFlashMemSize;
-	}
-}
-
-static void gpsLogNMEAData(const char *nmea, uint8_t length)
-{
-	if ((nonVolatileSettings.gps == GPS_MODE_ON_LOG) && gpsIsLogging && ((gpsData.Status & GPS_STATUS_HAS_FIX) != 0))
-	{
-		for(uint8_t i = 0; i < length; i++)
-		{
-			gpsLogByte(nmea[i]);
-		}
+		gpsProcessLine();
 	}
 }
 
+#if defined(LOG_GPS_DATA)
 void gpsLoggingStart(void)
 {
 	if (nonVolatileSettings.gps == GPS_MODE_ON_LOG)
@@ -1104,20 +1079,16 @@ void gpsLoggingStart(void)
 			// Except the ones with 16Mb flash chip
 			if ((gpsLogFlashStartAddress != LOG_FLASH_16MB_START_ADDRESS) && (dmrIDCacheGetCount() > 0))
 			{
+				uint8_t header[DMRID_HEADER_LENGTH];
+
 				dmrIDCacheClear(); // Ensure dmrIDLookup() fails
 
-				memset(NMEARecordingBuffer, 0x00, DMRID_HEADER_LENGTH);
-				SPI_Flash_write(DMRID_MEMORY_LOCATION_1, NMEARecordingBuffer, DMRID_HEADER_LENGTH);
+				memset(header, 0x00, DMRID_HEADER_LENGTH);
+				SPI_Flash_write(DMRID_MEMORY_LOCATION_1, header, DMRID_HEADER_LENGTH);
 			}
 #endif
-			// Load the last stored flash block
-			gpsLogMemOffset = nonVolatileSettings.gpsLogMemOffset;
-			SPI_Flash_read((((gpsLogFlashStartAddress + gpsLogMemOffset) / LOG_RAM_BUF_SIZE) * LOG_RAM_BUF_SIZE), NMEARecordingBuffer, LOG_RAM_BUF_SIZE);
-			// write start marker that can be read as text
-			gpsLogByte('A');
-			gpsLogByte('A');
-			gpsLogByte('A');
-			gpsLogByte('A');
+			// The head of the log is recovered from the Flash (first time), then a new track segment is started
+			gpsTrackLogStartSession();
 
 			gpsIsLogging = true;
 		}
@@ -1130,32 +1101,13 @@ void gpsLoggingStop(void)
 	{
 		gpsIsLogging = false;
 
-		// write end marker which can be read as text
-		gpsLogByte('Z');
-		gpsLogByte('Z');
-
-		if (gpsLogMemOffset % LOG_RAM_BUF_SIZE)
-		{
-			SPI_Flash_write((gpsLogFlashStartAddress + ((gpsLogMemOffset / LOG_RAM_BUF_SIZE) * LOG_RAM_BUF_SIZE)), NMEARecordingBuffer, (gpsLogMemOffset % LOG_RAM_BUF_SIZE));
-		}
-
-		settingsSet(nonVolatileSettings.gpsLogMemOffset, gpsLogMemOffset);
+		gpsTrackLogFlush();
 	}
 }
 
 void gpsLoggingClear(void)
 {
-	uint32_t numFlashPages = gpsLogFlashMemSize / LOG_RAM_BUF_SIZE;
-	uint32_t addr;
-
-	watchdogRun(false);
-	for(uint32_t i = 0; i < numFlashPages; i++)
-	{
-		addr = gpsLogFlashStartAddress + (i * LOG_RAM_BUF_SIZE);
-
-		SPI_Flash_eraseSector(addr);
-	}
-	watchdogRun(true);
+	gpsTrackLogClear();
 }
 #endif // LOG_GPS_DATA
 #endif // HAS_GPS
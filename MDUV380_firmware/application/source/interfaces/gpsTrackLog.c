@@ -0,0 +1,786 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "main.h"
+#include "interfaces/gpsTrackLog.h"
+
+#if defined(HAS_GPS) && defined(LOG_GPS_DATA)
+
+#include "hardware/SPI_Flash.h"
+#include "interfaces/wdog.h"
+#include "user_interface/uiUtilities.h"
+
+#define TRACK_LOG_SECTOR_SIZE          4096U
+#define TRACK_LOG_PAGE_SIZE             256U
+#define TRACK_LOG_KEYFRAME_SIZE          19U
+#define TRACK_LOG_VARINT_MAX_SIZE         5U
+#define TRACK_LOG_EXPORT_TEXT_SIZE      192
+
+typedef struct
+{
+	time_t_custom time;
+	int32_t       latitude;  // 1e-5 degree
+	int32_t       longitude; // 1e-5 degree
+	int16_t       altitude;
+	uint16_t      speed;
+	uint16_t      course;
+} trackLogPoint_t;
+
+typedef enum
+{
+	TRACK_LOG_EXPORT_HEADER = 0,
+	TRACK_LOG_EXPORT_RECORDS,
+	TRACK_LOG_EXPORT_FOOTER,
+	TRACK_LOG_EXPORT_DONE
+} trackLogExportPhase_t;
+
+static uint32_t trackLogStartAddress = 0U;
+static uint32_t trackLogSectorsCount = 0U;
+static bool trackLogIsRecovered = false;
+
+// Head of the log: the records are appended to the page buffer, which is programmed when full (or flushed).
+// trackLogOffset == TRACK_LOG_SECTOR_SIZE means the next record goes to a new sector.
+static uint32_t trackLogSector = 0U;
+static uint32_t trackLogSequence = 0U;
+static uint32_t trackLogOffset = TRACK_LOG_SECTOR_SIZE;
+static uint8_t trackLogPage[TRACK_LOG_PAGE_SIZE];
+static bool trackLogPageIsDirty = false;
+static bool trackLogNeedsKeyframe = true;
+static trackLogPoint_t trackLogLastPoint;
+
+static struct
+{
+	gpsTrackLogExportFormat_t format;
+	trackLogExportPhase_t     phase;
+	uint32_t                  position;    // in the text stream
+	uint32_t                  sector;
+	uint32_t                  sectorsLeft;
+	uint32_t                  offset;      // next record, in the sector
+	uint32_t                  pageOffset;  // page buffer content, in the sector
+	bool                      hasPoint;    // a keyframe has been decoded in this sector
+	bool                      segmentIsOpen;
+	trackLogPoint_t           point;
+	uint8_t                   page[TRACK_LOG_PAGE_SIZE];
+	char                      text[TRACK_LOG_EXPORT_TEXT_SIZE];
+	uint16_t                  textLength;
+	uint16_t                  textOffset;
+} trackLogExport;
+
+
+static inline uint32_t trackLogSectorAddress(uint32_t sector)
+{
+	return (trackLogStartAddress + (sector * TRACK_LOG_SECTOR_SIZE));
+}
+
+static uint8_t *trackLogPutUInt16(uint8_t *p, uint16_t value)
+{
+	*p++ = (value >> 0) & 0xFF;
+	*p++ = (value >> 8) & 0xFF;
+
+	return p;
+}
+
+static uint8_t *trackLogPutUInt32(uint8_t *p, uint32_t value)
+{
+	p = trackLogPutUInt16(p, (value & 0xFFFF));
+
+	return trackLogPutUInt16(p, (value >> 16));
+}
+
+static uint16_t trackLogGetUInt16(const uint8_t *p)
+{
+	return (p[0] | (p[1] << 8));
+}
+
+static uint32_t trackLogGetUInt32(const uint8_t *p)
+{
+	return (trackLogGetUInt16(p) | (trackLogGetUInt16(&p[2]) << 16));
+}
+
+static uint8_t *trackLogPutVarint(uint8_t *p, uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		*p++ = (value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	*p++ = value;
+
+	return p;
+}
+
+static uint8_t *trackLogPutSignedVarint(uint8_t *p, int32_t value)
+{
+	return trackLogPutVarint(p, (((uint32_t)value << 1) ^ (uint32_t)(value >> 31))); // zigzag
+}
+
+static const uint8_t *trackLogGetVarint(const uint8_t *p, uint32_t *value)
+{
+	uint32_t shift = 0U;
+
+	*value = 0U;
+	do
+	{
+		*value |= ((uint32_t)(*p & 0x7F) << shift);
+		shift += 7U;
+	} while (*p++ & 0x80);
+
+	return p;
+}
+
+static const uint8_t *trackLogGetSignedVarint(const uint8_t *p, int32_t *value)
+{
+	uint32_t v;
+
+	p = trackLogGetVarint(p, &v);
+	*value = (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+
+	return p;
+}
+
+// Returns the record length, or 0 if it's not a valid record (or it doesn't fit in the available bytes)
+static uint32_t trackLogRecordLength(const uint8_t *record, uint32_t available)
+{
+	uint8_t tag = record[0];
+
+	if (tag == GPS_TRACK_LOG_TAG_SESSION)
+	{
+		return 1U;
+	}
+
+	if (tag == GPS_TRACK_LOG_TAG_KEYFRAME)
+	{
+		return ((available >= TRACK_LOG_KEYFRAME_SIZE) ? TRACK_LOG_KEYFRAME_SIZE : 0U);
+	}
+
+	if ((tag & 0xF0) == GPS_TRACK_LOG_TAG_DELTA)
+	{
+		uint32_t varints = 2U; // latitude and longitude
+		uint32_t length = 1U;
+
+		for (uint8_t flags = (tag & 0x0F); flags; flags >>= 1)
+		{
+			varints += (flags & 0x01);
+		}
+
+		while (varints--)
+		{
+			uint32_t varintLength = 0U;
+
+			do
+			{
+				if ((length >= available) || (varintLength == TRACK_LOG_VARINT_MAX_SIZE))
+				{
+					return 0U;
+				}
+				varintLength++;
+			} while (record[length++] & 0x80);
+		}
+
+		return length;
+	}
+
+	return 0U;
+}
+
+// Updates the point from a keyframe or delta record. Returns false if the record isn't a point, or a delta without keyframe.
+static bool trackLogDecodeRecord(const uint8_t *record, trackLogPoint_t *point, bool *hasPoint)
+{
+	uint8_t tag = record[0];
+
+	if (tag == GPS_TRACK_LOG_TAG_KEYFRAME)
+	{
+		point->time = trackLogGetUInt32(&record[1]);
+		point->latitude = (int32_t)trackLogGetUInt32(&record[5]);
+		point->longitude = (int32_t)trackLogGetUInt32(&record[9]);
+		point->altitude = (int16_t)trackLogGetUInt16(&record[13]);
+		point->speed = trackLogGetUInt16(&record[15]);
+		point->course = trackLogGetUInt16(&record[17]);
+		*hasPoint = true;
+
+		return true;
+	}
+
+	if (((tag & 0xF0) == GPS_TRACK_LOG_TAG_DELTA) && *hasPoint)
+	{
+		const uint8_t *p = &record[1];
+		uint32_t timeDelta = 1U;
+		int32_t delta;
+
+		if (tag & GPS_TRACK_LOG_DELTA_HAS_TIME)
+		{
+			p = trackLogGetVarint(p, &timeDelta);
+		}
+		point->time += timeDelta;
+
+		p = trackLogGetSignedVarint(p, &delta);
+		point->latitude += delta;
+		p = trackLogGetSignedVarint(p, &delta);
+		point->longitude += delta;
+
+		if (tag & GPS_TRACK_LOG_DELTA_HAS_ALTITUDE)
+		{
+			p = trackLogGetSignedVarint(p, &delta);
+			point->altitude += delta;
+		}
+
+		if (tag & GPS_TRACK_LOG_DELTA_HAS_SPEED)
+		{
+			p = trackLogGetSignedVarint(p, &delta);
+			point->speed += delta;
+		}
+
+		if (tag & GPS_TRACK_LOG_DELTA_HAS_COURSE)
+		{
+			p = trackLogGetSignedVarint(p, &delta);
+			point->course += delta;
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+static bool trackLogReadSectorHeader(uint32_t sector, uint32_t *sequence)
+{
+	uint8_t header[GPS_TRACK_LOG_SECTOR_HEADER_SIZE];
+
+	if (SPI_Flash_read(trackLogSectorAddress(sector), header, sizeof(header)) &&
+			(trackLogGetUInt32(&header[0]) == GPS_TRACK_LOG_SECTOR_MAGIC))
+	{
+		*sequence = trackLogGetUInt32(&header[4]);
+		return true;
+	}
+
+	return false;
+}
+
+// Find the newest sector (highest sequence), then the end of its records.
+// Pages are only programmed with complete records, so the first erased tag is the head.
+static void trackLogRecover(void)
+{
+	int32_t newestSector = -1;
+	uint32_t newestSequence = 0U;
+	uint32_t sequence;
+
+	for (uint32_t sector = 0U; sector < trackLogSectorsCount; sector++)
+	{
+		if (trackLogReadSectorHeader(sector, &sequence) &&
+				((newestSector < 0) || ((int32_t)(sequence - newestSequence) > 0)))
+		{
+			newestSector = sector;
+			newestSequence = sequence;
+		}
+	}
+
+	trackLogPageIsDirty = false;
+	trackLogNeedsKeyframe = true;
+	trackLogIsRecovered = true;
+
+	if (newestSector < 0)
+	{
+		// Empty log, the first record will open sector 0
+		trackLogSector = (trackLogSectorsCount - 1);
+		trackLogSequence = 0U;
+		trackLogOffset = TRACK_LOG_SECTOR_SIZE;
+		return;
+	}
+
+	trackLogSector = newestSector;
+	trackLogSequence = newestSequence;
+	trackLogOffset = TRACK_LOG_SECTOR_SIZE;
+
+	for (uint32_t pageOffset = 0U; pageOffset < TRACK_LOG_SECTOR_SIZE; pageOffset += TRACK_LOG_PAGE_SIZE)
+	{
+		uint32_t offset = ((pageOffset == 0U) ? GPS_TRACK_LOG_SECTOR_HEADER_SIZE : 0U);
+
+		if (SPI_Flash_read(trackLogSectorAddress(trackLogSector) + pageOffset, trackLogPage, TRACK_LOG_PAGE_SIZE) == false)
+		{
+			return;
+		}
+
+		while (offset < TRACK_LOG_PAGE_SIZE)
+		{
+			uint32_t length;
+
+			if (trackLogPage[offset] == GPS_TRACK_LOG_TAG_ERASED)
+			{
+				trackLogOffset = (pageOffset + offset);
+				return;
+			}
+
+			// Padding (or unreadable record): the rest of the page is skipped
+			if ((length = trackLogRecordLength(&trackLogPage[offset], (TRACK_LOG_PAGE_SIZE - offset))) == 0U)
+			{
+				break;
+			}
+
+			offset += length;
+		}
+	}
+}
+
+static void trackLogWritePage(uint32_t pageOffset)
+{
+	if (trackLogPageIsDirty)
+	{
+		SPI_Flash_writePage(trackLogSectorAddress(trackLogSector) + pageOffset, trackLogPage);
+		trackLogPageIsDirty = false;
+	}
+}
+
+// Erase the next sector (the oldest one, once the log has wrapped) and start it with its header
+static void trackLogOpenNextSector(void)
+{
+	trackLogSector = ((trackLogSector + 1) % trackLogSectorsCount);
+	trackLogSequence++;
+
+	SPI_Flash_eraseSector(trackLogSectorAddress(trackLogSector)); // Immediate if pre-erased
+
+	// The following one is erased in the background, while this one is filled. The log keeps one sector less of history.
+	if (trackLogSectorsCount > 2U)
+	{
+		SPI_Flash_eraseSectorInBackground(trackLogSectorAddress((trackLogSector + 1) % trackLogSectorsCount));
+	}
+
+	memset(trackLogPage, 0xFF, TRACK_LOG_PAGE_SIZE);
+	trackLogPutUInt32(trackLogPutUInt32(trackLogPage, GPS_TRACK_LOG_SECTOR_MAGIC), trackLogSequence);
+	trackLogOffset = GPS_TRACK_LOG_SECTOR_HEADER_SIZE;
+	trackLogPageIsDirty = true;
+	trackLogNeedsKeyframe = true;
+}
+
+// Make room for a record in the current page, padding it and moving to the next page or sector if needed
+static void trackLogReserve(uint32_t length)
+{
+	if (trackLogOffset < TRACK_LOG_SECTOR_SIZE)
+	{
+		uint32_t offsetInPage = (trackLogOffset % TRACK_LOG_PAGE_SIZE);
+
+		if ((offsetInPage + length) > TRACK_LOG_PAGE_SIZE)
+		{
+			memset(&trackLogPage[offsetInPage], GPS_TRACK_LOG_TAG_PADDING, (TRACK_LOG_PAGE_SIZE - offsetInPage));
+			trackLogPageIsDirty = true;
+			trackLogWritePage(trackLogOffset - offsetInPage);
+
+			memset(trackLogPage, 0xFF, TRACK_LOG_PAGE_SIZE);
+			trackLogOffset += (TRACK_LOG_PAGE_SIZE - offsetInPage);
+		}
+	}
+
+	if (trackLogOffset >= TRACK_LOG_SECTOR_SIZE)
+	{
+		trackLogOpenNextSector();
+	}
+}
+
+static void trackLogAppend(const uint8_t *record, uint32_t length)
+{
+	uint32_t pageOffset = (trackLogOffset & ~(TRACK_LOG_PAGE_SIZE - 1));
+
+	memcpy(&trackLogPage[trackLogOffset - pageOffset], record, length);
+	trackLogPageIsDirty = true;
+	trackLogOffset += length;
+
+	if (trackLogOffset == (pageOffset + TRACK_LOG_PAGE_SIZE))
+	{
+		trackLogWritePage(pageOffset);
+		memset(trackLogPage, 0xFF, TRACK_LOG_PAGE_SIZE);
+	}
+}
+
+void gpsTrackLogInit(uint32_t startAddress, uint32_t size)
+{
+	trackLogStartAddress = startAddress;
+	trackLogSectorsCount = (size / TRACK_LOG_SECTOR_SIZE);
+	trackLogIsRecovered = false;
+}
+
+void gpsTrackLogStartSession(void)
+{
+	uint8_t record = GPS_TRACK_LOG_TAG_SESSION;
+
+	if (trackLogSectorsCount == 0U)
+	{
+		return;
+	}
+
+	if (trackLogIsRecovered == false)
+	{
+		trackLogRecover();
+	}
+
+	trackLogReserve(1U);
+	trackLogAppend(&record, 1U);
+	trackLogNeedsKeyframe = true;
+}
+
+void gpsTrackLogAddPoint(const gpsData_t *data)
+{
+	uint8_t record[GPS_TRACK_LOG_RECORD_MAX_SIZE];
+	uint8_t *p = &record[1];
+	trackLogPoint_t point;
+
+	if ((trackLogSectorsCount == 0U) || (trackLogIsRecovered == false))
+	{
+		return;
+	}
+
+	point.time = data->Time;
+	point.latitude = (int32_t)round(data->LatitudeHiRes * 1E5);
+	point.longitude = (int32_t)round(data->LongitudeHiRes * 1E5);
+	point.altitude = data->HeightInM;
+	point.speed = data->SpeedInHundredthKn;
+	point.course = data->CourseInHundredthDeg;
+
+	trackLogReserve(GPS_TRACK_LOG_RECORD_MAX_SIZE); // could open a new sector, which needs a keyframe
+
+	if (trackLogNeedsKeyframe || (point.time <= trackLogLastPoint.time))
+	{
+		record[0] = GPS_TRACK_LOG_TAG_KEYFRAME;
+		p = trackLogPutUInt32(p, point.time);
+		p = trackLogPutUInt32(p, (uint32_t)point.latitude);
+		p = trackLogPutUInt32(p, (uint32_t)point.longitude);
+		p = trackLogPutUInt16(p, (uint16_t)point.altitude);
+		p = trackLogPutUInt16(p, point.speed);
+		p = trackLogPutUInt16(p, point.course);
+	}
+	else
+	{
+		record[0] = GPS_TRACK_LOG_TAG_DELTA;
+
+		if ((point.time - trackLogLastPoint.time) != 1U)
+		{
+			record[0] |= GPS_TRACK_LOG_DELTA_HAS_TIME;
+			p = trackLogPutVarint(p, (point.time - trackLogLastPoint.time));
+		}
+
+		p = trackLogPutSignedVarint(p, (point.latitude - trackLogLastPoint.latitude));
+		p = trackLogPutSignedVarint(p, (point.longitude - trackLogLastPoint.longitude));
+
+		if (point.altitude != trackLogLastPoint.altitude)
+		{
+			record[0] |= GPS_TRACK_LOG_DELTA_HAS_ALTITUDE;
+			p = trackLogPutSignedVarint(p, (point.altitude - trackLogLastPoint.altitude));
+		}
+
+		if (point.speed != trackLogLastPoint.speed)
+		{
+			record[0] |= GPS_TRACK_LOG_DELTA_HAS_SPEED;
+			p = trackLogPutSignedVarint(p, (point.speed - trackLogLastPoint.speed));
+		}
+
+		if (point.course != trackLogLastPoint.course)
+		{
+			record[0] |= GPS_TRACK_LOG_DELTA_HAS_COURSE;
+			p = trackLogPutSignedVarint(p, (point.course - trackLogLastPoint.course));
+		}
+	}
+
+	trackLogAppend(record, (p - record));
+	trackLogLastPoint = point;
+	trackLogNeedsKeyframe = false;
+}
+
+// Program the partially filled page. The erased bytes can be programmed later on, when more records are appended.
+void gpsTrackLogFlush(void)
+{
+	if (trackLogOffset < TRACK_LOG_SECTOR_SIZE)
+	{
+		trackLogWritePage(trackLogOffset & ~(TRACK_LOG_PAGE_SIZE - 1));
+	}
+}
+
+void gpsTrackLogClear(void)
+{
+	watchdogRun(false);
+	for (uint32_t sector = 0U; sector < trackLogSectorsCount; sector++)
+	{
+		SPI_Flash_eraseSector(trackLogSectorAddress(sector));
+	}
+	watchdogRun(true);
+
+	trackLogSector = (trackLogSectorsCount - 1);
+	trackLogSequence = 0U;
+	trackLogOffset = TRACK_LOG_SECTOR_SIZE;
+	trackLogPageIsDirty = false;
+	trackLogNeedsKeyframe = true;
+	trackLogIsRecovered = true;
+}
+
+// Next record, oldest sector first. The returned pointer is valid until the next call.
+static const uint8_t *trackLogExportNextRecord(void)
+{
+	uint32_t sequence;
+
+	while (true)
+	{
+		if (trackLogExport.offset >= TRACK_LOG_SECTOR_SIZE)
+		{
+			if (trackLogExport.sectorsLeft == 0U)
+			{
+				return NULL;
+			}
+
+			trackLogExport.sectorsLeft--;
+			trackLogExport.sector = ((trackLogExport.sector + 1) % trackLogSectorsCount);
+
+			if (trackLogReadSectorHeader(trackLogExport.sector, &sequence) == false)
+			{
+				continue; // Erased
+			}
+
+			trackLogExport.offset = GPS_TRACK_LOG_SECTOR_HEADER_SIZE;
+			trackLogExport.pageOffset = TRACK_LOG_SECTOR_SIZE;
+			trackLogExport.hasPoint = false;
+		}
+
+		uint32_t pageOffset = (trackLogExport.offset & ~(TRACK_LOG_PAGE_SIZE - 1));
+		uint32_t offsetInPage = (trackLogExport.offset % TRACK_LOG_PAGE_SIZE);
+		uint32_t length;
+
+		if (pageOffset != trackLogExport.pageOffset)
+		{
+			if (SPI_Flash_read(trackLogSectorAddress(trackLogExport.sector) + pageOffset, trackLogExport.page, TRACK_LOG_PAGE_SIZE) == false)
+			{
+				trackLogExport.offset = TRACK_LOG_SECTOR_SIZE;
+				continue;
+			}
+			trackLogExport.pageOffset = pageOffset;
+		}
+
+		if (trackLogExport.page[offsetInPage] == GPS_TRACK_LOG_TAG_ERASED)
+		{
+			trackLogExport.offset = TRACK_LOG_SECTOR_SIZE; // End of this sector records
+			continue;
+		}
+
+		if ((length = trackLogRecordLength(&trackLogExport.page[offsetInPage], (TRACK_LOG_PAGE_SIZE - offsetInPage))) == 0U)
+		{
+			trackLogExport.offset = (pageOffset + TRACK_LOG_PAGE_SIZE); // Padding
+			continue;
+		}
+
+		trackLogExport.offset += length;
+
+		return &trackLogExport.page[offsetInPage];
+	}
+}
+
+static int trackLogFormatGPXPoint(char *text, int size, const trackLogPoint_t *point, bool openSegment)
+{
+	struct tm t;
+	uint32_t speed = ((point->speed * 5144U) / 10000U); // hundredth of knot to hundredth of m/s
+	uint32_t latitude = abs(point->latitude);
+	uint32_t longitude = abs(point->longitude);
+
+	gmtime_r_Custom(&point->time, &t);
+
+	return snprintf(text, size, "%s<trkpt lat=\"%s%u.%05u\" lon=\"%s%u.%05u\"><ele>%d</ele><time>%04d-%02d-%02dT%02d:%02d:%02dZ</time>"
+			"<course>%u.%02u</course><speed>%u.%02u</speed></trkpt>\n",
+			(openSegment ? "<trkseg>\n" : ""),
+			((point->latitude < 0) ? "-" : ""), (unsigned int)(latitude / 100000U), (unsigned int)(latitude % 100000U),
+			((point->longitude < 0) ? "-" : ""), (unsigned int)(longitude / 100000U), (unsigned int)(longitude % 100000U),
+			point->altitude, (t.tm_year + 1900), (t.tm_mon + 1), t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec,
+			(point->course / 100U), (point->course % 100U), (unsigned int)(speed / 100U), (unsigned int)(speed % 100U));
+}
+
+static int trackLogAppendNMEAChecksum(char *sentence, int length, int size)
+{
+	uint8_t checksum = 0U;
+
+	for (int i = 1; i < length; i++) // after the '$'
+	{
+		checksum ^= sentence[i];
+	}
+
+	return (length + snprintf(&sentence[length], (size - length), "*%02X\r\n", checksum));
+}
+
+// ddmm.mmmm or dddmm.mmmm, with the hemisphere letter
+static int trackLogFormatNMEACoordinate(char *text, int size, int32_t value, bool isLongitude)
+{
+	uint32_t v = abs(value);
+	uint32_t minutes = ((v % 100000U) * 6U); // in 1e-4 minute
+
+	return snprintf(text, size, (isLongitude ? "%03u%02u.%04u,%c" : "%02u%02u.%04u,%c"),
+			(unsigned int)(v / 100000U), (unsigned int)(minutes / 10000U), (unsigned int)(minutes % 10000U),
+			(isLongitude ? ((value < 0) ? 'W' : 'E') : ((value < 0) ? 'S' : 'N')));
+}
+
+static int trackLogFormatNMEAPoint(char *text, int size, const trackLogPoint_t *point)
+{
+	struct tm t;
+	char latitude[16];
+	char longitude[16];
+	int length;
+	int start;
+
+	gmtime_r_Custom(&point->time, &t);
+	trackLogFormatNMEACoordinate(latitude, sizeof(latitude), point->latitude, false);
+	trackLogFormatNMEACoordinate(longitude, sizeof(longitude), point->longitude, true);
+
+	length = snprintf(text, size, "$GPRMC,%02d%02d%02d.00,A,%s,%s,%u.%02u,%u.%02u,%02d%02d%02d,,,A",
+			t.tm_hour, t.tm_min, t.tm_sec, latitude, longitude,
+			(point->speed / 100U), (point->speed % 100U), (point->course / 100U), (point->course % 100U),
+			t.tm_mday, (t.tm_mon + 1), (t.tm_year % 100));
+	length = trackLogAppendNMEAChecksum(text, length, size);
+
+	start = length;
+	length += snprintf(&text[start], (size - start), "$GPGGA,%02d%02d%02d.00,%s,%s,1,,,%d,M,,M,,",
+			t.tm_hour, t.tm_min, t.tm_sec, latitude, longitude, point->altitude);
+
+	return (start + trackLogAppendNMEAChecksum(&text[start], (length - start), (size - start)));
+}
+
+// Fill the text buffer with the next chunk of the export, returns false once all has been sent
+static bool trackLogExportNextText(void)
+{
+	const uint8_t *record;
+
+	trackLogExport.textOffset = 0U;
+	trackLogExport.textLength = 0U;
+
+	while (trackLogExport.textLength == 0U)
+	{
+		int length = 0;
+
+		switch (trackLogExport.phase)
+		{
+			case TRACK_LOG_EXPORT_HEADER:
+				if (trackLogExport.format == GPS_TRACK_LOG_EXPORT_GPX)
+				{
+					length = snprintf(trackLogExport.text, TRACK_LOG_EXPORT_TEXT_SIZE, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+							"<gpx version=\"1.0\" creator=\"OpenGD77\" xmlns=\"http://www.topografix.com/GPX/1/0\">\n<trk>\n");
+				}
+				trackLogExport.phase = TRACK_LOG_EXPORT_RECORDS;
+				break;
+
+			case TRACK_LOG_EXPORT_RECORDS:
+				if ((record = trackLogExportNextRecord()) == NULL)
+				{
+					trackLogExport.phase = TRACK_LOG_EXPORT_FOOTER;
+				}
+				else if (record[0] == GPS_TRACK_LOG_TAG_SESSION)
+				{
+					if ((trackLogExport.format == GPS_TRACK_LOG_EXPORT_GPX) && trackLogExport.segmentIsOpen)
+					{
+						length = snprintf(trackLogExport.text, TRACK_LOG_EXPORT_TEXT_SIZE, "</trkseg>\n");
+					}
+					trackLogExport.segmentIsOpen = false;
+				}
+				else if (trackLogDecodeRecord(record, &trackLogExport.point, &trackLogExport.hasPoint))
+				{
+					if (trackLogExport.format == GPS_TRACK_LOG_EXPORT_GPX)
+					{
+						length = trackLogFormatGPXPoint(trackLogExport.text, TRACK_LOG_EXPORT_TEXT_SIZE, &trackLogExport.point, (trackLogExport.segmentIsOpen == false));
+						trackLogExport.segmentIsOpen = true;
+					}
+					else
+					{
+						length = trackLogFormatNMEAPoint(trackLogExport.text, TRACK_LOG_EXPORT_TEXT_SIZE, &trackLogExport.point);
+					}
+				}
+				break;
+
+			case TRACK_LOG_EXPORT_FOOTER:
+				if (trackLogExport.format == GPS_TRACK_LOG_EXPORT_GPX)
+				{
+					length = snprintf(trackLogExport.text, TRACK_LOG_EXPORT_TEXT_SIZE, "%s</trk>\n</gpx>\n", (trackLogExport.segmentIsOpen ? "</trkseg>\n" : ""));
+				}
+				trackLogExport.phase = TRACK_LOG_EXPORT_DONE;
+				break;
+
+			case TRACK_LOG_EXPORT_DONE:
+				return false;
+		}
+
+		trackLogExport.textLength = ((length < TRACK_LOG_EXPORT_TEXT_SIZE) ? length : (TRACK_LOG_EXPORT_TEXT_SIZE - 1));
+	}
+
+	return true;
+}
+
+// Streamed export of the whole log, as GPX or NMEA (RMC + GGA) text, generated on the fly.
+// The position has to follow the previous read, 0 (re)starts the export.
+// Returns the number of bytes copied (less than length at the end of the stream), or -1 if out of sequence.
+int gpsTrackLogExportRead(gpsTrackLogExportFormat_t format, uint32_t position, uint8_t *dest, int length)
+{
+	int copied = 0;
+
+	if (trackLogSectorsCount == 0U)
+	{
+		return -1;
+	}
+
+	if (position == 0U)
+	{
+		if (trackLogIsRecovered == false)
+		{
+			trackLogRecover();
+		}
+		gpsTrackLogFlush();
+
+		memset(&trackLogExport, 0, sizeof(trackLogExport));
+		trackLogExport.format = format;
+		trackLogExport.phase = TRACK_LOG_EXPORT_HEADER;
+		trackLogExport.sector = trackLogSector; // Starts from the next one, the oldest
+		trackLogExport.sectorsLeft = trackLogSectorsCount;
+		trackLogExport.offset = TRACK_LOG_SECTOR_SIZE;
+		trackLogExport.pageOffset = TRACK_LOG_SECTOR_SIZE;
+	}
+	else if ((position != trackLogExport.position) || (format != trackLogExport.format))
+	{
+		return -1;
+	}
+
+	while (copied < length)
+	{
+		if ((trackLogExport.textOffset == trackLogExport.textLength) && (trackLogExportNextText() == false))
+		{
+			break;
+		}
+
+		int chunk = (trackLogExport.textLength - trackLogExport.textOffset);
+
+		if (chunk > (length - copied))
+		{
+			chunk = (length - copied);
+		}
+
+		memcpy(&dest[copied], &trackLogExport.text[trackLogExport.textOffset], chunk);
+		trackLogExport.textOffset += chunk;
+		copied += chunk;
+	}
+
+	trackLogExport.position += copied;
+
+	return copied;
+}
+
+#endif // HAS_GPS && LOG_GPS_DATA
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <string.h>
+#include "main.h"
+#include "interfaces/runTimeStats.h"
+
+//
+// TIM5 (32 bits, APB1) is used as the run time statistics counter.
+// Its prescaler is recomputed on each system clock change, so the counter
+// always ticks at RUN_TIME_STATS_COUNTER_HZ.
+//
+typedef struct
+{
+	uint32_t       previousTaskRunTime[RUN_TIME_STATS_MAX_TASKS];
+	UBaseType_t    previousTaskNumber[RUN_TIME_STATS_MAX_TASKS];
+	uint32_t       previousTotalRunTime;
+	runTimeStats_t stats;
+} runTimeStatsWindowData_t;
+
+static TaskStatus_t taskStatusArray[RUN_TIME_STATS_MAX_TASKS];
+static runTimeStatsWindowData_t runTimeStatsWindows[RUN_TIME_STATS_NUM_WINDOWS];
+
+
+static uint32_t runTimeStatsGetPrescaler(void)
+{
+	uint32_t timerClock = HAL_RCC_GetPCLK1Freq();
+
+	// Timers clock is doubled when APB1 is divided
+	if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_HCLK_DIV1)
+	{
+		timerClock *= 2U;
+	}
+
+	return ((timerClock / RUN_TIME_STATS_COUNTER_HZ) - 1U);
+}
+
+void runTimeStatsTimerInit(void)
+{
+	__HAL_RCC_TIM5_CLK_ENABLE();
+
+	TIM5->CR1 = 0U;
+	TIM5->PSC = runTimeStatsGetPrescaler();
+	TIM5->ARR = 0xFFFFFFFFU;
+	TIM5->CNT = 0U;
+	TIM5->EGR = TIM_EGR_UG; // Load the prescaler
+	TIM5->CR1 = TIM_CR1_CEN;
+
+	// CPU cycles counter, for short durations
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0U;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t runTimeStatsGetCounter(void)
+{
+	return TIM5->CNT;
+}
+
+uint32_t runTimeStatsGetCycles(void)
+{
+	return DWT->CYCCNT;
+}
+
+// Uses the current core clock, the measured duration should not span a clock change
+uint32_t runTimeStatsCyclesToMicroseconds(uint32_t cycles)
+{
+	return (cycles / (SystemCoreClock / 1000000U));
+}
+
+// Needs to be called each time the APB1 clock is reconfigured.
+void runTimeStatsClockHasChanged(void)
+{
+	if (TIM5->CR1 & TIM_CR1_CEN)
+	{
+		uint32_t counter = TIM5->CNT;
+
+		TIM5->PSC = runTimeStatsGetPrescaler();
+		TIM5->EGR = TIM_EGR_UG; // The update event resets the counter, restore it.
+		TIM5->CNT = counter;
+	}
+}
+
+static int runTimeStatsGetPreviousIndex(runTimeStatsWindowData_t *windowData, UBaseType_t taskNumber)
+{
+	for (int i = 0; i < RUN_TIME_STATS_MAX_TASKS; i++)
+	{
+		if (windowData->previousTaskNumber[i] == taskNumber)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+// Computes the CPU usage of each task since the previous call for the same window.
+void runTimeStatsUpdate(runTimeStatsWindow_t window)
+{
+	runTimeStatsWindowData_t *windowData = &runTimeStatsWindows[window];
+	uint32_t totalRunTime;
+	UBaseType_t numTasks = uxTaskGetSystemState(taskStatusArray, RUN_TIME_STATS_MAX_TASKS, &totalRunTime);
+	uint32_t sampleDuration = (totalRunTime - windowData->previousTotalRunTime);
+	uint32_t runTime[RUN_TIME_STATS_MAX_TASKS];
+	UBaseType_t taskNumber[RUN_TIME_STATS_MAX_TASKS];
+	TaskHandle_t idleHandle = xTaskGetIdleTaskHandle();
+
+	windowData->stats.numTasks = numTasks;
+	windowData->stats.idlePermille = 0;
+	windowData->stats.sampleDuration = sampleDuration;
+
+	for (UBaseType_t i = 0; i < numTasks; i++)
+	{
+		TaskStatus_t *status = &taskStatusArray[i];
+		runTimeStatsTask_t *task = &windowData->stats.tasks[i];
+		int prevIndex = runTimeStatsGetPreviousIndex(windowData, status->xTaskNumber);
+		uint32_t taskRunTime = status->ulRunTimeCounter - ((prevIndex >= 0) ? windowData->previousTaskRunTime[prevIndex] : 0U);
+
+		strncpy(task->name, status->pcTaskName, configMAX_TASK_NAME_LEN);
+		task->name[configMAX_TASK_NAME_LEN - 1] = 0;
+		task->cpuPermille = ((sampleDuration > 0) ? (uint16_t)(((uint64_t)taskRunTime * 1000U) / sampleDuration) : 0);
+		task->stackHighWaterMark = status->usStackHighWaterMark;
+		task->state = status->eCurrentState;
+		task->priority = status->uxCurrentPriority;
+
+		if (status->xHandle == idleHandle)
+		{
+			windowData->stats.idlePermille = task->cpuPermille;
+		}
+
+		runTime[i] = status->ulRunTimeCounter;
+		taskNumber[i] = status->xTaskNumber;
+	}
+
+	memset(windowData->previousTaskNumber, 0, sizeof(windowData->previousTaskNumber));
+	memcpy(windowData->previousTaskRunTime, runTime, (numTasks * sizeof(uint32_t)));
+	memcpy(windowData->previousTaskNumber, taskNumber, (numTasks * sizeof(UBaseType_t)));
+	windowData->previousTotalRunTime = totalRunTime;
+}
+
+const runTimeStats_t *runTimeStatsGet(runTimeStatsWindow_t window)
+{
+	return &runTimeStatsWindows[window].stats;
+}
@@ -25,29 +25,194 @@
  *
  */
 #include "main.h"
+#include "functions/ticks.h"
+#include "hardware/SPI_Flash.h"
 #include "interfaces/batteryRAM.h"
+#include "interfaces/crc.h"
 #include "interfaces/settingsStorage.h"
 
-#define STORAGE_BASE_ADDRESS         (0x6000 + 0x4B /* After "Last Used Channel In Zone" */)
 #define USE_PERMANENT_STORAGE
 #if defined(STM32F405xx)
 #define SETTINGS_START_ADDRESS        0x02
 #endif
 
+#if defined(STM32F405xx) && defined(USE_PERMANENT_STORAGE)
+// Write-back cache: settings (and VFOs) changes are committed to the backup SRAM, the flash copy is only rewritten
+// after a long idle period, at power down, or when the backup SRAM content is lost.
+#define USE_BACKUP_SRAM_CACHE
+
+#define BACKUP_SRAM_CACHE_ADDRESS     0x10 // MD9600 stores its standby flag at 0x00
+#define BACKUP_SRAM_CACHE_MAGIC       0x53544753 // "SGTS"
+#define FLASH_COMMIT_IDLE_TIME        (5 * 60 * 1000) // 5 minutes after the last change
+#define FLASH_COMMIT_MAX_DELAY        (15 * 60 * 1000) // Even if the radio is never idle meanwhile
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t sequence; // incremented on each backup SRAM commit
+	uint32_t flashSequence; // sequence of the last flash commit
+	uint32_t length;
+	uint32_t vfosLength; // VFOs changed since the last flash commit: SETTINGS_STORAGE_VFOS_SIZE, they follow the settings data
+	uint32_t crc; // header (up to this field), settings and VFOs data
+} __attribute__((packed)) backupSRAMHeader_t;
+
+static backupSRAMHeader_t backupHeader;
+static uint8_t backupVFOs[SETTINGS_STORAGE_VFOS_SIZE]; // Last saved VFOs, flash content when vfosLength is 0
+static bool backupIsValid = false;
+static ticksTimer_t flashCommitTimer = { 0, 0 };
+
+static uint32_t backupSRAMCalcCRC(backupSRAMHeader_t *header, uint8_t *buf, uint32_t size)
+{
+	return crcCalc32(crcCalc32(crcCalc32(0, (uint8_t *)header, offsetof(backupSRAMHeader_t, crc)), buf, size), backupVFOs, header->vfosLength);
+}
+
+static bool backupSRAMCommit(uint8_t *buf, uint32_t size)
+{
+	backupHeader.magic = BACKUP_SRAM_CACHE_MAGIC;
+	backupHeader.length = size;
+	backupHeader.crc = backupSRAMCalcCRC(&backupHeader, buf, size);
+
+	// Data first, so a reset in between leaves a CRC mismatch rather than a valid looking record
+	backupIsValid = batteryRAM_Write(BACKUP_SRAM_CACHE_ADDRESS + sizeof(backupSRAMHeader_t), buf, size) &&
+			batteryRAM_Write(BACKUP_SRAM_CACHE_ADDRESS + sizeof(backupSRAMHeader_t) + size, backupVFOs, backupHeader.vfosLength) &&
+			batteryRAM_Write(BACKUP_SRAM_CACHE_ADDRESS, (uint8_t *)&backupHeader, sizeof(backupSRAMHeader_t));
+
+	return backupIsValid;
+}
+
+// Returns true if the backup SRAM holds settings that have not reached the flash yet.
+static bool backupSRAMLoad(uint8_t *buf, uint32_t size)
+{
+	if (batteryRAM_Read(BACKUP_SRAM_CACHE_ADDRESS, (uint8_t *)&backupHeader, sizeof(backupSRAMHeader_t)) &&
+			(backupHeader.magic == BACKUP_SRAM_CACHE_MAGIC) && (backupHeader.length == size) &&
+			((backupHeader.vfosLength == 0) || (backupHeader.vfosLength == SETTINGS_STORAGE_VFOS_SIZE)) &&
+			(backupHeader.sequence != backupHeader.flashSequence) &&
+			batteryRAM_Read(BACKUP_SRAM_CACHE_ADDRESS + sizeof(backupSRAMHeader_t), buf, size) &&
+			batteryRAM_Read(BACKUP_SRAM_CACHE_ADDRESS + sizeof(backupSRAMHeader_t) + size, backupVFOs, backupHeader.vfosLength) &&
+			(backupSRAMCalcCRC(&backupHeader, buf, size) == backupHeader.crc))
+	{
+		return true;
+	}
+
+	backupHeader.vfosLength = 0;
+	return false;
+}
+#endif
+
 bool settingsStorageRead(uint8_t *buf, uint32_t size)
 {
-#if !defined(STM32F405xx) || defined(USE_PERMANENT_STORAGE)
-	return EEPROM_Read(STORAGE_BASE_ADDRESS, buf, size);
+#if defined(USE_BACKUP_SRAM_CACHE)
+	batteryRAM_Init(false);
+
+	if (backupSRAMLoad(buf, size))
+	{
+		// Unflushed changes survived a reset, commit them now: the VFOs are read from the codeplug
+		backupIsValid = true;
+		settingsStorageFlush(buf, size);
+		return true;
+	}
+
+	// Backup domain is invalid or in sync: the flash copy is authoritative
+	if (EEPROM_Read(SETTINGS_STORAGE_ADDRESS, buf, size))
+	{
+		backupHeader.sequence = backupHeader.flashSequence = 0;
+		backupHeader.vfosLength = 0;
+		EEPROM_Read(CODEPLUG_ADDR_VFO_A_CHANNEL, backupVFOs, SETTINGS_STORAGE_VFOS_SIZE);
+		backupSRAMCommit(buf, size);
+		return true;
+	}
+
+	return false;
+#elif !defined(STM32F405xx) || defined(USE_PERMANENT_STORAGE)
+	return EEPROM_Read(SETTINGS_STORAGE_ADDRESS, buf, size);
 #else
 	return batteryRAM_Read(SETTINGS_START_ADDRESS,buf,size);
 #endif
 }
 
-bool settingsStorageWrite(uint8_t *buf, uint32_t size)
+// vfos: VFO A and B (codeplug format), NULL if they didn't change
+bool settingsStorageWrite(uint8_t *buf, uint32_t size, uint8_t *vfos)
 {
-#if !defined(STM32F405xx) || defined(USE_PERMANENT_STORAGE)
-	return EEPROM_Write(STORAGE_BASE_ADDRESS, buf, size);
+#if defined(USE_BACKUP_SRAM_CACHE)
+	if ((vfos != NULL) && (memcmp(backupVFOs, vfos, SETTINGS_STORAGE_VFOS_SIZE) != 0))
+	{
+		memcpy(backupVFOs, vfos, SETTINGS_STORAGE_VFOS_SIZE);
+		backupHeader.vfosLength = SETTINGS_STORAGE_VFOS_SIZE;
+	}
+
+	// Same content as the current record, which keeps its flash commit state
+	if (backupIsValid && (backupSRAMCalcCRC(&backupHeader, buf, size) == backupHeader.crc))
+	{
+		return true;
+	}
+
+	backupHeader.sequence++;
+
+	if (backupSRAMCommit(buf, size))
+	{
+		ticksTimerStart(&flashCommitTimer, FLASH_COMMIT_IDLE_TIME);
+		return true;
+	}
+
+	// No backup SRAM, straight to the flash
+	return settingsStorageFlush(buf, size);
+#elif !defined(STM32F405xx) || defined(USE_PERMANENT_STORAGE)
+	return EEPROM_Write(SETTINGS_STORAGE_ADDRESS, buf, size) &&
+			((vfos == NULL) || EEPROM_Write(CODEPLUG_ADDR_VFO_A_CHANNEL, vfos, SETTINGS_STORAGE_VFOS_SIZE));
 #else
-	return batteryRAM_Write(SETTINGS_START_ADDRESS,buf,size);
+	return batteryRAM_Write(SETTINGS_START_ADDRESS,buf,size) &&
+			((vfos == NULL) || EEPROM_Write(CODEPLUG_ADDR_VFO_A_CHANNEL, vfos, SETTINGS_STORAGE_VFOS_SIZE));
+#endif
+}
+
+bool settingsStorageFlushIsDue(void)
+{
+#if defined(USE_BACKUP_SRAM_CACHE)
+	// The settings sector is shared with the codeplug, it can't be pre-erased like the log sectors:
+	// the commit erases it in the foreground, so it waits for the radio to be idle, as the background erases do.
+	return (ticksTimerIsEnabled(&flashCommitTimer) && ticksTimerHasExpired(&flashCommitTimer) &&
+			(SPI_Flash_maintenanceRadioIsIdle() || ((ticksGetMillis() - flashCommitTimer.start) >= FLASH_COMMIT_MAX_DELAY)));
+#else
+	return false;
+#endif
+}
+
+bool settingsStorageFlush(uint8_t *buf, uint32_t size)
+{
+#if defined(USE_BACKUP_SRAM_CACHE)
+	// Nothing written since the last flash commit
+	if (backupHeader.sequence == backupHeader.flashSequence)
+	{
+		ticksTimerReset(&flashCommitTimer);
+		return true;
+	}
+
+	if (EEPROM_Write(SETTINGS_STORAGE_ADDRESS, buf, size) &&
+			((backupHeader.vfosLength == 0) || EEPROM_Write(CODEPLUG_ADDR_VFO_A_CHANNEL, backupVFOs, backupHeader.vfosLength)))
+	{
+		ticksTimerReset(&flashCommitTimer);
+		backupHeader.flashSequence = backupHeader.sequence;
+		backupHeader.vfosLength = 0;
+		backupSRAMCommit(buf, size);
+		return true;
+	}
+
+	return false;
+#else
+	return true;
+#endif
+}
+
+void settingsStorageDiscardBackup(void)
+{
+#if defined(USE_BACKUP_SRAM_CACHE)
+	uint32_t magic = 0;
+
+	batteryRAM_Write(BACKUP_SRAM_CACHE_ADDRESS, (uint8_t *)&magic, sizeof(magic));
+	backupIsValid = false;
+	backupHeader.flashSequence = backupHeader.sequence;
+	backupHeader.vfosLength = 0;
+	memset(backupVFOs, 0xFF, SETTINGS_STORAGE_VFOS_SIZE); // The CPS may have written them, don't trust the copy
+	ticksTimerReset(&flashCommitTimer);
 #endif
 }
@@ -27,14 +27,66 @@
  */
 
 #include <stdbool.h>
+#include <string.h>
 #include "interfaces/hr-c6000_spi.h"
+#include "interfaces/runTimeStats.h"
 #include "main.h"
 
+//
+// SPI0 (C6000 configuration bus) is bit-banged, its pins aren't mapped to any of the STM32F405 SPI peripherals.
+// CS, CLK, MOSI and MISO are all on GPIOE: each clock edge is a single BSRR write, the falling one also sets MOSI,
+// and the bytes are unrolled. The C6000 samples MOSI on the rising edge, MISO is read just before it.
+//
+#define SPI0_GPIO                     GPIOE
+#define SPI0_CLK_LOW_MOSI_HIGH        ((((uint32_t)DMR_SPI_CLK_Pin) << 16U) | DMR_SPI_MOSI_Pin)
+#define SPI0_CLK_LOW_MOSI_LOW         ((((uint32_t)DMR_SPI_CLK_Pin) << 16U) | (((uint32_t)DMR_SPI_MOSI_Pin) << 16U))
 
+// Clock half period padding, ~100ns at 72MHz (the HAL_GPIO_WritePin() version was running the clock at ~2MHz)
+#ifdef SPI_0_DELAYS
+#define SPI0_DELAY()                  do { for(volatile int x = 0; x < 1; x++); } while (0)
+#else
+#define SPI0_DELAY()                  do { __NOP(); __NOP(); __NOP(); __NOP(); } while (0)
+#endif
+
+#define SPI0_WRITE_BIT(val, bit) \
+	do { \
+		SPI0_GPIO->BSRR = (((val) & (1U << (bit))) ? SPI0_CLK_LOW_MOSI_HIGH : SPI0_CLK_LOW_MOSI_LOW); \
+		SPI0_DELAY(); \
+		SPI0_GPIO->BSRR = DMR_SPI_CLK_Pin; \
+		SPI0_DELAY(); \
+	} while (0)
+
+#define SPI0_TRANSFER_BIT(val, rxVal, bit) \
+	do { \
+		SPI0_GPIO->BSRR = (((val) & (1U << (bit))) ? SPI0_CLK_LOW_MOSI_HIGH : SPI0_CLK_LOW_MOSI_LOW); \
+		SPI0_DELAY(); \
+		(rxVal) |= ((SPI0_GPIO->IDR & DMR_SPI_MISO_Pin) ? (1U << (bit)) : 0U); \
+		SPI0_GPIO->BSRR = DMR_SPI_CLK_Pin; \
+		SPI0_DELAY(); \
+	} while (0)
+
+#define SPI0_CS_LOW()                 (SPI0_GPIO->BSRR = (((uint32_t)DMR_SPI_CS_Pin) << 16U))
+#define SPI0_CS_HIGH()                (SPI0_GPIO->BSRR = DMR_SPI_CS_Pin)
+
+// Above that, the timeslot interrupts stopped (analog mode, RX off), the bus time isn't accounted to a timeslot
+#define SPI_BUS_TIMESLOT_MAX_US       65000U
 
 volatile bool SPI0inUse = false;
 volatile bool SPI1inUse = false;
 
+// Last values written to the configuration pages 0x01 and 0x04, for the C6000 register scripts.
+// Only valid since the last SPI0ShadowInvalidate() (C6000 reset or power down) or page 0x04 register 0x00 write.
+#define SPI0_SHADOW_PAGE_INDEX(page)  (((page) == 0x01) ? 0 : (((page) == 0x04) ? 1 : -1))
+
+static uint8_t spi0Shadow[2][256];
+static uint32_t spi0ShadowValid[2][256 / 32];
+
+static uint32_t spi0StartCycles;
+static volatile uint32_t spiBusCycles = 0;
+static uint32_t spiBusTimeslotStartCycles = 0;
+static uint64_t spiBusTotalCycles = 0;
+static spiBusStats_t spiBusStats;
+
 void SPIInit(void)
 {
 
@@ -50,81 +102,150 @@ void SPI1Setup(void)
 	//SPI1 is a hardware Interface on the MD9600
 }
 
-int SPI0WritePageRegByte(uint8_t page, uint8_t reg, uint8_t val)
+static inline void spi0WriteByte(uint8_t val)
 {
-	uint8_t txBuf[3];
-	UBaseType_t SavedInterruptStatus;
+	SPI0_WRITE_BIT(val, 7);
+	SPI0_WRITE_BIT(val, 6);
+	SPI0_WRITE_BIT(val, 5);
+	SPI0_WRITE_BIT(val, 4);
+	SPI0_WRITE_BIT(val, 3);
+	SPI0_WRITE_BIT(val, 2);
+	SPI0_WRITE_BIT(val, 1);
+	SPI0_WRITE_BIT(val, 0);
+}
 
-	if (SPI0inUse)
+static inline uint8_t spi0TransferByte(uint8_t val)
+{
+	uint32_t rxVal = 0U;
+
+	SPI0_TRANSFER_BIT(val, rxVal, 7);
+	SPI0_TRANSFER_BIT(val, rxVal, 6);
+	SPI0_TRANSFER_BIT(val, rxVal, 5);
+	SPI0_TRANSFER_BIT(val, rxVal, 4);
+	SPI0_TRANSFER_BIT(val, rxVal, 3);
+	SPI0_TRANSFER_BIT(val, rxVal, 2);
+	SPI0_TRANSFER_BIT(val, rxVal, 1);
+	SPI0_TRANSFER_BIT(val, rxVal, 0);
+
+	return (uint8_t)rxVal;
+}
+
+// Called with the bus claimed, once the values are on the C6000
+static void spi0ShadowUpdate(uint8_t page, uint8_t reg, const uint8_t *values, int length)
+{
+	int index = SPI0_SHADOW_PAGE_INDEX(page);
+
+	// Page 0x04 register 0x00 is the reset/power control, it puts registers back to their defaults
+	if ((page == 0x04) && (reg == 0x00))
 	{
-		return -1;
+		memset(spi0ShadowValid, 0, sizeof(spi0ShadowValid));
+		return;
 	}
-	SavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
-	SPI0inUse = true;
 
-	txBuf[0] = page;
-	txBuf[1] = reg;
-	txBuf[2] = val;
+	if (index >= 0)
+	{
+		for (int i = 0; (i < length) && ((reg + i) < 256); i++)
+		{
+			spi0Shadow[index][reg + i] = values[i];
+			spi0ShadowValid[index][(reg + i) >> 5] |= (1U << ((reg + i) & 0x1F));
+		}
+	}
+}
 
-	SPI0Write(txBuf,3);
+// SPI1 transfers aren't run in a critical section
+static void spiBusAccount(uint32_t startCycles)
+{
+	UBaseType_t SavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
 
-	SPI0inUse = false;
+	spiBusCycles += (runTimeStatsGetCycles() - startCycles);
 	taskEXIT_CRITICAL_FROM_ISR(SavedInterruptStatus);
-	return 0;
 }
 
-
-int SPI0WritePageRegByteExtended(uint8_t page, uint16_t reg, uint8_t val)
+// Takes the bus, in a critical section (the C6000 ISRs use it too). Fails if it's already in use.
+static bool spi0Claim(UBaseType_t *savedInterruptStatus)
 {
-	uint8_t txBuf[4];
-	UBaseType_t SavedInterruptStatus;
+	*savedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
 
 	if (SPI0inUse)
 	{
-		return -1;
+		spiBusStats.collisions++;
+		taskEXIT_CRITICAL_FROM_ISR(*savedInterruptStatus);
+		return false;
 	}
-	SavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
+
 	SPI0inUse = true;
+	spi0StartCycles = runTimeStatsGetCycles();
 
-	txBuf[0] = page | 0x40;
-	txBuf[2] = (reg >> 8) & 0x07;
-	txBuf[1] = reg & 0xFF;
-	txBuf[3] = val;
+	return true;
+}
 
-	SPI0Write(txBuf,4);
+static void spi0Release(UBaseType_t savedInterruptStatus)
+{
+	spiBusCycles += (runTimeStatsGetCycles() - spi0StartCycles);
+	spiBusStats.transfers++;
 
 	SPI0inUse = false;
-	taskEXIT_CRITICAL_FROM_ISR(SavedInterruptStatus);
-	return 0;
+	taskEXIT_CRITICAL_FROM_ISR(savedInterruptStatus);
 }
 
+int SPI0WritePageRegByte(uint8_t page, uint8_t reg, uint8_t val)
+{
+	UBaseType_t SavedInterruptStatus;
+
+	if (spi0Claim(&SavedInterruptStatus) == false)
+	{
+		return -1;
+	}
+
+	SPI0_CS_LOW();
+	spi0WriteByte(page);
+	spi0WriteByte(reg);
+	spi0WriteByte(val);
+	SPI0_CS_HIGH();
 
+	spi0ShadowUpdate(page, reg, &val, 1);
+	spi0Release(SavedInterruptStatus);
+	return 0;
+}
 
 
-int SPI0ReadPageRegByte(uint8_t page, uint8_t reg, volatile uint8_t *val)
+int SPI0WritePageRegByteExtended(uint8_t page, uint16_t reg, uint8_t val)
 {
-	uint8_t rxBuf[3];
-	uint8_t txBuf[3];
 	UBaseType_t SavedInterruptStatus;
 
-	if (SPI0inUse)
+	if (spi0Claim(&SavedInterruptStatus) == false)
 	{
 		return -1;
 	}
-	SavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
-	SPI0inUse = true;
 
-	txBuf[0] = page | 0x80;
-	txBuf[1] = reg;
-	txBuf[2] = 0xFF;
+	SPI0_CS_LOW();
+	spi0WriteByte(page | 0x40);
+	spi0WriteByte(reg & 0xFF);
+	spi0WriteByte((reg >> 8) & 0x07);
+	spi0WriteByte(val);
+	SPI0_CS_HIGH();
 
-	SPI0Read(txBuf, rxBuf, 3);
+	// Extended (page | 0x40) registers aren't the configuration registers, they're not shadowed
+	spi0Release(SavedInterruptStatus);
+	return 0;
+}
 
-	*val = rxBuf[2];
+int SPI0ReadPageRegByte(uint8_t page, uint8_t reg, volatile uint8_t *val)
+{
+	UBaseType_t SavedInterruptStatus;
 
-	SPI0inUse = false;
-	taskEXIT_CRITICAL_FROM_ISR(SavedInterruptStatus);
+	if (spi0Claim(&SavedInterruptStatus) == false)
+	{
+		return -1;
+	}
+
+	SPI0_CS_LOW();
+	spi0WriteByte(page | 0x80);
+	spi0WriteByte(reg);
+	*val = spi0TransferByte(0xFF);
+	SPI0_CS_HIGH();
 
+	spi0Release(SavedInterruptStatus);
 	return 0;
 }
 
@@ -144,133 +265,151 @@ int SPI0ClearPageRegByteWithMask(uint8_t page, uint8_t reg, uint8_t mask, uint8_
 	return status;
 }
 
+// Burst write: the C6000 increments the register address, a page range is written in one transaction,
+// straight from the values buffer.
 int SPI0WritePageRegByteArray(uint8_t page, uint8_t reg, const uint8_t *values, uint8_t length)
 {
-	const int SPI0_PAGE_WRITE_BUFFER_SIZE = 128 + 2;
-	uint8_t txBuf[SPI0_PAGE_WRITE_BUFFER_SIZE + 2];
 	UBaseType_t SavedInterruptStatus;
 
-	if (length > SPI0_PAGE_WRITE_BUFFER_SIZE)
+	if (spi0Claim(&SavedInterruptStatus) == false)
 	{
-		return kStatus_InvalidArgument;
+		return -1;
 	}
 
-	if (SPI0inUse)
+	SPI0_CS_LOW();
+	spi0WriteByte(page);
+	spi0WriteByte(reg);
+	for (int i = 0; i < length; i++)
 	{
-		return -1;
+		spi0WriteByte(values[i]);
 	}
+	SPI0_CS_HIGH();
 
-	SavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
-	SPI0inUse = true;
-
-	txBuf[0] = page;
-	txBuf[1] = reg;
-	memcpy(txBuf + 2, values, length);
-
-	SPI0Write(txBuf, length + 2);
-
-	SPI0inUse = false;
-	taskEXIT_CRITICAL_FROM_ISR(SavedInterruptStatus);
+	spi0ShadowUpdate(page, reg, values, length);
+	spi0Release(SavedInterruptStatus);
 	return 0;
 }
 
+// Burst read of a page range, in one transaction
 int SPI0ReadPageRegByteArray(uint8_t page, uint8_t reg, volatile uint8_t *values, uint8_t length)
 {
-	uint8_t rxBuf[0x60 + 2];
-	uint8_t txBuf[0x60 + 2];
 	UBaseType_t SavedInterruptStatus;
 
-	if (length > 0x60)
+	if (spi0Claim(&SavedInterruptStatus) == false)
 	{
-		return kStatus_InvalidArgument;
+		return -1;
 	}
 
-	if (SPI0inUse)
+	SPI0_CS_LOW();
+	spi0WriteByte(page | 0x80);
+	spi0WriteByte(reg);
+	for (int i = 0; i < length; i++)
 	{
-		return -1;
+		values[i] = spi0TransferByte(0xFF);
 	}
-	SavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
-	SPI0inUse = true;
+	SPI0_CS_HIGH();
 
-	txBuf[0] = page | 0x80;
-	txBuf[1] = reg;
+	spi0Release(SavedInterruptStatus);
+	return 0;
+}
 
-	SPI0Read(txBuf, rxBuf, length + 2);
+// Writes a list of { register, value } of the same page. Like the single writes, the interrupts are only
+// masked for each register write, not for the whole list (the init lists are long).
+int SPI0WritePageRegByteList(uint8_t page, const uint8_t regValues[][2], uint8_t length)
+{
+	UBaseType_t SavedInterruptStatus;
 
 	for (int i = 0; i < length; i++)
 	{
-		values[i] = rxBuf[i + 2];
-	}
+		if (spi0Claim(&SavedInterruptStatus) == false)
+		{
+			return -1;
+		}
 
+		SPI0_CS_LOW();
+		spi0WriteByte(page);
+		spi0WriteByte(regValues[i][0]);
+		spi0WriteByte(regValues[i][1]);
+		SPI0_CS_HIGH();
+
+		spi0ShadowUpdate(page, regValues[i][0], &regValues[i][1], 1);
+		spi0Release(SavedInterruptStatus);
+	}
 
-	SPI0inUse = false;
-	taskEXIT_CRITICAL_FROM_ISR(SavedInterruptStatus);
 	return 0;
 }
 
-void SPI0Write(uint8_t *txBuf, uint8_t length)
+// Gets the last value written to a configuration register, false if it's unknown
+bool SPI0ShadowGet(uint8_t page, uint8_t reg, uint8_t *val)
 {
-	uint8_t val;
+	int index = SPI0_SHADOW_PAGE_INDEX(page);
 
-	//Set the CS pin Low
-	HAL_GPIO_WritePin(DMR_SPI_CS_GPIO_Port,DMR_SPI_CS_Pin, GPIO_PIN_RESET);
-	for(int v = 0; v < length; v++)
+	if ((index < 0) || ((spi0ShadowValid[index][reg >> 5] & (1U << (reg & 0x1F))) == 0))
 	{
-		val = txBuf[v];
-		for (register int i = 0; i < 8; i++)
-		{
-			HAL_GPIO_WritePin(DMR_SPI_MOSI_GPIO_Port, DMR_SPI_MOSI_Pin, ((val & 0x80) != 0));
+		return false;
+	}
 
-#ifdef SPI_0_DELAYS
-			for(volatile int x=0;x<1;x++);
-#endif
+	*val = spi0Shadow[index][reg];
+	return true;
+}
 
-			HAL_GPIO_WritePin(DMR_SPI_CLK_GPIO_Port, DMR_SPI_CLK_Pin, GPIO_PIN_RESET);
-#ifdef SPI_0_DELAYS
-			for(volatile int x=0;x<1;x++);
-#endif
+// The C6000 registers content is lost (reset, power down)
+void SPI0ShadowInvalidate(void)
+{
+	UBaseType_t SavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
 
-			val = val << 1;
-			HAL_GPIO_WritePin(DMR_SPI_CLK_GPIO_Port, DMR_SPI_CLK_Pin, GPIO_PIN_SET);
+	memset(spi0ShadowValid, 0, sizeof(spi0ShadowValid));
+	taskEXIT_CRITICAL_FROM_ISR(SavedInterruptStatus);
+}
 
-#ifdef SPI_0_DELAYS
-			for(volatile int x=0;x<1;x++);
-#endif
-		}
+// Raw transfers, not reflected in the shadow
+void SPI0Write(uint8_t *txBuf, uint8_t length)
+{
+	SPI0_CS_LOW();
+	for (int v = 0; v < length; v++)
+	{
+		spi0WriteByte(txBuf[v]);
 	}
-
-	//Set the CS pin high again
-	HAL_GPIO_WritePin(DMR_SPI_CS_GPIO_Port, DMR_SPI_CS_Pin, GPIO_PIN_SET);
+	SPI0_CS_HIGH();
 }
 
 void SPI0Read(uint8_t *txBuf, uint8_t *rxBuf, uint8_t length)
 {
-	uint8_t val;
-	uint8_t rxval;
+	SPI0_CS_LOW();
+	for (int v = 0; v < length; v++)
+	{
+		rxBuf[v] = spi0TransferByte(txBuf[v]);
+	}
+	SPI0_CS_HIGH();
+}
 
-	//Set the CS pin Low
-	HAL_GPIO_WritePin(DMR_SPI_CS_GPIO_Port,DMR_SPI_CS_Pin, GPIO_PIN_RESET);
+// Called on each C6000 timeslot interrupt, accounts the time spent on both buses since the previous one.
+void SPIBusTimeslotTick(void)
+{
+	uint32_t now = runTimeStatsGetCycles();
+	uint32_t busCycles;
+	UBaseType_t SavedInterruptStatus = taskENTER_CRITICAL_FROM_ISR();
 
-	for(int v = 0; v < length; v++)
-	{
-		val = txBuf[v];
-		rxval = 0;
-		for (register int i = 0; i < 8; i++)
-		{
-			HAL_GPIO_WritePin(DMR_SPI_MOSI_GPIO_Port, DMR_SPI_MOSI_Pin, ((val & 0x80) != 0));
-			HAL_GPIO_WritePin(DMR_SPI_CLK_GPIO_Port, DMR_SPI_CLK_Pin, GPIO_PIN_RESET);
-			val = val << 1;
-			rxval = (rxval << 1) + (HAL_GPIO_ReadPin(DMR_SPI_MISO_GPIO_Port, DMR_SPI_MISO_Pin) != 0);
-			HAL_GPIO_WritePin(DMR_SPI_CLK_GPIO_Port, DMR_SPI_CLK_Pin, GPIO_PIN_SET);
+	busCycles = spiBusCycles;
+	spiBusCycles = 0U;
+	taskEXIT_CRITICAL_FROM_ISR(SavedInterruptStatus);
 
-		}
-		rxBuf[v] = rxval;
+	if ((spiBusTimeslotStartCycles != 0U) && (runTimeStatsCyclesToMicroseconds(now - spiBusTimeslotStartCycles) < SPI_BUS_TIMESLOT_MAX_US))
+	{
+		spiBusStats.timeslots++;
+		spiBusStats.lastTimeslotUs = runTimeStatsCyclesToMicroseconds(busCycles);
+		spiBusStats.maxTimeslotUs = ((spiBusStats.lastTimeslotUs > spiBusStats.maxTimeslotUs) ? spiBusStats.lastTimeslotUs : spiBusStats.maxTimeslotUs);
+		spiBusTotalCycles += busCycles;
+		spiBusStats.meanTimeslotUs = runTimeStatsCyclesToMicroseconds((uint32_t)(spiBusTotalCycles / spiBusStats.timeslots));
 	}
 
-	//Set the CS pin high again
-	HAL_GPIO_WritePin(DMR_SPI_CS_GPIO_Port,DMR_SPI_CS_Pin, GPIO_PIN_SET);
+	spiBusTimeslotStartCycles = now;
 }
 
+const spiBusStats_t *SPIGetBusStats(void)
+{
+	return &spiBusStats;
+}
 
 int SPI1WritePageRegByteArray(uint8_t page, uint8_t reg, const uint8_t *values, uint8_t length)
 {
@@ -294,9 +433,11 @@ int SPI1WritePageRegByteArray(uint8_t page, uint8_t reg, const uint8_t *values,
 	txBuf[1] = reg;
 	memcpy(txBuf + 2, values, length);
 
+	uint32_t startCycles = runTimeStatsGetCycles();
 	HAL_GPIO_WritePin(V_SPI_CS_GPIO_Port, V_SPI_CS_Pin, GPIO_PIN_RESET);
 	status = HAL_SPI_Transmit(&hspi2, txBuf, length + 2, HAL_MAX_DELAY);
 	HAL_GPIO_WritePin(V_SPI_CS_GPIO_Port, V_SPI_CS_Pin, GPIO_PIN_SET);
+	spiBusAccount(startCycles);
 
 	SPI1inUse = false;
 
@@ -325,9 +466,11 @@ int SPI1ReadPageRegByteArray(uint8_t page, uint8_t reg, volatile uint8_t *values
 	txBuf[0] = page | 0x80;
 	txBuf[1] = reg;
 
+	uint32_t startCycles = runTimeStatsGetCycles();
 	HAL_GPIO_WritePin(V_SPI_CS_GPIO_Port, V_SPI_CS_Pin, GPIO_PIN_RESET);
 	status = HAL_SPI_TransmitReceive(&hspi2, txBuf, rxBuf, length + 2, HAL_MAX_DELAY);
 	HAL_GPIO_WritePin(V_SPI_CS_GPIO_Port, V_SPI_CS_Pin, GPIO_PIN_SET);
+	spiBusAccount(startCycles);
 
 	if (status == HAL_OK)
 	{
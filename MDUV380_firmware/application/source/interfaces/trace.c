@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include "main.h"
+#include "interfaces/trace.h"
+
+#if defined(USING_TRACE)
+
+#include "SeggerRTT/RTT/SEGGER_RTT.h"
+#include "interfaces/runTimeStats.h"
+
+//
+// The DWT cycles counter is enabled by runTimeStatsTimerInit(), when the scheduler starts
+// (the host build counts the elapsed time instead).
+// SEGGER_RTT_LOCK() masks the HR-C6000 interrupts (BASEPRI), so events from the ISRs and the tasks
+// are written in order.
+//
+static uint8_t traceBuffer[TRACE_RTT_BUFFER_SIZE];
+static uint16_t traceSequence = 0;
+static volatile bool traceEnabled = false;
+
+
+void traceInit(void)
+{
+	SEGGER_RTT_ConfigUpBuffer(TRACE_RTT_CHANNEL, "Trace", traceBuffer, sizeof(traceBuffer), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+	traceEnabled = true;
+
+	traceClockHasChanged();
+}
+
+void traceEvent(uint8_t id, uint8_t type)
+{
+	traceEvent_t event;
+
+	if (traceEnabled == false)
+	{
+		return;
+	}
+
+	SEGGER_RTT_LOCK();
+	event.cycles = runTimeStatsGetCycles();
+	event.sequence = traceSequence++;
+	event.id = id;
+	event.type = type;
+	SEGGER_RTT_WriteNoLock(TRACE_RTT_CHANNEL, &event, sizeof(event));
+	SEGGER_RTT_UNLOCK();
+}
+
+// The host converts the cycles using the last known core clock.
+void traceClockHasChanged(void)
+{
+	traceEvent((uint8_t)(SystemCoreClock / 1000000U), TRACE_EVENT_CLOCK);
+}
+
+#endif
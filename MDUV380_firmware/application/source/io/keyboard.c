@@ -34,6 +34,7 @@
 #include "interfaces/gpio.h"
 #include "interfaces/adc.h"
 #include "io/buttons.h"
+#include "functions/eventBus.h"
 
 // Keyboard Keys
 typedef struct
@@ -68,6 +69,9 @@ volatile rotaryData_t rotaryData =
 		.Direction = 0
 };
 
+// Steps received from the event bus (EVENT_BUS_ROTARY), one is given per keyboardCheckKeyEvent() call
+static int32_t rotaryPendingSteps = 0;
+
 enum KEY_STATE
 {
 	KEY_IDLE = 0,
@@ -334,6 +338,16 @@ bool keyboardKeyIsDTMFKey(char key)
 	return false;
 }
 
+void keyboardRotaryStep(int8_t direction)
+{
+	rotaryPendingSteps += direction;
+}
+
+bool keyboardRotaryHasPendingSteps(void)
+{
+	return (rotaryPendingSteps != 0);
+}
+
 void rotaryEncoderISR(void)
 {
 	GPIO_PinState pinA = HAL_GPIO_ReadPin(ROTARY_SW_A_GPIO_Port, ROTARY_SW_A_Pin);
@@ -344,6 +358,8 @@ void rotaryEncoderISR(void)
 		rotaryData.lastB = pinB;
 		rotaryData.Direction = ((pinA == pinB) ? -1 : 1);
 		rotaryData.Count += rotaryData.Direction;
+
+		eventBusPost(EVENT_BUS_ROTARY, (uint8_t)rotaryData.Direction);
 	}
 }
 
@@ -361,12 +377,13 @@ void keyboardCheckKeyEvent(keyboardCode_t *keys, int *event)
 	keys->event = 0;
 	keys->key = KEY_NONE;
 
-	if (rotaryData.Direction != 0)
+	if (rotaryPendingSteps != 0)
 	{
-		keys->key = (rotaryData.Direction == 1) ? KEY_ROTARY_INCREMENT : KEY_ROTARY_DECREMENT;
+		keys->key = (rotaryPendingSteps > 0) ? KEY_ROTARY_INCREMENT : KEY_ROTARY_DECREMENT;
 		keys->event = KEY_MOD_UP | KEY_MOD_PRESS; // Hack send both Up and Down events because the menus use KEY_MOD_PRESS but the VFO uses KEY_MOD_UP
 		*event = EVENT_KEY_CHANGE;
-		rotaryData.Direction = 0;
+		rotaryPendingSteps += ((rotaryPendingSteps > 0) ? -1 : 1);
+		rotaryData.Direction = 0; // Still read by the hardware test screen
 		return;
 	}
 	else
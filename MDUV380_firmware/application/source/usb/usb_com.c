@@ -43,6 +43,10 @@
 #include <interfaces/clockManager.h>
 #include "interfaces/settingsStorage.h"
 #include "interfaces/gps.h"
+#include "interfaces/gpsTrackLog.h"
+#include "interfaces/runTimeStats.h"
+#include "interfaces/crc.h"
+#include "functions/eventBus.h"
 
 #define GITVERSIONREV GITVERSION
 
@@ -57,9 +61,80 @@ enum CPS_ACCESS_AREA
 	CPS_ACCESS_RADIO_INFO = 9,
 #if ! defined(CPU_MK22FN512VLL12)
 	CPS_ACCESS_FLASH_SECURITY_REGISTERS = 10,
+#endif
+	CPS_ACCESS_RUN_TIME_STATS = 11,
+#if defined(HAS_GPS) && defined(LOG_GPS_DATA)
+	// GPS track log, streamed as text: the address is the position in the stream (0 restarts it),
+	// a reply shorter than the requested length is the end of the stream.
+	CPS_ACCESS_GPS_TRACK_LOG_GPX = 12,
+	CPS_ACCESS_GPS_TRACK_LOG_NMEA = 13,
 #endif
 };
 
+//
+// Run time statistics (CPS_ACCESS_RUN_TIME_STATS)
+//
+// Reply: structVersion(4), then one block per subsystem: id(1), version(1), length(2), data[length] (little endian).
+// Each block has its own version, bumped when its layout changes, unknown blocks are skipped using their length.
+// The request address is a mask of the wanted blocks (1 << id), 0 for all of them. The blocks which don't fit
+// in the requested length are left out.
+//
+#define CPS_RUN_TIME_STATS_STRUCT_VERSION      0x0D
+#define CPS_RUN_TIME_STATS_BLOCK_HEADER_SIZE   4
+
+enum CPS_RUN_TIME_STATS_BLOCK
+{
+	CPS_RUN_TIME_STATS_BLOCK_CLOCK_SPEED = 0,    // clock speed setting (4)
+	CPS_RUN_TIME_STATS_BLOCK_TASKS,              // per task CPU usage (since the previous request), stack high water marks, idle percentage
+	CPS_RUN_TIME_STATS_BLOCK_RETUNE,
+	CPS_RUN_TIME_STATS_BLOCK_PTT_LATENCY,        // PTT to first AMBE frame
+	CPS_RUN_TIME_STATS_BLOCK_HOTSPOT_USB_TX,
+	CPS_RUN_TIME_STATS_BLOCK_HOTSPOT_JITTER,
+	CPS_RUN_TIME_STATS_BLOCK_MAIN_LOOP,          // loop rate and events latency
+	CPS_RUN_TIME_STATS_BLOCK_CHANNELS_CACHE,
+	CPS_RUN_TIME_STATS_BLOCK_CLOCK_GOVERNOR,     // levels residency
+	CPS_RUN_TIME_STATS_BLOCK_C6000_BUS,          // SPI bus time per timeslot
+	CPS_RUN_TIME_STATS_BLOCK_C6000_SCRIPTS,
+	CPS_RUN_TIME_STATS_BLOCK_SPI_FLASH           // cache and writes stall
+};
+
+//
+// Pipelined transfers ('P' command)
+//
+// Request: 'P', op, sequence(2), address(4), length(2), CRC32 of the payload(4), payload[length] (none for read)
+// Reply:   'P', op, sequence(2), status, length(2), data[length], CRC32 of the data(4)
+// (all values are big endian)
+//
+// Each request is replied once handled, but the host doesn't have to wait for the reply to send the next ones:
+// the USB OUT endpoint is held (NAK) meanwhile, so the requests queue up on the host side.
+// The sequence numbers have to be consecutive, starting from the one given with CPS_PIPELINE_OP_OPEN.
+// Firmwares without this support reply '-' to CPS_PIPELINE_OP_OPEN.
+//
+#define CPS_PIPELINE_PROTOCOL_VERSION      2
+#define CPS_PIPELINE_HEADER_SIZE           14
+#define CPS_PIPELINE_REPLY_HEADER_SIZE     7
+#define CPS_PIPELINE_MAX_DATA_LENGTH       1024
+#define CPS_PIPELINE_MAX_DIGEST_RANGES     128
+#define CPS_PIPELINE_DIGEST_CHUNK_SIZE     512 // the calibration and the VFOs fit in a single aligned chunk
+
+enum CPS_PIPELINE_OP
+{
+	CPS_PIPELINE_OP_OPEN = 0,          // (re)start the sequence numbering, replies version(1) + max data length(2)
+	CPS_PIPELINE_OP_WRITE_FLASH = 1,   // data can't cross a sector boundary, the sector is written when another one is addressed
+	CPS_PIPELINE_OP_COMMIT = 2,        // write the pending sector, replies erased(2) + programmed only(2) + unchanged(2) sectors counters
+	CPS_PIPELINE_OP_READ_FLASH = 3,
+	CPS_PIPELINE_OP_DIGEST = 4         // (version 2) data is a list of address(4) + length(4) ranges, replies a CRC32(4) for each of them
+};
+
+enum CPS_PIPELINE_STATUS
+{
+	CPS_PIPELINE_STATUS_OK = 0,
+	CPS_PIPELINE_STATUS_SEQUENCE_ERROR,
+	CPS_PIPELINE_STATUS_CRC_ERROR,
+	CPS_PIPELINE_STATUS_BAD_REQUEST,
+	CPS_PIPELINE_STATUS_FLASH_ERROR
+};
+
 
 #if defined(PLATFORM_GD77) || defined(PLATFORM_GD77S) || defined(PLATFORM_DM1801) || defined(PLATFORM_DM1801A) || defined(PLATFORM_RD5R)
 #define TASK_LOCK_WRITE()	  do { } while(0)
@@ -79,12 +154,20 @@ volatile uint8_t com_requestbuffer[COM_REQUESTBUFFER_SIZE];
 volatile uint8_t usbComSendBuf[COM_BUFFER_SIZE];
 
 static int sector = -1;
-volatile int comRecvMMDVMIndexIn = 0;
-volatile int comRecvMMDVMIndexOut = 0;
-volatile int comRecvMMDVMFrameCount = 0;
 static bool flashingDMRIDs = false;
 static bool channelsRewritten = false;
 static bool luczRewritten = false;
+static uint16_t sectorModifiedPages = 0; // one bit per page of the sector buffer which differs from the Flash content
+static bool sectorNeedsErase = false; // some bits have to go from 0 to 1
+static bool calibrationPending = false;
+static bool pipelineIsOpen = false;
+static uint16_t pipelineNextSequence = 0;
+static struct
+{
+	uint16_t erased;
+	uint16_t programmedOnly;
+	uint16_t unchanged;
+} sectorWriteStats;
 #if defined(HAS_GPS)
 static gpsMode_t previousGPSState = GPS_NOT_DETECTED;
 #endif
@@ -114,21 +197,51 @@ static bool addressInSegment(uint32_t address, uint32_t length, uint32_t segment
 	return ((address >= segmentStart) && ((address + length) <= (segmentStart + segmentSize)));
 }
 
+static bool addressOverlapsSegment(uint32_t address, uint32_t length, uint32_t segmentStart, uint32_t segmentSize)
+{
+	return ((address < (segmentStart + segmentSize)) && ((address + length) > segmentStart));
+}
+
+// Called on each CPS write (both paths): any channel record write makes the decoded channels cache stale,
+// as any settings or VFOs write does for the backup SRAM copy, which is discarded
+static void cpsInvalidateCachesForWrite(uint32_t address, uint32_t length)
+{
+	if (addressOverlapsSegment(address, length, CODEPLUG_ADDR_CHANNEL_HEADER_EEPROM, 0x1C10 /*128 first channels*/) ||
+			addressOverlapsSegment(address, length, (FLASH_ADDRESS_OFFSET + CODEPLUG_ADDR_CHANNEL_HEADER_FLASH),
+					((CODEPLUG_CHANNELS_BANKS_MAX - 1) * ((CODEPLUG_CHANNELS_PER_BANK * CODEPLUG_CHANNEL_DATA_STRUCT_SIZE) + 16))))
+	{
+		codeplugChannelCacheInvalidate();
+	}
+
+	// The emulated EEPROM sits at the start of the flash, so the same address is checked for both write paths
+	if (addressOverlapsSegment(address, length, SETTINGS_STORAGE_ADDRESS, sizeof(settingsStruct_t)) ||
+			addressOverlapsSegment(address, length, CODEPLUG_ADDR_VFO_A_CHANNEL, SETTINGS_STORAGE_VFOS_SIZE))
+	{
+		settingsStorageDiscardBackup(); // Don't let unflushed settings or VFOs override the CPS ones on next boot
+	}
+}
+
 void tick_com_request(void)
 {
 	switch (settingsUsbMode)
 	{
 		case USB_MODE_CPS:
-			if (com_request == 1)
+			if ((com_request == 1) || hasToReply)
 			{
 				TASK_LOCK_WRITE();
-				handleCPSRequest();
-				com_request = 0;
-				if (hasToReply)
+				if ((com_request == 1) && (hasToReply == false))
+				{
+					handleCPSRequest();
+					com_request = 0;
+				}
+
+				// When the host is pipelining its requests, the previous reply could still be in transmission,
+				// retry on next tick. Nothing more will be received until this reply is sent.
+				if ((hasToReply == false) || (CDC_Transmit_FS((uint8_t *) usbComSendBuf, replyLength) != USBD_BUSY))
 				{
-					CDC_Transmit_FS((uint8_t *) usbComSendBuf, replyLength);
 					hasToReply = false;
 					replyLength = 0;
+					CDC_ResumeReceive_FS();
 				}
 				TASK_UNLOCK_WRITE();
 			}
@@ -141,6 +254,11 @@ void tick_com_request(void)
 			{
 				com_request = 0;
 
+				// A CPS request could have been pending while switching mode
+				TASK_LOCK_WRITE();
+				CDC_ResumeReceive_FS();
+				TASK_UNLOCK_WRITE();
+
 				if ((nonVolatileSettings.hotspotType != HOTSPOT_TYPE_OFF) &&
 						((comRecvMMDVMFrameCount >= 1) && (com_requestbuffer[1] == MMDVM_FRAME_START)) &&
 						(uiDataGlobal.dmrDisabled == false)) // DMR (digital) is disabled.
@@ -156,6 +274,64 @@ void tick_com_request(void)
 	}
 }
 
+// Appends a run time statistics block, if it's wanted and fits. Returns the new length.
+static uint32_t cpsRunTimeStatsAddBlock(uint8_t *dest, uint32_t length, uint32_t maxLength, uint32_t mask,
+		uint8_t id, uint8_t version, const void *data, uint16_t dataLength)
+{
+	if (((mask != 0) && ((mask & (1U << id)) == 0)) || ((length + CPS_RUN_TIME_STATS_BLOCK_HEADER_SIZE + dataLength) > maxLength))
+	{
+		return length;
+	}
+
+	dest[length] = id;
+	dest[length + 1] = version;
+	dest[length + 2] = (dataLength & 0xFF);
+	dest[length + 3] = (dataLength >> 8);
+	memcpy(&dest[length + CPS_RUN_TIME_STATS_BLOCK_HEADER_SIZE], data, dataLength);
+
+	return (length + CPS_RUN_TIME_STATS_BLOCK_HEADER_SIZE + dataLength);
+}
+
+static bool cpsFlashRead(uint32_t address, uint8_t *dest, uint32_t length)
+{
+	bool result = false;
+
+	// Calibration register, returns local copy
+	if (addressInSegment(address, length, 0x10000, 0x200))
+	{
+		uint8_t *p = calibrationGetLocalDataPointer();
+		memcpy(dest, (p + (address - 0x10000)), length);
+		result = true;
+	}
+	else
+	{
+		TASK_UNLOCK_WRITE();
+		result = SPI_Flash_read(address, dest, length);
+		uint32_t end = address + length - 1;
+		const uint32_t VFOs_END = CODEPLUG_ADDR_VFO_A_CHANNEL + (sizeof(struct_codeplugChannel_t) * 2);
+
+		// if CPS is writing the second part of the EEPROM (emulated in Flash) then the VFO's are being updated.
+		if ((address <= CODEPLUG_ADDR_VFO_A_CHANNEL) && (end  >= VFOs_END))
+		{
+			uint32_t offset = CODEPLUG_ADDR_VFO_A_CHANNEL - address;
+
+			struct_codeplugChannel_t * destPtr = (struct_codeplugChannel_t *)&dest[offset];
+
+			memcpy((uint8_t *)destPtr, (uint8_t *)&settingsVFOChannel[0], CODEPLUG_CHANNEL_DATA_STRUCT_SIZE);
+			codeplugConvertChannelInternalToCodeplug(destPtr, destPtr);
+
+			destPtr = (struct_codeplugChannel_t *)&dest[offset + CODEPLUG_CHANNEL_DATA_STRUCT_SIZE];
+
+			memcpy((uint8_t *)destPtr, (uint8_t *)&settingsVFOChannel[1], CODEPLUG_CHANNEL_DATA_STRUCT_SIZE);
+			codeplugConvertChannelInternalToCodeplug(destPtr, destPtr);
+		}
+
+		TASK_LOCK_WRITE();
+	}
+
+	return result;
+}
+
 static void cpsHandleReadCommand(void)
 {
 	uint32_t address = (com_requestbuffer[2] << 24) + (com_requestbuffer[3] << 16) + (com_requestbuffer[4] << 8) + (com_requestbuffer[5] << 0);
@@ -170,40 +346,7 @@ static void cpsHandleReadCommand(void)
 	switch(com_requestbuffer[1])
 	{
 		case CPS_ACCESS_FLASH:
-		{
-			// Calibration register, returns local copy
-			if (addressInSegment(address, length, 0x10000, 0x200))
-			{
-				uint8_t *p = calibrationGetLocalDataPointer();
-				memcpy((uint8_t *)&usbComSendBuf[3], (p + (address - 0x10000)), length);
-				result = true;
-			}
-			else
-			{
-				TASK_UNLOCK_WRITE();
-				result = SPI_Flash_read(address, (uint8_t *)&usbComSendBuf[3], length);
-				uint32_t end = address + length - 1;
-				const uint32_t VFOs_END = CODEPLUG_ADDR_VFO_A_CHANNEL + (sizeof(struct_codeplugChannel_t) * 2);
-
-				// if CPS is writing the second part of the EEPROM (emulated in Flash) then the VFO's are being updated.
-				if ((address <= CODEPLUG_ADDR_VFO_A_CHANNEL) && (end  >= VFOs_END))
-				{
-					uint32_t offset = CODEPLUG_ADDR_VFO_A_CHANNEL - address;
-
-					struct_codeplugChannel_t * destPtr = (struct_codeplugChannel_t *)&usbComSendBuf[3 + offset];
-
-					memcpy((uint8_t *)destPtr, (uint8_t *)&settingsVFOChannel[0], CODEPLUG_CHANNEL_DATA_STRUCT_SIZE);
-					codeplugConvertChannelInternalToCodeplug(destPtr, destPtr);
-
-					destPtr = (struct_codeplugChannel_t *)&usbComSendBuf[3 + offset + CODEPLUG_CHANNEL_DATA_STRUCT_SIZE];
-
-					memcpy((uint8_t *)destPtr, (uint8_t *)&settingsVFOChannel[1], CODEPLUG_CHANNEL_DATA_STRUCT_SIZE);
-					codeplugConvertChannelInternalToCodeplug(destPtr, destPtr);
-				}
-
-				TASK_LOCK_WRITE();
-			}
-			}
+			result = cpsFlashRead(address, (uint8_t *)&usbComSendBuf[3], length);
 			break;
 
 		case CPS_ACCESS_EEPROM:
@@ -227,10 +370,10 @@ static void cpsHandleReadCommand(void)
 			}
 			else
 			{
-				memcpy((uint8_t *)&usbComSendBuf[3], (uint8_t *)displayGetPrimaryScreenBuffer() + address - (DISPLAY_Y_OFFSET * DISPLAY_SIZE_X * 2), length);
+				displayCopyPrimaryScreenBufferNative((uint8_t *)&usbComSendBuf[3], (address - (DISPLAY_Y_OFFSET * DISPLAY_SIZE_X * 2)), length);
 			}
 #else
-			memcpy((uint8_t *)&usbComSendBuf[3], (uint8_t *)displayGetPrimaryScreenBuffer() + address, length);
+			displayCopyPrimaryScreenBufferNative((uint8_t *)&usbComSendBuf[3], address, length);
 #endif
 			result = true;
 			break;
@@ -308,6 +451,66 @@ static void cpsHandleReadCommand(void)
 			TASK_LOCK_WRITE();
 			break;
 #endif
+
+		case CPS_ACCESS_RUN_TIME_STATS:
+			{
+				uint8_t *dest = (uint8_t *)&usbComSendBuf[3];
+				uint32_t maxLength = length;
+				uint32_t clockSpeedSetting = clockManagerGetRunMode();
+				eventBusStats_t mainLoop;
+
+				if (maxLength < sizeof(uint32_t))
+				{
+					break;
+				}
+
+				// The tasks usage window restarts on each update
+				if ((address == 0) || (address & (1U << CPS_RUN_TIME_STATS_BLOCK_TASKS)))
+				{
+					runTimeStatsUpdate(RUN_TIME_STATS_WINDOW_CPS);
+				}
+
+				eventBusGetStats(&mainLoop);
+
+				dest[0] = CPS_RUN_TIME_STATS_STRUCT_VERSION;
+				dest[1] = dest[2] = dest[3] = 0;
+				length = sizeof(uint32_t);
+
+				length = cpsRunTimeStatsAddBlock(dest, length, maxLength, address, CPS_RUN_TIME_STATS_BLOCK_CLOCK_SPEED, 1, &clockSpeedSetting, sizeof(uint32_t));
+				length = cpsRunTimeStatsAddBlock(dest, length, maxLength, address, CPS_RUN_TIME_STATS_BLOCK_TASKS, 1, runTimeStatsGet(RUN_TIME_STATS_WINDOW_CPS), sizeof(runTimeStats_t));
+				length = cpsRunTimeStatsAddBlock(dest, length, maxLength, address, CPS_RUN_TIME_STATS_BLOCK_RETUNE, 1, trxGetRetuneStats(), sizeof(trxRetuneStats_t));
+				length = cpsRunTimeStatsAddBlock(dest, length, maxLength, address, CPS_RUN_TIME_STATS_BLOCK_PTT_LATENCY, 1, codecGetLatencyStats(), sizeof(codecLatencyStats_t));
+				length = cpsRunTimeStatsAddBlock(dest, length, maxLength, address, CPS_RUN_TIME_STATS_BLOCK_HOTSPOT_USB_TX, 1, hotspotGetUSBTxStats(), sizeof(hotspotUSBTxStats_t));
+				length = cpsRunTimeStatsAddBlock(dest, length, maxLength, address, CPS_RUN_TIME_STATS_BLOCK_HOTSPOT_JITTER, 1, hotspotGetJitterStats(), sizeof(hotspotJitterStats_t));
+				length = cpsRunTimeStatsAddBlock(dest, length, maxLength, address, CPS_RUN_TIME_STATS_BLOCK_MAIN_LOOP, 1, &mainLoop, sizeof(eventBusStats_t));
+				length = cpsRunTimeStatsAddBlock(dest, length, maxLength, address, CPS_RUN_TIME_STATS_BLOCK_CHANNELS_CACHE, 1, codeplugChannelCacheGetStats(), sizeof(codeplugChannelCacheStats_t));
+				length = cpsRunTimeStatsAddBlock(dest, length, maxLength, address, CPS_RUN_TIME_STATS_BLOCK_CLOCK_GOVERNOR, 1, clockManagerGovernorGetStats(), sizeof(clockManagerGovernorStats_t));
+				length = cpsRunTimeStatsAddBlock(dest, length, maxLength, address, CPS_RUN_TIME_STATS_BLOCK_C6000_BUS, 1, SPIGetBusStats(), sizeof(spiBusStats_t));
+				length = cpsRunTimeStatsAddBlock(dest, length, maxLength, address, CPS_RUN_TIME_STATS_BLOCK_C6000_SCRIPTS, 1, HRC6000GetScriptStats(), sizeof(hrc6000ScriptStats_t));
+				length = cpsRunTimeStatsAddBlock(dest, length, maxLength, address, CPS_RUN_TIME_STATS_BLOCK_SPI_FLASH, 1, SPI_Flash_getStats(), sizeof(spiFlashStats_t));
+				result = true;
+			}
+			break;
+
+#if defined(HAS_GPS) && defined(LOG_GPS_DATA)
+		case CPS_ACCESS_GPS_TRACK_LOG_GPX:
+		case CPS_ACCESS_GPS_TRACK_LOG_NMEA:
+			{
+				int exported;
+
+				TASK_UNLOCK_WRITE();
+				exported = gpsTrackLogExportRead(((com_requestbuffer[1] == CPS_ACCESS_GPS_TRACK_LOG_GPX) ? GPS_TRACK_LOG_EXPORT_GPX : GPS_TRACK_LOG_EXPORT_NMEA),
+						address, (uint8_t *)&usbComSendBuf[3], length);
+				TASK_LOCK_WRITE();
+
+				if (exported >= 0)
+				{
+					length = exported;
+					result = true;
+				}
+			}
+			break;
+#endif
 	}
 
 	hasToReply = true;
@@ -325,6 +528,199 @@ static void cpsHandleReadCommand(void)
 	}
 }
 
+// Load a sector from the Flash to the sector buffer, in order to be partially rewritten.
+static bool cpsFlashLoadSector(int newSector)
+{
+	bool ok;
+
+	sector = newSector;
+	sectorModifiedPages = 0;
+	sectorNeedsErase = false;
+
+	if ((sector * 4096) == 0x30000) // start address of DMRIDs DB
+	{
+		flashingDMRIDs = true;
+	}
+
+	TASK_UNLOCK_WRITE();
+	ok = SPI_Flash_read(sector * 4096, SPI_Flash_sectorbuffer, 4096);
+	TASK_LOCK_WRITE();
+
+	return ok;
+}
+
+// Store data into the sector buffer, keeping track of what really differs from the Flash content
+static void cpsSectorBufferWrite(uint32_t address, const uint8_t *data, uint32_t length)
+{
+	for (uint32_t i = 0; i < length; i++)
+	{
+		if (sector == (address + i) / 4096)
+		{
+			uint32_t offset = ((address + i) % 4096);
+			uint8_t previous = SPI_Flash_sectorbuffer[offset];
+
+			if (previous != data[i])
+			{
+				sectorModifiedPages |= (1U << (offset / 256));
+
+				// Programming can only clear bits
+				if ((previous & data[i]) != data[i])
+				{
+					sectorNeedsErase = true;
+				}
+
+				SPI_Flash_sectorbuffer[offset] = data[i];
+			}
+		}
+	}
+}
+
+static bool cpsFlashStageData(uint32_t address, uint32_t length, const uint8_t *data)
+{
+	bool calibrationWriting = false;
+
+	cpsInvalidateCachesForWrite(address, length);
+
+#if defined(PLATFORM_MD9600) || defined(PLATFORM_MDUV380) || defined(PLATFORM_MD380) || defined(PLATFORM_RT84_DM1701) || defined(PLATFORM_MD2017)
+	if ((calibrationWriting == false) && addressInSegment(address, length, 0x10000, 0x200)) // Local calibration
+	{
+		calibrationWriting = true;
+	}
+	// Channel is going to be rewritten, will need to reset current zone/etc...
+	else if ((channelsRewritten == false) && addressInSegment(address, length, CODEPLUG_ADDR_CHANNEL_HEADER_EEPROM, 0x1C10 /*128 first channels*/))
+	{
+		channelsRewritten = true;
+	}
+	else if ((luczRewritten == false) && addressInSegment(address, length, CODEPLUG_ADDR_LUCZ, (4 + CODEPLUG_ALL_ZONES_MAX + 1)))
+	{
+		luczRewritten = true;
+	}
+	else
+#endif
+#if !defined(PLATFORM_GD77S)
+	// Temporary hack to automatically set Prompt to Level 1
+	// A better solution will be added to the CPS and firmware at a later date.
+	if ((address == VOICE_PROMPTS_FLASH_HEADER_ADDRESS) || (address == VOICE_PROMPTS_FLASH_OLD_HEADER_ADDRESS))
+	{
+		uint32_t header[2];
+
+		memcpy(header, data, sizeof(header)); // data may not be word aligned
+		if (voicePromptsCheckMagicAndVersion(header))
+		{
+			nonVolatileSettings.audioPromptMode = AUDIO_PROMPT_MODE_VOICE_LEVEL_1;
+		}
+	}
+#endif
+
+#if defined(PLATFORM_MD9600) || defined(PLATFORM_MDUV380) || defined(PLATFORM_MD380) || defined(PLATFORM_RT84_DM1701) || defined(PLATFORM_MD2017)
+	// Temporary hack to prevent the QuickKeys getting overwritten by the codeplug
+	const int QUICKKEYS_BLOCK_END = (CODEPLUG_ADDR_QUICKKEYS + (CODEPLUG_QUICKKEYS_SIZE * sizeof(uint16_t)) - 1);
+	int end = (address + length) - 1;
+
+	if (((address >= CODEPLUG_ADDR_QUICKKEYS) && (address <= QUICKKEYS_BLOCK_END))
+			|| ((end >= CODEPLUG_ADDR_QUICKKEYS) && (end <= QUICKKEYS_BLOCK_END))
+			|| ((address < CODEPLUG_ADDR_QUICKKEYS) && (end > QUICKKEYS_BLOCK_END)))
+	{
+		if (address < CODEPLUG_ADDR_QUICKKEYS)
+		{
+			cpsSectorBufferWrite(address, data, (CODEPLUG_ADDR_QUICKKEYS - address));
+
+			if ((end > QUICKKEYS_BLOCK_END))
+			{
+				cpsSectorBufferWrite((QUICKKEYS_BLOCK_END + 1), &data[(QUICKKEYS_BLOCK_END + 1) - address], (end - QUICKKEYS_BLOCK_END));
+			}
+		}
+		else
+		{
+			if ((address <= QUICKKEYS_BLOCK_END) && (end > QUICKKEYS_BLOCK_END))
+			{
+				cpsSectorBufferWrite((QUICKKEYS_BLOCK_END + 1), &data[(QUICKKEYS_BLOCK_END + 1) - address], (end - QUICKKEYS_BLOCK_END));
+			}
+		}
+	}
+	else
+#endif
+	{
+#if defined(PLATFORM_MD9600) || defined(PLATFORM_MDUV380) || defined(PLATFORM_MD380) || defined(PLATFORM_RT84_DM1701) || defined(PLATFORM_MD2017)
+		if (calibrationWriting)
+		{
+			uint8_t *p = calibrationGetLocalDataPointer();
+
+			memcpy((p + (address - 0x10000)), data, length);
+			calibrationPending = true;
+			return true;
+		}
+#endif
+
+		cpsSectorBufferWrite(address, data, length);
+	}
+
+	return true;
+}
+
+// Write the sector buffer back to the Flash, if it has been modified.
+// The sector is only erased when some bits have to be set, otherwise the modified pages are just programmed.
+static bool cpsFlashCommitSector(void)
+{
+	bool ok = true;
+
+	if (sectorModifiedPages == 0)
+	{
+		sectorWriteStats.unchanged++;
+	}
+	else
+	{
+		if (sectorNeedsErase)
+		{
+			TASK_UNLOCK_WRITE();
+			ok = SPI_Flash_eraseSector(sector * 4096);
+			TASK_LOCK_WRITE();
+
+			sectorWriteStats.erased++;
+		}
+		else
+		{
+			sectorWriteStats.programmedOnly++;
+		}
+
+		for (int i = 0; (i < 16) && ok; i++)
+		{
+			bool hasToBeProgrammed;
+
+			if (sectorNeedsErase)
+			{
+				// Erased pages are already full of 0xFF
+				hasToBeProgrammed = false;
+				for (int j = 0; j < 256; j++)
+				{
+					if (SPI_Flash_sectorbuffer[(i * 256) + j] != 0xFF)
+					{
+						hasToBeProgrammed = true;
+						break;
+					}
+				}
+			}
+			else
+			{
+				hasToBeProgrammed = ((sectorModifiedPages & (1U << i)) != 0);
+			}
+
+			if (hasToBeProgrammed)
+			{
+				TASK_UNLOCK_WRITE();
+				ok = SPI_Flash_writePage(sector * 4096 + i * 256, SPI_Flash_sectorbuffer + i * 256);
+				TASK_LOCK_WRITE();
+			}
+		}
+	}
+
+	sectorModifiedPages = 0;
+	sectorNeedsErase = false;
+	sector = -1;
+
+	return ok;
+}
+
 static void cpsHandleWriteCommand(void)
 {
 	bool ok = false;
@@ -334,21 +730,16 @@ static void cpsHandleWriteCommand(void)
 		case 1: // Flash Prepare Sector
 			if (sector == -1)
 			{
-				sector = (com_requestbuffer[2] << 16) + (com_requestbuffer[3] << 8) + (com_requestbuffer[4] << 0);
+				int newSector = (com_requestbuffer[2] << 16) + (com_requestbuffer[3] << 8) + (com_requestbuffer[4] << 0);
 
-				if ((sector * 4096) == 0x10000) // Local calibration
+				if ((newSector * 4096) == 0x10000) // Local calibration
 				{
+					sector = newSector;
 					ok = true;
 					break;
 				}
-				else if ((sector * 4096) == 0x30000) // start address of DMRIDs DB
-				{
-					flashingDMRIDs = true;
-				}
 
-				TASK_UNLOCK_WRITE();
-				ok = SPI_Flash_read(sector * 4096, SPI_Flash_sectorbuffer, 4096);
-				TASK_LOCK_WRITE();
+				ok = cpsFlashLoadSector(newSector);
 			}
 			break;
 
@@ -357,140 +748,32 @@ static void cpsHandleWriteCommand(void)
 			{
 				uint32_t address = (com_requestbuffer[2] << 24) + (com_requestbuffer[3] << 16) + (com_requestbuffer[4] << 8) + (com_requestbuffer[5] << 0);
 				uint32_t length = (com_requestbuffer[6] << 8) + (com_requestbuffer[7] << 0);
-				bool calibrationWriting = false;
-
-#if defined(PLATFORM_MD9600) || defined(PLATFORM_MDUV380) || defined(PLATFORM_MD380) || defined(PLATFORM_RT84_DM1701) || defined(PLATFORM_MD2017)
-				if ((calibrationWriting == false) && addressInSegment(address, length, 0x10000, 0x200)) // Local calibration
-				{
-					calibrationWriting = true;
-				}
-				// Channel is going to be rewritten, will need to reset current zone/etc...
-				else if ((channelsRewritten == false) && addressInSegment(address, length, CODEPLUG_ADDR_CHANNEL_HEADER_EEPROM, 0x1C10 /*128 first channels*/))
-				{
-					channelsRewritten = true;
-				}
-				else if ((luczRewritten == false) && addressInSegment(address, length, CODEPLUG_ADDR_LUCZ, (4 + CODEPLUG_ALL_ZONES_MAX + 1)))
-				{
-					luczRewritten = true;
-				}
-				else
-#endif
-#if !defined(PLATFORM_GD77S)
-				// Temporary hack to automatically set Prompt to Level 1
-				// A better solution will be added to the CPS and firmware at a later date.
-				if ((address == VOICE_PROMPTS_FLASH_HEADER_ADDRESS) || (address == VOICE_PROMPTS_FLASH_OLD_HEADER_ADDRESS))
-				{
-					if (voicePromptsCheckMagicAndVersion((uint32_t *)&com_requestbuffer[8]))
-					{
-						nonVolatileSettings.audioPromptMode = AUDIO_PROMPT_MODE_VOICE_LEVEL_1;
-					}
-				}
-#endif
 
 				if (length > (COM_REQUESTBUFFER_SIZE - 8))
 				{
 					length = (COM_REQUESTBUFFER_SIZE - 8);
 				}
 
-#if defined(PLATFORM_MD9600) || defined(PLATFORM_MDUV380) || defined(PLATFORM_MD380) || defined(PLATFORM_RT84_DM1701) || defined(PLATFORM_MD2017)
-				// Temporary hack to prevent the QuickKeys getting overwritten by the codeplug
-				const int QUICKKEYS_BLOCK_END = (CODEPLUG_ADDR_QUICKKEYS + (CODEPLUG_QUICKKEYS_SIZE * sizeof(uint16_t)) - 1);
-				int end = (address + length) - 1;
+				ok = cpsFlashStageData(address, length, (uint8_t *)&com_requestbuffer[8]);
 
-				if (((address >= CODEPLUG_ADDR_QUICKKEYS) && (address <= QUICKKEYS_BLOCK_END))
-						|| ((end >= CODEPLUG_ADDR_QUICKKEYS) && (end <= QUICKKEYS_BLOCK_END))
-						|| ((address < CODEPLUG_ADDR_QUICKKEYS) && (end > QUICKKEYS_BLOCK_END)))
+				if (calibrationPending)
 				{
-					if (address < CODEPLUG_ADDR_QUICKKEYS)
-					{
-						for (int i = 0; i < (CODEPLUG_ADDR_QUICKKEYS - address); i++)
-						{
-							if (sector == (address + i) / 4096)
-							{
-								SPI_Flash_sectorbuffer[(address + i) % 4096] = com_requestbuffer[i + 8];
-							}
-						}
-
-						if ((end > QUICKKEYS_BLOCK_END))
-						{
-							for (int i = 0; i <  (end - QUICKKEYS_BLOCK_END); i++)
-							{
-								if (sector == ((QUICKKEYS_BLOCK_END + 1) + i) / 4096)
-								{
-									SPI_Flash_sectorbuffer[((QUICKKEYS_BLOCK_END + 1) + i) % 4096] = com_requestbuffer[i + 8 + ((QUICKKEYS_BLOCK_END + 1) - address)];
-								}
-							}
-						}
-
-					}
-					else
-					{
-						if ((address <= QUICKKEYS_BLOCK_END) && (end > QUICKKEYS_BLOCK_END))
-						{
-							for (int i = 0; i < (end - QUICKKEYS_BLOCK_END); i++)
-							{
-								if (sector == ((QUICKKEYS_BLOCK_END + 1) + i) / 4096)
-								{
-									SPI_Flash_sectorbuffer[((QUICKKEYS_BLOCK_END + 1) + i) % 4096] = com_requestbuffer[i + 8 + ((QUICKKEYS_BLOCK_END + 1) - address)];
-								}
-							}
-						}
-					}
-				}
-				else
-#endif
-				{
-#if defined(PLATFORM_MD9600) || defined(PLATFORM_MDUV380) || defined(PLATFORM_MD380) || defined(PLATFORM_RT84_DM1701) || defined(PLATFORM_MD2017)
-					if (calibrationWriting)
-					{
-						uint8_t *p = calibrationGetLocalDataPointer();
-
-						memcpy((p + (address - 0x10000)), (uint8_t *)&com_requestbuffer[8], length);
-						sector = -2; // special case in Flash Write;
-						ok = true;
-						break;
-					}
-#endif
-
-					for (int i = 0; i < length; i++)
-					{
-						if (sector == (address + i) / 4096)
-						{
-							SPI_Flash_sectorbuffer[(address + i) % 4096] = com_requestbuffer[i + 8];
-						}
-					}
+					sector = -2; // special case in Flash Write;
 				}
-
-				ok = true;
 			}
 			break;
 
 		case 3: // Flash Write
 			if (sector >= 0)
 			{
-				TASK_UNLOCK_WRITE();
-				ok = SPI_Flash_eraseSector(sector * 4096);
-				TASK_LOCK_WRITE();
-				if (ok)
-				{
-					for (int i = 0; i < 16; i++)
-					{
-						TASK_UNLOCK_WRITE();
-						ok = SPI_Flash_writePage(sector * 4096 + i * 256, SPI_Flash_sectorbuffer + i * 256);
-						TASK_LOCK_WRITE();
-						if (!ok)
-						{
-							break;
-						}
-					}
-				}
-				sector = -1;
+				ok = cpsFlashCommitSector();
 			}
 			else if (sector == -2)
 			{
 				TASK_UNLOCK_WRITE();
 				calibrationSaveLocal();
 				TASK_LOCK_WRITE();
+				calibrationPending = false;
 				ok = true;
 				sector = -1;
 			}
@@ -502,6 +785,8 @@ static void cpsHandleWriteCommand(void)
 				uint32_t address = (com_requestbuffer[2] << 24) + (com_requestbuffer[3] << 16) + (com_requestbuffer[4] << 8) + (com_requestbuffer[5] << 0);
 				uint32_t length = (com_requestbuffer[6] << 8) + (com_requestbuffer[7] << 0);
 
+				cpsInvalidateCachesForWrite(address, length);
+
 				// Channel is going to be rewritten, will need to reset current zone/etc...
 				if ((channelsRewritten == false) && addressInSegment(address, length, CODEPLUG_ADDR_CHANNEL_HEADER_EEPROM, 0x1C10 /*128 first channels*/))
 				{
@@ -898,6 +1183,219 @@ static void cpsHandleCommand(void)
 	replyLength = 1;
 }
 
+// Digest of the content a CPS read would get (calibration and VFOs included), the tail of the send buffer is used as scratch
+static bool cpsFlashDigest(uint32_t address, uint32_t length, uint32_t *crc)
+{
+	uint8_t *chunk = (uint8_t *)&usbComSendBuf[COM_BUFFER_SIZE - CPS_PIPELINE_DIGEST_CHUNK_SIZE];
+
+	*crc = 0;
+
+	while (length > 0)
+	{
+		uint32_t chunkLength = CPS_PIPELINE_DIGEST_CHUNK_SIZE - (address % CPS_PIPELINE_DIGEST_CHUNK_SIZE);
+
+		if (chunkLength > length)
+		{
+			chunkLength = length;
+		}
+
+		if (cpsFlashRead(address, chunk, chunkLength) == false)
+		{
+			return false;
+		}
+
+		*crc = crcCalc32(*crc, chunk, chunkLength);
+		address += chunkLength;
+		length -= chunkLength;
+	}
+
+	return true;
+}
+
+static void cpsHandlePipelinedCommand(void)
+{
+	uint8_t op = com_requestbuffer[1];
+	uint16_t sequence = (com_requestbuffer[2] << 8) + (com_requestbuffer[3] << 0);
+	uint32_t address = (com_requestbuffer[4] << 24) + (com_requestbuffer[5] << 16) + (com_requestbuffer[6] << 8) + (com_requestbuffer[7] << 0);
+	uint32_t length = (com_requestbuffer[8] << 8) + (com_requestbuffer[9] << 0);
+	uint32_t crc = (com_requestbuffer[10] << 24) + (com_requestbuffer[11] << 16) + (com_requestbuffer[12] << 8) + (com_requestbuffer[13] << 0);
+	uint8_t *data = (uint8_t *)&com_requestbuffer[CPS_PIPELINE_HEADER_SIZE];
+	uint8_t *replyData = (uint8_t *)&usbComSendBuf[CPS_PIPELINE_REPLY_HEADER_SIZE];
+	uint32_t replyDataLength = 0;
+	uint8_t status = CPS_PIPELINE_STATUS_OK;
+
+	if (op == CPS_PIPELINE_OP_OPEN)
+	{
+		pipelineIsOpen = true;
+		pipelineNextSequence = sequence;
+		memset(&sectorWriteStats, 0, sizeof(sectorWriteStats));
+	}
+
+	if ((pipelineIsOpen == false) || (sequence != pipelineNextSequence))
+	{
+		status = CPS_PIPELINE_STATUS_SEQUENCE_ERROR;
+	}
+	else
+	{
+		pipelineNextSequence++;
+
+		switch (op)
+		{
+			case CPS_PIPELINE_OP_OPEN:
+				if (sector >= 0) // Some leftover from an aborted transfer
+				{
+					sector = -1;
+				}
+				replyData[0] = CPS_PIPELINE_PROTOCOL_VERSION;
+				replyData[1] = (CPS_PIPELINE_MAX_DATA_LENGTH >> 8) & 0xFF;
+				replyData[2] = (CPS_PIPELINE_MAX_DATA_LENGTH >> 0) & 0xFF;
+				replyDataLength = 3;
+				break;
+
+			case CPS_PIPELINE_OP_WRITE_FLASH:
+				if ((length == 0) || (length > CPS_PIPELINE_MAX_DATA_LENGTH) || ((address / 4096) != ((address + length - 1) / 4096)))
+				{
+					status = CPS_PIPELINE_STATUS_BAD_REQUEST;
+				}
+				else if (crcCalc32(0, data, length) != crc)
+				{
+					status = CPS_PIPELINE_STATUS_CRC_ERROR;
+				}
+				else
+				{
+					int newSector = (address / 4096);
+
+					if ((addressInSegment(address, length, 0x10000, 0x200) == false) && (sector != newSector))
+					{
+						if ((sector >= 0) && (cpsFlashCommitSector() == false))
+						{
+							status = CPS_PIPELINE_STATUS_FLASH_ERROR;
+						}
+						else if (cpsFlashLoadSector(newSector) == false)
+						{
+							sector = -1;
+							status = CPS_PIPELINE_STATUS_FLASH_ERROR;
+						}
+					}
+
+					if (status == CPS_PIPELINE_STATUS_OK)
+					{
+						cpsFlashStageData(address, length, data);
+					}
+				}
+				break;
+
+			case CPS_PIPELINE_OP_COMMIT:
+				if ((sector >= 0) && (cpsFlashCommitSector() == false))
+				{
+					status = CPS_PIPELINE_STATUS_FLASH_ERROR;
+				}
+
+				if (calibrationPending)
+				{
+					TASK_UNLOCK_WRITE();
+					calibrationSaveLocal();
+					TASK_LOCK_WRITE();
+					calibrationPending = false;
+				}
+
+				replyData[0] = (sectorWriteStats.erased >> 8) & 0xFF;
+				replyData[1] = (sectorWriteStats.erased >> 0) & 0xFF;
+				replyData[2] = (sectorWriteStats.programmedOnly >> 8) & 0xFF;
+				replyData[3] = (sectorWriteStats.programmedOnly >> 0) & 0xFF;
+				replyData[4] = (sectorWriteStats.unchanged >> 8) & 0xFF;
+				replyData[5] = (sectorWriteStats.unchanged >> 0) & 0xFF;
+				replyDataLength = 6;
+				break;
+
+			case CPS_PIPELINE_OP_READ_FLASH:
+				if ((length == 0) || (length > CPS_PIPELINE_MAX_DATA_LENGTH))
+				{
+					status = CPS_PIPELINE_STATUS_BAD_REQUEST;
+				}
+				else
+				{
+					// Reads have to see what has been written before
+					if ((sector >= 0) && (cpsFlashCommitSector() == false))
+					{
+						status = CPS_PIPELINE_STATUS_FLASH_ERROR;
+					}
+					else if (cpsFlashRead(address, replyData, length))
+					{
+						replyDataLength = length;
+					}
+					else
+					{
+						status = CPS_PIPELINE_STATUS_FLASH_ERROR;
+					}
+				}
+				break;
+
+			case CPS_PIPELINE_OP_DIGEST:
+				if ((length == 0) || ((length % 8) != 0) || ((length / 8) > CPS_PIPELINE_MAX_DIGEST_RANGES))
+				{
+					status = CPS_PIPELINE_STATUS_BAD_REQUEST;
+				}
+				else if (crcCalc32(0, data, length) != crc)
+				{
+					status = CPS_PIPELINE_STATUS_CRC_ERROR;
+				}
+				else if ((sector >= 0) && (cpsFlashCommitSector() == false))
+				{
+					status = CPS_PIPELINE_STATUS_FLASH_ERROR;
+				}
+				else
+				{
+					for (uint32_t i = 0; i < length; i += 8)
+					{
+						uint32_t rangeAddress = (data[i + 0] << 24) + (data[i + 1] << 16) + (data[i + 2] << 8) + (data[i + 3] << 0);
+						uint32_t rangeLength = (data[i + 4] << 24) + (data[i + 5] << 16) + (data[i + 6] << 8) + (data[i + 7] << 0);
+						uint32_t rangeCrc;
+
+						if (cpsFlashDigest(rangeAddress, rangeLength, &rangeCrc) == false)
+						{
+							status = CPS_PIPELINE_STATUS_FLASH_ERROR;
+							replyDataLength = 0;
+							break;
+						}
+
+						replyData[replyDataLength++] = (rangeCrc >> 24) & 0xFF;
+						replyData[replyDataLength++] = (rangeCrc >> 16) & 0xFF;
+						replyData[replyDataLength++] = (rangeCrc >> 8) & 0xFF;
+						replyData[replyDataLength++] = (rangeCrc >> 0) & 0xFF;
+					}
+				}
+				break;
+
+			default:
+				status = CPS_PIPELINE_STATUS_BAD_REQUEST;
+				break;
+		}
+	}
+
+	if ((op == CPS_PIPELINE_OP_OPEN) && (status != CPS_PIPELINE_STATUS_OK))
+	{
+		pipelineIsOpen = false;
+	}
+
+	crc = crcCalc32(0, replyData, replyDataLength);
+
+	usbComSendBuf[0] = com_requestbuffer[0];
+	usbComSendBuf[1] = op;
+	usbComSendBuf[2] = (sequence >> 8) & 0xFF;
+	usbComSendBuf[3] = (sequence >> 0) & 0xFF;
+	usbComSendBuf[4] = status;
+	usbComSendBuf[5] = (replyDataLength >> 8) & 0xFF;
+	usbComSendBuf[6] = (replyDataLength >> 0) & 0xFF;
+	replyData[replyDataLength + 0] = (crc >> 24) & 0xFF;
+	replyData[replyDataLength + 1] = (crc >> 16) & 0xFF;
+	replyData[replyDataLength + 2] = (crc >> 8) & 0xFF;
+	replyData[replyDataLength + 3] = (crc >> 0) & 0xFF;
+
+	hasToReply = true;
+	replyLength = CPS_PIPELINE_REPLY_HEADER_SIZE + replyDataLength + 4;
+}
+
 static void handleCPSRequest(void)
 {
 	//Handle read
@@ -920,6 +1418,9 @@ static void handleCPSRequest(void)
 		case 'C':
 			cpsHandleCommand();
 			break;
+		case 'P':
+			cpsHandlePipelinedCommand();
+			break;
 #ifdef USB_DEBUG_COMMANDS
 		case 'D':
 			cpsHandleDebugCommand();
@@ -958,6 +1459,7 @@ static void handleCPSRequest(void)
 			break;
 	}
 }
+
 #if 0
 __attribute__((section(".ccmram"))) volatile uint8_t com_buffer[COM_BUFFER_SIZE];
 int com_buffer_write_idx = 0;
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2019      Kai Ludwig, DG4KLU
+ * Copyright (C) 2019-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <string.h>
+#include "usb/usb_com.h"
+
+//
+// MMDVMHost frames circular receive buffer (com_requestbuffer, in hotspot mode).
+// Each frame is preceded by its block length (frame length + 1). The frames are stored from the USB ISR
+// and parsed in place by the hotspot task: a frame stays in the buffer until it has been released.
+//
+
+volatile int comRecvMMDVMIndexIn = 0;
+volatile int comRecvMMDVMIndexOut = 0;
+volatile int comRecvMMDVMFrameCount = 0;
+volatile uint32_t comRecvMMDVMOverruns = 0;
+
+// Bytes that can be stored without overwriting an unreleased frame
+static int usbComMMDVMFreeSpace(void)
+{
+	if (comRecvMMDVMFrameCount <= 0)
+	{
+		return COM_REQUESTBUFFER_SIZE;
+	}
+
+	return ((comRecvMMDVMIndexOut - comRecvMMDVMIndexIn + COM_REQUESTBUFFER_SIZE) % COM_REQUESTBUFFER_SIZE);
+}
+
+// Append one MMDVMHost frame (preceded by its block length) to the circular receive buffer, called from the USB ISR.
+// The frame is dropped (and counted as an overrun) if it doesn't fit in front of the unreleased ones.
+bool usbComMMDVMFrameStore(const uint8_t *data, uint8_t length)
+{
+	int indexIn = comRecvMMDVMIndexIn;
+	int firstLength;
+
+	if ((length + 1) > usbComMMDVMFreeSpace())
+	{
+		comRecvMMDVMOverruns++;
+		return false;
+	}
+
+	// We can't rely on the MMDVMHost's frame size, so we're managing the block size ourselves.
+	com_requestbuffer[indexIn++] = length + 1;
+	if (indexIn >= COM_REQUESTBUFFER_SIZE)
+	{
+		indexIn = 0;
+	}
+
+	firstLength = ((indexIn + length) > COM_REQUESTBUFFER_SIZE) ? (COM_REQUESTBUFFER_SIZE - indexIn) : length;
+	memcpy((uint8_t *)&com_requestbuffer[indexIn], data, firstLength);
+	if (firstLength < length)
+	{
+		memcpy((uint8_t *)&com_requestbuffer[0], data + firstLength, (length - firstLength));
+	}
+
+	indexIn += length;
+	if (indexIn >= COM_REQUESTBUFFER_SIZE)
+	{
+		indexIn -= COM_REQUESTBUFFER_SIZE;
+	}
+
+	comRecvMMDVMIndexIn = indexIn;
+	comRecvMMDVMFrameCount++;
+
+	return true;
+}
+// Get a view of the oldest MMDVMHost frame, in place. The frame stays in the buffer until usbComMMDVMFrameRelease()
+bool usbComMMDVMFramePeek(usbComFrameView_t *view)
+{
+	int indexOut = comRecvMMDVMIndexOut;
+	uint16_t length;
+
+	if (comRecvMMDVMFrameCount <= 0)
+	{
+		return false;
+	}
+
+	length = (uint8_t)(com_requestbuffer[indexOut++] - 1); // Remove our data block length header
+	if (indexOut >= COM_REQUESTBUFFER_SIZE)
+	{
+		indexOut = 0;
+	}
+
+	view->segment[0] = (const uint8_t *)&com_requestbuffer[indexOut];
+	if ((indexOut + length) > COM_REQUESTBUFFER_SIZE)
+	{
+		view->length[0] = COM_REQUESTBUFFER_SIZE - indexOut;
+		view->segment[1] = (const uint8_t *)&com_requestbuffer[0];
+		view->length[1] = length - view->length[0];
+	}
+	else
+	{
+		view->length[0] = length;
+		view->segment[1] = NULL;
+		view->length[1] = 0;
+	}
+
+	return true;
+}
+
+void usbComMMDVMFrameRelease(const usbComFrameView_t *view)
+{
+	int indexOut = (view->segment[0] - (const uint8_t *)com_requestbuffer) + view->length[0];
+
+	if (view->length[1] != 0)
+	{
+		indexOut = view->length[1];
+	}
+
+	if (indexOut >= COM_REQUESTBUFFER_SIZE)
+	{
+		indexOut = 0;
+	}
+
+	// The USB ISR updates the frame counter too
+	taskENTER_CRITICAL();
+	comRecvMMDVMIndexOut = indexOut;
+
+	// Decrement the frame counter
+	comRecvMMDVMFrameCount--;
+
+	// Something went wrong, resync to the RX buffer
+	if (comRecvMMDVMFrameCount < 0)
+	{
+		comRecvMMDVMIndexIn = comRecvMMDVMIndexOut = 0; // Resync, it may skip few frames.
+		comRecvMMDVMFrameCount = 0;
+	}
+	taskEXIT_CRITICAL();
+}
+
+// Copy a part of a frame view, across the wrap if needed
+void usbComFrameViewCopy(const usbComFrameView_t *view, uint16_t offset, uint8_t *dest, uint16_t length)
+{
+	if (offset < view->length[0])
+	{
+		uint16_t firstLength = MIN(length, (view->length[0] - offset));
+
+		memcpy(dest, view->segment[0] + offset, firstLength);
+		dest += firstLength;
+		length -= firstLength;
+		offset = 0;
+	}
+	else
+	{
+		offset -= view->length[0];
+	}
+
+	if (length > 0)
+	{
+		memcpy(dest, view->segment[1] + offset, length);
+	}
+}
@@ -105,8 +105,8 @@ menuStatus_t menuLastHeard(uiEvent_t *ev, bool isFirstRun)
 		}
 		else
 		{
-			// Just refresh the list while displaying details, it's all about elapsed time
-			if (displayLHDetails && ((ev->time - m) > (1000U * 60U)))
+			// Just refresh the list while displaying details, it's all about elapsed time (and a call has just ended)
+			if (displayLHDetails && ((ev->events & DMR_CALL_END_EVENT) || ((ev->time - m) > (1000U * 60U))))
 			{
 				m = ev->time;
 				menuLastHeardUpdateScreen(true, displayLHDetails, false);
@@ -32,6 +32,7 @@
 #include "utils.h"
 #include "interfaces/pit.h"
 #include "functions/satellite.h"
+#include "interfaces/runTimeStats.h"
 #if defined(PLATFORM_MD9600) || defined(PLATFORM_MD380) || defined(PLATFORM_MDUV380) || defined(PLATFORM_RT84_DM1701) || defined(PLATFORM_MD2017)
 #include "interfaces/batteryAndPowerManagement.h"
 #include "semphr.h"
@@ -744,6 +745,40 @@ static void updateScreen(uiEvent_t *ev, bool forceRedraw)
 		}
 		break;
 
+		case RADIO_INFOS_CPU_LOAD:
+		{
+			const runTimeStats_t *stats;
+			int y = 16;
+
+			runTimeStatsUpdate(RUN_TIME_STATS_WINDOW_UI);
+			stats = runTimeStatsGet(RUN_TIME_STATS_WINDOW_UI);
+
+			displayClearBuf();
+			menuDisplayTitle(currentLanguage->cpu_load);
+
+			snprintf(buffer, SCREEN_LINE_BUFFER_SIZE, "Idle %3u.%1u%%", (stats->idlePermille / 10), (stats->idlePermille % 10));
+			displayPrintCentered(y, buffer, FONT_SIZE_3);
+			y += (FONT_SIZE_3_HEIGHT + 2);
+
+			// Task name, CPU usage and stack high water mark (words)
+			for (int i = 0; (i < stats->numTasks) && (y <= (DISPLAY_SIZE_Y - (8 + 8))); i++)
+			{
+				const runTimeStatsTask_t *task = &stats->tasks[i];
+
+				snprintf(buffer, SCREEN_LINE_BUFFER_SIZE, "%-11.11s%3u.%1u%% %4u", task->name, (task->cpuPermille / 10), (task->cpuPermille % 10), task->stackHighWaterMark);
+				displayPrintAt(2 + DISPLAY_H_OFFSET, y, buffer, FONT_SIZE_1);
+				y += 9;
+			}
+
+			renderArrowOnly = false;
+
+			displayThemeApply(THEME_ITEM_FG_DECORATION, THEME_ITEM_BG);
+			// Up/Down blinking arrow
+			displayFillTriangle(63 + DISPLAY_H_OFFSET, (DISPLAY_SIZE_Y - 1), 59 + DISPLAY_H_OFFSET, (DISPLAY_SIZE_Y - 3), 67 + DISPLAY_H_OFFSET, (DISPLAY_SIZE_Y - 3), blink);
+			displayFillTriangle(63 + DISPLAY_H_OFFSET, (DISPLAY_SIZE_Y - 5), 59 + DISPLAY_H_OFFSET, (DISPLAY_SIZE_Y - 3), 67 + DISPLAY_H_OFFSET, (DISPLAY_SIZE_Y - 3), blink);
+		}
+		break;
+
 		case RADIO_INFOS_UP_TIME:
 		{
 			displayClearBuf();
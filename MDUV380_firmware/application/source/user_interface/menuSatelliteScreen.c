@@ -187,7 +187,7 @@ menuStatus_t menuSatelliteScreen(uiEvent_t *ev, bool isFirstRun)
 		{
 			if (numTotalSatellitesPredicted == 0)
 			{
-				clockManagerSetRunMode(kAPP_PowerModeHsrun, CLOCK_MANAGER_SPEED_HS_RUN);
+				clockManagerGovernorSetDemand(CLOCK_MANAGER_DEMAND_PREDICTION, true);
 			}
 
 			while (!calculatePredictionsForSatelliteIndex(currentlyPredictingSatellite))
@@ -216,7 +216,7 @@ menuStatus_t menuSatelliteScreen(uiEvent_t *ev, bool isFirstRun)
 								selectSatellite(foundSatellite);
 							}
 						}
-						clockManagerSetRunMode(kAPP_PowerModeHsrun,CLOCK_MANAGER_SPEED_RUN);
+						clockManagerGovernorSetDemand(CLOCK_MANAGER_DEMAND_PREDICTION, false);
 					}
 				}
 			}
@@ -1508,10 +1508,7 @@ void menuSatelliteSetFullReload(void)
 
 static void exitCallback(void *data)
 {
-	if (displayMode == SATELLITE_SCREEN_ALL_PREDICTIONS_LIST)
-	{
-		clockManagerSetRunMode(kAPP_PowerModeRun, CLOCK_MANAGER_SPEED_RUN);
-	}
+	clockManagerGovernorSetDemand(CLOCK_MANAGER_DEMAND_PREDICTION, false);
 
 	if (menuSystemGetRootMenuNumber() == UI_CHANNEL_MODE)
 	{
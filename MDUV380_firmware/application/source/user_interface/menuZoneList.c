@@ -68,7 +68,7 @@ static void updateScreen(bool isFirstRun)
 {
 	char nameBuf[17];
 	int mNum;
-	struct_codeplugZone_t zoneBuf;
+	codeplugZoneHeader_t zoneHeader;
 
 	displayClearBuf();
 	menuDisplayTitle(currentLanguage->zones);
@@ -90,8 +90,8 @@ static void updateScreen(bool isFirstRun)
 			break;
 		}
 
-		codeplugZoneGetDataForNumber(mNum, &zoneBuf);
-		codeplugUtilConvertBufToString(zoneBuf.name, nameBuf, 16);// need to convert to zero terminated string
+		codeplugZoneGetHeaderForNumber(mNum, &zoneHeader);
+		codeplugUtilConvertBufToString(zoneHeader.name, nameBuf, 16);// need to convert to zero terminated string
 
 		menuDisplayEntry(i, mNum, (char *)nameBuf, 0, THEME_ITEM_FG_ZONE_NAME, THEME_ITEM_COLOUR_NONE, THEME_ITEM_BG);
 
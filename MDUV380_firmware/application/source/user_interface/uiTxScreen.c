@@ -501,11 +501,6 @@ static void handleEvent(uiEvent_t *ev)
 					LedWrite(LED_GREEN, 1);
 				}
 
-				if (trxGetMode() == RADIO_MODE_DIGITAL)
-				{
-					clockManagerSetRunMode(kAPP_PowerModeRun, CLOCK_MANAGER_SPEED_RUN);
-				}
-
 				HRC6000ClearIsWakingState();
 
 				menuSystemPopPreviousMenu();
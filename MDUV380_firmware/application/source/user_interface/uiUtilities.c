@@ -61,9 +61,24 @@ static uint32_t dmrIdDataArea_1_Size;
 const uint32_t DMRID_HEADER_LENGTH = 0x0C;
 const uint32_t DMRID_MEMORY_LOCATION_1 = 0x30000 + FLASH_ADDRESS_OFFSET;
 const uint32_t DMRID_MEMORY_LOCATION_2 = 0xB8000 + FLASH_ADDRESS_OFFSET;
+static const uint32_t DMRID_MEMORY_END = 0x100000 + FLASH_ADDRESS_OFFSET; // End of the second area
 uint32_t dmrIDDatabaseMemoryLocation2 = DMRID_MEMORY_LOCATION_2;
 
 static dmrIDsCache_t dmrIDsCache;
+#define DMRID_V2_INDEX_CACHE_SIZE       256 // First ID of every dmrIDv2IndexCacheStep block (1KB)
+#define DMRID_V2_INDEX_CACHE_MAX_STEP   16  // 4096 blocks, more than both areas can hold
+#define DMRID_V2_READ_CHUNK_SIZE        32  // A block is read as far as its records are decoded
+static dmrIDv2Header_t dmrIDv2Header;
+static uint32_t dmrIDv2DataOffset;
+static uint32_t dmrIDv2BlocksInArea1;
+static uint32_t dmrIDv2IndexCache[DMRID_V2_INDEX_CACHE_SIZE];
+static uint32_t dmrIDv2IndexCacheEntries;
+static uint32_t dmrIDv2IndexCacheStep;
+static uint8_t dmrIDv2Block[DMRID_V2_BLOCK_SIZE];
+static int32_t dmrIDv2BlockNumber = -1; // Block currently in dmrIDv2Block[], the QSO display looks up the same ID over and over
+static uint32_t dmrIDv2BlockLength; // Bytes of the block read so far
+static uint32_t dmrIDv2BlockFirstId;
+static uint32_t dmrIDv2BlockEndId; // First ID of the next block
 static uint32_t lastTG = 0;
 
 volatile uint32_t lastID = 0;// This needs to be volatile as lastHeardClearLastID() is called from an ISR
@@ -1024,15 +1039,180 @@ static bool dmrIDReadContactInFlash(uint32_t contactOffset, uint8_t *data, uint3
 	return SPI_Flash_read(address, data, len);
 }
 
+static bool dmrIDv2ReadBlockFirstIds(uint32_t block, uint32_t *ids, uint32_t count)
+{
+	return SPI_Flash_read(DMRID_MEMORY_LOCATION_1 + sizeof(dmrIDv2Header_t) + (block * sizeof(uint32_t)), (uint8_t *)ids, (count * sizeof(uint32_t)));
+}
+
+static uint32_t dmrIDv2BlockAddress(uint32_t block)
+{
+	if (block < dmrIDv2BlocksInArea1)
+	{
+		return (DMRID_MEMORY_LOCATION_1 + dmrIDv2DataOffset + (block * DMRID_V2_BLOCK_SIZE));
+	}
+
+	return (dmrIDDatabaseMemoryLocation2 + ((block - dmrIDv2BlocksInArea1) * DMRID_V2_BLOCK_SIZE));
+}
+
+// Selects the last block starting with an ID <= targetId: the index cache narrows it down to dmrIDv2IndexCacheStep blocks,
+// whose index entries (and the next one, which ends the last of them) are read at once.
+static bool dmrIDv2FindBlock(uint32_t targetId)
+{
+	uint32_t ids[DMRID_V2_INDEX_CACHE_MAX_STEP + 1];
+	uint32_t start = 0;
+	uint32_t end = (dmrIDv2IndexCacheEntries - 1);
+	uint32_t firstBlock;
+	uint32_t count;
+
+	if ((dmrIDv2BlockNumber >= 0) && (targetId >= dmrIDv2BlockFirstId) && (targetId < dmrIDv2BlockEndId))
+	{
+		return true;
+	}
+
+	while (start < end)
+	{
+		uint32_t current = ((start + end + 1) >> 1);
+
+		if (dmrIDv2IndexCache[current] <= targetId)
+		{
+			start = current;
+		}
+		else
+		{
+			end = current - 1;
+		}
+	}
+
+	firstBlock = (start * dmrIDv2IndexCacheStep);
+	count = MIN((dmrIDv2IndexCacheStep + 1), (dmrIDv2Header.blocks - firstBlock));
+
+	dmrIDv2BlockNumber = -1;
+
+	if (dmrIDv2ReadBlockFirstIds(firstBlock, ids, count) == false)
+	{
+		return false;
+	}
+
+	if (count == (dmrIDv2Header.blocks - firstBlock))
+	{
+		ids[count++] = (dmrIDv2Header.lastId + 1);
+	}
+
+	start = 0;
+	end = (count - 2);
+	while (start < end)
+	{
+		uint32_t current = ((start + end + 1) >> 1);
+
+		if (ids[current] <= targetId)
+		{
+			start = current;
+		}
+		else
+		{
+			end = current - 1;
+		}
+	}
+
+	dmrIDv2BlockNumber = (firstBlock + start);
+	dmrIDv2BlockLength = 0;
+	dmrIDv2BlockFirstId = ids[start];
+	dmrIDv2BlockEndId = ids[start + 1];
+
+	return true;
+}
+
+// Makes sure the first length bytes of the current block are in dmrIDv2Block[]
+static bool dmrIDv2LoadBlock(uint32_t length)
+{
+	if (length > DMRID_V2_BLOCK_SIZE)
+	{
+		return false;
+	}
+
+	while (dmrIDv2BlockLength < length)
+	{
+		uint32_t chunkLength = MIN(DMRID_V2_READ_CHUNK_SIZE, (DMRID_V2_BLOCK_SIZE - dmrIDv2BlockLength));
+
+		if (SPI_Flash_read(dmrIDv2BlockAddress(dmrIDv2BlockNumber) + dmrIDv2BlockLength, &dmrIDv2Block[dmrIDv2BlockLength], chunkLength) == false)
+		{
+			dmrIDv2BlockNumber = -1;
+			return false;
+		}
+
+		dmrIDv2BlockLength += chunkLength;
+	}
+
+	return true;
+}
+
+static void dmrIDv2CacheInit(void)
+{
+	uint32_t numSymbols = 0;
+
+	SPI_Flash_read(DMRID_MEMORY_LOCATION_1, (uint8_t *)&dmrIDv2Header, sizeof(dmrIDv2Header_t));
+
+	for (uint8_t i = 1; i <= DMRID_V2_MAX_CODE_LENGTH; i++)
+	{
+		numSymbols += dmrIDv2Header.codeLengthCounts[i];
+	}
+
+	dmrIDv2DataOffset = ((sizeof(dmrIDv2Header_t) + (dmrIDv2Header.blocks * sizeof(uint32_t)) + (DMRID_V2_BLOCK_SIZE - 1)) / DMRID_V2_BLOCK_SIZE) * DMRID_V2_BLOCK_SIZE;
+
+	// The index has to fit in the first area
+	if ((dmrIDv2Header.blockSize != DMRID_V2_BLOCK_SIZE) || (dmrIDv2Header.blocks == 0) || (dmrIDv2DataOffset >= 0x40000) ||
+			(dmrIDv2Header.numSymbols > DMRID_V2_MAX_SYMBOLS) || (numSymbols != dmrIDv2Header.numSymbols))
+	{
+		return;
+	}
+
+	if (dmrIDv2Header.flags & DMRID_V2_FLAG_OVERWRITE_VP)
+	{
+		dmrIDDatabaseMemoryLocation2 = VOICE_PROMPTS_FLASH_HEADER_ADDRESS;
+	}
+
+	dmrIDv2BlocksInArea1 = ((0x40000 - dmrIDv2DataOffset) / DMRID_V2_BLOCK_SIZE);
+
+	dmrIDv2IndexCacheStep = ((dmrIDv2Header.blocks + (DMRID_V2_INDEX_CACHE_SIZE - 1)) / DMRID_V2_INDEX_CACHE_SIZE);
+
+	// A corrupted (or too large) block count would read past the second area
+	if ((dmrIDv2Header.blocks > (dmrIDv2BlocksInArea1 + ((DMRID_MEMORY_END - dmrIDDatabaseMemoryLocation2) / DMRID_V2_BLOCK_SIZE))) ||
+			(dmrIDv2IndexCacheStep > DMRID_V2_INDEX_CACHE_MAX_STEP))
+	{
+		dmrIDDatabaseMemoryLocation2 = DMRID_MEMORY_LOCATION_2;
+		return;
+	}
+
+	dmrIDv2IndexCacheEntries = 0;
+	for (uint32_t block = 0; block < dmrIDv2Header.blocks; block += dmrIDv2IndexCacheStep)
+	{
+		dmrIDv2ReadBlockFirstIds(block, &dmrIDv2IndexCache[dmrIDv2IndexCacheEntries++], 1);
+	}
+
+	dmrIDsCache.slices[0] = dmrIDv2IndexCache[0];
+	dmrIDsCache.slices[ID_SLICES - 1] = dmrIDv2Header.lastId;
+
+	dmrIDsCache.version = 2;
+	dmrIDsCache.entries = dmrIDv2Header.entries;
+}
+
 void dmrIDCacheInit(void)
 {
 	uint8_t headerBuf[32];
 
 	dmrIDCacheClear();
 	memset(&headerBuf, 0, sizeof(headerBuf));
+	dmrIDDatabaseMemoryLocation2 = DMRID_MEMORY_LOCATION_2;
+	DMRID_IdLength = 4U;
 
 	SPI_Flash_read(DMRID_MEMORY_LOCATION_1, headerBuf, DMRID_HEADER_LENGTH);
 
+	if (memcmp(headerBuf, "IDv2", 4) == 0)
+	{
+		dmrIDv2CacheInit();
+		return;
+	}
+
 	// Break backward compatibility with old "ID{N,n} tag, as we had too
 	// much problems with corrupted database.
 	if ((headerBuf[0] != 'I') || (headerBuf[1] != 'd') )
@@ -1056,6 +1236,7 @@ void dmrIDCacheInit(void)
 		return;
 	}
 
+	dmrIDsCache.version = 1;
 	dmrIDsCache.entries = ((uint32_t)headerBuf[8] | (uint32_t)headerBuf[9] << 8 | (uint32_t)headerBuf[10] << 16 | (uint32_t)headerBuf[11] << 24);
 
 	// Size of number of complete DMR ID records for the first storage location
@@ -1094,6 +1275,7 @@ void dmrIDCacheInit(void)
 void dmrIDCacheClear(void)
 {
 	memset(&dmrIDsCache, 0, sizeof(dmrIDsCache_t));
+	dmrIDv2BlockNumber = -1;
 }
 
 uint32_t dmrIDCacheGetCount(void)
@@ -1139,10 +1321,141 @@ static void dmrDbTextDecode(uint8_t *decompressedBufOut, uint8_t *compressedBufI
 	}
 }
 
+// Canonical Huffman decoding, MSB first
+static void dmrIDv2TextDecode(char *textOut, const uint8_t *in, uint32_t inLength)
+{
+	uint32_t bitPos = 0;
+	uint32_t numBits = (inLength * 8);
+	int outLength = 0;
+
+	while (outLength < (MAX_DMR_ID_CONTACT_TEXT_LENGTH - 1))
+	{
+		int code = 0;
+		int first = 0;
+		int index = 0;
+		int symbol = -1;
+
+		for (uint8_t len = 1; (len <= DMRID_V2_MAX_CODE_LENGTH) && (bitPos < numBits); len++)
+		{
+			int count = dmrIDv2Header.codeLengthCounts[len];
+
+			code |= ((in[bitPos >> 3] >> (7 - (bitPos & 0x07))) & 0x01);
+			bitPos++;
+
+			if ((code - count) < first)
+			{
+				symbol = dmrIDv2Header.symbols[index + (code - first)];
+				break;
+			}
+
+			index += count;
+			first = ((first + count) << 1);
+			code <<= 1;
+		}
+
+		if (symbol <= 0) // End of text, or invalid code
+		{
+			break;
+		}
+
+		textOut[outLength++] = symbol;
+	}
+
+	textOut[outLength] = 0;
+}
+
+static bool dmrIDv2Lookup(uint32_t targetId, dmrIdDataStruct_t *foundRecord)
+{
+	uint32_t id;
+	uint32_t pos = 1;
+	uint32_t textEnd = DMRID_V2_BLOCK_SIZE;
+	uint8_t numRecords;
+
+	if ((targetId < dmrIDsCache.slices[0]) || (targetId > dmrIDv2Header.lastId))
+	{
+		return false;
+	}
+
+	if ((dmrIDv2FindBlock(targetId) == false) || (dmrIDv2LoadBlock(1) == false))
+	{
+		return false;
+	}
+
+	id = dmrIDv2BlockFirstId;
+	numRecords = dmrIDv2Block[0];
+
+	while (numRecords--)
+	{
+		uint32_t delta = 0;
+		uint8_t shift = 0;
+		uint8_t b;
+		uint8_t textLength;
+
+		do
+		{
+			if ((shift > 28) || (dmrIDv2LoadBlock(pos + 1) == false))
+			{
+				return false;
+			}
+
+			b = dmrIDv2Block[pos++];
+			delta |= ((uint32_t)(b & 0x7F) << shift);
+			shift += 7;
+		} while (b & 0x80);
+
+		id += delta;
+
+		if (dmrIDv2LoadBlock(pos + 1) == false)
+		{
+			return false;
+		}
+
+		textLength = dmrIDv2Block[pos++];
+
+		// The texts are stored backwards from the end of the block, they can't reach the IDs
+		if (textLength > (textEnd - pos))
+		{
+			return false;
+		}
+
+		textEnd -= textLength;
+
+		if (id == targetId)
+		{
+			// Only the text is read, at its place in the block buffer
+			if (((textEnd + textLength) > dmrIDv2BlockLength) &&
+					(SPI_Flash_read(dmrIDv2BlockAddress(dmrIDv2BlockNumber) + textEnd, &dmrIDv2Block[textEnd], textLength) == false))
+			{
+				return false;
+			}
+
+			foundRecord->id = id;
+			dmrIDv2TextDecode(foundRecord->text, &dmrIDv2Block[textEnd], textLength);
+			return true;
+		}
+		else if (id > targetId)
+		{
+			break;
+		}
+	}
+
+	return false;
+}
+
 bool dmrIDLookup(uint32_t targetId, dmrIdDataStruct_t *foundRecord)
 {
 	uint32_t targetIdBCD;
 
+	if (dmrIDsCache.version == 2)
+	{
+		if ((dmrIDsCache.entries > 0) && dmrIDv2Lookup(targetId, foundRecord))
+		{
+			return true;
+		}
+
+		goto spiReadFailure;
+	}
+
 	if (DMRID_IdLength == 4U)
 	{
 		targetIdBCD = int2bcd(targetId);
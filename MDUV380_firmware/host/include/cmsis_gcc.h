@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Host replacement of CMSIS cmsis_gcc.h (force included, see Makefile): compiler abstraction, and the few core intrinsics
+// the application uses, implemented in C (no ARM instructions).
+
+#ifndef __CMSIS_GCC_H
+#define __CMSIS_GCC_H
+
+#include <stdint.h>
+
+#define __ASM                                  __asm
+#define __INLINE                               inline
+#define __STATIC_INLINE                        static inline
+#define __STATIC_FORCEINLINE                   __attribute__((always_inline)) static inline
+#define __NO_RETURN                            __attribute__((__noreturn__))
+#define __USED                                 __attribute__((used))
+#define __WEAK                                 __attribute__((weak))
+#define __PACKED                               __attribute__((packed, aligned(1)))
+#define __PACKED_STRUCT                        struct __attribute__((packed, aligned(1)))
+#define __PACKED_UNION                         union __attribute__((packed, aligned(1)))
+#define __ALIGNED(x)                           __attribute__((aligned(x)))
+#define __RESTRICT                             __restrict
+#define __COMPILER_BARRIER()                   __ASM volatile("":::"memory")
+
+#define __UNALIGNED_UINT16_READ(addr)          (*((const uint16_t *)(const void *)(addr)))
+#define __UNALIGNED_UINT16_WRITE(addr, val)    (void)(*((uint16_t *)(void *)(addr)) = (val))
+#define __UNALIGNED_UINT32_READ(addr)          (*((const uint32_t *)(const void *)(addr)))
+#define __UNALIGNED_UINT32_WRITE(addr, val)    (void)(*((uint32_t *)(void *)(addr)) = (val))
+#define __UNALIGNED_UINT32(x)                  (*((uint32_t *)(x)))
+
+#define __NOP()                                __COMPILER_BARRIER()
+#define __WFI()                                __COMPILER_BARRIER()
+#define __WFE()                                __COMPILER_BARRIER()
+#define __SEV()                                __COMPILER_BARRIER()
+#define __BKPT(value)                          __builtin_trap()
+
+__STATIC_FORCEINLINE void __ISB(void)
+{
+	__sync_synchronize();
+}
+
+__STATIC_FORCEINLINE void __DSB(void)
+{
+	__sync_synchronize();
+}
+
+__STATIC_FORCEINLINE void __DMB(void)
+{
+	__sync_synchronize();
+}
+
+__STATIC_FORCEINLINE uint32_t __REV(uint32_t value)
+{
+	return __builtin_bswap32(value);
+}
+
+__STATIC_FORCEINLINE uint32_t __REV16(uint32_t value)
+{
+	return (((value & 0xFF00FF00U) >> 8) | ((value & 0x00FF00FFU) << 8));
+}
+
+__STATIC_FORCEINLINE int16_t __REVSH(int16_t value)
+{
+	return (int16_t)__builtin_bswap16((uint16_t)value);
+}
+
+__STATIC_FORCEINLINE uint32_t __ROR(uint32_t op1, uint32_t op2)
+{
+	op2 %= 32U;
+	return ((op2 == 0U) ? op1 : ((op1 >> op2) | (op1 << (32U - op2))));
+}
+
+__STATIC_FORCEINLINE uint32_t __RBIT(uint32_t value)
+{
+	uint32_t result = 0;
+
+	for (int i = 0; i < 32; i++)
+	{
+		result = (result << 1) | (value & 0x01);
+		value >>= 1;
+	}
+
+	return result;
+}
+
+__STATIC_FORCEINLINE uint8_t __CLZ(uint32_t value)
+{
+	return ((value == 0U) ? 32U : (uint8_t)__builtin_clz(value));
+}
+
+__STATIC_FORCEINLINE int32_t __SSAT(int32_t val, uint32_t sat)
+{
+	const int32_t max = (int32_t)((1U << (sat - 1U)) - 1U);
+	const int32_t min = -1 - max;
+
+	return ((val > max) ? max : ((val < min) ? min : val));
+}
+
+__STATIC_FORCEINLINE uint32_t __USAT(int32_t val, uint32_t sat)
+{
+	const uint32_t max = ((1U << sat) - 1U);
+
+	return ((val > (int32_t)max) ? max : ((val < 0) ? 0U : (uint32_t)val));
+}
+
+// Interrupts don't exist on the host, everything runs in thread mode.
+__STATIC_FORCEINLINE void __enable_irq(void) { }
+__STATIC_FORCEINLINE void __disable_irq(void) { }
+__STATIC_FORCEINLINE void __enable_fault_irq(void) { }
+__STATIC_FORCEINLINE void __disable_fault_irq(void) { }
+__STATIC_FORCEINLINE uint32_t __get_IPSR(void) { return 0U; }
+__STATIC_FORCEINLINE uint32_t __get_PRIMASK(void) { return 0U; }
+__STATIC_FORCEINLINE void __set_PRIMASK(uint32_t priMask) { (void)priMask; }
+__STATIC_FORCEINLINE uint32_t __get_BASEPRI(void) { return 0U; }
+__STATIC_FORCEINLINE void __set_BASEPRI(uint32_t basePri) { (void)basePri; }
+__STATIC_FORCEINLINE void __set_BASEPRI_MAX(uint32_t basePri) { (void)basePri; }
+__STATIC_FORCEINLINE uint32_t __get_FAULTMASK(void) { return 0U; }
+__STATIC_FORCEINLINE void __set_FAULTMASK(uint32_t faultMask) { (void)faultMask; }
+__STATIC_FORCEINLINE uint32_t __get_CONTROL(void) { return 0U; }
+__STATIC_FORCEINLINE void __set_CONTROL(uint32_t control) { (void)control; }
+__STATIC_FORCEINLINE uint32_t __get_FPSCR(void) { return 0U; }
+__STATIC_FORCEINLINE void __set_FPSCR(uint32_t fpscr) { (void)fpscr; }
+
+#endif /* __CMSIS_GCC_H */
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+// Host replacement of the FreeRTOS ARM_CM4F portmacro.h. The simulator runs the application
+// in a single thread, hence the kernel API is provided by sim/simRTOS.c instead of the FreeRTOS sources.
+
+#ifndef PORTMACRO_H
+#define PORTMACRO_H
+
+#include <stdint.h>
+
+#define portCHAR                          char
+#define portFLOAT                         float
+#define portDOUBLE                        double
+#define portLONG                          long
+#define portSHORT                         short
+#define portSTACK_TYPE                    uint32_t
+#define portBASE_TYPE                     long
+
+typedef portSTACK_TYPE StackType_t;
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+
+typedef uint32_t TickType_t;
+#define portMAX_DELAY                     (TickType_t)0xffffffffUL
+#define portTICK_TYPE_IS_ATOMIC           1
+
+#define portSTACK_GROWTH                  (-1)
+#define portTICK_PERIOD_MS                ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portBYTE_ALIGNMENT                8
+
+extern void vPortEnterCritical(void);
+extern void vPortExitCritical(void);
+extern void vPortYield(void);
+
+#define portYIELD()                                   vPortYield()
+#define portEND_SWITCHING_ISR(xSwitchRequired)        do { if ((xSwitchRequired) != pdFALSE) { portYIELD(); } } while(0)
+#define portYIELD_FROM_ISR(x)                         portEND_SWITCHING_ISR(x)
+#define portSET_INTERRUPT_MASK_FROM_ISR()             0
+#define portCLEAR_INTERRUPT_MASK_FROM_ISR(x)          (void)(x)
+#define portDISABLE_INTERRUPTS()
+#define portENABLE_INTERRUPTS()
+#define portENTER_CRITICAL()                          vPortEnterCritical()
+#define portEXIT_CRITICAL()                           vPortExitCritical()
+
+#define portTASK_FUNCTION_PROTO(vFunction, pvParameters) void vFunction(void *pvParameters)
+#define portTASK_FUNCTION(vFunction, pvParameters)       void vFunction(void *pvParameters)
+
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION       0
+#define portASSERT_IF_INTERRUPT_PRIORITY_INVALID()
+#define portNOP()
+#define portINLINE                                    __inline
+#define portFORCE_INLINE                              inline __attribute__((always_inline))
+#define portMEMORY_BARRIER()                          __asm volatile("" ::: "memory")
+
+static portFORCE_INLINE BaseType_t xPortIsInsideInterrupt(void)
+{
+	return 0;
+}
+
+#endif /* PORTMACRO_H */
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <signal.h>
+#include <getopt.h>
+#include <execinfo.h>
+#include <unistd.h>
+#include "sim.h"
+
+extern void applicationMainTask(void);
+extern volatile uint32_t uwTick;
+
+bool simVerbose = false;
+
+static bool dumpRegistersOnExit = false;
+
+void simExit(int status)
+{
+	if (dumpRegistersOnExit)
+	{
+		simRadioDump();
+	}
+
+	simFlashSave();
+	simUSBClose();
+
+#if defined(USING_TRACE)
+	simTraceClose();
+#endif
+
+	// Failed script expectations
+	if ((status == EXIT_SUCCESS) && (simScriptGetFailures() > 0))
+	{
+		status = EXIT_FAILURE;
+	}
+
+	exit(status);
+}
+
+void simFatal(const char *format, ...)
+{
+	va_list args;
+
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+
+	simExit(EXIT_FAILURE);
+}
+
+static void signalHandler(int signum)
+{
+	simExit(EXIT_SUCCESS);
+}
+
+// Something accessed an address which isn't backed (or the stack overflowed)
+static void crashHandler(int signum)
+{
+	void *frames[32];
+	int numFrames = backtrace(frames, 32);
+
+	fprintf(stderr, "Fatal signal %d, at %u ms:\n", signum, uwTick);
+	backtrace_symbols_fd(frames, numFrames, STDERR_FILENO);
+	_exit(EXIT_FAILURE);
+}
+
+static void usage(const char *name)
+{
+	printf("Usage: %s [options]\n"
+			"  -f, --flash <file>      SPI flash image (16MB, created if it doesn't exist, saved on exit)\n"
+			"  -c, --security <file>   SPI flash security registers (calibration, 768 bytes)\n"
+			"  -s, --script <file>     input script (see sim/simScript.c)\n"
+#if defined(USING_TRACE)
+			"  -t, --trace <file>      raw trace capture (see tools/trace_decode.py)\n"
+#endif
+			"  -u, --usb               USB CDC on a pseudo terminal (CPS, hotspot)\n"
+			"  -r, --registers         dump the radio chips registers on exit\n"
+			"  -v, --verbose\n"
+			"  -h, --help\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option options[] =
+	{
+		{ "flash",     required_argument, NULL, 'f' },
+		{ "security",  required_argument, NULL, 'c' },
+		{ "script",    required_argument, NULL, 's' },
+#if defined(USING_TRACE)
+		{ "trace",     required_argument, NULL, 't' },
+#endif
+		{ "usb",       no_argument,       NULL, 'u' },
+		{ "registers", no_argument,       NULL, 'r' },
+		{ "verbose",   no_argument,       NULL, 'v' },
+		{ "help",      no_argument,       NULL, 'h' },
+		{ NULL,        0,                 NULL, 0   }
+	};
+	const char *flashPath = NULL;
+	const char *securityPath = NULL;
+	const char *scriptPath = NULL;
+	const char *tracePath = NULL;
+	bool usb = false;
+	int opt;
+
+	while ((opt = getopt_long(argc, argv, "f:c:s:t:urvh", options, NULL)) != -1)
+	{
+		switch (opt)
+		{
+			case 'f':
+				flashPath = optarg;
+				break;
+			case 'c':
+				securityPath = optarg;
+				break;
+			case 's':
+				scriptPath = optarg;
+				break;
+#if defined(USING_TRACE)
+			case 't':
+				tracePath = optarg;
+				break;
+#endif
+			case 'u':
+				usb = true;
+				break;
+			case 'r':
+				dumpRegistersOnExit = true;
+				break;
+			case 'v':
+				simVerbose = true;
+				break;
+			case 'h':
+				usage(argv[0]);
+				return EXIT_SUCCESS;
+			default:
+				usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	if (!simHALMapPeripherals())
+	{
+		return EXIT_FAILURE;
+	}
+
+	if (!simFlashLoad(flashPath))
+	{
+		fprintf(stderr, "Failed to allocate the flash image\n");
+		return EXIT_FAILURE;
+	}
+
+	if ((securityPath != NULL) && !simFlashLoadSecurityRegisters(securityPath))
+	{
+		fprintf(stderr, "Failed to read %s\n", securityPath);
+		return EXIT_FAILURE;
+	}
+
+	if ((scriptPath != NULL) && !simScriptLoad(scriptPath))
+	{
+		fprintf(stderr, "Failed to read %s\n", scriptPath);
+		return EXIT_FAILURE;
+	}
+
+#if defined(USING_TRACE)
+	if ((tracePath != NULL) && !simTraceOpen(tracePath))
+	{
+		fprintf(stderr, "Failed to create %s\n", tracePath);
+		return EXIT_FAILURE;
+	}
+#endif
+
+	if (usb)
+	{
+		if (!simUSBOpen())
+		{
+			fprintf(stderr, "Failed to create the USB pseudo terminal\n");
+			return EXIT_FAILURE;
+		}
+
+		printf("USB CDC: %s\n", simUSBGetPath());
+	}
+
+	signal(SIGINT, signalHandler);
+	signal(SIGTERM, signalHandler);
+	signal(SIGSEGV, crashHandler);
+	signal(SIGBUS, crashHandler);
+
+	simHALInit();
+
+	applicationMainTask(); // never returns
+
+	return EXIT_SUCCESS;
+}
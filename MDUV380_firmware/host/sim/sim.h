@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Host simulation (PLATFORM_HOST) internals, shared by the sim/ sources only.
+
+typedef enum
+{
+	SIM_INPUT_KEY_1 = 0,
+	SIM_INPUT_KEY_2,
+	SIM_INPUT_KEY_3,
+	SIM_INPUT_KEY_4,
+	SIM_INPUT_KEY_5,
+	SIM_INPUT_KEY_6,
+	SIM_INPUT_KEY_0,
+	SIM_INPUT_KEY_STAR,
+	SIM_INPUT_KEY_GREEN,
+	SIM_INPUT_KEY_UP,
+	SIM_INPUT_KEY_DOWN,
+	SIM_INPUT_KEY_7,
+	SIM_INPUT_KEY_8,
+	SIM_INPUT_KEY_9,
+	SIM_INPUT_KEY_HASH,
+	SIM_INPUT_KEY_RED,
+	SIM_INPUT_SK1,
+	SIM_INPUT_SK2,
+	SIM_INPUT_PTT,
+	SIM_INPUT_PTT_EXTERNAL,
+	SIM_INPUT_COUNT
+} simInput_t;
+
+extern bool simVerbose;
+
+#define SIM_LOG(...) do { if (simVerbose) { fprintf(stderr, __VA_ARGS__); } } while (0)
+
+// hostMain.c
+void simExit(int status) __attribute__((noreturn));
+void simFatal(const char *format, ...) __attribute__((noreturn));
+
+// simRTOS.c: virtual clock, 1ms tick
+void simClockAdvance(uint32_t ms);
+uint32_t simClockGetMillis(void);
+
+// simHAL.c: GPIO level inputs (keypad matrix, side buttons, PTT, rotary encoder), ADC
+extern uint32_t simVolumeADC;
+
+bool simHALMapPeripherals(void);
+void simHALInit(void);
+void simHALTick(uint32_t now);
+int simInputFromName(const char *name);
+void simInputSet(simInput_t input, bool pressed);
+void simRotaryStep(int direction);
+
+// simRadio.c: AT1846S (I2C) and HR-C6000 (SPI) register files
+#define SIM_RADIO_SPI0_LOG_SIZE     1024
+
+typedef struct
+{
+	uint8_t  page;  // | 0x40 for the extended registers
+	uint16_t reg;
+	uint8_t  value;
+} simRadioSPI0Write_t;
+
+typedef struct
+{
+	simRadioSPI0Write_t writes[SIM_RADIO_SPI0_LOG_SIZE];
+	int                 count;
+	int                 transfers; // CS cycles
+} simRadioSPI0Log_t;
+
+bool simRadioI2CTransmit(uint16_t address, const uint8_t *data, uint16_t size);
+bool simRadioI2CReceive(uint16_t address, uint8_t *data, uint16_t size);
+void simRadioDump(void);
+void simRadioSPI0LogClear(void);
+const simRadioSPI0Log_t *simRadioSPI0LogGet(void);
+uint8_t simRadioSPI0Register(uint8_t page, uint16_t reg);
+
+// simFlash.c: SPI flash chip
+bool simFlashLoad(const char *path);
+bool simFlashLoadSecurityRegisters(const char *path);
+bool simFlashSave(void);
+void simFlashChipSelect(bool selected);
+void simFlashGetStats(uint32_t *transactions, uint32_t *bytes);
+
+// simDisplay.c: HX8353E panel
+void simDisplayDMA(const uint8_t *data, uint32_t length);
+uint16_t simDisplayGetPixel(int x, int y);
+bool simDisplaySavePNG(const char *path);
+bool simDisplayFindText(const char *text);
+
+// simScript.c
+bool simScriptLoad(const char *path);
+void simScriptTick(uint32_t now);
+bool simScriptIsDone(void);
+int simScriptGetFailures(void);
+
+// simTrace.c: RTT trace channel capture (USING_TRACE)
+bool simTraceOpen(const char *path);
+void simTraceDrain(void);
+void simTraceClose(void);
+
+// simUSB.c: USB CDC, on a pseudo terminal
+bool simUSBOpen(void);
+const char *simUSBGetPath(void);
+void simUSBClose(void);
+void simUSBTick(void);
+
+#endif
@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "hardware/HX8353E.h"
+#include "io/display.h"
+#include "functions/settings.h"
+#include "interfaces/gpio.h"
+#include "user_interface/uiGlobals.h"
+#include "main.h"
+#include "sim.h"
+
+//
+// HX8353E panel, replaces io/display.c.
+//
+// The application renders with displayRenderRows() unmodified: it sets the row window, and
+// the screen buffer reaches the panel through the memory to FSMC DMA (HAL_DMA_Start()).
+// The panel RAM (RGB565, MSB first) is what the PNG dumps show, with the inversion applied.
+//
+
+#define PANEL_WIDTH     DISPLAY_SIZE_X
+#define PANEL_HEIGHT    128
+
+uint8_t displayLCD_Type = 1;
+
+static bool displayIsInverseVideo = false;
+
+static uint16_t panelRAM[PANEL_HEIGHT][PANEL_WIDTH];
+static uint8_t  panelCommand = 0;
+static uint16_t panelColumnStart = 0;
+static uint16_t panelRowStart = 0;
+static uint32_t panelWritePosition = 0;
+static bool     panelIsInverted = false;
+static bool     panelIsAwake = false;
+
+static void panelCommandWrite(uint8_t cmd, size_t len, const uint8_t *opts)
+{
+	panelCommand = cmd;
+
+	switch (cmd)
+	{
+		case HX8583_CMD_CASET:
+			if (len >= 2)
+			{
+				panelColumnStart = ((opts[0] << 8) | opts[1]);
+			}
+			break;
+		case HX8583_CMD_RASET:
+			if (len >= 2)
+			{
+				panelRowStart = ((opts[0] << 8) | opts[1]);
+			}
+			break;
+		case HX8583_CMD_RAMWR:
+			panelWritePosition = 0;
+			break;
+		case HX8583_CMD_INVON:
+			panelIsInverted = true;
+			break;
+		case HX8583_CMD_INVOFF:
+			panelIsInverted = false;
+			break;
+		case HX8583_CMD_SLPIN:
+			panelIsAwake = false;
+			break;
+		case HX8583_CMD_SLPOUT:
+			panelIsAwake = true;
+			break;
+	}
+}
+
+void simDisplayDMA(const uint8_t *data, uint32_t length)
+{
+	if (panelCommand != HX8583_CMD_RAMWR)
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; (i + 1) < length; i += 2, panelWritePosition++)
+	{
+		uint32_t x = panelColumnStart + (panelWritePosition % (PANEL_WIDTH - panelColumnStart));
+		uint32_t y = panelRowStart + (panelWritePosition / (PANEL_WIDTH - panelColumnStart));
+
+		if (y < PANEL_HEIGHT)
+		{
+			panelRAM[y][x] = ((data[i] << 8) | data[i + 1]);
+		}
+	}
+}
+
+// Panel RAM content (RGB565), without the inversion
+uint16_t simDisplayGetPixel(int x, int y)
+{
+	return panelRAM[y][x];
+}
+
+// The text pixels must all have one colour, the other pixels of their bounding box another one
+static bool panelHasPattern(const uint16_t *pattern, int x0, int y0, int width, int height)
+{
+	int32_t colours[2] = { -1, -1 }; // Background, text
+
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			int isText = (pattern[(y * DISPLAY_SIZE_X) + x] != 0);
+			uint16_t colour = panelRAM[y0 + y][x0 + x];
+
+			if (colours[isText] < 0)
+			{
+				colours[isText] = colour;
+			}
+			else if (colours[isText] != colour)
+			{
+				return false;
+			}
+		}
+	}
+
+	return (colours[0] != colours[1]);
+}
+
+// Whether the text is shown, in any font, colour and position. The firmware renders it in a scratch buffer,
+// which gives the glyph pixels to look for in the panel RAM.
+bool simDisplayFindText(const char *text)
+{
+	static uint16_t scratch[DISPLAY_SIZE_X * DISPLAY_SIZE_Y];
+	const ucFont_t fonts[] = { FONT_SIZE_1, FONT_SIZE_1_BOLD, FONT_SIZE_2, FONT_SIZE_3, FONT_SIZE_4 };
+	uint16_t *screenBuffer = displayGetScreenBuffer();
+	uint16_t fgColour, bgColour;
+	bool found = false;
+
+	displayGetForegroundAndBackgroundColours(&fgColour, &bgColour);
+	displayOverrideScreenBuffer(scratch);
+	displaySetForegroundAndBackgroundColours(0xFFFF, 0x0000);
+
+	for (size_t f = 0; (f < (sizeof(fonts) / sizeof(fonts[0]))) && (found == false); f++)
+	{
+		int minX = DISPLAY_SIZE_X, minY = DISPLAY_SIZE_Y, maxX = -1, maxY = -1;
+
+		memset(scratch, 0, sizeof(scratch));
+		displayPrintCore(0, 0, text, fonts[f], TEXT_ALIGN_LEFT, false);
+
+		for (int y = 0; y < DISPLAY_SIZE_Y; y++)
+		{
+			for (int x = 0; x < DISPLAY_SIZE_X; x++)
+			{
+				if (scratch[(y * DISPLAY_SIZE_X) + x] != 0)
+				{
+					minX = MIN(minX, x);
+					minY = MIN(minY, y);
+					maxX = MAX(maxX, x);
+					maxY = MAX(maxY, y);
+				}
+			}
+		}
+
+		if (maxX < 0)
+		{
+			continue; // Blank, or doesn't fit on the screen
+		}
+
+		for (int y = 0; (y <= (DISPLAY_SIZE_Y - (maxY - minY + 1))) && (found == false); y++)
+		{
+			for (int x = 0; (x <= (DISPLAY_SIZE_X - (maxX - minX + 1))) && (found == false); x++)
+			{
+				found = panelHasPattern(&scratch[(minY * DISPLAY_SIZE_X) + minX], x, (y + DISPLAY_Y_OFFSET), (maxX - minX + 1), (maxY - minY + 1));
+			}
+		}
+	}
+
+	displayOverrideScreenBuffer(screenBuffer);
+	displaySetForegroundAndBackgroundColours(fgColour, bgColour);
+
+	return found;
+}
+
+static void pngWriteChunk(FILE *f, const char *type, const uint8_t *data, uint32_t length)
+{
+	uint8_t header[8] = { (length >> 24), (length >> 16), (length >> 8), length, type[0], type[1], type[2], type[3] };
+	uLong crc = crc32(crc32(0L, Z_NULL, 0), header + 4, 4);
+	uint8_t footer[4];
+
+	crc = crc32(crc, data, length);
+	footer[0] = (crc >> 24);
+	footer[1] = (crc >> 16);
+	footer[2] = (crc >> 8);
+	footer[3] = crc;
+
+	fwrite(header, 1, sizeof(header), f);
+	fwrite(data, 1, length, f);
+	fwrite(footer, 1, sizeof(footer), f);
+}
+
+bool simDisplaySavePNG(const char *path)
+{
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	const uint32_t rowSize = 1 + (PANEL_WIDTH * 3); // filter type + RGB
+	uint8_t ihdr[13] = { 0, 0, (PANEL_WIDTH >> 8), PANEL_WIDTH, 0, 0, (PANEL_HEIGHT >> 8), PANEL_HEIGHT, 8, 2, 0, 0, 0 };
+	uint8_t *raw = malloc(rowSize * PANEL_HEIGHT);
+	uLongf compressedSize = compressBound(rowSize * PANEL_HEIGHT);
+	uint8_t *compressed = malloc(compressedSize);
+	bool success = false;
+	FILE *f;
+
+	if ((raw == NULL) || (compressed == NULL))
+	{
+		goto exit;
+	}
+
+	for (int y = 0; y < PANEL_HEIGHT; y++)
+	{
+		uint8_t *p = raw + (y * rowSize);
+
+		*p++ = 0; // no filter
+		for (int x = 0; x < PANEL_WIDTH; x++)
+		{
+			uint16_t pixel = (panelIsAwake ? (panelIsInverted ? ~panelRAM[y][x] : panelRAM[y][x]) : 0);
+
+			*p++ = (((pixel >> 11) & 0x1F) * 255) / 31;
+			*p++ = (((pixel >> 5) & 0x3F) * 255) / 63;
+			*p++ = ((pixel & 0x1F) * 255) / 31;
+		}
+	}
+
+	if ((compress2(compressed, &compressedSize, raw, (rowSize * PANEL_HEIGHT), Z_BEST_COMPRESSION) != Z_OK) ||
+			((f = fopen(path, "wb")) == NULL))
+	{
+		goto exit;
+	}
+
+	fwrite(signature, 1, sizeof(signature), f);
+	pngWriteChunk(f, "IHDR", ihdr, sizeof(ihdr));
+	pngWriteChunk(f, "IDAT", compressed, compressedSize);
+	pngWriteChunk(f, "IEND", NULL, 0);
+	success = (fclose(f) == 0);
+
+	exit:
+	free(raw);
+	free(compressed);
+
+	return success;
+}
+
+void displayWriteCmd(uint8_t cmd)
+{
+	panelCommandWrite(cmd, 0, NULL);
+}
+
+void displayWriteData(uint8_t val)
+{
+	simDisplayDMA((const uint8_t []){ 0x00, val }, 2);
+}
+
+void displayWriteCmds(uint8_t cmd, size_t len, uint8_t opts[])
+{
+	panelCommandWrite(cmd, len, opts);
+}
+
+void displaySetInvertedState(bool isInverted)
+{
+	if (displayIsInverseVideo != isInverted)
+	{
+		displayIsInverseVideo = isInverted;
+		displayWriteCmd(displayIsInverseVideo ? HX8583_CMD_INVON : HX8583_CMD_INVOFF);
+		displaySetInverseVideo(displayIsInverseVideo);
+	}
+}
+
+void displayInit(bool isInverted, bool SPIFlashAvailable)
+{
+	{
+		uint8_t opts[] = { 0x00, 0x00, 0x00, DISPLAY_SIZE_X };
+		displayWriteCmds(HX8583_CMD_CASET, sizeof(opts), opts);
+	}
+
+	{
+		uint8_t opts[] = { 0x00, 0x00, 0x00, DISPLAY_SIZE_Y };
+		displayWriteCmds(HX8583_CMD_RASET, sizeof(opts), opts);
+	}
+
+	displayWriteCmd(HX8583_CMD_SLPOUT);
+	displayWriteCmd(HX8583_CMD_DISPON);
+
+	displayBegin(isInverted, SPIFlashAvailable);
+	displayClearBuf();
+	displayRender();
+}
+
+void displayEnableBacklight(bool enable, int displayBacklightPercentageOff)
+{
+	if (enable)
+	{
+		gpioSetDisplayBacklightIntensityPercentage(nonVolatileSettings.displayBacklightPercentage[DAYTIME_CURRENT]);
+	}
+	else
+	{
+		gpioSetDisplayBacklightIntensityPercentage(((nonVolatileSettings.backlightMode == BACKLIGHT_MODE_NONE) ? 0 : displayBacklightPercentageOff));
+	}
+}
+
+bool displayIsBacklightLit(void)
+{
+	return (gpioGetDisplayBacklightIntensityPercentage() != nonVolatileSettings.displayBacklightPercentageOff);
+}
@@ -0,0 +1,404 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "sim.h"
+
+//
+// W25Q128 (16MB) SPI flash, on SPI1. The real SPI_Flash.c driver is used, this emulates the chip
+// at the HAL_SPI level: command, address and data bytes are exchanged while the CS pin is low.
+//
+// Program and erase only clear/set bits when the write enable latch is set, and keep the chip
+// busy for their typical duration (so the driver polls the status register, as on the radio).
+// An erase can be suspended (reads are possible meanwhile) and resumed.
+//
+// The image is loaded from, and saved back to, a file (--flash). The security registers
+// (calibration data, 3 x 256 bytes) can be loaded from another one (--security).
+//
+
+#define FLASH_SIZE                  (16 * 1024 * 1024)
+#define FLASH_PAGE_SIZE             256
+#define FLASH_SECTOR_SIZE           4096
+#define FLASH_NUM_SECURITY_REGS     3
+#define FLASH_JEDEC_ID              0xEF4018 // Winbond, 25Q128
+
+#define FLASH_PAGE_PROGRAM_TIME     1   // ms
+#define FLASH_SECTOR_ERASE_TIME     45  // ms
+#define FLASH_BLOCK_ERASE_TIME      150 // ms
+#define FLASH_CHIP_ERASE_TIME       20000 // ms
+
+#define FLASH_CMD_WRITE_ENABLE      0x06
+#define FLASH_CMD_WRITE_DISABLE     0x04
+#define FLASH_CMD_READ_SR1          0x05
+#define FLASH_CMD_READ_SR2          0x35
+#define FLASH_CMD_READ_SR3          0x15
+#define FLASH_CMD_PAGE_PROGRAM      0x02
+#define FLASH_CMD_SECTOR_ERASE      0x20
+#define FLASH_CMD_BLOCK_ERASE_32K   0x52
+#define FLASH_CMD_BLOCK_ERASE_64K   0xD8
+#define FLASH_CMD_CHIP_ERASE        0xC7
+#define FLASH_CMD_CHIP_ERASE2       0x60
+#define FLASH_CMD_READ_DATA         0x03
+#define FLASH_CMD_FAST_READ         0x0B
+#define FLASH_CMD_READ_JEDEC_ID     0x9F
+#define FLASH_CMD_READ_SEC_REGS     0x48
+#define FLASH_CMD_ERASE_SUSPEND     0x75
+#define FLASH_CMD_ERASE_RESUME      0x7A
+
+#define FLASH_SR1_BUSY              0x01
+#define FLASH_SR1_WEL               0x02
+#define FLASH_SR2_SUS               0x80
+
+static uint8_t *flashImage = NULL;
+static uint8_t flashSecurityRegisters[FLASH_NUM_SECURITY_REGS][FLASH_PAGE_SIZE];
+static const char *flashImagePath = NULL;
+static bool flashIsDirty = false;
+
+static bool     flashSelected = false;
+static uint32_t flashByteIndex;
+static uint8_t  flashCommand;
+static uint32_t flashAddress;
+static bool     flashWriteEnabled = false;
+static uint32_t flashBusyUntil = 0;
+static bool     flashIsErasing = false;
+static bool     flashEraseIsSuspended = false;
+static uint32_t flashEraseRemaining = 0;
+static uint32_t flashTransactions = 0;
+static uint32_t flashBytes = 0;
+
+SPI_HandleTypeDef hspi1;
+SPI_HandleTypeDef hspi2;
+
+static bool flashLoadFile(const char *path, uint8_t *dest, size_t size)
+{
+	FILE *f = fopen(path, "rb");
+
+	if (f == NULL)
+	{
+		return false;
+	}
+
+	size_t length = fread(dest, 1, size, f);
+	fclose(f);
+
+	SIM_LOG("Flash: %zu bytes loaded from %s\n", length, path);
+	return true;
+}
+
+bool simFlashLoad(const char *path)
+{
+	if ((flashImage == NULL) && ((flashImage = malloc(FLASH_SIZE)) == NULL))
+	{
+		return false;
+	}
+
+	memset(flashImage, 0xFF, FLASH_SIZE);
+	memset(flashSecurityRegisters, 0xFF, sizeof(flashSecurityRegisters));
+
+	// No image: erased chip, nothing is saved
+	if ((flashImagePath = path) == NULL)
+	{
+		return true;
+	}
+
+	if (!flashLoadFile(path, flashImage, FLASH_SIZE))
+	{
+		// Will be created on exit
+		SIM_LOG("Flash: %s doesn't exist, starting with an erased chip\n", path);
+	}
+
+	return true;
+}
+
+bool simFlashLoadSecurityRegisters(const char *path)
+{
+	return flashLoadFile(path, &flashSecurityRegisters[0][0], sizeof(flashSecurityRegisters));
+}
+
+bool simFlashSave(void)
+{
+	if ((flashImagePath == NULL) || !flashIsDirty)
+	{
+		return true;
+	}
+
+	FILE *f = fopen(flashImagePath, "wb");
+	bool success = false;
+
+	if (f != NULL)
+	{
+		success = (fwrite(flashImage, 1, FLASH_SIZE, f) == FLASH_SIZE);
+		fclose(f);
+	}
+
+	if (success)
+	{
+		flashIsDirty = false;
+	}
+	else
+	{
+		fprintf(stderr, "Flash: failed to save %s\n", flashImagePath);
+	}
+
+	return success;
+}
+
+static inline bool flashIsBusy(void)
+{
+	return ((int32_t)(flashBusyUntil - uwTick) > 0);
+}
+
+static void flashErase(uint32_t address, uint32_t size, uint32_t duration)
+{
+	if (flashWriteEnabled && !flashIsBusy())
+	{
+		address &= ~(size - 1);
+		memset(flashImage + (address % FLASH_SIZE), 0xFF, size);
+		flashIsDirty = true;
+		flashBusyUntil = uwTick + duration;
+		flashIsErasing = true;
+	}
+
+	flashWriteEnabled = false;
+}
+
+// CS falling edge starts a transaction, rising edge ends it (erase/program are executed then).
+void simFlashChipSelect(bool selected)
+{
+	if (selected == flashSelected)
+	{
+		return;
+	}
+
+	flashSelected = selected;
+
+	if (selected)
+	{
+		flashByteIndex = 0;
+		flashTransactions++;
+		return;
+	}
+
+	if (flashByteIndex < 4)
+	{
+		return;
+	}
+
+	switch (flashCommand)
+	{
+		case FLASH_CMD_PAGE_PROGRAM:
+			if (flashWriteEnabled)
+			{
+				flashBusyUntil = uwTick + FLASH_PAGE_PROGRAM_TIME;
+				flashIsErasing = false;
+			}
+			flashWriteEnabled = false;
+			break;
+		case FLASH_CMD_SECTOR_ERASE:
+			flashErase(flashAddress, FLASH_SECTOR_SIZE, FLASH_SECTOR_ERASE_TIME);
+			break;
+		case FLASH_CMD_BLOCK_ERASE_32K:
+			flashErase(flashAddress, (32 * 1024), FLASH_BLOCK_ERASE_TIME);
+			break;
+		case FLASH_CMD_BLOCK_ERASE_64K:
+			flashErase(flashAddress, (64 * 1024), FLASH_BLOCK_ERASE_TIME);
+			break;
+	}
+}
+
+static uint8_t flashExchange(uint8_t tx)
+{
+	uint32_t index = flashByteIndex++;
+	uint8_t rx = 0xFF;
+
+	if (!flashSelected)
+	{
+		return rx;
+	}
+
+	flashBytes++;
+
+	if (index == 0)
+	{
+		flashCommand = tx;
+		flashAddress = 0;
+
+		switch (flashCommand)
+		{
+			case FLASH_CMD_WRITE_ENABLE:
+				flashWriteEnabled = !flashIsBusy();
+				break;
+			case FLASH_CMD_WRITE_DISABLE:
+				flashWriteEnabled = false;
+				break;
+			case FLASH_CMD_CHIP_ERASE:
+			case FLASH_CMD_CHIP_ERASE2:
+				flashErase(0, FLASH_SIZE, FLASH_CHIP_ERASE_TIME);
+				break;
+			case FLASH_CMD_ERASE_SUSPEND:
+				if (flashIsErasing && flashIsBusy() && !flashEraseIsSuspended)
+				{
+					flashEraseRemaining = (flashBusyUntil - uwTick);
+					flashBusyUntil = uwTick;
+					flashEraseIsSuspended = true;
+				}
+				break;
+			case FLASH_CMD_ERASE_RESUME:
+				if (flashEraseIsSuspended)
+				{
+					flashBusyUntil = uwTick + flashEraseRemaining;
+					flashEraseIsSuspended = false;
+				}
+				break;
+		}
+
+		return rx;
+	}
+
+	switch (flashCommand)
+	{
+		case FLASH_CMD_READ_SR1:
+			return ((flashIsBusy() ? FLASH_SR1_BUSY : 0) | (flashWriteEnabled ? FLASH_SR1_WEL : 0));
+
+		case FLASH_CMD_READ_SR2:
+			return (flashEraseIsSuspended ? FLASH_SR2_SUS : 0x00);
+
+		case FLASH_CMD_READ_SR3:
+			return 0x00;
+
+		case FLASH_CMD_READ_JEDEC_ID:
+			return ((index <= 3) ? ((FLASH_JEDEC_ID >> ((3 - index) * 8)) & 0xFF) : 0xFF);
+	}
+
+	// 24 bits address
+	if (index <= 3)
+	{
+		flashAddress = ((flashAddress << 8) | tx);
+		return rx;
+	}
+
+	if (flashIsBusy())
+	{
+		return rx;
+	}
+
+	switch (flashCommand)
+	{
+		case FLASH_CMD_READ_DATA:
+			rx = flashImage[flashAddress++ % FLASH_SIZE];
+			break;
+
+		case FLASH_CMD_FAST_READ:
+			if (index > 4) // dummy byte
+			{
+				rx = flashImage[flashAddress++ % FLASH_SIZE];
+			}
+			break;
+
+		case FLASH_CMD_READ_SEC_REGS:
+			if (index > 4) // dummy byte
+			{
+				uint32_t reg = ((flashAddress >> 12) & 0x0F);
+
+				if ((reg >= 1) && (reg <= FLASH_NUM_SECURITY_REGS))
+				{
+					rx = flashSecurityRegisters[reg - 1][flashAddress & 0xFF];
+				}
+				flashAddress = ((flashAddress & ~0xFF) | ((flashAddress + 1) & 0xFF));
+			}
+			break;
+
+		case FLASH_CMD_PAGE_PROGRAM:
+			if (flashWriteEnabled)
+			{
+				// Wraps within the page
+				uint32_t address = (((flashAddress & ~0xFF) | ((flashAddress + (index - 4)) & 0xFF)) % FLASH_SIZE);
+
+				flashImage[address] &= tx;
+				flashIsDirty = true;
+			}
+			break;
+	}
+
+	return rx;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	if (hspi == &hspi1)
+	{
+		while (Size--)
+		{
+			flashExchange(*pData++);
+		}
+	}
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	while (Size--)
+	{
+		*pData++ = ((hspi == &hspi1) ? flashExchange(0xFF) : 0xFF);
+	}
+
+	return HAL_OK;
+}
+
+// The DMA transfers complete straight away
+HAL_StatusTypeDef HAL_SPI_Receive_DMA(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size)
+{
+	HAL_SPI_Receive(hspi, pData, Size, HAL_MAX_DELAY);
+	HAL_SPI_RxCpltCallback(hspi);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Abort(SPI_HandleTypeDef *hspi)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_TransmitReceive(SPI_HandleTypeDef *hspi, uint8_t *pTxData, uint8_t *pRxData, uint16_t Size, uint32_t Timeout)
+{
+	while (Size--)
+	{
+		*pRxData++ = ((hspi == &hspi1) ? flashExchange(*pTxData++) : 0xFF);
+	}
+
+	return HAL_OK;
+}
+
+void simFlashGetStats(uint32_t *transactions, uint32_t *bytes)
+{
+	*transactions = flashTransactions;
+	*bytes = flashBytes;
+}
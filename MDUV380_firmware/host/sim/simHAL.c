@@ -0,0 +1,495 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "main.h"
+#include "hardware/HX8353E.h"
+#include "interfaces/adc.h"
+#include "io/keyboard.h"
+#include "sim.h"
+
+//
+// HAL subset used by the application, at the GPIO/bus level:
+//  - keypad matrix, side buttons and PTTs are read through the shared LCD data pins, as on the radio,
+//  - the rotary encoder toggles its pins and runs the EXTI handler,
+//  - the LCD is fed by the memory to FSMC DMA,
+//  - ADC conversions complete every 10ms, with a fixed battery voltage and volume knob position.
+//
+
+#define SIM_NUM_GPIO_PORTS          11 // A..K
+#define SIM_ADC_PERIOD              10 // ms
+#define SIM_BATTERY_ADC             3300 // ~8.2V (BATTERY_ADC_COEFF: 40.3 per 100mV)
+#define SIM_TEMPERATURE_ADC         943 // 25°C
+
+typedef struct
+{
+	GPIO_TypeDef *ctrlPort;
+	uint16_t      ctrlPin;
+	GPIO_TypeDef *dataPort;
+	uint16_t      dataPin;
+	const char   *name;
+} simInputWiring_t;
+
+// Same order as simInput_t. Keys and side buttons connect their row control pin to an LCD data line,
+// the PTTs pull their pin low.
+static const simInputWiring_t simInputWiring[SIM_INPUT_COUNT] =
+{
+	{ KEYPAD_ROW0_GPIO_Port, KEYPAD_ROW0_Pin, LCD_D0_GPIO_Port, LCD_D0_Pin, "1"     },
+	{ KEYPAD_ROW0_GPIO_Port, KEYPAD_ROW0_Pin, LCD_D1_GPIO_Port, LCD_D1_Pin, "2"     },
+	{ KEYPAD_ROW0_GPIO_Port, KEYPAD_ROW0_Pin, LCD_D2_GPIO_Port, LCD_D2_Pin, "3"     },
+	{ KEYPAD_ROW0_GPIO_Port, KEYPAD_ROW0_Pin, LCD_D3_GPIO_Port, LCD_D3_Pin, "4"     },
+	{ KEYPAD_ROW0_GPIO_Port, KEYPAD_ROW0_Pin, LCD_D4_GPIO_Port, LCD_D4_Pin, "5"     },
+	{ KEYPAD_ROW0_GPIO_Port, KEYPAD_ROW0_Pin, LCD_D5_GPIO_Port, LCD_D5_Pin, "6"     },
+	{ KEYPAD_ROW0_GPIO_Port, KEYPAD_ROW0_Pin, LCD_D6_GPIO_Port, LCD_D6_Pin, "0"     },
+	{ KEYPAD_ROW0_GPIO_Port, KEYPAD_ROW0_Pin, LCD_D7_GPIO_Port, LCD_D7_Pin, "STAR"  },
+	{ KEYPAD_ROW1_GPIO_Port, KEYPAD_ROW1_Pin, LCD_D0_GPIO_Port, LCD_D0_Pin, "GREEN" },
+	{ KEYPAD_ROW1_GPIO_Port, KEYPAD_ROW1_Pin, LCD_D1_GPIO_Port, LCD_D1_Pin, "UP"    },
+	{ KEYPAD_ROW1_GPIO_Port, KEYPAD_ROW1_Pin, LCD_D2_GPIO_Port, LCD_D2_Pin, "DOWN"  },
+	{ KEYPAD_ROW1_GPIO_Port, KEYPAD_ROW1_Pin, LCD_D3_GPIO_Port, LCD_D3_Pin, "7"     },
+	{ KEYPAD_ROW1_GPIO_Port, KEYPAD_ROW1_Pin, LCD_D4_GPIO_Port, LCD_D4_Pin, "8"     },
+	{ KEYPAD_ROW1_GPIO_Port, KEYPAD_ROW1_Pin, LCD_D5_GPIO_Port, LCD_D5_Pin, "9"     },
+	{ KEYPAD_ROW1_GPIO_Port, KEYPAD_ROW1_Pin, LCD_D6_GPIO_Port, LCD_D6_Pin, "HASH"  },
+	{ KEYPAD_ROW1_GPIO_Port, KEYPAD_ROW1_Pin, LCD_D7_GPIO_Port, LCD_D7_Pin, "RED"   },
+	{ KEYPAD_ROW2_GPIO_Port, KEYPAD_ROW2_Pin, LCD_D7_GPIO_Port, LCD_D7_Pin, "SK1"   },
+	{ KEYPAD_ROW2_GPIO_Port, KEYPAD_ROW2_Pin, LCD_D6_GPIO_Port, LCD_D6_Pin, "SK2"   },
+	{ NULL,                  0,               PTT_GPIO_Port,    PTT_Pin,    "PTT"   },
+	{ NULL,                  0,               PTT_EXTERNAL_GPIO_Port, PTT_EXTERNAL_Pin, "PTT_EXT" }
+};
+
+static bool simInputPressed[SIM_INPUT_COUNT];
+
+static uint16_t simGpioOutputData[SIM_NUM_GPIO_PORTS];
+static uint16_t simGpioIsOutput[SIM_NUM_GPIO_PORTS];
+static uint16_t simGpioPullUp[SIM_NUM_GPIO_PORTS];
+
+static GPIO_PinState simRotaryPinA = GPIO_PIN_RESET;
+static GPIO_PinState simRotaryPinB = GPIO_PIN_RESET;
+
+static time_t simRtcBase; // RTC time at uwTick == 0
+
+static uint32_t *simAdcData = NULL;
+
+uint32_t simVolumeADC = 1000; // Volume knob, ADC value (~ -20dB .. +20dB: 100 .. 2000)
+
+uint32_t NumInterruptPriorityBits = 4;
+
+ADC_HandleTypeDef hadc1;
+DAC_HandleTypeDef hdac;
+I2C_HandleTypeDef hi2c3;
+I2S_HandleTypeDef hi2s3;
+RTC_HandleTypeDef hrtc;
+TIM_HandleTypeDef htim1;
+TIM_HandleTypeDef htim3;
+TIM_HandleTypeDef htim6;
+DMA_HandleTypeDef hdma_memtomem_dma2_stream0;
+DMA_HandleTypeDef hdma_tim1_ch1;
+
+extern void rotaryEncoderISR(void);
+
+// The application, the HAL macros and the CMSIS structures access the peripherals (and the FSMC LCD)
+// by address. Backing these ranges with plain memory makes the accesses which aren't simulated harmless.
+static const struct
+{
+	uintptr_t address;
+	size_t    size;
+} peripheralRegions[] =
+{
+	{ 0x40000000, 0x20100000 }, // APB/AHB peripherals, backup SRAM, USB OTG, FSMC bank 1 (LCD)
+	{ 0xA0000000, 0x00001000 }, // FSMC control registers
+	{ 0xE0000000, 0x00100000 }  // Cortex-M4 private peripherals (NVIC, SCB, DWT, ...)
+};
+
+bool simHALMapPeripherals(void)
+{
+	for (size_t i = 0; i < (sizeof(peripheralRegions) / sizeof(peripheralRegions[0])); i++)
+	{
+		void *p = mmap((void *)peripheralRegions[i].address, peripheralRegions[i].size, (PROT_READ | PROT_WRITE),
+				(MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE | MAP_NORESERVE), -1, 0);
+
+		if (p != (void *)peripheralRegions[i].address)
+		{
+			fprintf(stderr, "Failed to map the peripherals at 0x%08lX\n", (unsigned long)peripheralRegions[i].address);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void simHALInit(void)
+{
+	hadc1.Instance = ADC1;
+	hdac.Instance = DAC;
+	hi2c3.Instance = I2C3;
+	hi2s3.Instance = SPI3;
+	hrtc.Instance = RTC;
+	htim1.Instance = TIM1;
+	htim3.Instance = TIM3;
+	htim6.Instance = TIM6;
+
+	// Rotary switch (A/B) and PTTs have pull-ups
+	simGpioPullUp[(((uintptr_t)ROTARY_SW_A_GPIO_Port - GPIOA_BASE) / 0x400)] |= ROTARY_SW_A_Pin;
+	simGpioPullUp[(((uintptr_t)ROTARY_SW_B_GPIO_Port - GPIOA_BASE) / 0x400)] |= ROTARY_SW_B_Pin;
+	simGpioPullUp[(((uintptr_t)PTT_GPIO_Port - GPIOA_BASE) / 0x400)] |= (PTT_Pin | PTT_EXTERNAL_Pin);
+
+	simRtcBase = time(NULL);
+}
+
+static inline int gpioPortIndex(GPIO_TypeDef *GPIOx)
+{
+	int index = (((uintptr_t)GPIOx - GPIOA_BASE) / 0x400);
+
+	if ((index < 0) || (index >= SIM_NUM_GPIO_PORTS))
+	{
+		simFatal("HAL: invalid GPIO port %p\n", (void *)GPIOx);
+	}
+
+	return index;
+}
+
+int simInputFromName(const char *name)
+{
+	for (int i = 0; i < SIM_INPUT_COUNT; i++)
+	{
+		if (strcasecmp(name, simInputWiring[i].name) == 0)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+void simInputSet(simInput_t input, bool pressed)
+{
+	simInputPressed[input] = pressed;
+}
+
+// One detent: pin B toggles, pin A gives the direction
+void simRotaryStep(int direction)
+{
+	simRotaryPinB = ((simRotaryPinB == GPIO_PIN_SET) ? GPIO_PIN_RESET : GPIO_PIN_SET);
+	simRotaryPinA = ((direction > 0) ? ((simRotaryPinB == GPIO_PIN_SET) ? GPIO_PIN_RESET : GPIO_PIN_SET) : simRotaryPinB);
+
+	rotaryEncoderISR();
+}
+
+// Called every ms by the virtual clock
+void simHALTick(uint32_t now)
+{
+	if ((simAdcData != NULL) && ((now % SIM_ADC_PERIOD) == 0))
+	{
+		volatile uint16_t *values = (volatile uint16_t *)simAdcData;
+
+		values[0] = simVolumeADC;
+		values[1] = SIM_BATTERY_ADC;
+		values[2] = 0; // Mic
+		values[3] = SIM_TEMPERATURE_ADC;
+
+		HAL_ADC_ConvCpltCallback(&hadc1);
+	}
+}
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init)
+{
+	int port = gpioPortIndex(GPIOx);
+
+	if ((GPIO_Init->Mode == GPIO_MODE_OUTPUT_PP) || (GPIO_Init->Mode == GPIO_MODE_OUTPUT_OD))
+	{
+		simGpioIsOutput[port] |= GPIO_Init->Pin;
+	}
+	else
+	{
+		simGpioIsOutput[port] &= ~GPIO_Init->Pin;
+	}
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+	int port = gpioPortIndex(GPIOx);
+
+	if ((GPIOx == SPI_Flash_CS_GPIO_Port) && (GPIO_Pin & SPI_Flash_CS_Pin))
+	{
+		simFlashChipSelect(PinState == GPIO_PIN_RESET);
+	}
+
+	if (PinState == GPIO_PIN_SET)
+	{
+		simGpioOutputData[port] |= GPIO_Pin;
+	}
+	else
+	{
+		simGpioOutputData[port] &= ~GPIO_Pin;
+
+		if ((GPIOx == PWR_SW_GPIO_Port) && (GPIO_Pin & PWR_SW_Pin))
+		{
+			printf("Power off (uptime %u ms)\n", uwTick);
+			simExit(0);
+		}
+	}
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	simGpioOutputData[gpioPortIndex(GPIOx)] ^= GPIO_Pin;
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	int port = gpioPortIndex(GPIOx);
+
+	if (simGpioIsOutput[port] & GPIO_Pin)
+	{
+		return ((simGpioOutputData[port] & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+	}
+
+	if ((GPIOx == ROTARY_SW_A_GPIO_Port) && (GPIO_Pin == ROTARY_SW_A_Pin))
+	{
+		return simRotaryPinA;
+	}
+
+	if ((GPIOx == ROTARY_SW_B_GPIO_Port) && (GPIO_Pin == ROTARY_SW_B_Pin))
+	{
+		return simRotaryPinB;
+	}
+
+	for (int i = 0; i < SIM_INPUT_COUNT; i++)
+	{
+		const simInputWiring_t *wiring = &simInputWiring[i];
+
+		if (simInputPressed[i] && (wiring->dataPort == GPIOx) && (wiring->dataPin == GPIO_Pin))
+		{
+			if (wiring->ctrlPort == NULL)
+			{
+				return GPIO_PIN_RESET;
+			}
+
+			int ctrlPort = gpioPortIndex(wiring->ctrlPort);
+
+			// The row is selected when driven high
+			if ((simGpioIsOutput[ctrlPort] & wiring->ctrlPin) && (simGpioOutputData[ctrlPort] & wiring->ctrlPin))
+			{
+				return GPIO_PIN_SET;
+			}
+		}
+	}
+
+	return ((simGpioPullUp[port] & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	return (simRadioI2CTransmit(DevAddress, pData, Size) ? HAL_OK : HAL_ERROR);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+	return (simRadioI2CReceive(DevAddress, pData, Size) ? HAL_OK : HAL_ERROR);
+}
+
+// Only the display uses the memory to memory DMA, to the FSMC
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength)
+{
+	if (DstAddress == LCD_FSMC_ADDR_DATA)
+	{
+		simDisplayDMA((const uint8_t *)(uintptr_t)SrcAddress, DataLength);
+		return HAL_OK;
+	}
+
+	return HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_DMA_PollForTransfer(DMA_HandleTypeDef *hdma, HAL_DMA_LevelCompleteTypeDef CompleteLevel, uint32_t Timeout)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Start_IT(ADC_HandleTypeDef *hadc)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef *hadc, uint32_t *pData, uint32_t Length)
+{
+	simAdcData = pData;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DAC_SetValue(DAC_HandleTypeDef *hdac, uint32_t Channel, uint32_t Alignment, uint32_t Data)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DAC_Start(DAC_HandleTypeDef *hdac, uint32_t Channel)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_OC_Start(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef *htim, const TIM_MasterConfigTypeDef *sMasterConfig)
+{
+	return HAL_OK;
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+}
+
+void HAL_PWR_EnableBkUpAccess(void)
+{
+}
+
+void HAL_PWR_DisableWakeUpPin(uint32_t WakeUpPinx)
+{
+}
+
+void HAL_PWR_EnterSTANDBYMode(void)
+{
+	printf("Standby (uptime %u ms)\n", uwTick);
+	simExit(0);
+}
+
+void HAL_SuspendTick(void)
+{
+}
+
+void HAL_ResumeTick(void)
+{
+}
+
+uint32_t HAL_GetTick(void)
+{
+	return uwTick;
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+	simClockAdvance(Delay);
+}
+
+HAL_StatusTypeDef HAL_RTCEx_DeactivateWakeUpTimer(RTC_HandleTypeDef *hrtc)
+{
+	return HAL_OK;
+}
+
+// The RTC runs from the virtual clock, it starts at the host time (UTC)
+HAL_StatusTypeDef HAL_RTC_GetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format)
+{
+	time_t now = simRtcBase + (uwTick / 1000);
+	struct tm tm;
+
+	gmtime_r(&now, &tm);
+	sTime->Hours = tm.tm_hour;
+	sTime->Minutes = tm.tm_min;
+	sTime->Seconds = tm.tm_sec;
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_GetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format)
+{
+	time_t now = simRtcBase + (uwTick / 1000);
+	struct tm tm;
+
+	gmtime_r(&now, &tm);
+	sDate->Year = (tm.tm_year % 100);
+	sDate->Month = (tm.tm_mon + 1);
+	sDate->Date = tm.tm_mday;
+	sDate->WeekDay = ((tm.tm_wday == 0) ? 7 : tm.tm_wday);
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_SetTime(RTC_HandleTypeDef *hrtc, RTC_TimeTypeDef *sTime, uint32_t Format)
+{
+	time_t now = simRtcBase + (uwTick / 1000);
+	struct tm tm;
+
+	gmtime_r(&now, &tm);
+	tm.tm_hour = sTime->Hours;
+	tm.tm_min = sTime->Minutes;
+	tm.tm_sec = sTime->Seconds;
+	simRtcBase = (timegm(&tm) - (uwTick / 1000));
+
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RTC_SetDate(RTC_HandleTypeDef *hrtc, RTC_DateTypeDef *sDate, uint32_t Format)
+{
+	time_t now = simRtcBase + (uwTick / 1000);
+	struct tm tm;
+
+	gmtime_r(&now, &tm);
+	tm.tm_year = (sDate->Year + 100);
+	tm.tm_mon = (sDate->Month - 1);
+	tm.tm_mday = sDate->Date;
+	simRtcBase = (timegm(&tm) - (uwTick / 1000));
+
+	return HAL_OK;
+}
+
+void Error_Handler(void)
+{
+	SIM_LOG("HAL: Error_Handler()\n");
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "main.h"
+#include "interfaces/clockManager.h"
+#include "user_interface/uiGlobals.h"
+#include "interfaces/gps.h"
+#include "interfaces/gpsTrackLog.h"
+#include "interfaces/runTimeStats.h"
+#include "sim.h"
+
+//
+// Peripherals without a simulation: there is no GPS fix (nor track log),
+// and the clock speed doesn't change anything.
+//
+
+#define SIM_CORE_CLOCK_MHZ      168
+
+uint32_t SystemCoreClock = (SIM_CORE_CLOCK_MHZ * 1000000U);
+
+// GPS
+gpsData_t gpsData;
+
+void gpsInit(void)
+{
+}
+
+void gpsTick(void)
+{
+}
+
+void gpsProcessData(void)
+{
+}
+
+void gpsOn(void)
+{
+}
+
+void gpsOff(void)
+{
+}
+
+void gpsOnUsingQuickKey(bool on)
+{
+}
+
+void gpsDataInputStartStop(bool enable)
+{
+}
+
+void gpsLoggingStart(void)
+{
+}
+
+void gpsLoggingStop(void)
+{
+}
+
+void gpsLoggingClear(void)
+{
+}
+
+int gpsTrackLogExportRead(gpsTrackLogExportFormat_t format, uint32_t position, uint8_t *dest, int length)
+{
+	return 0;
+}
+
+// Clock manager
+static bool ticklessIdleAllowed = true;
+static clockManagerGovernorStats_t governorStats;
+
+clockManagerSpeedSetting_t clockManagerGetRunMode(void)
+{
+	return CLOCK_MANAGER_SPEED_RUN;
+}
+
+const clockManagerGovernorStats_t *clockManagerGovernorGetStats(void)
+{
+	return &governorStats;
+}
+
+void clockManagerSetRunMode(uint8_t targetConfigIndex, clockManagerSpeedSetting_t clockSpeedSetting)
+{
+}
+
+void clockManagerGovernorTick(uint32_t activeDemand)
+{
+}
+
+void clockManagerGovernorSetDemand(uint32_t demand, bool active)
+{
+}
+
+void clockManagerGovernorSetEcoAllowed(bool allowed)
+{
+}
+
+void clockManagerTimersRescale(void)
+{
+}
+
+void clockManagerSetTicklessIdleAllowed(bool allowed)
+{
+	ticklessIdleAllowed = allowed;
+}
+
+bool clockManagerIsTicklessIdleAllowed(void)
+{
+	return ticklessIdleAllowed;
+}
+
+// Run time statistics: the cycles counter follows the host time, there are no per task figures
+static runTimeStats_t runTimeStats;
+
+uint32_t runTimeStatsGetCycles(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec) * SIM_CORE_CLOCK_MHZ / 1000ULL);
+}
+
+uint32_t runTimeStatsCyclesToMicroseconds(uint32_t cycles)
+{
+	return (cycles / SIM_CORE_CLOCK_MHZ);
+}
+
+void runTimeStatsUpdate(runTimeStatsWindow_t window)
+{
+}
+
+const runTimeStats_t *runTimeStatsGet(runTimeStatsWindow_t window)
+{
+	return &runTimeStats;
+}
+
+// Not in glibc
+char *itoa(int value, char *str, int base)
+{
+	char digits[34];
+	char *p = digits;
+	char *s = str;
+	unsigned int v = (((value < 0) && (base == 10)) ? -value : value);
+
+	if ((base < 2) || (base > 36))
+	{
+		*str = 0;
+		return str;
+	}
+
+	do
+	{
+		int digit = (v % base);
+
+		*p++ = ((digit < 10) ? ('0' + digit) : ('a' + digit - 10));
+		v /= base;
+	} while (v);
+
+	if ((value < 0) && (base == 10))
+	{
+		*s++ = '-';
+	}
+
+	while (p > digits)
+	{
+		*s++ = *--p;
+	}
+
+	*s = 0;
+
+	return str;
+}
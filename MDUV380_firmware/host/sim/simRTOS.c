@@ -0,0 +1,347 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "cmsis_os.h"
+#include "interfaces/pit.h"
+#include "sim.h"
+
+//
+// Single threaded RTOS: only the application main task runs, on the host main thread.
+// The other tasks are recorded but never scheduled, and anything that blocks the main
+// task advances the virtual clock instead (1ms per tick, as configured on the radio).
+//
+
+#define SIM_MAX_TASKS   16
+
+struct tskTaskControlBlock
+{
+	char         name[configMAX_TASK_NAME_LEN];
+	UBaseType_t  priority;
+	bool         suspended;
+};
+
+struct QueueDefinition
+{
+	uint8_t     type;
+	UBaseType_t length;
+	UBaseType_t itemSize;
+	UBaseType_t count;
+	UBaseType_t head;
+	uint8_t    *storage;
+};
+
+volatile uint32_t uwTick = 0;
+
+static struct tskTaskControlBlock simTasks[SIM_MAX_TASKS];
+static int simNumTasks = 0;
+static int simCriticalNesting = 0;
+
+void simClockAdvance(uint32_t ms)
+{
+	while (ms--)
+	{
+		uwTick++;
+		PIT0_IRQHandler();
+
+		if ((uwTick % 1000) == 0)
+		{
+			PIT2SecondsCounter++;
+		}
+
+		simHALTick(uwTick);
+		simScriptTick(uwTick);
+		simUSBTick();
+#if defined(USING_TRACE)
+		simTraceDrain();
+#endif
+	}
+}
+
+uint32_t simClockGetMillis(void)
+{
+	return uwTick;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pxTaskCode, const char * const pcName, const configSTACK_DEPTH_TYPE usStackDepth,
+		void * const pvParameters, UBaseType_t uxPriority, TaskHandle_t * const pxCreatedTask)
+{
+	if (simNumTasks >= SIM_MAX_TASKS)
+	{
+		return errCOULD_NOT_ALLOCATE_REQUIRED_MEMORY;
+	}
+
+	TaskHandle_t task = &simTasks[simNumTasks++];
+
+	snprintf(task->name, sizeof(task->name), "%s", pcName);
+	task->priority = uxPriority;
+	task->suspended = false;
+
+	SIM_LOG("RTOS: task \"%s\" created (not scheduled)\n", task->name);
+
+	if (pxCreatedTask != NULL)
+	{
+		*pxCreatedTask = task;
+	}
+
+	return pdPASS;
+}
+
+void vTaskSuspend(TaskHandle_t xTaskToSuspend)
+{
+	if (xTaskToSuspend != NULL)
+	{
+		xTaskToSuspend->suspended = true;
+	}
+}
+
+void vTaskResume(TaskHandle_t xTaskToResume)
+{
+	if (xTaskToResume != NULL)
+	{
+		xTaskToResume->suspended = false;
+	}
+}
+
+void vTaskDelay(const TickType_t xTicksToDelay)
+{
+	simClockAdvance((xTicksToDelay > 0) ? xTicksToDelay : 1);
+}
+
+osStatus_t osDelay(uint32_t ticks)
+{
+	vTaskDelay(ticks);
+	return osOK;
+}
+
+BaseType_t xTaskGetSchedulerState(void)
+{
+	return taskSCHEDULER_RUNNING;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	return uwTick;
+}
+
+void vPortYield(void)
+{
+}
+
+void vPortEnterCritical(void)
+{
+	simCriticalNesting++;
+}
+
+void vPortExitCritical(void)
+{
+	simCriticalNesting--;
+}
+
+QueueHandle_t xQueueGenericCreate(const UBaseType_t uxQueueLength, const UBaseType_t uxItemSize, const uint8_t ucQueueType)
+{
+	QueueHandle_t queue = calloc(1, sizeof(struct QueueDefinition));
+
+	if (queue == NULL)
+	{
+		return NULL;
+	}
+
+	queue->type = ucQueueType;
+	queue->length = uxQueueLength;
+	queue->itemSize = uxItemSize;
+
+	if ((uxItemSize > 0) && ((queue->storage = calloc(uxQueueLength, uxItemSize)) == NULL))
+	{
+		free(queue);
+		return NULL;
+	}
+
+	return queue;
+}
+
+QueueHandle_t xQueueCreateMutex(const uint8_t ucQueueType)
+{
+	QueueHandle_t queue = xQueueGenericCreate(1, 0, ucQueueType);
+
+	if (queue != NULL)
+	{
+		queue->count = 1;
+	}
+
+	return queue;
+}
+
+BaseType_t xQueueGenericSend(QueueHandle_t xQueue, const void * const pvItemToQueue, TickType_t xTicksToWait, const BaseType_t xCopyPosition)
+{
+	if (xQueue->type == queueQUEUE_TYPE_MUTEX)
+	{
+		return pdPASS;
+	}
+
+	if (xQueue->count >= xQueue->length)
+	{
+		// Nobody else could make some room
+		simClockAdvance(((xTicksToWait == portMAX_DELAY) || (xTicksToWait == 0)) ? 0 : xTicksToWait);
+		return errQUEUE_FULL;
+	}
+
+	if (xQueue->itemSize > 0)
+	{
+		UBaseType_t index;
+
+		if (xCopyPosition == queueSEND_TO_FRONT)
+		{
+			xQueue->head = ((xQueue->head + xQueue->length - 1) % xQueue->length);
+			index = xQueue->head;
+		}
+		else
+		{
+			index = ((xQueue->head + xQueue->count) % xQueue->length);
+		}
+
+		memcpy(xQueue->storage + (index * xQueue->itemSize), pvItemToQueue, xQueue->itemSize);
+	}
+
+	xQueue->count++;
+	return pdPASS;
+}
+
+BaseType_t xQueueGenericSendFromISR(QueueHandle_t xQueue, const void * const pvItemToQueue, BaseType_t * const pxHigherPriorityTaskWoken, const BaseType_t xCopyPosition)
+{
+	if (pxHigherPriorityTaskWoken != NULL)
+	{
+		*pxHigherPriorityTaskWoken = pdFALSE;
+	}
+
+	return xQueueGenericSend(xQueue, pvItemToQueue, 0, xCopyPosition);
+}
+
+// Waits, one tick at a time, for the clock to deliver something (script inputs, timers)
+static bool queueWait(QueueHandle_t xQueue, TickType_t xTicksToWait)
+{
+	while (xQueue->count == 0)
+	{
+		if (xTicksToWait == 0)
+		{
+			return false;
+		}
+
+		if (xTicksToWait != portMAX_DELAY)
+		{
+			xTicksToWait--;
+		}
+		else if (simScriptIsDone())
+		{
+			simFatal("RTOS: main task blocked forever on an empty queue\n");
+		}
+
+		simClockAdvance(1);
+	}
+
+	return true;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t xQueue, void * const pvBuffer, TickType_t xTicksToWait)
+{
+	if (!queueWait(xQueue, xTicksToWait))
+	{
+		return errQUEUE_EMPTY;
+	}
+
+	memcpy(pvBuffer, xQueue->storage + (xQueue->head * xQueue->itemSize), xQueue->itemSize);
+	xQueue->head = ((xQueue->head + 1) % xQueue->length);
+	xQueue->count--;
+
+	return pdPASS;
+}
+
+BaseType_t xQueuePeek(QueueHandle_t xQueue, void * const pvBuffer, TickType_t xTicksToWait)
+{
+	if (!queueWait(xQueue, xTicksToWait))
+	{
+		return errQUEUE_EMPTY;
+	}
+
+	memcpy(pvBuffer, xQueue->storage + (xQueue->head * xQueue->itemSize), xQueue->itemSize);
+
+	return pdPASS;
+}
+
+BaseType_t xQueueReceiveFromISR(QueueHandle_t xQueue, void * const pvBuffer, BaseType_t * const pxHigherPriorityTaskWoken)
+{
+	if (pxHigherPriorityTaskWoken != NULL)
+	{
+		*pxHigherPriorityTaskWoken = pdFALSE;
+	}
+
+	return xQueueReceive(xQueue, pvBuffer, 0);
+}
+
+BaseType_t xQueueSemaphoreTake(QueueHandle_t xQueue, TickType_t xTicksToWait)
+{
+	// There is no other task to hold a mutex
+	if (xQueue->type == queueQUEUE_TYPE_MUTEX)
+	{
+		return pdPASS;
+	}
+
+	if (!queueWait(xQueue, xTicksToWait))
+	{
+		return errQUEUE_EMPTY;
+	}
+
+	xQueue->count--;
+	return pdPASS;
+}
+
+BaseType_t xQueueGiveFromISR(QueueHandle_t xQueue, BaseType_t * const pxHigherPriorityTaskWoken)
+{
+	if (pxHigherPriorityTaskWoken != NULL)
+	{
+		*pxHigherPriorityTaskWoken = pdFALSE;
+	}
+
+	if (xQueue->count >= xQueue->length)
+	{
+		return errQUEUE_FULL;
+	}
+
+	xQueue->count++;
+	return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(const QueueHandle_t xQueue)
+{
+	return xQueue->count;
+}
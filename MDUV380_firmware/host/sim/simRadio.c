@@ -0,0 +1,351 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include "main.h"
+#include "interfaces/hr-c6000_spi.h"
+#include "interfaces/i2s.h"
+#include "dmr_codec/codec.h"
+#include "sim.h"
+
+//
+// Radio chips register files.
+//
+// AT1846S: 7 bits I2C address 0x5C, 16 bits registers, register 0x7F selects the second bank.
+// HR-C6000: SPI0 (configuration) and SPI1 (voice) page registers, 11 bits addresses on SPI0.
+//
+// Nothing is received: the HR-C6000 interrupt lines are never asserted, and the registers
+// read back what has been written (the status registers read 0, no signal). A write to the page 0x04
+// register 0x00 (reset) puts the configuration registers back to 0.
+//
+// The SPI0 writes are logged (simRadioSPI0LogGet()), for the tests.
+//
+
+#define AT1846S_I2C_ADDRESS     0x5C
+#define AT1846S_BANK_REGISTER   0x7F
+
+#define HRC6000_NUM_PAGES       8
+#define HRC6000_PAGE_SIZE       0x800
+
+static uint16_t at1846sRegisters[2][128];
+static uint8_t  at1846sSelectedRegister = 0;
+
+static uint8_t  hrc6000Registers[HRC6000_NUM_PAGES][HRC6000_PAGE_SIZE];
+static uint8_t  hrc6000VoiceRegisters[HRC6000_NUM_PAGES][256];
+static bool     hrc6000ShadowValid[HRC6000_NUM_PAGES][256]; // SPI0 shadow: the registers written since the last reset/power down
+static simRadioSPI0Log_t hrc6000SPI0Log;
+
+uint16_t i2s_Tx_Buffer[NUM_I2S_BUFFERS][2][WAV_BUFFER_SIZE];
+uint16_t i2s_Rx_Buffer[NUM_I2S_BUFFERS][2][WAV_BUFFER_SIZE];
+volatile bool g_TX_SAI_in_use = false;
+volatile bool isSending = false;
+volatile bool isReceiving = false;
+
+static inline int at1846sBank(void)
+{
+	return (at1846sRegisters[0][AT1846S_BANK_REGISTER] & 0x01);
+}
+
+bool simRadioI2CTransmit(uint16_t address, const uint8_t *data, uint16_t size)
+{
+	if ((address != AT1846S_I2C_ADDRESS) || (size < 1))
+	{
+		return false;
+	}
+
+	at1846sSelectedRegister = (data[0] & 0x7F);
+
+	if (size >= 3)
+	{
+		uint16_t value = ((data[1] << 8) | data[2]);
+
+		// The bank register is reachable from both banks
+		if (at1846sSelectedRegister == AT1846S_BANK_REGISTER)
+		{
+			at1846sRegisters[0][AT1846S_BANK_REGISTER] = value;
+		}
+		else
+		{
+			at1846sRegisters[at1846sBank()][at1846sSelectedRegister] = value;
+		}
+	}
+
+	return true;
+}
+
+bool simRadioI2CReceive(uint16_t address, uint8_t *data, uint16_t size)
+{
+	if ((address != AT1846S_I2C_ADDRESS) || (size != 2))
+	{
+		return false;
+	}
+
+	uint16_t value = at1846sRegisters[((at1846sSelectedRegister == AT1846S_BANK_REGISTER) ? 0 : at1846sBank())][at1846sSelectedRegister];
+
+	data[0] = (value >> 8);
+	data[1] = (value & 0xFF);
+
+	return true;
+}
+
+void simRadioDump(void)
+{
+	for (int bank = 0; bank < 2; bank++)
+	{
+		printf("AT1846S bank %d:", bank);
+		for (int reg = 0; reg < 128; reg++)
+		{
+			printf("%s%04X", (((reg % 16) == 0) ? "\n  " : " "), at1846sRegisters[bank][reg]);
+		}
+		printf("\n");
+	}
+
+	for (int page = 1; page <= 4; page++)
+	{
+		printf("HR-C6000 page %d:", page);
+		for (int reg = 0; reg < 256; reg++)
+		{
+			printf("%s%02X", (((reg % 32) == 0) ? "\n  " : " "), hrc6000Registers[page][reg]);
+		}
+		printf("\n");
+	}
+}
+
+static inline uint8_t *hrc6000Register(uint8_t page, uint16_t reg)
+{
+	return &hrc6000Registers[page % HRC6000_NUM_PAGES][reg % HRC6000_PAGE_SIZE];
+}
+
+static void hrc6000LogWrite(uint8_t page, uint16_t reg, uint8_t val)
+{
+	if (hrc6000SPI0Log.count < SIM_RADIO_SPI0_LOG_SIZE)
+	{
+		hrc6000SPI0Log.writes[hrc6000SPI0Log.count] = (simRadioSPI0Write_t) { .page = page, .reg = reg, .value = val };
+		hrc6000SPI0Log.count++;
+	}
+}
+
+static inline void hrc6000WriteRegister(uint8_t page, uint16_t reg, uint8_t val)
+{
+	hrc6000LogWrite(page, reg, val);
+
+	if ((page == 0x04) && (reg == 0x00))
+	{
+		for (int p = 0x01; p <= 0x04; p++)
+		{
+			memset(hrc6000Registers[p], 0x00, 256);
+		}
+		memset(hrc6000ShadowValid, 0, sizeof(hrc6000ShadowValid));
+	}
+
+	*hrc6000Register(page, reg) = val;
+
+	if ((reg < 256) && ((page != 0x04) || (reg != 0x00)))
+	{
+		hrc6000ShadowValid[page % HRC6000_NUM_PAGES][reg] = true;
+	}
+}
+
+void simRadioSPI0LogClear(void)
+{
+	hrc6000SPI0Log.count = 0;
+	hrc6000SPI0Log.transfers = 0;
+}
+
+const simRadioSPI0Log_t *simRadioSPI0LogGet(void)
+{
+	return &hrc6000SPI0Log;
+}
+
+uint8_t simRadioSPI0Register(uint8_t page, uint16_t reg)
+{
+	return *hrc6000Register(page, reg);
+}
+
+int SPI0WritePageRegByte(uint8_t page, uint8_t reg, uint8_t val)
+{
+	hrc6000SPI0Log.transfers++;
+	hrc6000WriteRegister(page, reg, val);
+	return kStatus_Success;
+}
+
+// Extended registers aren't shadowed
+int SPI0WritePageRegByteExtended(uint8_t page, uint16_t reg, uint8_t val)
+{
+	hrc6000SPI0Log.transfers++;
+	hrc6000LogWrite((page | 0x40), (reg & 0x7FF), val);
+	*hrc6000Register(page, (reg & 0x7FF)) = val;
+	return kStatus_Success;
+}
+
+int SPI0ReadPageRegByte(uint8_t page, uint8_t reg, volatile uint8_t *val)
+{
+	*val = *hrc6000Register(page, reg);
+	return kStatus_Success;
+}
+
+int SPI0ClearPageRegByteWithMask(uint8_t page, uint8_t reg, uint8_t mask, uint8_t val)
+{
+	hrc6000SPI0Log.transfers += 2; // Read, then write
+	hrc6000WriteRegister(page, reg, (val | (*hrc6000Register(page, reg) & mask)));
+	return kStatus_Success;
+}
+
+int SPI0WritePageRegByteArray(uint8_t page, uint8_t reg, const uint8_t *values, uint8_t length)
+{
+	hrc6000SPI0Log.transfers++;
+
+	for (int i = 0; i < length; i++)
+	{
+		hrc6000WriteRegister(page, (reg + i), values[i]);
+	}
+
+	return kStatus_Success;
+}
+
+int SPI0ReadPageRegByteArray(uint8_t page, uint8_t reg, volatile uint8_t *values, uint8_t length)
+{
+	for (int i = 0; i < length; i++)
+	{
+		values[i] = *hrc6000Register(page, (reg + i));
+	}
+
+	return kStatus_Success;
+}
+
+int SPI0WritePageRegByteList(uint8_t page, const uint8_t regValues[][2], uint8_t length)
+{
+	hrc6000SPI0Log.transfers += length;
+
+	for (int i = 0; i < length; i++)
+	{
+		hrc6000WriteRegister(page, regValues[i][0], regValues[i][1]);
+	}
+
+	return kStatus_Success;
+}
+
+int SPI1WritePageRegByteArray(uint8_t page, uint8_t reg, const uint8_t *values, uint8_t length)
+{
+	for (int i = 0; i < length; i++)
+	{
+		hrc6000VoiceRegisters[page % HRC6000_NUM_PAGES][(uint8_t)(reg + i)] = values[i];
+	}
+
+	return kStatus_Success;
+}
+
+int SPI1ReadPageRegByteArray(uint8_t page, uint8_t reg, volatile uint8_t *values, uint8_t length)
+{
+	for (int i = 0; i < length; i++)
+	{
+		values[i] = hrc6000VoiceRegisters[page % HRC6000_NUM_PAGES][(uint8_t)(reg + i)];
+	}
+
+	return kStatus_Success;
+}
+
+bool SPI0ShadowGet(uint8_t page, uint8_t reg, uint8_t *val)
+{
+	if (((page != 0x01) && (page != 0x04)) || (hrc6000ShadowValid[page][reg] == false))
+	{
+		return false;
+	}
+
+	*val = *hrc6000Register(page, reg);
+	return true;
+}
+
+void SPI0ShadowInvalidate(void)
+{
+	memset(hrc6000ShadowValid, 0, sizeof(hrc6000ShadowValid));
+}
+
+void SPIBusTimeslotTick(void)
+{
+}
+
+const spiBusStats_t *SPIGetBusStats(void)
+{
+	static spiBusStats_t busStats;
+
+	return &busStats;
+}
+
+// No audio path: the I2S transfers never start
+void I2SStartDMA(uint16_t *txbuff, uint16_t *rxbuff, size_t bufferLen)
+{
+}
+
+void I2STerminateTransfers(void)
+{
+	g_TX_SAI_in_use = false;
+	isSending = false;
+	isReceiving = false;
+}
+
+// The AMBE codec isn't part of the sources, DMR voice is unavailable
+bool codecIsAvailable(void)
+{
+	return false;
+}
+
+void codecInit(bool fromVoicePrompts)
+{
+}
+
+void codecDecode(uint8_t *indata_ptr, int numbBlocks)
+{
+}
+
+void codecEncodeBlock(uint8_t *outdata_ptr)
+{
+}
+
+void codecEncode(uint8_t *outdata_ptr, int numbBlocks)
+{
+}
+
+void codecInitInternalBuffers(void)
+{
+}
+
+const codecLatencyStats_t *codecGetLatencyStats(void)
+{
+	static codecLatencyStats_t latencyStats;
+
+	return &latencyStats;
+}
+
+void codecLatencyProbeStart(void)
+{
+}
+
+void codecLatencyProbeStop(void)
+{
+}
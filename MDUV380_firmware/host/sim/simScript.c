@@ -0,0 +1,413 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include "sim.h"
+#include "user_interface/menuSystem.h"
+#include "user_interface/uiUtilities.h"
+
+//
+// Input script, one command per line ('#' starts a comment). Commands are run on the
+// virtual clock, a script time cursor is advanced by the commands that take some time:
+//
+//   wait <ms>                    advance the cursor
+//   press <input>                <input>: 0..9, STAR, HASH, GREEN, RED, UP, DOWN, SK1, SK2, PTT, PTT_EXT
+//   release <input>
+//   tap <input> [<ms>]           press, release after <ms> (default 100), then wait 150ms
+//   rotary <steps>               rotary encoder detents (negative: the other way), 20ms apart
+//   volume <adc>                 volume knob position, as an ADC value (~ 30 .. 2000)
+//   screenshot <file.png>        dump the panel content
+//   registers                    dump the radio chips registers
+//   lookup <id>                  DMR ID database lookup, with the SPI flash transactions it took
+//   expect screen <name>         the current screen is <name> (MENU_... or UI_..., see menuSystem.h)
+//   expect text <text>           <text> (the rest of the line) is shown, in any font, colour and position
+//   quit                         power off the simulation
+//
+// A failed expectation is reported, and makes the simulator exit with a failure status.
+//
+
+#define SCRIPT_TAP_DURATION     100 // ms
+#define SCRIPT_TAP_GAP          150 // ms
+#define SCRIPT_ROTARY_PERIOD    20  // ms
+
+typedef enum
+{
+	SCRIPT_PRESS = 0,
+	SCRIPT_RELEASE,
+	SCRIPT_ROTARY,
+	SCRIPT_VOLUME,
+	SCRIPT_SCREENSHOT,
+	SCRIPT_REGISTERS,
+	SCRIPT_LOOKUP,
+	SCRIPT_EXPECT_SCREEN,
+	SCRIPT_EXPECT_TEXT,
+	SCRIPT_QUIT
+} scriptCommand_t;
+
+typedef struct
+{
+	uint32_t        time;
+	scriptCommand_t command;
+	int             value;
+	char           *path;
+	int             line;
+} scriptEvent_t;
+
+typedef struct
+{
+	const char *name;
+	int         number;
+} scriptScreen_t;
+
+#define SCRIPT_SCREEN(s)        { #s, s }
+
+static const scriptScreen_t scriptScreens[] =
+{
+	SCRIPT_SCREEN(MENU_MAIN_MENU),
+	SCRIPT_SCREEN(MENU_CONTACTS_MENU),
+	SCRIPT_SCREEN(MENU_ZONE_LIST),
+	SCRIPT_SCREEN(MENU_RADIO_INFOS),
+	SCRIPT_SCREEN(MENU_RSSI_SCREEN),
+	SCRIPT_SCREEN(MENU_LAST_HEARD),
+	SCRIPT_SCREEN(MENU_OPTIONS),
+	SCRIPT_SCREEN(MENU_GENERAL),
+	SCRIPT_SCREEN(MENU_RADIO),
+	SCRIPT_SCREEN(MENU_DISPLAY),
+	SCRIPT_SCREEN(MENU_SOUND),
+	SCRIPT_SCREEN(MENU_SATELLITE),
+#if defined(HAS_GPS)
+	SCRIPT_SCREEN(MENU_GPS),
+#endif
+	SCRIPT_SCREEN(MENU_CONTACT_LIST),
+	SCRIPT_SCREEN(MENU_DTMF_CONTACT_LIST),
+	SCRIPT_SCREEN(MENU_CONTACT_QUICKLIST),
+	SCRIPT_SCREEN(MENU_CONTACT_LIST_SUBMENU),
+	SCRIPT_SCREEN(MENU_CONTACT_DETAILS),
+	SCRIPT_SCREEN(MENU_LANGUAGE),
+	SCRIPT_SCREEN(MENU_CALIBRATION),
+#if defined(HAS_COLOURS)
+	SCRIPT_SCREEN(MENU_THEME),
+#endif
+	SCRIPT_SCREEN(UI_CHANNEL_QUICK_MENU),
+	SCRIPT_SCREEN(UI_VFO_QUICK_MENU),
+	SCRIPT_SCREEN(MENU_CHANNEL_DETAILS),
+	SCRIPT_SCREEN(MENU_FIRMWARE_INFO),
+	SCRIPT_SCREEN(MENU_APRS),
+	SCRIPT_SCREEN(UI_MESSAGE_BOX),
+	SCRIPT_SCREEN(UI_HOTSPOT_MODE),
+	SCRIPT_SCREEN(UI_CPS),
+	SCRIPT_SCREEN(MENU_NUMERICAL_ENTRY),
+	SCRIPT_SCREEN(UI_TX_SCREEN),
+	SCRIPT_SCREEN(UI_SPLASH_SCREEN),
+	SCRIPT_SCREEN(UI_POWER_OFF),
+	SCRIPT_SCREEN(UI_VFO_MODE),
+	SCRIPT_SCREEN(UI_CHANNEL_MODE),
+	SCRIPT_SCREEN(UI_LOCK_SCREEN),
+	SCRIPT_SCREEN(UI_PRIVATE_CALL),
+	SCRIPT_SCREEN(MENU_CONTACT_NEW),
+#if defined(HAS_COLOURS)
+	SCRIPT_SCREEN(MENU_THEME_ITEMS_BROWSER),
+	SCRIPT_SCREEN(MENU_COLOUR_PICKER),
+#endif
+};
+
+#define SCRIPT_NUM_SCREENS      (sizeof(scriptScreens) / sizeof(scriptScreens[0]))
+
+static scriptEvent_t *scriptEvents = NULL;
+static int scriptNumEvents = 0;
+static int scriptCapacity = 0;
+static int scriptNext = 0;
+static const char *scriptPath = NULL;
+static int scriptLine = 0;
+static int scriptFailures = 0;
+
+static void scriptAdd(uint32_t time, scriptCommand_t command, int value, const char *path)
+{
+	if (scriptNumEvents == scriptCapacity)
+	{
+		scriptCapacity = ((scriptCapacity == 0) ? 64 : (scriptCapacity * 2));
+		if ((scriptEvents = realloc(scriptEvents, (scriptCapacity * sizeof(scriptEvent_t)))) == NULL)
+		{
+			simFatal("Script: out of memory\n");
+		}
+	}
+
+	scriptEvents[scriptNumEvents++] = (scriptEvent_t) { .time = time, .command = command, .value = value, .path = (path ? strdup(path) : NULL), .line = scriptLine };
+}
+
+static int scriptScreen(const char *name, const char *path, int line)
+{
+	for (size_t i = 0; (name != NULL) && (i < SCRIPT_NUM_SCREENS); i++)
+	{
+		if (strcmp(name, scriptScreens[i].name) == 0)
+		{
+			return scriptScreens[i].number;
+		}
+	}
+
+	simFatal("%s:%d: unknown screen \"%s\"\n", path, line, (name ? name : ""));
+	return MENU_EMPTY;
+}
+
+static const char *scriptScreenName(int number)
+{
+	for (size_t i = 0; i < SCRIPT_NUM_SCREENS; i++)
+	{
+		if (scriptScreens[i].number == number)
+		{
+			return scriptScreens[i].name;
+		}
+	}
+
+	return "?";
+}
+
+static int scriptInput(const char *name, const char *path, int line)
+{
+	int input = ((name != NULL) ? simInputFromName(name) : -1);
+
+	if (input < 0)
+	{
+		simFatal("%s:%d: unknown input \"%s\"\n", path, line, (name ? name : ""));
+	}
+
+	return input;
+}
+
+bool simScriptLoad(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	char buffer[256];
+	uint32_t cursor = 0;
+	int line = 0;
+
+	if (f == NULL)
+	{
+		return false;
+	}
+
+	scriptPath = strdup(path);
+
+	while (fgets(buffer, sizeof(buffer), f) != NULL)
+	{
+		char *p = strchr(buffer, '#');
+		char *command;
+		char *arg1;
+		char *arg2;
+
+		scriptLine = ++line;
+
+		if (p != NULL)
+		{
+			*p = 0;
+		}
+
+		if ((command = strtok(buffer, " \t\r\n")) == NULL)
+		{
+			continue;
+		}
+
+		arg1 = strtok(NULL, " \t\r\n");
+		arg2 = strtok(NULL, "\r\n"); // The rest of the line, for the text expectations
+
+		if (arg2 != NULL)
+		{
+			// Trailing blanks, before a comment
+			for (p = (arg2 + strlen(arg2)); (p > arg2) && isspace((unsigned char)p[-1]); p--)
+			{
+				p[-1] = 0;
+			}
+
+			arg2 += strspn(arg2, " \t");
+
+			if (*arg2 == 0)
+			{
+				arg2 = NULL;
+			}
+		}
+
+		if (strcmp(command, "wait") == 0)
+		{
+			cursor += (arg1 ? strtoul(arg1, NULL, 10) : 0);
+		}
+		else if (strcmp(command, "press") == 0)
+		{
+			scriptAdd(cursor, SCRIPT_PRESS, scriptInput(arg1, path, line), NULL);
+		}
+		else if (strcmp(command, "release") == 0)
+		{
+			scriptAdd(cursor, SCRIPT_RELEASE, scriptInput(arg1, path, line), NULL);
+		}
+		else if (strcmp(command, "tap") == 0)
+		{
+			int input = scriptInput(arg1, path, line);
+
+			scriptAdd(cursor, SCRIPT_PRESS, input, NULL);
+			cursor += (arg2 ? strtoul(arg2, NULL, 10) : SCRIPT_TAP_DURATION);
+			scriptAdd(cursor, SCRIPT_RELEASE, input, NULL);
+			cursor += SCRIPT_TAP_GAP;
+		}
+		else if (strcmp(command, "rotary") == 0)
+		{
+			int steps = (arg1 ? atoi(arg1) : 0);
+
+			for (int i = 0; i < abs(steps); i++)
+			{
+				scriptAdd(cursor, SCRIPT_ROTARY, ((steps > 0) ? 1 : -1), NULL);
+				cursor += SCRIPT_ROTARY_PERIOD;
+			}
+		}
+		else if (strcmp(command, "volume") == 0)
+		{
+			scriptAdd(cursor, SCRIPT_VOLUME, (arg1 ? atoi(arg1) : 0), NULL);
+		}
+		else if ((strcmp(command, "screenshot") == 0) && (arg1 != NULL))
+		{
+			scriptAdd(cursor, SCRIPT_SCREENSHOT, 0, arg1);
+		}
+		else if (strcmp(command, "registers") == 0)
+		{
+			scriptAdd(cursor, SCRIPT_REGISTERS, 0, NULL);
+		}
+		else if ((strcmp(command, "lookup") == 0) && (arg1 != NULL))
+		{
+			scriptAdd(cursor, SCRIPT_LOOKUP, (int)strtoul(arg1, NULL, 10), NULL);
+		}
+		else if ((strcmp(command, "expect") == 0) && (arg1 != NULL) && (strcmp(arg1, "screen") == 0))
+		{
+			scriptAdd(cursor, SCRIPT_EXPECT_SCREEN, scriptScreen(arg2, path, line), NULL);
+		}
+		else if ((strcmp(command, "expect") == 0) && (arg1 != NULL) && (strcmp(arg1, "text") == 0) && (arg2 != NULL))
+		{
+			scriptAdd(cursor, SCRIPT_EXPECT_TEXT, 0, arg2);
+		}
+		else if (strcmp(command, "quit") == 0)
+		{
+			scriptAdd(cursor, SCRIPT_QUIT, 0, NULL);
+		}
+		else
+		{
+			simFatal("%s:%d: invalid command \"%s\"\n", path, line, command);
+		}
+	}
+
+	fclose(f);
+
+	return true;
+}
+
+static void scriptLookup(uint32_t id)
+{
+	dmrIdDataStruct_t record;
+	uint32_t transactions, bytes, endTransactions, endBytes;
+	bool found;
+
+	simFlashGetStats(&transactions, &bytes);
+	found = dmrIDLookup(id, &record);
+	simFlashGetStats(&endTransactions, &endBytes);
+
+	printf("Lookup %u: %s \"%s\", %u SPI flash transactions, %u bytes\n", id, (found ? "found" : "not found"), record.text,
+			(endTransactions - transactions), (endBytes - bytes));
+}
+
+static void scriptFail(const scriptEvent_t *event, const char *format, ...)
+{
+	va_list args;
+
+	fprintf(stderr, "%s:%d: ", scriptPath, event->line);
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+	fprintf(stderr, "\n");
+
+	scriptFailures++;
+}
+
+int simScriptGetFailures(void)
+{
+	return scriptFailures;
+}
+
+bool simScriptIsDone(void)
+{
+	return (scriptNext >= scriptNumEvents);
+}
+
+void simScriptTick(uint32_t now)
+{
+	while ((scriptNext < scriptNumEvents) && (scriptEvents[scriptNext].time <= now))
+	{
+		scriptEvent_t *event = &scriptEvents[scriptNext++];
+
+		SIM_LOG("Script: %u ms, command %d (%d)\n", now, event->command, event->value);
+
+		switch (event->command)
+		{
+			case SCRIPT_PRESS:
+			case SCRIPT_RELEASE:
+				simInputSet(event->value, (event->command == SCRIPT_PRESS));
+				break;
+			case SCRIPT_ROTARY:
+				simRotaryStep(event->value);
+				break;
+			case SCRIPT_VOLUME:
+				simVolumeADC = event->value;
+				break;
+			case SCRIPT_SCREENSHOT:
+				if (!simDisplaySavePNG(event->path))
+				{
+					fprintf(stderr, "Script: failed to save %s\n", event->path);
+				}
+				break;
+			case SCRIPT_REGISTERS:
+				simRadioDump();
+				break;
+			case SCRIPT_LOOKUP:
+				scriptLookup(event->value);
+				break;
+			case SCRIPT_EXPECT_SCREEN:
+				if (menuSystemGetCurrentMenuNumber() != event->value)
+				{
+					scriptFail(event, "expected screen %s, got %s", scriptScreenName(event->value), scriptScreenName(menuSystemGetCurrentMenuNumber()));
+				}
+				break;
+			case SCRIPT_EXPECT_TEXT:
+				if (simDisplayFindText(event->path) == false)
+				{
+					scriptFail(event, "expected text \"%s\" isn't shown", event->path);
+				}
+				break;
+			case SCRIPT_QUIT:
+				simExit(0);
+				break;
+		}
+	}
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdio.h>
+#include "main.h"
+#include "sim.h"
+
+#if defined(USING_TRACE)
+
+#include "SeggerRTT/RTT/SEGGER_RTT.h"
+#include "interfaces/trace.h"
+
+//
+// Trace build (make TRACE=1): the RTT up-buffer written by interfaces/trace.c is drained on each tick,
+// as a J-Link/OpenOCD would, into a raw capture file (--trace) which tools/trace_decode.py reads.
+// The cycles are the elapsed host time, at the simulated core clock.
+//
+
+static FILE *traceFile = NULL;
+
+
+bool simTraceOpen(const char *path)
+{
+	traceFile = fopen(path, "wb");
+
+	return (traceFile != NULL);
+}
+
+void simTraceDrain(void)
+{
+	uint8_t buffer[4096];
+	unsigned length;
+
+	if (traceFile == NULL)
+	{
+		return;
+	}
+
+	while ((length = SEGGER_RTT_ReadUpBuffer(TRACE_RTT_CHANNEL, buffer, sizeof(buffer))) > 0)
+	{
+		fwrite(buffer, 1, length, traceFile);
+	}
+}
+
+void simTraceClose(void)
+{
+	if (traceFile != NULL)
+	{
+		simTraceDrain();
+		fclose(traceFile);
+		traceFile = NULL;
+	}
+}
+
+#endif
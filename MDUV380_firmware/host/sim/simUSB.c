@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include "main.h"
+#include "usbd_cdc_if.h"
+#include "usb_device.h"
+#include "usb/usb_com.h"
+#include "functions/settings.h"
+#include "functions/eventBus.h"
+#include "sim.h"
+// After the CMSIS headers: the CRx/NLx termios defines clash with their register names
+#include <sys/ioctl.h>
+#include <termios.h>
+
+//
+// USB CDC device (USB_DEVICE/App/usbd_cdc_if.c): usb/usb_com.c handles the CPS requests as on the radio,
+// the host end is a pseudo terminal (--usb), which can be used as the radio serial port (tools/opengd77_cps_transfer.py).
+// The USB packets boundaries don't go through a pty: the requests are delimited using their header instead.
+// As with the OUT endpoint, nothing more is received while a pipelined request ('P') isn't replied.
+//
+
+USBD_HandleTypeDef hUsbDeviceFS;
+
+static int usbFd = -1;
+static char usbPath[64];
+static bool receivePaused = false;
+static uint8_t receiveBuffer[COM_REQUESTBUFFER_SIZE];
+static uint32_t receiveLength = 0;
+static uint8_t cdcTxBuffer[COM_BUFFER_SIZE];
+
+
+void MX_USB_DEVICE_Init(void)
+{
+}
+
+void MX_USB_DEVICE_DeInit(void)
+{
+}
+
+bool simUSBOpen(void)
+{
+	struct termios tio;
+	unsigned int ptyNumber;
+	int unlock = 0;
+
+	usbFd = open("/dev/ptmx", O_RDWR | O_NOCTTY);
+	if (usbFd < 0)
+	{
+		return false;
+	}
+
+	if ((ioctl(usbFd, TIOCSPTLCK, &unlock) != 0) || (ioctl(usbFd, TIOCGPTN, &ptyNumber) != 0))
+	{
+		simUSBClose();
+		return false;
+	}
+	snprintf(usbPath, sizeof(usbPath), "/dev/pts/%u", ptyNumber);
+
+	// Raw binary transfers, whatever the other end sets
+	if (tcgetattr(usbFd, &tio) == 0)
+	{
+		cfmakeraw(&tio);
+		tcsetattr(usbFd, TCSANOW, &tio);
+	}
+
+	hUsbDeviceFS.dev_state = USBD_STATE_CONFIGURED;
+
+	return true;
+}
+
+const char *simUSBGetPath(void)
+{
+	return ((usbFd >= 0) ? usbPath : NULL);
+}
+
+void simUSBClose(void)
+{
+	if (usbFd >= 0)
+	{
+		close(usbFd);
+		usbFd = -1;
+	}
+
+	hUsbDeviceFS.dev_state = USBD_STATE_DEFAULT;
+}
+
+// Length of the request at the start of the buffer, 0 if more is needed to know it.
+// Anything but the sized requests is taken as a whole (a packet on the radio).
+static uint32_t simUSBRequestLength(const uint8_t *buf, uint32_t length)
+{
+	switch (buf[0])
+	{
+		case 'R':
+			return 8;
+
+		case 'W':
+		case 'X':
+			if (length < 2)
+			{
+				return 0;
+			}
+
+			switch (buf[1])
+			{
+				case 1:
+					return 5;
+				case 3:
+					return 2;
+				case 2:
+				case 4:
+				case 7:
+					return ((length < 8) ? 0 : (8 + ((buf[6] << 8) + buf[7])));
+				default:
+					return length;
+			}
+
+		case 'P':
+			if (length < 10)
+			{
+				return 0;
+			}
+			return (14 + ((buf[1] == 3) ? 0 : ((buf[8] << 8) + buf[9])));
+
+		default:
+			return length;
+	}
+}
+
+// Called on each tick: hands the next complete request over to usb_com.c, once the previous one is handled
+void simUSBTick(void)
+{
+	struct pollfd pfd = { .fd = usbFd, .events = POLLIN };
+	uint32_t requestLength;
+
+	if ((usbFd < 0) || receivePaused || (com_request != 0))
+	{
+		return;
+	}
+
+	if ((receiveLength < sizeof(receiveBuffer)) && (poll(&pfd, 1, 0) > 0) && (pfd.revents & POLLIN))
+	{
+		ssize_t length = read(usbFd, &receiveBuffer[receiveLength], (sizeof(receiveBuffer) - receiveLength));
+
+		if (length > 0)
+		{
+			receiveLength += length;
+		}
+	}
+
+	if (receiveLength == 0)
+	{
+		return;
+	}
+
+	requestLength = simUSBRequestLength(receiveBuffer, receiveLength);
+	if (requestLength > sizeof(receiveBuffer))
+	{
+		// Same as an overflow on the radio
+		receiveLength = 0;
+		cdcTxBuffer[0] = '-';
+		CDC_Transmit_FS(cdcTxBuffer, 1);
+		return;
+	}
+
+	if ((requestLength == 0) || (requestLength > receiveLength))
+	{
+		return;
+	}
+
+	memset((uint8_t *)com_requestbuffer, 0, sizeof(com_requestbuffer));
+	memcpy((uint8_t *)com_requestbuffer, receiveBuffer, requestLength);
+	receiveLength -= requestLength;
+	memmove(receiveBuffer, &receiveBuffer[requestLength], receiveLength);
+
+	if ((settingsUsbMode == USB_MODE_CPS) && (com_requestbuffer[0] == 'P'))
+	{
+		receivePaused = true;
+	}
+
+	com_request = 1;
+	eventBusPost(EVENT_BUS_USB_DATA, 0);
+}
+
+uint8_t CDC_Transmit_FS(uint8_t *Buf, uint16_t Len)
+{
+	while ((usbFd >= 0) && (Len > 0))
+	{
+		ssize_t length = write(usbFd, Buf, Len);
+
+		if (length <= 0)
+		{
+			break;
+		}
+
+		Buf += length;
+		Len -= length;
+	}
+
+	return USBD_OK;
+}
+
+void CDC_ResumeReceive_FS(void)
+{
+	receivePaused = false;
+}
+
+uint8_t *CDC_AcquireTxBuffer_FS(void)
+{
+	return cdcTxBuffer;
+}
+
+uint8_t CDC_TransmitTxBuffer_FS(uint16_t Len)
+{
+	return CDC_Transmit_FS(cdcTxBuffer, Len);
+}
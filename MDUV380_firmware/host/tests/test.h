@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef _TEST_H_
+#define _TEST_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sim.h"
+
+// Host unit tests: a test is a program linked against the application and sim/ objects (hostMain.c excepted),
+// run by "make test" from the host directory. A test can #include a source file to reach its static functions
+// (or a driver the sim/ sources replace), its definitions win over the library ones.
+
+#define TEST_ASSERT(condition) \
+	do { if (!(condition)) { testFail(__FILE__, __LINE__, "%s", #condition); } } while (0)
+
+#define TEST_ASSERT_EQUAL(expected, actual) \
+	do { long long e_ = (long long)(expected), a_ = (long long)(actual); \
+		if (e_ != a_) { testFail(__FILE__, __LINE__, "%s == %s: expected %lld, got %lld", #actual, #expected, e_, a_); } } while (0)
+
+#define TEST_ASSERT_MEMORY(expected, actual, length) \
+	do { if (memcmp((expected), (actual), (length)) != 0) { testFail(__FILE__, __LINE__, "%s differs from %s", #actual, #expected); } } while (0)
+
+void testInit(const char *name);
+void testFail(const char *file, int line, const char *format, ...) __attribute__((format(printf, 3, 4)));
+int testDone(void);
+
+#endif
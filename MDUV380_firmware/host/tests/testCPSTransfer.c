@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include "main.h"
+#include "usb/usb_com.h"
+#include "hardware/SPI_Flash.h"
+#include "interfaces/crc.h"
+#include "test.h"
+
+//
+// CPS pipelined transfers ('P' command, usb/usb_com.c), as tools/opengd77_cps_transfer.py does them: the requests
+// are written to the simulated USB CDC pseudo terminal (sim/simUSB.c) several at a time, without waiting for
+// the replies, then the main loop side (tick_com_request()) runs each simulated millisecond until they are all replied.
+//
+// It checks the replies order and contents, the Flash content once committed, the commit counters (erased,
+// programmed only, unchanged sectors), the pipelined reads, the digests, and the sequence and CRC errors.
+//
+
+#define TEST_AREA               0x00200000 // Away from the codeplug, nobody else uses it here
+#define TEST_AREA_SIZE          (3 * 4096)
+#define TEST_BLOCK_SIZE         1024
+#define MAX_REPLY_LENGTH        (7 + TEST_BLOCK_SIZE + 4)
+
+enum
+{
+	OP_OPEN = 0,
+	OP_WRITE_FLASH,
+	OP_COMMIT,
+	OP_READ_FLASH,
+	OP_DIGEST
+};
+
+enum
+{
+	STATUS_OK = 0,
+	STATUS_SEQUENCE_ERROR,
+	STATUS_CRC_ERROR,
+	STATUS_BAD_REQUEST
+};
+
+typedef struct
+{
+	uint8_t  op;
+	uint16_t sequence;
+	uint8_t  status;
+	uint16_t length;
+	uint8_t  data[TEST_BLOCK_SIZE];
+} reply_t;
+
+static int hostFd = -1;
+static uint16_t sequence = 0;
+static uint8_t reference[TEST_AREA_SIZE];
+
+static void put32(uint8_t *p, uint32_t value)
+{
+	p[0] = (value >> 24);
+	p[1] = (value >> 16);
+	p[2] = (value >> 8);
+	p[3] = value;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+	return ((p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]);
+}
+
+// Returns the request sequence number
+static uint16_t sendRequest(uint8_t op, uint32_t address, uint16_t length, const uint8_t *payload, bool corrupted)
+{
+	uint8_t request[14 + TEST_BLOCK_SIZE];
+	uint16_t payloadLength = ((op == OP_READ_FLASH) ? 0 : length);
+	uint16_t requestSequence = sequence++;
+
+	request[0] = 'P';
+	request[1] = op;
+	request[2] = (requestSequence >> 8);
+	request[3] = requestSequence;
+	put32(&request[4], address);
+	request[8] = (length >> 8);
+	request[9] = length;
+	put32(&request[10], (crcCalc32(0, payload, payloadLength) ^ (corrupted ? 1 : 0)));
+	memcpy(&request[14], payload, payloadLength);
+
+	TEST_ASSERT_EQUAL(14 + payloadLength, write(hostFd, request, 14 + payloadLength));
+
+	return requestSequence;
+}
+
+// Runs the main loop until the given length is received
+static bool receive(uint8_t *buf, uint32_t length)
+{
+	uint32_t received = 0;
+
+	for (int ms = 0; (ms < 5000) && (received < length); ms++)
+	{
+		struct pollfd pfd = { .fd = hostFd, .events = POLLIN };
+
+		simClockAdvance(1);
+		tick_com_request();
+
+		while ((received < length) && (poll(&pfd, 1, 0) > 0))
+		{
+			ssize_t count = read(hostFd, &buf[received], (length - received));
+
+			if (count <= 0)
+			{
+				break;
+			}
+			received += count;
+		}
+	}
+
+	return (received == length);
+}
+
+static bool receiveReply(reply_t *reply)
+{
+	uint8_t buf[MAX_REPLY_LENGTH];
+
+	if ((receive(buf, 7) == false) || (buf[0] != 'P'))
+	{
+		return false;
+	}
+
+	reply->op = buf[1];
+	reply->sequence = ((buf[2] << 8) | buf[3]);
+	reply->status = buf[4];
+	reply->length = ((buf[5] << 8) | buf[6]);
+
+	if ((reply->length > TEST_BLOCK_SIZE) || (receive(&buf[7], reply->length + 4) == false))
+	{
+		return false;
+	}
+
+	memcpy(reply->data, &buf[7], reply->length);
+
+	return (get32(&buf[7 + reply->length]) == crcCalc32(0, reply->data, reply->length));
+}
+
+static void checkReply(uint8_t op, uint16_t requestSequence, uint8_t status, reply_t *reply)
+{
+	TEST_ASSERT(receiveReply(reply));
+	TEST_ASSERT_EQUAL(op, reply->op);
+	TEST_ASSERT_EQUAL(requestSequence, reply->sequence);
+	TEST_ASSERT_EQUAL(status, reply->status);
+}
+
+static void openPipeline(void)
+{
+	reply_t reply;
+
+	sequence = 0;
+	checkReply(OP_OPEN, sendRequest(OP_OPEN, 0, 0, NULL, false), STATUS_OK, &reply);
+	TEST_ASSERT_EQUAL(3, reply.length);
+	TEST_ASSERT_EQUAL(2, reply.data[0]); // protocol version
+	TEST_ASSERT_EQUAL(TEST_BLOCK_SIZE, ((reply.data[1] << 8) | reply.data[2]));
+}
+
+// Erased, programmed only, unchanged
+static void commit(int erased, int programmedOnly, int unchanged)
+{
+	reply_t reply;
+
+	checkReply(OP_COMMIT, sendRequest(OP_COMMIT, 0, 0, NULL, false), STATUS_OK, &reply);
+	TEST_ASSERT_EQUAL(6, reply.length);
+	TEST_ASSERT_EQUAL(erased, ((reply.data[0] << 8) | reply.data[1]));
+	TEST_ASSERT_EQUAL(programmedOnly, ((reply.data[2] << 8) | reply.data[3]));
+	TEST_ASSERT_EQUAL(unchanged, ((reply.data[4] << 8) | reply.data[5]));
+}
+
+// The whole area, all the blocks queued before the first reply is read
+static void writeArea(void)
+{
+	uint16_t sequences[TEST_AREA_SIZE / TEST_BLOCK_SIZE];
+	reply_t reply;
+
+	for (int i = 0; i < (TEST_AREA_SIZE / TEST_BLOCK_SIZE); i++)
+	{
+		sequences[i] = sendRequest(OP_WRITE_FLASH, TEST_AREA + (i * TEST_BLOCK_SIZE), TEST_BLOCK_SIZE, &reference[i * TEST_BLOCK_SIZE], false);
+	}
+
+	for (int i = 0; i < (TEST_AREA_SIZE / TEST_BLOCK_SIZE); i++)
+	{
+		checkReply(OP_WRITE_FLASH, sequences[i], STATUS_OK, &reply);
+		TEST_ASSERT_EQUAL(0, reply.length);
+	}
+}
+
+static void checkFlash(void)
+{
+	static uint8_t buf[TEST_AREA_SIZE];
+
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA, buf, TEST_AREA_SIZE));
+	TEST_ASSERT_MEMORY(reference, buf, TEST_AREA_SIZE);
+}
+
+static void testWrite(void)
+{
+	for (int i = 0; i < TEST_AREA_SIZE; i++)
+	{
+		reference[i] = rand();
+	}
+
+	// Blank sectors are only programmed
+	openPipeline();
+	writeArea();
+	commit(0, 3, 0);
+	checkFlash();
+
+	// Same content
+	openPipeline();
+	writeArea();
+	commit(0, 0, 3);
+
+	// Some bits back to 1 in the second sector only
+	reference[4096 + 10] = ~reference[4096 + 10];
+	openPipeline();
+	writeArea();
+	commit(1, 0, 2);
+	checkFlash();
+}
+
+static void testRead(void)
+{
+	uint16_t sequences[TEST_AREA_SIZE / TEST_BLOCK_SIZE];
+	reply_t reply;
+
+	openPipeline();
+
+	for (int i = 0; i < (TEST_AREA_SIZE / TEST_BLOCK_SIZE); i++)
+	{
+		sequences[i] = sendRequest(OP_READ_FLASH, TEST_AREA + (i * TEST_BLOCK_SIZE), TEST_BLOCK_SIZE, NULL, false);
+	}
+
+	for (int i = 0; i < (TEST_AREA_SIZE / TEST_BLOCK_SIZE); i++)
+	{
+		checkReply(OP_READ_FLASH, sequences[i], STATUS_OK, &reply);
+		TEST_ASSERT_EQUAL(TEST_BLOCK_SIZE, reply.length);
+		TEST_ASSERT_MEMORY(&reference[i * TEST_BLOCK_SIZE], reply.data, TEST_BLOCK_SIZE);
+	}
+}
+
+static void testDigest(void)
+{
+	uint8_t ranges[3 * 8];
+	reply_t reply;
+
+	// A sector, a part of one, a range across two
+	put32(&ranges[0], TEST_AREA);
+	put32(&ranges[4], 4096);
+	put32(&ranges[8], TEST_AREA + 4096 + 100);
+	put32(&ranges[12], 1000);
+	put32(&ranges[16], TEST_AREA + 4000);
+	put32(&ranges[20], 5000);
+
+	openPipeline();
+	checkReply(OP_DIGEST, sendRequest(OP_DIGEST, 0, sizeof(ranges), ranges, false), STATUS_OK, &reply);
+	TEST_ASSERT_EQUAL(3 * 4, reply.length);
+	TEST_ASSERT_EQUAL(crcCalc32(0, reference, 4096), get32(&reply.data[0]));
+	TEST_ASSERT_EQUAL(crcCalc32(0, &reference[4096 + 100], 1000), get32(&reply.data[4]));
+	TEST_ASSERT_EQUAL(crcCalc32(0, &reference[4000], 5000), get32(&reply.data[8]));
+}
+
+static void testErrors(void)
+{
+	uint8_t block[TEST_BLOCK_SIZE];
+	reply_t reply;
+	uint16_t requestSequence;
+
+	memset(block, 0x00, sizeof(block));
+	openPipeline();
+
+	// Corrupted data: nothing is staged, the next sequence number is still expected
+	checkReply(OP_WRITE_FLASH, sendRequest(OP_WRITE_FLASH, TEST_AREA, sizeof(block), block, true), STATUS_CRC_ERROR, &reply);
+
+	// Crossing a sector boundary
+	checkReply(OP_WRITE_FLASH, sendRequest(OP_WRITE_FLASH, TEST_AREA + 4000, sizeof(block), block, false), STATUS_BAD_REQUEST, &reply);
+
+	// Skipped sequence number
+	sequence++;
+	requestSequence = sendRequest(OP_READ_FLASH, TEST_AREA, 16, NULL, false);
+	checkReply(OP_READ_FLASH, requestSequence, STATUS_SEQUENCE_ERROR, &reply);
+	sequence = (requestSequence - 1); // still the expected one
+
+	// Nothing has been written
+	commit(0, 0, 0);
+	checkFlash();
+}
+
+int main(int argc, char **argv)
+{
+	testInit("testCPSTransfer");
+
+	if (simUSBOpen() == false)
+	{
+		simFatal("testCPSTransfer: can't create the USB pseudo terminal\n");
+	}
+
+	hostFd = open(simUSBGetPath(), O_RDWR | O_NOCTTY);
+	TEST_ASSERT(hostFd >= 0);
+
+	testWrite();
+	testRead();
+	testDigest();
+	testErrors();
+
+	close(hostFd);
+	simUSBClose();
+
+	return testDone();
+}
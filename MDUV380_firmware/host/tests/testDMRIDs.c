@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "hardware/SPI_Flash.h"
+#include "functions/voicePrompts.h"
+#include "user_interface/uiUtilities.h"
+#include "test.h"
+#include "sim.h"
+
+//
+// DMR IDs database (user_interface/uiUtilities.c): an IDv2 header is only accepted if its blocks fit
+// in the two Flash areas, the second one being over the voice prompts or not, and every ID of a
+// database spanning both areas is found, with its text, while the IDs in between are not.
+//
+
+extern const uint32_t DMRID_MEMORY_LOCATION_1;
+extern const uint32_t DMRID_MEMORY_LOCATION_2;
+extern uint32_t dmrIDDatabaseMemoryLocation2;
+
+#define TEST_ENTRIES                1234
+#define TEST_LOOKUP_ENTRIES         40000
+#define TEST_LOOKUP_MAX_BLOCKS      2048
+#define TEST_LOOKUP_FIRST_ID        2340000
+
+// All coded on 7 bits, after the end of text symbol (0): symbol k has the code k
+static const char lookupSymbols[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+static uint8_t lookupBlocks[TEST_LOOKUP_MAX_BLOCKS][DMRID_V2_BLOCK_SIZE];
+static uint32_t lookupIndex[TEST_LOOKUP_MAX_BLOCKS];
+
+static uint32_t dataOffset(uint32_t blocks)
+{
+	return ((sizeof(dmrIDv2Header_t) + (blocks * sizeof(uint32_t)) + (DMRID_V2_BLOCK_SIZE - 1)) / DMRID_V2_BLOCK_SIZE) * DMRID_V2_BLOCK_SIZE;
+}
+
+// Same as v2Capacity(), in tools/dmrid_db_builder.py
+static uint32_t capacity(uint32_t area2Address)
+{
+	uint32_t area2Blocks = (((0x100000 + FLASH_ADDRESS_OFFSET) - area2Address) / DMRID_V2_BLOCK_SIZE);
+	uint32_t blocks = 0;
+
+	while ((((0x40000 - dataOffset(blocks + 1)) / DMRID_V2_BLOCK_SIZE) + area2Blocks) >= (blocks + 1))
+	{
+		blocks++;
+	}
+
+	return blocks;
+}
+
+static void writeHeader(uint32_t blocks, uint8_t flags)
+{
+	dmrIDv2Header_t header;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "IDv2", 4);
+	header.entries = TEST_ENTRIES;
+	header.blocks = blocks;
+	header.lastId = 9999999;
+	header.blockSize = DMRID_V2_BLOCK_SIZE;
+	header.flags = flags;
+	header.numSymbols = 2;
+	header.codeLengthCounts[1] = 2;
+
+	TEST_ASSERT(SPI_Flash_write(DMRID_MEMORY_LOCATION_1, (uint8_t *)&header, sizeof(header)));
+}
+
+static void testBlocksBounds(uint8_t flags, uint32_t area2Address)
+{
+	uint32_t maxBlocks = capacity(area2Address);
+
+	writeHeader(maxBlocks, flags);
+	dmrIDCacheInit();
+	TEST_ASSERT_EQUAL(TEST_ENTRIES, dmrIDCacheGetCount());
+	TEST_ASSERT_EQUAL(area2Address, dmrIDDatabaseMemoryLocation2);
+
+	writeHeader(maxBlocks + 1, flags);
+	dmrIDCacheInit();
+	TEST_ASSERT_EQUAL(0, dmrIDCacheGetCount());
+	TEST_ASSERT_EQUAL(DMRID_MEMORY_LOCATION_2, dmrIDDatabaseMemoryLocation2);
+
+	// The index size computation wraps around
+	writeHeader(0x40000000, flags);
+	dmrIDCacheInit();
+	TEST_ASSERT_EQUAL(0, dmrIDCacheGetCount());
+}
+
+// IDs are 2 to 4 apart, so (lookupId(i) + 1) is never in the database
+static uint32_t lookupId(uint32_t i)
+{
+	return (TEST_LOOKUP_FIRST_ID + (i * 3) + ((i % 7) == 0));
+}
+
+static void lookupText(uint32_t i, char *text)
+{
+	sprintf(text, "%c%u%.*s", ('A' + (i % 26)), (unsigned int)i, (int)(i % 11), "ZYXWVUTSRQP");
+}
+
+static uint8_t lookupTextEncode(const char *text, uint8_t *out)
+{
+	uint32_t numBits = 0;
+	size_t len = strlen(text);
+
+	memset(out, 0, MAX_DMR_ID_CONTACT_TEXT_LENGTH);
+
+	for (size_t i = 0; i <= len; i++)
+	{
+		uint8_t code = ((i < len) ? ((strchr(lookupSymbols, text[i]) - lookupSymbols) + 1) : 0);
+
+		for (int bit = 6; bit >= 0; bit--)
+		{
+			out[numBits >> 3] |= (((code >> bit) & 0x01) << (7 - (numBits & 0x07)));
+			numBits++;
+		}
+	}
+
+	return ((numBits + 7) / 8);
+}
+
+// Same layout as buildV2(), in tools/dmrid_db_builder.py
+static uint32_t lookupBuild(void)
+{
+	uint32_t blocks = 0;
+	uint32_t pairsLength = 0;
+	uint32_t textsLength = DMRID_V2_BLOCK_SIZE;
+	uint32_t previousId = 0;
+
+	memset(lookupBlocks, 0xFF, sizeof(lookupBlocks));
+
+	for (uint32_t i = 0; i < TEST_LOOKUP_ENTRIES; i++)
+	{
+		char text[MAX_DMR_ID_CONTACT_TEXT_LENGTH];
+		uint8_t encoded[MAX_DMR_ID_CONTACT_TEXT_LENGTH];
+		uint8_t pair[6];
+		uint8_t pairLength = 0;
+		uint32_t delta = (lookupId(i) - previousId);
+		uint8_t textLength;
+
+		lookupText(i, text);
+		textLength = lookupTextEncode(text, encoded);
+
+		do
+		{
+			pair[pairLength++] = ((delta & 0x7F) | ((delta > 0x7F) ? 0x80 : 0x00));
+			delta >>= 7;
+		} while (delta);
+		pair[pairLength++] = textLength;
+
+		if ((blocks == 0) || ((pairsLength + pairLength + (DMRID_V2_BLOCK_SIZE - textsLength) + textLength) > DMRID_V2_BLOCK_SIZE))
+		{
+			TEST_ASSERT(blocks < TEST_LOOKUP_MAX_BLOCKS);
+			lookupIndex[blocks++] = lookupId(i);
+			lookupBlocks[blocks - 1][0] = 0;
+			pairsLength = 1;
+			textsLength = DMRID_V2_BLOCK_SIZE;
+			// The first record's delta is from the block index
+			pair[0] = 0;
+			pair[1] = textLength;
+			pairLength = 2;
+		}
+
+		memcpy(&lookupBlocks[blocks - 1][pairsLength], pair, pairLength);
+		pairsLength += pairLength;
+		textsLength -= textLength;
+		memcpy(&lookupBlocks[blocks - 1][textsLength], encoded, textLength);
+		lookupBlocks[blocks - 1][0]++;
+		previousId = lookupId(i);
+	}
+
+	return blocks;
+}
+
+static void testLookups(void)
+{
+	dmrIDv2Header_t header;
+	dmrIdDataStruct_t record;
+	char text[MAX_DMR_ID_CONTACT_TEXT_LENGTH];
+	uint32_t blocks = lookupBuild();
+	uint32_t blocksInArea1 = ((0x40000 - dataOffset(blocks)) / DMRID_V2_BLOCK_SIZE);
+	uint32_t transactions, bytes;
+	uint32_t repeatTransactions, repeatBytes;
+
+	// The second area has to be used
+	TEST_ASSERT(blocks > blocksInArea1);
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "IDv2", 4);
+	header.entries = TEST_LOOKUP_ENTRIES;
+	header.blocks = blocks;
+	header.lastId = lookupId(TEST_LOOKUP_ENTRIES - 1);
+	header.blockSize = DMRID_V2_BLOCK_SIZE;
+	header.numSymbols = (strlen(lookupSymbols) + 1);
+	header.codeLengthCounts[7] = header.numSymbols;
+	memcpy(&header.symbols[1], lookupSymbols, strlen(lookupSymbols));
+
+	TEST_ASSERT(SPI_Flash_write(DMRID_MEMORY_LOCATION_1, (uint8_t *)&header, sizeof(header)));
+	TEST_ASSERT(SPI_Flash_write(DMRID_MEMORY_LOCATION_1 + sizeof(header), (uint8_t *)lookupIndex, (blocks * sizeof(uint32_t))));
+	TEST_ASSERT(SPI_Flash_write(DMRID_MEMORY_LOCATION_1 + dataOffset(blocks), lookupBlocks[0], (blocksInArea1 * DMRID_V2_BLOCK_SIZE)));
+	TEST_ASSERT(SPI_Flash_write(DMRID_MEMORY_LOCATION_2, lookupBlocks[blocksInArea1], ((blocks - blocksInArea1) * DMRID_V2_BLOCK_SIZE)));
+
+	dmrIDCacheInit();
+	TEST_ASSERT_EQUAL(TEST_LOOKUP_ENTRIES, dmrIDCacheGetCount());
+
+	for (uint32_t i = 0; i < TEST_LOOKUP_ENTRIES; i++)
+	{
+		memset(&record, 0, sizeof(record));
+		lookupText(i, text);
+		TEST_ASSERT(dmrIDLookup(lookupId(i), &record));
+		TEST_ASSERT_EQUAL(lookupId(i), record.id);
+		TEST_ASSERT(strcmp(text, record.text) == 0);
+
+		TEST_ASSERT(dmrIDLookup(lookupId(i) + 1, &record) == false);
+	}
+
+	TEST_ASSERT(dmrIDLookup(TEST_LOOKUP_FIRST_ID - 1, &record) == false);
+	TEST_ASSERT(dmrIDLookup(lookupId(TEST_LOOKUP_ENTRIES - 1) + 1, &record) == false);
+
+	// Looking the same ID up again (e.g. a QSO going on) doesn't go further than the SPI Flash cache
+	TEST_ASSERT(dmrIDLookup(lookupId(TEST_LOOKUP_ENTRIES / 2), &record));
+	simFlashGetStats(&transactions, &bytes);
+	TEST_ASSERT(dmrIDLookup(lookupId(TEST_LOOKUP_ENTRIES / 2), &record));
+	simFlashGetStats(&repeatTransactions, &repeatBytes);
+	TEST_ASSERT_EQUAL(transactions, repeatTransactions);
+}
+
+int main(int argc, char **argv)
+{
+	testInit("testDMRIDs");
+
+	testBlocksBounds(0, DMRID_MEMORY_LOCATION_2);
+	testBlocksBounds(DMRID_V2_FLAG_OVERWRITE_VP, VOICE_PROMPTS_FLASH_HEADER_ADDRESS);
+	testLookups();
+
+	return testDone();
+}
@@ -0,0 +1,363 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+#include "application/source/hardware/HX8353E_display.c"
+#include "user_interface/uiLocalisation.h"
+#include "test.h"
+
+//
+// HX8353E framebuffer (hardware/HX8353E_display.c): scenes are drawn, sent to the simulated panel, and each
+// 8 lines row of the panel is compared to the recorded one (CRC32 of the RGB565 pixels, tests/data/displayScenes.txt).
+// testDisplayIndexed builds the same test with the palette indexed framebuffer, against the same recording.
+//
+// "testDisplay -w" rewrites the recording, a failing scene is saved as build/tests/<test>-<scene>.png.
+// "testDisplay -b" also times the text rendering.
+//
+
+#if !defined(TEST_DISPLAY_NAME)
+#define TEST_DISPLAY_NAME       "testDisplay"
+#endif
+#define GOLDEN_PATH             "tests/data/displayScenes.txt"
+#define GOLDEN_MAX_LINES        (32 * DISPLAY_NUMBER_OF_ROWS)
+#define LINE_LENGTH             64
+
+typedef struct
+{
+	const char *name;
+	void (*draw)(void);
+} scene_t;
+
+static char golden[GOLDEN_MAX_LINES][LINE_LENGTH];
+static int goldenCount = 0;
+static FILE *goldenOutput = NULL;
+
+static uint16_t colour(uint32_t rgb888)
+{
+	return displayConvertRGB888ToNative(rgb888);
+}
+
+// No more than 16 colours per scene, as a 4 bits per pixel palette holds
+static void drawShapes(void)
+{
+	displaySetForegroundAndBackgroundColours(colour(0x000000), colour(0xFFFFFF));
+	displayClearBuf();
+
+	displaySetForegroundAndBackgroundColours(colour(0xFF0000), colour(0xFFFFFF));
+	displayFillRect(3, 5, 40, 20, false);
+	displayDrawRect(50, 5, 41, 21, true);
+	displaySetForegroundAndBackgroundColours(colour(0x00FF00), colour(0x202020));
+	displayFillRect(100, 2, 57, 30, true);
+	displayFillRoundRect(102, 4, 50, 24, 6, false);
+	displaySetForegroundAndBackgroundColours(colour(0x0000FF), colour(0xFFFF00));
+	displayDrawRoundRectWithDropShadow(5, 35, 60, 25, 5, true);
+	displayDrawRectWithDropShadow(70, 35, 30, 25, true);
+	displayFillCircle(130, 50, 14, true);
+	displaySetForegroundAndBackgroundColours(colour(0x808080), colour(0x00FFFF));
+	displayDrawCircle(130, 50, 17, true);
+	displayDrawLine(0, 127, 159, 64, true);
+	displayDrawLine(0, 64, 159, 127, false);
+	displayDrawFastHLine(0, 70, 160, true);
+	displayDrawFastVLine(80, 64, 64, true);
+	displaySetForegroundAndBackgroundColours(colour(0xFF00FF), colour(0x400080));
+	displayFillTriangle(10, 120, 40, 75, 70, 120, true);
+	displayDrawTriangle(90, 120, 120, 75, 150, 120, true);
+	displayDrawEllipse(20, 80, 60, 100, false);
+	displaySetForegroundAndBackgroundColours(colour(0xFF8000), colour(0xFFFFFF));
+	displayFillArc(120, 100, 20, 5, 30.0f, 300.0f, true);
+
+	// Up to the edges (the primitives don't clip)
+	displayFillRect(150, 118, 10, 10, true);
+	displayFillCircle(6, 6, 6, true);
+}
+
+static void drawRows(void)
+{
+	displaySetForegroundAndBackgroundColours(colour(0x00FF00), colour(0x000040));
+	displayClearBuf();
+	displayClearRows(2, 5, true);
+	displayClearRows(9, 10, false);
+	displaySetForegroundAndBackgroundColours(colour(0xFFFFFF), colour(0x800000));
+	displayClearRows(12, 16, true);
+	displayDrawChoice(CHOICE_YESNO, false);
+}
+
+// All the fonts, foreground and inverted, at odd positions (packed pixels span bytes boundaries)
+static void drawText(void)
+{
+	displaySetForegroundAndBackgroundColours(colour(0x000000), colour(0xFFFFFF));
+	displayClearBuf();
+
+	displayPrintCore(1, 0, "Font 1 !\"#$%&'()*+,-./09:", FONT_SIZE_1, TEXT_ALIGN_LEFT, false);
+	displayPrintCore(3, 9, "Bold ;<=>?@AZ[\\]^_`az{|}~", FONT_SIZE_1_BOLD, TEXT_ALIGN_LEFT, false);
+	displaySetForegroundAndBackgroundColours(colour(0x0000FF), colour(0xFFFF00));
+	displayClearRows(3, 5, true);
+	displayPrintCore(0, 24, "Inverted 8x8", FONT_SIZE_2, TEXT_ALIGN_CENTER, true);
+	displaySetForegroundAndBackgroundColours(colour(0xFF0000), colour(0xFFFFFF));
+	displayPrintCore(0, 33, "Right", FONT_SIZE_2, TEXT_ALIGN_RIGHT, false);
+	displayPrintCore(5, 42, "8x16 \xE9 gjpq", FONT_SIZE_3, TEXT_ALIGN_LEFT, false);
+	displaySetForegroundAndBackgroundColours(colour(0x008000), colour(0xFFFFFF));
+	displayPrintCore(7, 60, "145.5", FONT_SIZE_4, TEXT_ALIGN_LEFT, false);
+	displayPrintCentered(94, "Centered", FONT_SIZE_3);
+	displayPrintAt(2, 110, "Truncated at the right edge", FONT_SIZE_2);
+	displayPrintCore(130, 120, "Bottom", FONT_SIZE_3, TEXT_ALIGN_LEFT, false);
+}
+
+static const scene_t scenes[] =
+{
+	{ "shapes", drawShapes },
+	{ "rows",   drawRows },
+	{ "text",   drawText },
+};
+
+static uint32_t panelRowCRC(int row)
+{
+	uint8_t line[DISPLAY_SIZE_X * 2];
+	uLong crc = crc32(0L, Z_NULL, 0);
+
+	for (int y = (row * 8); y < ((row + 1) * 8); y++)
+	{
+		for (int x = 0; x < DISPLAY_SIZE_X; x++)
+		{
+			uint16_t pixel = simDisplayGetPixel(x, y);
+
+			line[x * 2] = (pixel >> 8);
+			line[(x * 2) + 1] = (pixel & 0xFF);
+		}
+		crc = crc32(crc, line, sizeof(line));
+	}
+
+	return crc;
+}
+
+static const char *goldenFind(const char *key)
+{
+	for (int i = 0; i < goldenCount; i++)
+	{
+		if (strncmp(golden[i], key, strlen(key)) == 0)
+		{
+			return (golden[i] + strlen(key));
+		}
+	}
+
+	return NULL;
+}
+
+static void checkScene(const scene_t *scene)
+{
+	char key[LINE_LENGTH];
+	char path[128];
+	int failures = 0;
+
+	scene->draw();
+	displayRenderRows(0, DISPLAY_NUMBER_OF_ROWS);
+
+	for (int row = 0; row < DISPLAY_NUMBER_OF_ROWS; row++)
+	{
+		uint32_t crc = panelRowCRC(row);
+		const char *expected;
+
+		snprintf(key, sizeof(key), "%s %d ", scene->name, row);
+
+		if (goldenOutput != NULL)
+		{
+			fprintf(goldenOutput, "%s%08X\n", key, crc);
+		}
+		else if ((expected = goldenFind(key)) == NULL)
+		{
+			testFail(GOLDEN_PATH, 0, "no %s", key);
+			failures++;
+		}
+		else if (strtoul(expected, NULL, 16) != crc)
+		{
+			testFail(GOLDEN_PATH, 0, "scene %s, row %d differs", scene->name, row);
+			failures++;
+		}
+	}
+
+	if (failures != 0)
+	{
+		snprintf(path, sizeof(path), "build/tests/%s-%s.png", TEST_DISPLAY_NAME, scene->name);
+		simDisplaySavePNG(path);
+	}
+}
+
+// An overriding buffer holds native colours, it's sent as is
+static void testOverride(void)
+{
+	static uint16_t buffer[DISPLAY_SIZE_X * DISPLAY_SIZE_Y];
+
+	for (int i = 0; i < (DISPLAY_SIZE_X * DISPLAY_SIZE_Y); i++)
+	{
+		buffer[i] = (uint16_t)(i * 7);
+	}
+
+	displayOverrideScreenBuffer(buffer);
+	displayRenderRows(0, DISPLAY_NUMBER_OF_ROWS);
+	displayRestorePrimaryScreenBuffer();
+
+	for (int i = 0; i < (DISPLAY_SIZE_X * DISPLAY_SIZE_Y); i++)
+	{
+		uint16_t pixel = simDisplayGetPixel((i % DISPLAY_SIZE_X), (i / DISPLAY_SIZE_X));
+
+		if (pixel != __builtin_bswap16(buffer[i]))
+		{
+			testFail(__FILE__, __LINE__, "overriding buffer pixel %d: expected %04X, got %04X", i, __builtin_bswap16(buffer[i]), pixel);
+			break;
+		}
+	}
+}
+
+// Characters across the left and right edges are clipped, not wrapped to the neighbouring lines
+static void testTextClipping(void)
+{
+	uint8_t native[2];
+	uint16_t background = colour(0xFFFFFF);
+	bool wrapped = false;
+
+	displaySetForegroundAndBackgroundColours(colour(0x000000), background);
+	displayClearBuf();
+	displayPrintCore(-5, 16, "MMMM", FONT_SIZE_2, TEXT_ALIGN_LEFT, false);
+	displayPrintCore(156, 40, "MMMM", FONT_SIZE_2, TEXT_ALIGN_LEFT, false);
+
+	for (int y = 0; y < DISPLAY_SIZE_Y; y++)
+	{
+		for (int x = 140; x < DISPLAY_SIZE_X; x++)
+		{
+			if ((y < 40) || (y >= 48) || (x < 156))
+			{
+				displayCopyPrimaryScreenBufferNative(native, (((y * DISPLAY_SIZE_X) + x) * 2), sizeof(native));
+				wrapped |= ((native[0] | (native[1] << 8)) != background);
+			}
+		}
+	}
+
+	TEST_ASSERT(wrapped == false);
+}
+
+// Rendering time per string, from the glyph rows cache
+static void benchmarkText(void)
+{
+	static const ucFont_t fonts[] = { FONT_SIZE_1, FONT_SIZE_1_BOLD, FONT_SIZE_2, FONT_SIZE_3, FONT_SIZE_4 };
+	static const char *text[] = { "438.02500 DMR TS1", "438.02500 DMR TS1", "CC1 TG 91 Ch 12", "VK3KYY Roger", "145.500" };
+	const int count = 2000;
+
+	for (size_t f = 0; f < (sizeof(fonts) / sizeof(fonts[0])); f++)
+	{
+		struct timespec start, end;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (int i = 0; i < count; i++)
+		{
+			displayPrintCore(0, 0, text[f], fonts[f], TEXT_ALIGN_LEFT, (i & 1));
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		printf("  font %d, \"%s\": %.2f us\n", (int)fonts[f], text[f],
+				((((end.tv_sec - start.tv_sec) * 1e9) + (end.tv_nsec - start.tv_nsec)) / count) / 1e3);
+	}
+}
+
+#if defined(DISPLAY_INDEXED_FRAMEBUFFER_BPP)
+// Once the palette is full, a new colour is drawn with the nearest one
+static void testPaletteFull(void)
+{
+	uint8_t native[2];
+
+	displaySetForegroundAndBackgroundColours(colour(0x000000), colour(0x000000));
+	displayClearBuf();
+
+	for (int i = 1; i < DISPLAY_PALETTE_SIZE; i++)
+	{
+		displaySetForegroundAndBackgroundColours(colour(0x100000 * i), colour(0x000000));
+		displaySetPixel(i, 0, true);
+	}
+
+	displaySetForegroundAndBackgroundColours(colour(0x330102), colour(0x000000));
+	displaySetPixel(0, 1, true);
+
+	displayCopyPrimaryScreenBufferNative(native, (DISPLAY_SIZE_X * 2), sizeof(native));
+	TEST_ASSERT_EQUAL(colour(0x300000), (native[0] | (native[1] << 8)));
+}
+#endif
+
+int main(int argc, char **argv)
+{
+	FILE *f;
+
+	testInit(TEST_DISPLAY_NAME);
+	currentLanguage = &languages[0];
+	displayInit(false, false);
+
+	if ((argc > 1) && (strcmp(argv[1], "-w") == 0))
+	{
+		if ((goldenOutput = fopen(GOLDEN_PATH, "w")) == NULL)
+		{
+			simFatal("Can't write %s\n", GOLDEN_PATH);
+		}
+	}
+	else
+	{
+		if ((f = fopen(GOLDEN_PATH, "r")) == NULL)
+		{
+			simFatal("Can't read %s\n", GOLDEN_PATH);
+		}
+
+		while ((goldenCount < GOLDEN_MAX_LINES) && (fgets(golden[goldenCount], LINE_LENGTH, f) != NULL))
+		{
+			goldenCount++;
+		}
+		fclose(f);
+	}
+
+	for (size_t i = 0; i < (sizeof(scenes) / sizeof(scenes[0])); i++)
+	{
+		checkScene(&scenes[i]);
+	}
+
+	if (goldenOutput != NULL)
+	{
+		fclose(goldenOutput);
+		return EXIT_SUCCESS;
+	}
+
+	testOverride();
+	testTextClipping();
+#if defined(DISPLAY_INDEXED_FRAMEBUFFER_BPP)
+	testPaletteFull();
+#endif
+
+	if ((argc > 1) && (strcmp(argv[1], "-b") == 0))
+	{
+		benchmarkText();
+	}
+
+	return testDone();
+}
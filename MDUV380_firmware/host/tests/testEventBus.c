@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "functions/eventBus.h"
+#include "test.h"
+
+//
+// Event bus (functions/eventBus.c): the main loop receives the posted events in order, with their data,
+// waiting doesn't consume them, and the events posted while the queue is full are counted as dropped.
+//
+
+static void testReceive(void)
+{
+	eventBusEvent_t event;
+	eventBusStats_t stats;
+
+	TEST_ASSERT(eventBusReceive(&event) == false);
+
+	eventBusPost(EVENT_BUS_ROTARY, (uint8_t)-1);
+	eventBusPost(EVENT_BUS_DMR_CALL_START, 0);
+	eventBusPost(EVENT_BUS_ROTARY, 1);
+
+	// Returns straight away, the events are left for eventBusReceive()
+	eventBusWait(100);
+
+	TEST_ASSERT(eventBusReceive(&event));
+	TEST_ASSERT_EQUAL(EVENT_BUS_ROTARY, event.type);
+	TEST_ASSERT_EQUAL(-1, (int8_t)event.data);
+	TEST_ASSERT(eventBusReceive(&event));
+	TEST_ASSERT_EQUAL(EVENT_BUS_DMR_CALL_START, event.type);
+	TEST_ASSERT(eventBusReceive(&event));
+	TEST_ASSERT_EQUAL(EVENT_BUS_ROTARY, event.type);
+	TEST_ASSERT_EQUAL(1, (int8_t)event.data);
+	TEST_ASSERT(eventBusReceive(&event) == false);
+
+	eventBusGetStats(&stats);
+	TEST_ASSERT_EQUAL(2, stats.events[EVENT_BUS_ROTARY]);
+	TEST_ASSERT_EQUAL(1, stats.events[EVENT_BUS_DMR_CALL_START]);
+	TEST_ASSERT_EQUAL(3, stats.queueMaxDepth);
+	TEST_ASSERT_EQUAL(0, stats.dropped);
+}
+
+static void testDropped(void)
+{
+	eventBusEvent_t event;
+	eventBusStats_t stats;
+	int received = 0;
+
+	eventBusLoopIteration();
+
+	for (int i = 0; i < 20; i++)
+	{
+		eventBusPost(EVENT_BUS_GPS_DATA, 0);
+	}
+
+	while (eventBusReceive(&event))
+	{
+		received++;
+	}
+
+	eventBusGetStats(&stats);
+	TEST_ASSERT_EQUAL(20, (received + stats.dropped));
+	TEST_ASSERT(stats.dropped > 0);
+	TEST_ASSERT_EQUAL(received, stats.queueMaxDepth);
+}
+
+int main(int argc, char **argv)
+{
+	testInit("testEventBus");
+
+	eventBusInit();
+
+	testReceive();
+	testDropped();
+
+	return testDone();
+}
@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "main.h"
+#include "hardware/HR-C6000.h"
+#include "hardware/radioHardwareInterface.h"
+#include "functions/trx.h"
+#include "functions/settings.h"
+#include "interfaces/hr-c6000_spi.h"
+#include "test.h"
+
+//
+// HR-C6000 register scripts: the mode switches have to leave the chip in the same state as the
+// original call sequences (register by register writes, recorded in tests/data/hrc6000Scripts.txt).
+//
+//  - with the SPI0 shadow invalidated before each switch, the writes are the recorded ones, in the same order,
+//  - with the shadow kept (as on the radio), every recorded register holds its recorded value afterwards.
+//
+// "testHRC6000Scripts -w" rewrites the recording.
+//
+
+#define GOLDEN_PATH        "tests/data/hrc6000Scripts.txt"
+#define LINE_LENGTH        4096
+
+typedef struct
+{
+	const char *name;
+	void (*function)(void);
+} modeSwitch_t;
+
+static const modeSwitch_t modeSwitches[] =
+{
+	{ "FMTx",  HRC6000SetFMTx },
+	{ "FMRx",  HRC6000SetFMRx },
+	{ "DMR",   HRC6000SetDMR },
+	{ "DmrRx", HRC6000InitDigitalDmrRx },
+	{ "FMTx",  HRC6000SetFMTx },
+	{ "DMR",   HRC6000SetDMR }
+};
+
+static void formatLog(char *line, const char *name)
+{
+	const simRadioSPI0Log_t *log = simRadioSPI0LogGet();
+	int length = sprintf(line, "%s:", name);
+
+	for (int i = 0; (i < log->count) && (length < (LINE_LENGTH - 16)); i++)
+	{
+		length += sprintf(&line[length], " %X.%02X=%02X", log->writes[i].page, log->writes[i].reg, log->writes[i].value);
+	}
+}
+
+// Each recorded write must have left its value, unless the register is written again (or reset) later
+static void checkRegisters(const char *golden, int lineNumber)
+{
+	static unsigned int writes[SIM_RADIO_SPI0_LOG_SIZE][3];
+	const char *p = (strchr(golden, ':') + 1);
+	int count = 0;
+	int consumed;
+
+	while ((count < SIM_RADIO_SPI0_LOG_SIZE) && (sscanf(p, " %X.%X=%X%n", &writes[count][0], &writes[count][1], &writes[count][2], &consumed) == 3))
+	{
+		p += consumed;
+		count++;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		uint8_t page = (writes[i][0] & 0x3F);
+		bool overwritten = false;
+
+		for (int j = (i + 1); (j < count) && (overwritten == false); j++)
+		{
+			overwritten = (((writes[j][0] & 0x3F) == page) && (writes[j][1] == writes[i][1])) || ((writes[j][0] == 0x04) && (writes[j][1] == 0x00));
+		}
+
+		if ((overwritten == false) && (simRadioSPI0Register(page, writes[i][1]) != writes[i][2]))
+		{
+			testFail(GOLDEN_PATH, lineNumber, "register %X.%02X is %02X instead of %02X", writes[i][0], writes[i][1],
+					simRadioSPI0Register(page, writes[i][1]), writes[i][2]);
+		}
+	}
+}
+
+static void setupCalibration(void)
+{
+	currentRadioDevice = &radioDevices[0];
+	analogIGain = 0x11;
+	analogQGain = 0x22;
+	digitalIGain = 0x33;
+	digitalQGain = 0x44;
+	Mod2Offset = 0x55;
+	nonVolatileSettings.micGainFM = 7;
+	nonVolatileSettings.micGainDMR = 9;
+}
+
+// Runs all the mode switches, for the frequency, bandwidth and tone variants. Returns the lines count.
+// Without golden lines the shadow is invalidated before each switch, otherwise the registers are checked after each one.
+static int runModeSwitches(char (*lines)[LINE_LENGTH], char (*golden)[LINE_LENGTH], int goldenCount)
+{
+	static const uint32_t frequencies[2] = { 43000000, 14500000 };
+	int count = 0;
+
+	simRadioSPI0LogClear();
+	HRC6000Init();
+	formatLog(lines[count], "Init");
+	if ((golden != NULL) && (count < goldenCount))
+	{
+		checkRegisters(golden[count], (count + 1));
+	}
+	count++;
+
+	for (int f = 0; f < 2; f++)
+	{
+		for (int bw = 0; bw < 2; bw++)
+		{
+			for (int dcs = 0; dcs < 2; dcs++)
+			{
+				currentRadioDevice->currentRxFrequency = frequencies[f];
+				currentRadioDevice->currentTxFrequency = frequencies[f];
+				currentRadioDevice->currentBandWidthIs25kHz = bw;
+
+				if (dcs)
+				{
+					HRC6000SetTxDCS(0x23, false);
+				}
+				else
+				{
+					HRC6000SetTxCTCSS(5);
+				}
+
+				sprintf(lines[count++], "-- f %d bw %d dcs %d", f, bw, dcs);
+
+				for (size_t i = 0; i < (sizeof(modeSwitches) / sizeof(modeSwitches[0])); i++)
+				{
+					if (golden == NULL)
+					{
+						SPI0ShadowInvalidate();
+					}
+
+					simRadioSPI0LogClear();
+					modeSwitches[i].function();
+					formatLog(lines[count], modeSwitches[i].name);
+
+					if ((golden != NULL) && (count < goldenCount))
+					{
+						checkRegisters(golden[count], (count + 1));
+					}
+					count++;
+				}
+			}
+		}
+	}
+
+	return count;
+}
+
+int main(int argc, char **argv)
+{
+	static char lines[64][LINE_LENGTH];
+	static char golden[64][LINE_LENGTH];
+	int count;
+	int goldenCount = 0;
+	FILE *f;
+
+	testInit("testHRC6000Scripts");
+	setupCalibration();
+
+	count = runModeSwitches(lines, NULL, 0);
+
+	if ((argc > 1) && (strcmp(argv[1], "-w") == 0))
+	{
+		if ((f = fopen(GOLDEN_PATH, "w")) == NULL)
+		{
+			simFatal("Can't write %s\n", GOLDEN_PATH);
+		}
+
+		for (int i = 0; i < count; i++)
+		{
+			fprintf(f, "%s\n", lines[i]);
+		}
+		fclose(f);
+
+		return EXIT_SUCCESS;
+	}
+
+	if ((f = fopen(GOLDEN_PATH, "r")) == NULL)
+	{
+		simFatal("Can't read %s\n", GOLDEN_PATH);
+	}
+
+	while ((goldenCount < 64) && (fgets(golden[goldenCount], LINE_LENGTH, f) != NULL))
+	{
+		golden[goldenCount][strcspn(golden[goldenCount], "\n")] = 0;
+		goldenCount++;
+	}
+	fclose(f);
+
+	// Shadow invalidated: same writes
+	TEST_ASSERT_EQUAL(goldenCount, count);
+	for (int i = 0; (i < count) && (i < goldenCount); i++)
+	{
+		if (strcmp(lines[i], golden[i]) != 0)
+		{
+			testFail(GOLDEN_PATH, (i + 1), "differs:\n  expected %s\n  got      %s", golden[i], lines[i]);
+		}
+	}
+
+	// Shadow kept: same registers content, with fewer writes
+	runModeSwitches(lines, golden, goldenCount);
+
+	// After a (partial) reset, a switch to the same mode has to write everything again
+	HRC6000SetFMRx();
+	SPI0WritePageRegByte(0x04, 0x00, 0x2A);
+	simRadioSPI0LogClear();
+	HRC6000SetFMRx();
+	TEST_ASSERT_EQUAL(7, simRadioSPI0LogGet()->count);
+	TEST_ASSERT_EQUAL(0xFD, simRadioSPI0Register(0x04, 0x26));
+
+	return testDone();
+}
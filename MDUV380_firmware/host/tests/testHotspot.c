@@ -0,0 +1,890 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "application/source/functions/hotspot.c"
+#include "test.h"
+
+//
+// Hotspot (functions/hotspot.c) against an MMDVMHost stand-in, without a radio or MMDVMHost:
+//  - the USB layer: the frames go through the real receive ring (usb/usb_mmdvm.c), the replies are captured from
+//    the IN transfers (CDC_AcquireTxBuffer_FS()/CDC_TransmitTxBuffer_FS()) and parsed as MMDVMHost does,
+//  - the HR-C6000 layer: the timeslot ISR is emulated, one voice burst per 60ms, it takes the network frames from
+//    the TX buffer and gives the RF frames to hotspotRxFrameHandler(),
+//  - the trx and UI layers are stubbed (TX on/off, frequency, colour code, screen updates are recorded).
+// The hotspot task runs every simulated millisecond, as menuHotspotMode() does.
+//
+// It checks the protocol replies (version, status, config, mode, frequency, QSO info, invalid requests), voice
+// streams in both directions (contents, TX on/off timings, buffer high-water marks), and a flow controlled flood.
+// -b prints the timings, frames per second and high-water marks, plus the host time spent per handled frame.
+//
+
+#define HOST_REPLIES                1024
+#define HOST_REPLY_MAX_LENGTH       128
+#define HOST_STATUS_PERIOD          250 // ms, MMDVMHost's status polling
+#define HOST_SRC_ID                 2351234
+#define HOST_DST_ID                 505
+#define RF_SRC_ID                   5053238
+#define RF_DST_ID                   91
+#define VOICE_PERIOD                60 // ms, one DMR voice burst
+#define VOICE_AUDIO_LENGTH          AMBE_AUDIO_LENGTH
+
+typedef struct
+{
+	uint32_t time;
+	uint8_t  frame[HOST_REPLY_MAX_LENGTH];
+} hostReply_t;
+
+// MMDVMHost side
+static hostReply_t hostReplies[HOST_REPLIES];
+static int hostRepliesIn = 0;
+static int hostRepliesOut = 0;
+static bool hostStatusPolling = false;
+static bool hostDiscardReplies = false;
+static uint32_t hostDMRAcks = 0;
+static uint32_t hostDMRNaks = 0;
+static uint32_t hostStatusReplies = 0;
+static uint32_t hostStatusTx = 0;        // status replies with the TX flag set
+static uint8_t hostStatusDMRSpace = 0;
+static uint8_t hostNetAudio[HOTSPOT_BUFFER_COUNT * 2][VOICE_AUDIO_LENGTH]; // sent, not transmitted yet
+static int hostNetAudioIn = 0;
+static int hostNetAudioOut = 0;
+
+// USB IN endpoint
+static uint8_t usbTxBuffer[APP_TX_DATA_SIZE];
+static bool usbTransferPending = false;
+
+// HR-C6000 timeslot ISR and trx
+static uint32_t rfTxFrames = 0;
+static uint32_t rfTxMismatches = 0;
+static uint32_t rfTxMissingFrames = 0;
+static uint32_t rfTxFirstFrameTime = 0;
+static uint32_t rfTxLastFrameTime = 0;
+static uint32_t rfTxOnTime = 0;
+static uint32_t rfTxOffTime = 0;
+static uint32_t rfFrequencyRx = 0;
+static uint32_t rfFrequencyTx = 0;
+static uint8_t rfColourCode = 0xFF;
+static uint32_t uiScreenUpdates = 0;
+static bool uiExited = false;
+
+// State transitions and high-water marks
+static uint32_t stateEnterTime[HOTSPOT_STATE_TX_SHUTDOWN + 1];
+static HOTSPOT_STATE lastState = HOTSPOT_STATE_NOT_CONNECTED;
+static int highWaterTxBuffer = 0;
+static int highWaterRxBuffer = 0;
+static int highWaterUSBRing = 0;
+
+// Report (-b)
+static bool report = false;
+
+//
+// Stubbed layers
+//
+
+uint8_t *CDC_AcquireTxBuffer_FS(void)
+{
+	return (usbTransferPending ? NULL : usbTxBuffer);
+}
+
+// The IN transfer, as MMDVMHost reads it: a stream of frames
+uint8_t CDC_TransmitTxBuffer_FS(uint16_t Len)
+{
+	uint16_t offset = 0;
+
+	while (offset < Len)
+	{
+		const uint8_t *frame = &usbTxBuffer[offset];
+
+		if ((frame[0] != MMDVM_FRAME_START) || (frame[1] < 3) || ((offset + frame[1]) > Len))
+		{
+			testFail(__FILE__, __LINE__, "invalid frame in the USB transfer, offset %u", offset);
+			break;
+		}
+
+		offset += frame[1];
+
+		if ((frame[2] == MMDVM_GET_STATUS) && hostStatusPolling)
+		{
+			hostStatusReplies++;
+			hostStatusTx += (frame[5] & 0x01);
+			hostStatusDMRSpace = frame[8];
+			continue;
+		}
+
+		if ((frame[2] == MMDVM_ACK) && (frame[3] == MMDVM_DMR_DATA2))
+		{
+			hostDMRAcks++;
+			continue;
+		}
+
+		if ((frame[2] == MMDVM_NAK) && (frame[3] == MMDVM_DMR_DATA2))
+		{
+			hostDMRNaks++;
+			continue;
+		}
+
+		if (hostDiscardReplies)
+		{
+			continue;
+		}
+
+		if ((hostRepliesIn - hostRepliesOut) >= HOST_REPLIES)
+		{
+			testFail(__FILE__, __LINE__, "too many unchecked replies");
+			break;
+		}
+
+		hostReplies[hostRepliesIn % HOST_REPLIES].time = ticksGetMillis();
+		memcpy(hostReplies[hostRepliesIn % HOST_REPLIES].frame, frame, MIN(frame[1], HOST_REPLY_MAX_LENGTH));
+		hostRepliesIn++;
+	}
+
+	usbTransferPending = true;
+
+	return USBD_OK;
+}
+
+void trxEnableTransmission(void)
+{
+	trxTransmissionEnabled = true;
+	rfTxOnTime = ticksGetMillis();
+}
+
+void trxDisableTransmission(void)
+{
+	if (trxIsTransmitting)
+	{
+		rfTxOffTime = ticksGetMillis();
+	}
+
+	trxIsTransmitting = false;
+}
+
+void trxSetFrequency(uint32_t fRx, uint32_t fTx, int dmrMode)
+{
+	rfFrequencyRx = fRx;
+	rfFrequencyTx = fTx;
+}
+
+void trxSetDMRColourCode(uint8_t colourCode)
+{
+	rfColourCode = colourCode;
+}
+
+void trxSetPowerFromLevel(uint8_t powerLevel)
+{
+}
+
+void trxSetModeAndBandwidth(int mode, bool bandwidthIs25kHz)
+{
+}
+
+void trxSetTxCSS(uint16_t tone)
+{
+}
+
+void trxSetTone1(int toneFreq)
+{
+}
+
+void HRC6000ClearIsWakingState(void)
+{
+}
+
+void uiHotspotUpdateScreen(uint8_t rxCommandState)
+{
+	uiScreenUpdates++;
+}
+
+void hotspotExit(void)
+{
+	uiExited = true;
+}
+
+//
+// Emulated HR-C6000 timeslot ISR (TX side), like HR-C6000.c in hotspot mode
+//
+
+static void rfTimeslot(void)
+{
+	static bool missing = false;
+
+	if (trxTransmissionEnabled == false)
+	{
+		return;
+	}
+
+	// The first burst is the LC header
+	if (trxIsTransmitting == false)
+	{
+		trxIsTransmitting = true;
+		missing = false;
+		return;
+	}
+
+	if (wavbuffer_count > 0)
+	{
+		const uint8_t *audio = (const uint8_t *)&audioAndHotspotDataBuffer.hotspotBuffer[wavbuffer_read_idx][LC_DATA_LENGTH];
+
+		if ((hostNetAudioOut == hostNetAudioIn) ||
+				(memcmp(audio, hostNetAudio[hostNetAudioOut % (HOTSPOT_BUFFER_COUNT * 2)], VOICE_AUDIO_LENGTH) != 0))
+		{
+			rfTxMismatches++;
+		}
+		hostNetAudioOut++;
+
+		wavbuffer_read_idx = ((wavbuffer_read_idx + 1) % HOTSPOT_BUFFER_COUNT);
+		wavbuffer_count--;
+
+		if (rfTxFrames++ == 0)
+		{
+			rfTxFirstFrameTime = ticksGetMillis();
+		}
+		rfTxLastFrameTime = ticksGetMillis();
+		missing = false;
+	}
+	else
+	{
+		hotspotTxFrameIsMissing(missing == false);
+		missing = true;
+		rfTxMissingFrames++;
+	}
+}
+
+// One received burst, as the HR-C6000 ISR gives it: LC, audio, RX command, sequence number (+1)
+static void rfReceive(uint8_t command, uint8_t sequence, uint8_t *audio)
+{
+	uint8_t frame[HOTSPOT_BUFFER_SIZE];
+
+	memset(frame, 0, sizeof(frame));
+	frame[0] = TG_CALL_FLAG;
+	frame[3] = (RF_DST_ID >> 16) & 0xFF;
+	frame[4] = (RF_DST_ID >> 8) & 0xFF;
+	frame[5] = RF_DST_ID & 0xFF;
+	frame[6] = (RF_SRC_ID >> 16) & 0xFF;
+	frame[7] = (RF_SRC_ID >> 8) & 0xFF;
+	frame[8] = RF_SRC_ID & 0xFF;
+
+	for (int i = 0; i < VOICE_AUDIO_LENGTH; i++)
+	{
+		audio[i] = rand();
+	}
+	memcpy(&frame[LC_DATA_LENGTH], audio, VOICE_AUDIO_LENGTH);
+
+	frame[LC_DATA_LENGTH + AMBE_AUDIO_LENGTH] = command;
+	frame[LC_DATA_LENGTH + AMBE_AUDIO_LENGTH + 1] = sequence + 1;
+
+	hotspotRxFrameHandler(frame);
+}
+
+//
+// Hotspot task, every millisecond (menuHotspotMode())
+//
+
+static void hotspotRun(uint32_t ms)
+{
+	while (ms--)
+	{
+		uint32_t now;
+
+		simClockAdvance(1);
+		now = ticksGetMillis();
+
+		// USB IN transfer complete interrupt
+		if (usbTransferPending)
+		{
+			usbTransferPending = false;
+			hotspotUSBTransmitComplete();
+		}
+
+		if ((now % VOICE_PERIOD) == (VOICE_PERIOD / 2))
+		{
+			rfTimeslot();
+		}
+		highWaterRxBuffer = MAX(highWaterRxBuffer, (int)rfFrameBufCount);
+
+		if (hostStatusPolling && ((now % HOST_STATUS_PERIOD) == 0))
+		{
+			uint8_t frame[] = { MMDVM_FRAME_START, 3, MMDVM_GET_STATUS };
+
+			usbComMMDVMFrameStore(frame, frame[1]);
+		}
+
+		highWaterUSBRing = MAX(highWaterUSBRing, comRecvMMDVMFrameCount);
+
+		processUSBDataQueue();
+		if (comRecvMMDVMFrameCount > 0)
+		{
+			handleHotspotRequest();
+		}
+		hotspotStateMachine();
+
+		if (hotspotState != lastState)
+		{
+			stateEnterTime[hotspotState] = now;
+			lastState = hotspotState;
+		}
+
+		highWaterTxBuffer = MAX(highWaterTxBuffer, wavbuffer_count);
+	}
+}
+
+static void resetHighWaterMarks(void)
+{
+	highWaterTxBuffer = 0;
+	highWaterRxBuffer = 0;
+	highWaterUSBRing = 0;
+}
+
+//
+// MMDVMHost side
+//
+
+static void hostSend(const uint8_t *frame)
+{
+	TEST_ASSERT(usbComMMDVMFrameStore(frame, frame[1]));
+}
+
+static void hostSendCommand(uint8_t command, const uint8_t *data, uint8_t length)
+{
+	uint8_t frame[256];
+
+	frame[0] = MMDVM_FRAME_START;
+	frame[1] = length + 3;
+	frame[2] = command;
+	memcpy(&frame[3], data, length);
+
+	hostSend(frame);
+	hotspotRun(2);
+}
+
+static const uint8_t *hostReceive(void)
+{
+	if (hostRepliesOut == hostRepliesIn)
+	{
+		return NULL;
+	}
+
+	return hostReplies[(hostRepliesOut++) % HOST_REPLIES].frame;
+}
+
+static bool hostExpectACK(uint8_t command)
+{
+	const uint8_t *reply = hostReceive();
+
+	return ((reply != NULL) && (reply[1] == 4) && (reply[2] == MMDVM_ACK) && (reply[3] == command));
+}
+
+static bool hostExpectNAK(uint8_t command, uint8_t err)
+{
+	const uint8_t *reply = hostReceive();
+
+	return ((reply != NULL) && (reply[1] == 5) && (reply[2] == MMDVM_NAK) && (reply[3] == command) && (reply[4] == err));
+}
+
+static void hostSendLC(uint8_t dataType)
+{
+	uint8_t frame[MMDVM_HEADER_LENGTH + DMR_FRAME_LENGTH_BYTES] = { MMDVM_FRAME_START, sizeof(frame), MMDVM_DMR_DATA2, (DMR_SYNC_DATA | dataType) };
+	const uint8_t *sync = ((dataType == DT_VOICE_LC_HEADER) ? VOICE_LC_SYNC_FULL : TERMINATOR_LC_SYNC_FULL);
+	DMRLC_t lc;
+
+	memset(&lc, 0, sizeof(lc));
+	lc.FLCO = TG_CALL_FLAG;
+	lc.srcId = HOST_SRC_ID;
+	lc.dstId = HOST_DST_ID;
+
+	DMRFullLC_encode(&lc, frame + MMDVM_HEADER_LENGTH, dataType);
+	for (int i = 0; i < 8; i++)
+	{
+		frame[i + LC_DATA_LENGTH + MMDVM_HEADER_LENGTH] = (frame[i + LC_DATA_LENGTH + MMDVM_HEADER_LENGTH] & ~LC_SYNC_MASK_FULL[i]) | sync[i];
+	}
+
+	hostSend(frame);
+}
+
+// One voice burst, the audio the HR-C6000 has to transmit is kept to be checked
+static void hostSendVoice(uint8_t sequence)
+{
+	uint8_t frame[MMDVM_HEADER_LENGTH + DMR_FRAME_LENGTH_BYTES] = { MMDVM_FRAME_START, sizeof(frame), MMDVM_DMR_DATA2, ((sequence == 0) ? MMDVM_VOICE_SYNC_PATTERN : sequence) };
+	uint8_t *audio = hostNetAudio[hostNetAudioIn % (HOTSPOT_BUFFER_COUNT * 2)];
+
+	for (int i = MMDVM_HEADER_LENGTH; i < sizeof(frame); i++)
+	{
+		frame[i] = rand();
+	}
+
+	memcpy(audio, &frame[MMDVM_HEADER_LENGTH], 13);
+	audio[13] = (frame[MMDVM_HEADER_LENGTH + 13] & 0xF0) | (frame[MMDVM_HEADER_LENGTH + 19] & 0x0F);
+	memcpy(&audio[14], &frame[MMDVM_HEADER_LENGTH + 20], 13);
+	hostNetAudioIn++;
+
+	hostSend(frame);
+}
+
+// MMDVMHost's start up: version, status, config, mode and frequency
+static void hostConnect(void)
+{
+	static const uint8_t config[] = { 0x02, 0x00, 10, STATE_IDLE, 0x00, 0x80, 1, 0x00, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80 };
+	static const uint8_t mode[] = { STATE_DMR };
+	// 433.500MHz, in Hz (little endian), full power
+	static const uint8_t frequency[] = { 0x00, 0x60, 0xAF, 0xD6, 0x19, 0x60, 0xAF, 0xD6, 0x19, 0xFF };
+	const uint8_t *reply;
+
+	hostSendCommand(MMDVM_GET_VERSION, NULL, 0);
+	reply = hostReceive();
+	TEST_ASSERT((reply != NULL) && (reply[2] == MMDVM_GET_VERSION) && (reply[3] == PROTOCOL_VERSION));
+
+	hostSendCommand(MMDVM_GET_STATUS, NULL, 0);
+	reply = hostReceive();
+	TEST_ASSERT((reply != NULL) && (reply[1] == 13) && (reply[2] == MMDVM_GET_STATUS));
+
+	hostSendCommand(MMDVM_SET_CONFIG, config, sizeof(config));
+	TEST_ASSERT(hostExpectACK(MMDVM_SET_CONFIG));
+	hostSendCommand(MMDVM_SET_MODE, mode, sizeof(mode));
+	TEST_ASSERT(hostExpectACK(MMDVM_SET_MODE));
+	hostSendCommand(MMDVM_SET_FREQ, frequency, sizeof(frequency));
+	TEST_ASSERT(hostExpectACK(MMDVM_SET_FREQ));
+}
+
+static void hotspotStart(void)
+{
+	hotspotInit();
+	hotspotModemState = STATE_IDLE;
+	comRecvMMDVMIndexIn = comRecvMMDVMIndexOut = 0;
+	comRecvMMDVMFrameCount = 0;
+	hostRepliesIn = hostRepliesOut = 0;
+	hostNetAudioIn = hostNetAudioOut = 0;
+	hostDMRAcks = hostDMRNaks = 0;
+	hostStatusPolling = false;
+	usbTransferPending = false;
+	trxTransmissionEnabled = false;
+	trxIsTransmitting = false;
+	rfTxFrames = rfTxMismatches = rfTxMissingFrames = 0;
+	memset(&jitterStats, 0, sizeof(jitterStats));
+	resetHighWaterMarks();
+}
+
+//
+// Tests
+//
+
+static void testConformance(void)
+{
+	static const uint8_t configShort[] = { 0x02, 0x00, 10, STATE_IDLE, 0x00 };
+	static const uint8_t configColourCode[] = { 0x02, 0x00, 10, STATE_IDLE, 0x00, 0x80, 16, 0x00, 0x80, 0x80, 0x80, 0x80, 0x80 };
+	static const uint8_t configYSF[] = { 0x02, 0x00, 10, STATE_YSF, 0x00, 0x80, 1, 0x00, 0x80, 0x80, 0x80, 0x80, 0x80 };
+	static const uint8_t config[] = { 0x02, 0x00, 25, STATE_IDLE, 0x00, 0x80, 7, 0x00, 0x80, 0x80, 0x80, 0x80, 0x80 };
+	static const uint8_t modeYSF[] = { STATE_YSF };
+	static const uint8_t modeDMR[] = { STATE_DMR };
+	// 436.000MHz (satellite band), in Hz (little endian)
+	static const uint8_t frequencyBanned[] = { 0x00, 0x00, 0xD5, 0xFC, 0x19, 0x00, 0xD5, 0xFC, 0x19, 0xFF };
+	static const uint8_t frequency[] = { 0x00, 0x60, 0xAF, 0xD6, 0x19, 0x60, 0xAF, 0xD6, 0x19, 0xFF };
+	static const uint8_t dstarHeader[41] = { 0 };
+	uint8_t qsoInfo[47 - 3];
+	const uint8_t *reply;
+
+	hotspotStart();
+	TEST_ASSERT(hotspotMmdvmHostIsConnected == false);
+
+	// Version: protocol 1, then the description
+	hostSendCommand(MMDVM_GET_VERSION, NULL, 0);
+	reply = hostReceive();
+	TEST_ASSERT((reply != NULL) && (reply[2] == MMDVM_GET_VERSION) && (reply[3] == PROTOCOL_VERSION));
+	if (reply != NULL)
+	{
+		char description[HOST_REPLY_MAX_LENGTH];
+
+		snprintf(description, sizeof(description), "%.*s", (reply[1] - 4), &reply[4]);
+		TEST_ASSERT(strstr(description, "MD-UV380") != NULL);
+		TEST_ASSERT(strstr(description, "Mode:MMDVM") != NULL);
+	}
+	TEST_ASSERT(hotspotMmdvmHostIsConnected);
+
+	// Status: DMR and POCSAG, idle, the whole DMR buffer is free
+	hostSendCommand(MMDVM_GET_STATUS, NULL, 0);
+	reply = hostReceive();
+	TEST_ASSERT((reply != NULL) && (reply[1] == 13) && (reply[2] == MMDVM_GET_STATUS));
+	if (reply != NULL)
+	{
+		TEST_ASSERT_EQUAL(0x22, reply[3]);
+		TEST_ASSERT_EQUAL(STATE_IDLE, reply[4]);
+		TEST_ASSERT_EQUAL(0x00, reply[5]);
+		TEST_ASSERT_EQUAL(HOTSPOT_BUFFER_COUNT, reply[8]);
+	}
+
+	// Config
+	hostSendCommand(MMDVM_SET_CONFIG, configShort, sizeof(configShort));
+	TEST_ASSERT(hostExpectNAK(MMDVM_SET_CONFIG, 4));
+	hostSendCommand(MMDVM_SET_CONFIG, configColourCode, sizeof(configColourCode));
+	TEST_ASSERT(hostExpectNAK(MMDVM_SET_CONFIG, 4));
+	hostSendCommand(MMDVM_SET_CONFIG, configYSF, sizeof(configYSF));
+	TEST_ASSERT(hostExpectNAK(MMDVM_SET_CONFIG, 4));
+	hostSendCommand(MMDVM_SET_CONFIG, config, sizeof(config));
+	TEST_ASSERT(hostExpectACK(MMDVM_SET_CONFIG));
+	TEST_ASSERT_EQUAL(7, rfColourCode);
+	TEST_ASSERT(uiScreenUpdates > 0);
+	TEST_ASSERT_EQUAL(250, hotspotTxDelay);
+
+	// Mode
+	hostSendCommand(MMDVM_SET_MODE, modeYSF, sizeof(modeYSF));
+	TEST_ASSERT(hostExpectNAK(MMDVM_SET_MODE, 4));
+	hostSendCommand(MMDVM_SET_MODE, NULL, 0);
+	TEST_ASSERT(hostExpectNAK(MMDVM_SET_MODE, 4));
+	hostSendCommand(MMDVM_SET_MODE, modeDMR, sizeof(modeDMR));
+	TEST_ASSERT(hostExpectACK(MMDVM_SET_MODE));
+	TEST_ASSERT_EQUAL(STATE_DMR, hotspotModemState);
+
+	// Frequency (in 10Hz units for the trx)
+	hostSendCommand(MMDVM_SET_FREQ, frequencyBanned, sizeof(frequencyBanned));
+	TEST_ASSERT(hostExpectNAK(MMDVM_SET_FREQ, 4));
+	hostSendCommand(MMDVM_SET_FREQ, frequency, 8);
+	TEST_ASSERT(hostExpectNAK(MMDVM_SET_FREQ, 4));
+	hostSendCommand(MMDVM_SET_FREQ, frequency, sizeof(frequency));
+	TEST_ASSERT(hostExpectACK(MMDVM_SET_FREQ));
+	TEST_ASSERT_EQUAL(43350000, rfFrequencyRx);
+	TEST_ASSERT_EQUAL(43350000, rfFrequencyTx);
+
+	// QSO info: the source callsign becomes the talker alias
+	memset(qsoInfo, ' ', sizeof(qsoInfo));
+	qsoInfo[0] = STATE_DMR;
+	qsoInfo[1] = 0;
+	memcpy(&qsoInfo[2], "G4KYF Roger", 11);
+	memcpy(&qsoInfo[22], "TG 505", 6);
+	hostSendCommand(MMDVM_QSO_INFO, qsoInfo, sizeof(qsoInfo));
+	TEST_ASSERT(hostExpectACK(MMDVM_QSO_INFO));
+	TEST_ASSERT(overriddenLCAvailable);
+	TEST_ASSERT_MEMORY("G4KYF", &overriddenLCTA[3], 5);
+	hostSendCommand(MMDVM_QSO_INFO, qsoInfo, (sizeof(qsoInfo) - 1));
+	TEST_ASSERT(hostExpectNAK(MMDVM_QSO_INFO, 5));
+
+	// Unsupported modes and commands
+	hostSendCommand(MMDVM_DSTAR_HEADER, dstarHeader, sizeof(dstarHeader));
+	TEST_ASSERT(hostExpectNAK(MMDVM_DSTAR_HEADER, 2));
+	hostSendCommand(MMDVM_DMR_DATA1, dstarHeader, 34);
+	TEST_ASSERT(hostExpectNAK(MMDVM_DMR_DATA1, 2));
+	hostSendCommand(0x55, NULL, 0);
+	TEST_ASSERT(hostExpectNAK(0x55, 1));
+	hostSendCommand(MMDVM_DMR_START, modeDMR, sizeof(modeDMR));
+	TEST_ASSERT(hostExpectACK(MMDVM_DMR_START));
+	hostSendCommand(MMDVM_TRANSPARENT, modeDMR, sizeof(modeDMR));
+	TEST_ASSERT(hostReceive() == NULL);
+
+	// A frame without the start byte is dropped, along with the following ones
+	{
+		uint8_t garbage[] = { 0xAA, 3, MMDVM_GET_STATUS };
+		uint8_t status[] = { MMDVM_FRAME_START, 3, MMDVM_GET_STATUS };
+
+		hostSend(garbage);
+		hostSend(status);
+		hotspotRun(4);
+		TEST_ASSERT(hostReceive() == NULL);
+		TEST_ASSERT_EQUAL(0, comRecvMMDVMFrameCount);
+	}
+
+	TEST_ASSERT(hostReceive() == NULL);
+	TEST_ASSERT(uiExited == false);
+}
+
+// Network to RF: a long stream with jitter, the HR-C6000 has to transmit every burst, in order
+static void testNetToRF(void)
+{
+	const int frames = 600;
+	uint32_t startTime, terminatorTime, nextTime;
+	uint32_t missingBeforeEnd = 0;
+
+	hotspotStart();
+	hostConnect();
+	srand(0x1A1A);
+
+	hostStatusPolling = true;
+	hostStatusReplies = hostStatusTx = 0;
+	hotspotRun(VOICE_PERIOD - (ticksGetMillis() % VOICE_PERIOD));
+
+	startTime = ticksGetMillis();
+	hostSendLC(DT_VOICE_LC_HEADER);
+	nextTime = startTime;
+
+	for (int i = 0; i < frames; i++)
+	{
+		nextTime += VOICE_PERIOD;
+		hotspotRun(nextTime + (rand() % 20) - ticksGetMillis()); // up to 20ms late
+		hostSendVoice(i % 6);
+
+		if ((int)rfTxFrames < (i - (int)HOTSPOT_BUFFER_COUNT)) // Not transmitting
+		{
+			break;
+		}
+	}
+
+	// Wait for the buffer to drain
+	while ((rfTxFrames < frames) && ((ticksGetMillis() - nextTime) < (HOTSPOT_BUFFER_COUNT * VOICE_PERIOD)))
+	{
+		hotspotRun(1);
+	}
+	missingBeforeEnd = rfTxMissingFrames;
+
+	terminatorTime = ticksGetMillis();
+	hostSendLC(DT_TERMINATOR_WITH_LC);
+	hotspotRun(3000);
+
+	TEST_ASSERT_EQUAL(frames + 2, hostDMRAcks);
+	TEST_ASSERT_EQUAL(0, hostDMRNaks);
+	TEST_ASSERT_EQUAL(frames, rfTxFrames);
+	TEST_ASSERT_EQUAL(0, rfTxMismatches);
+	TEST_ASSERT_EQUAL(0, missingBeforeEnd);
+	TEST_ASSERT_EQUAL(0, jitterStats.dropped);
+	TEST_ASSERT_EQUAL(0, jitterStats.late);
+	TEST_ASSERT_EQUAL(frames, jitterStats.frames);
+
+	// TX on once the jitter is covered, off after the buffer drained, back to RX
+	TEST_ASSERT((rfTxOnTime - startTime) <= (7 * VOICE_PERIOD));
+	TEST_ASSERT((rfTxOffTime > terminatorTime) && ((rfTxOffTime - terminatorTime) <= 1500));
+	TEST_ASSERT(trxIsTransmitting == false);
+	TEST_ASSERT_EQUAL(HOTSPOT_STATE_RX_PROCESS, hotspotState);
+	TEST_ASSERT(highWaterTxBuffer <= (TX_BUFFER_MAX_BEFORE_TRANSMISSION / 2));
+
+	// MMDVMHost saw the TX through the status polling, and all the DMR space back at the end
+	TEST_ASSERT(hostStatusTx >= ((frames * VOICE_PERIOD) / HOST_STATUS_PERIOD));
+	TEST_ASSERT_EQUAL(HOTSPOT_BUFFER_COUNT, hostStatusDMRSpace);
+	TEST_ASSERT(hostReceive() == NULL);
+
+	if (report)
+	{
+		printf("  net to RF: %d frames, TX on after %u ms (TX_START_BUFFERING -> TRANSMITTING %u ms), TX off %u ms after the terminator\n",
+				frames, (rfTxOnTime - startTime), (stateEnterTime[HOTSPOT_STATE_TRANSMITTING] - stateEnterTime[HOTSPOT_STATE_TX_START_BUFFERING]),
+				(rfTxOffTime - terminatorTime));
+		printf("             %.1f frames/s, jitter %u ms, prebuffer %u frames, TX buffer high-water %d, USB ring high-water %d, %u silent bursts after the stream\n",
+				((frames - 1) * 1000.0) / (rfTxLastFrameTime - rfTxFirstFrameTime), jitterStats.jitterMs, jitterStats.prebufferFrames,
+				highWaterTxBuffer, highWaterUSBRing, (rfTxMissingFrames - missingBeforeEnd));
+	}
+}
+
+// RF to network: the header, the voice bursts and the terminator reach MMDVMHost, with the same contents
+static void testRFToNet(void)
+{
+	const int frames = 300;
+	uint8_t audio[VOICE_AUDIO_LENGTH];
+	uint32_t sentTime, maxLatency = 0, firstVoiceTime = 0, lastVoiceTime = 0;
+	const uint8_t *reply;
+	DMRLC_t lc;
+	int voiceFrames = 0;
+
+	hotspotStart();
+	hostConnect();
+	srand(0x2B2B);
+
+	hostStatusPolling = true;
+	hotspotRun(VOICE_PERIOD - (ticksGetMillis() % VOICE_PERIOD));
+
+	sentTime = ticksGetMillis();
+	rfReceive(HOTSPOT_RX_START, 0, audio);
+	hotspotRun(VOICE_PERIOD);
+	reply = hostReceive();
+	TEST_ASSERT((reply != NULL) && (reply[1] == 39) && (reply[2] == MMDVM_DMR_DATA2) && (reply[3] == (DMR_SYNC_DATA | DT_VOICE_LC_HEADER)));
+	if (reply != NULL)
+	{
+		TEST_ASSERT(voiceLCHeaderDecode(&reply[MMDVM_HEADER_LENGTH], DT_VOICE_LC_HEADER, &lc));
+		TEST_ASSERT_EQUAL(RF_SRC_ID, lc.srcId);
+		TEST_ASSERT_EQUAL(RF_DST_ID, lc.dstId);
+		maxLatency = hostReplies[(hostRepliesOut - 1) % HOST_REPLIES].time - sentTime;
+	}
+
+	for (int i = 0; i < frames; i++)
+	{
+		uint8_t sequence = (i + 1) % 6;
+
+		sentTime = ticksGetMillis();
+		rfReceive(HOTSPOT_RX_AUDIO_FRAME, sequence, audio);
+		hotspotRun(VOICE_PERIOD);
+
+		reply = hostReceive();
+		if ((reply != NULL) && (reply[1] == 39) && (reply[2] == MMDVM_DMR_DATA2) && (reply[3] == ((sequence == 0) ? MMDVM_VOICE_SYNC_PATTERN : sequence)) &&
+				(memcmp(&reply[MMDVM_HEADER_LENGTH], audio, 13) == 0) && (memcmp(&reply[MMDVM_HEADER_LENGTH + 20], &audio[14], 13) == 0))
+		{
+			lastVoiceTime = hostReplies[(hostRepliesOut - 1) % HOST_REPLIES].time;
+			if (voiceFrames++ == 0)
+			{
+				firstVoiceTime = lastVoiceTime;
+			}
+			maxLatency = MAX(maxLatency, (lastVoiceTime - sentTime));
+		}
+	}
+	TEST_ASSERT_EQUAL(frames, voiceFrames);
+
+	rfReceive(HOTSPOT_RX_STOP, 0, audio);
+	hotspotRun(VOICE_PERIOD);
+	reply = hostReceive();
+	TEST_ASSERT((reply != NULL) && (reply[2] == MMDVM_DMR_DATA2) && (reply[3] == (DMR_SYNC_DATA | DT_TERMINATOR_WITH_LC)));
+
+	TEST_ASSERT(maxLatency <= 2);
+	TEST_ASSERT_EQUAL(1, highWaterRxBuffer);
+	TEST_ASSERT_EQUAL(0, hostDMRAcks);
+
+	// A stream without its terminator is reported lost after 300ms
+	rfReceive(HOTSPOT_RX_START, 0, audio);
+	hotspotRun(VOICE_PERIOD);
+	rfReceive(HOTSPOT_RX_AUDIO_FRAME, 1, audio);
+	hotspotRun(VOICE_PERIOD);
+	TEST_ASSERT(hostReceive() != NULL);
+	TEST_ASSERT(hostReceive() != NULL);
+	sentTime = ticksGetMillis();
+	hotspotRun(500);
+	reply = hostReceive();
+	TEST_ASSERT((reply != NULL) && (reply[1] == 3) && (reply[2] == MMDVM_DMR_LOST2));
+	TEST_ASSERT(hostReceive() == NULL);
+
+	if (report)
+	{
+		printf("  RF to net: %d frames, %.1f frames/s, max latency %u ms, RX buffer high-water %d, USB TX queue high-water %u\n",
+				frames, (((frames - 1) * 1000.0) / (lastVoiceTime - firstVoiceTime)), maxLatency, highWaterRxBuffer, hotspotGetUSBTxStats()->maxDepth);
+	}
+}
+
+// MMDVMHost sends what the DMR space allows, as soon as it knows it (network bursts): nothing can be dropped
+static void testFlood(void)
+{
+	const int frames = 500;
+	int sent = 0;
+	uint32_t startTime;
+
+	hotspotStart();
+	hostConnect();
+	srand(0x3C3C);
+
+	hostStatusPolling = true;
+	hostStatusDMRSpace = 0;
+	startTime = ticksGetMillis();
+	hostSendLC(DT_VOICE_LC_HEADER);
+
+	while (rfTxFrames < frames)
+	{
+		hotspotRun(HOST_STATUS_PERIOD);
+
+		// The space from the last status, minus what has been sent since
+		for (int i = 0; (i < hostStatusDMRSpace) && (sent < frames) && ((sent - (int)rfTxFrames) < HOTSPOT_BUFFER_COUNT); i++)
+		{
+			hostSendVoice(sent % 6);
+			sent++;
+		}
+
+		if ((ticksGetMillis() - startTime) > (frames * VOICE_PERIOD * 2))
+		{
+			break;
+		}
+	}
+
+	hostSendLC(DT_TERMINATOR_WITH_LC);
+	hotspotRun(3000);
+
+	TEST_ASSERT_EQUAL(frames, rfTxFrames);
+	TEST_ASSERT_EQUAL(0, rfTxMismatches);
+	TEST_ASSERT_EQUAL(0, jitterStats.dropped);
+	TEST_ASSERT_EQUAL(0, comRecvMMDVMOverruns);
+	TEST_ASSERT_EQUAL(frames + 2, hostDMRAcks);
+	TEST_ASSERT(highWaterTxBuffer <= HOTSPOT_BUFFER_COUNT);
+	TEST_ASSERT(hostReceive() == NULL);
+
+	if (report)
+	{
+		printf("  flood: %d frames, %.1f frames/s, TX buffer high-water %d, USB ring high-water %d\n",
+				frames, ((frames - 1) * 1000.0) / (rfTxLastFrameTime - rfTxFirstFrameTime), highWaterTxBuffer, highWaterUSBRing);
+	}
+}
+
+// Host time spent in the hotspot task per frame (status and voice bursts while transmitting)
+static void benchmarkHandling(void)
+{
+	const int count = 200000;
+	struct timespec start, end;
+	double seconds;
+
+	hotspotStart();
+	hostConnect();
+	hostDiscardReplies = true;
+	hostSendLC(DT_VOICE_LC_HEADER);
+	hotspotRun(2);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < count; i++)
+	{
+		if (i & 1)
+		{
+			uint8_t frame[] = { MMDVM_FRAME_START, 3, MMDVM_GET_STATUS };
+
+			usbComMMDVMFrameStore(frame, frame[1]);
+		}
+		else
+		{
+			hostSendVoice((i >> 1) % 6);
+		}
+
+		handleHotspotRequest();
+		hotspotStateMachine();
+
+		if (usbTransferPending)
+		{
+			usbTransferPending = false;
+			hotspotUSBTransmitComplete();
+		}
+
+		// The HR-C6000 takes the bursts right away
+		wavbuffer_count = 0;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	seconds = (end.tv_sec - start.tv_sec) + ((end.tv_nsec - start.tv_nsec) / 1e9);
+	printf("  handling: %.2f us per frame, %.0f frames/s\n", ((seconds * 1e6) / count), (count / seconds));
+
+	hostDiscardReplies = false;
+}
+
+int main(int argc, char **argv)
+{
+	testInit("testHotspot");
+
+	report = ((argc > 1) && (strcmp(argv[1], "-b") == 0));
+
+	nonVolatileSettings.hotspotType = HOTSPOT_TYPE_MMDVM;
+	settingsUsbMode = USB_MODE_HOTSPOT;
+	currentLanguage = &languages[0];
+	lastHeardInitList();
+
+	testConformance();
+	testNetToRF();
+	testRFToNet();
+	testFlood();
+
+	if (report)
+	{
+		benchmarkHandling();
+	}
+
+	return testDone();
+}
@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "functions/hotspot.h"
+#include "usb/usb_com.h"
+#include "test.h"
+
+//
+// MMDVMHost frames receive ring (usb/usb_mmdvm.c): frames stored from the USB ISR are parsed in place, across the
+// end of the ring when they wrap, and must decode as the former byte by byte copy did. A frame that doesn't fit in
+// front of an unreleased one is dropped.
+//
+
+#define TEST_ITERATIONS             50000
+#define TEST_MIN_FRAME_LENGTH       3 // The shortest MMDVMHost frame
+#define TEST_MAX_FRAME_LENGTH       255
+
+// Reference ring, stored and decoded one byte at a time (as CDC_Receive_FS() and handleHotspotRequest() used to)
+static uint8_t refBuffer[COM_REQUESTBUFFER_SIZE];
+static int refIndexIn = 0;
+static int refIndexOut = 0;
+static int refFrameCount = 0;
+static int refUsed = 0;
+
+static void refStore(const uint8_t *data, uint8_t frameLength)
+{
+	refBuffer[refIndexIn++] = frameLength + 1;
+	if (refIndexIn >= COM_REQUESTBUFFER_SIZE)
+	{
+		refIndexIn = 0;
+	}
+
+	for (uint8_t i = 0; i < frameLength; i++)
+	{
+		refBuffer[refIndexIn++] = data[i];
+		if (refIndexIn >= COM_REQUESTBUFFER_SIZE)
+		{
+			refIndexIn = 0;
+		}
+	}
+
+	refFrameCount++;
+	refUsed += frameLength + 1;
+}
+
+static uint8_t refDecode(uint8_t *frame)
+{
+	uint8_t frameLength = (refBuffer[refIndexOut++] - 1);
+
+	if (refIndexOut >= COM_REQUESTBUFFER_SIZE)
+	{
+		refIndexOut = 0;
+	}
+
+	for (uint8_t i = 0; i < frameLength; i++)
+	{
+		frame[i] = refBuffer[refIndexOut++];
+		if (refIndexOut >= COM_REQUESTBUFFER_SIZE)
+		{
+			refIndexOut = 0;
+		}
+	}
+
+	refFrameCount--;
+	refUsed -= frameLength + 1;
+
+	return frameLength;
+}
+
+static void ringReset(void)
+{
+	comRecvMMDVMIndexIn = comRecvMMDVMIndexOut = 0;
+	comRecvMMDVMFrameCount = 0;
+	comRecvMMDVMOverruns = 0;
+	refIndexIn = refIndexOut = 0;
+	refFrameCount = 0;
+	refUsed = 0;
+}
+
+static uint8_t makeFrame(uint8_t *frame, uint8_t length, uint32_t sequence)
+{
+	frame[0] = MMDVM_FRAME_START;
+	frame[1] = length;
+	for (int i = 2; i < length; i++)
+	{
+		frame[i] = (uint8_t)(sequence * 31 + i);
+	}
+
+	return length;
+}
+
+// Random frame lengths and store/decode interleaving, the frames are read back with random fragment sizes
+static void testAgainstReference(void)
+{
+	uint8_t frame[TEST_MAX_FRAME_LENGTH];
+	uint8_t refFrame[TEST_MAX_FRAME_LENGTH];
+	uint8_t fragments[TEST_MAX_FRAME_LENGTH];
+	usbComFrameView_t view;
+	uint32_t sequence = 0;
+	int wrappedFrames = 0;
+	int wrappedHeaders = 0;
+
+	ringReset();
+	srand(0x4D4D4456);
+
+	for (int i = 0; i < TEST_ITERATIONS; i++)
+	{
+		uint8_t length = TEST_MIN_FRAME_LENGTH + (rand() % (TEST_MAX_FRAME_LENGTH - TEST_MIN_FRAME_LENGTH + 1));
+
+		// The reference ring has no overrun protection, only feed it what fits
+		if ((rand() & 1) && ((refUsed + length + 1) <= COM_REQUESTBUFFER_SIZE))
+		{
+			if (comRecvMMDVMIndexIn == (COM_REQUESTBUFFER_SIZE - 1))
+			{
+				wrappedHeaders++;
+			}
+
+			makeFrame(frame, length, sequence++);
+			refStore(frame, length);
+			TEST_ASSERT(usbComMMDVMFrameStore(frame, length));
+			TEST_ASSERT_EQUAL(refIndexIn, comRecvMMDVMIndexIn);
+			TEST_ASSERT_EQUAL(refFrameCount, comRecvMMDVMFrameCount);
+		}
+		else if (refFrameCount > 0)
+		{
+			uint16_t offset = 0;
+			uint8_t refLength = refDecode(refFrame);
+
+			TEST_ASSERT(usbComMMDVMFramePeek(&view));
+			TEST_ASSERT_EQUAL(refLength, view.length[0] + view.length[1]);
+			if (view.length[1] != 0)
+			{
+				wrappedFrames++;
+			}
+
+			usbComFrameViewCopy(&view, 0, frame, refLength);
+			TEST_ASSERT_MEMORY(refFrame, frame, refLength);
+
+			memset(fragments, 0, sizeof(fragments));
+			while (offset < refLength)
+			{
+				uint16_t fragmentLength = 1 + (rand() % 64);
+
+				fragmentLength = MIN(fragmentLength, (refLength - offset));
+
+				usbComFrameViewCopy(&view, offset, fragments + offset, fragmentLength);
+				offset += fragmentLength;
+			}
+			TEST_ASSERT_MEMORY(refFrame, fragments, refLength);
+
+			usbComMMDVMFrameRelease(&view);
+			TEST_ASSERT_EQUAL(refIndexOut, comRecvMMDVMIndexOut);
+			TEST_ASSERT_EQUAL(refFrameCount, comRecvMMDVMFrameCount);
+		}
+		else
+		{
+			TEST_ASSERT(usbComMMDVMFramePeek(&view) == false);
+		}
+	}
+
+	TEST_ASSERT_EQUAL(0, comRecvMMDVMOverruns);
+	TEST_ASSERT(wrappedFrames > 0);
+	TEST_ASSERT(wrappedHeaders > 0);
+}
+
+// A frame stored while the oldest one is handled must not overwrite it
+static void testOverrun(void)
+{
+	uint8_t frame[TEST_MAX_FRAME_LENGTH];
+	uint8_t handled[TEST_MAX_FRAME_LENGTH];
+	uint8_t copy[TEST_MAX_FRAME_LENGTH];
+	usbComFrameView_t view;
+	int stored = 0;
+
+	ringReset();
+
+	// Start near the end of the ring, so the handled frame wraps
+	comRecvMMDVMIndexIn = comRecvMMDVMIndexOut = COM_REQUESTBUFFER_SIZE - 100;
+
+	while (usbComMMDVMFrameStore(frame, makeFrame(frame, TEST_MAX_FRAME_LENGTH, stored)))
+	{
+		stored++;
+	}
+	TEST_ASSERT_EQUAL(COM_REQUESTBUFFER_SIZE / (TEST_MAX_FRAME_LENGTH + 1), stored);
+	TEST_ASSERT_EQUAL(stored, comRecvMMDVMFrameCount);
+	TEST_ASSERT_EQUAL(1, comRecvMMDVMOverruns);
+
+	TEST_ASSERT(usbComMMDVMFramePeek(&view));
+	TEST_ASSERT(view.length[1] != 0);
+	makeFrame(handled, TEST_MAX_FRAME_LENGTH, 0);
+
+	// The remaining space is smaller than the smallest frame plus its header: the ISR drops it
+	TEST_ASSERT((COM_REQUESTBUFFER_SIZE % (TEST_MAX_FRAME_LENGTH + 1)) < (TEST_MIN_FRAME_LENGTH + 1));
+	memset(frame, 0xAA, sizeof(frame));
+	TEST_ASSERT(usbComMMDVMFrameStore(frame, TEST_MIN_FRAME_LENGTH) == false);
+	TEST_ASSERT_EQUAL(2, comRecvMMDVMOverruns);
+	TEST_ASSERT_EQUAL(stored, comRecvMMDVMFrameCount);
+
+	usbComFrameViewCopy(&view, 0, copy, TEST_MAX_FRAME_LENGTH);
+	TEST_ASSERT_MEMORY(handled, copy, TEST_MAX_FRAME_LENGTH);
+
+	// Once released, its space is reused
+	usbComMMDVMFrameRelease(&view);
+	TEST_ASSERT(usbComMMDVMFrameStore(frame, makeFrame(frame, TEST_MAX_FRAME_LENGTH, stored)));
+	TEST_ASSERT_EQUAL(2, comRecvMMDVMOverruns);
+
+	// Everything still decodes in order
+	for (int i = 1; i <= stored; i++)
+	{
+		TEST_ASSERT(usbComMMDVMFramePeek(&view));
+		TEST_ASSERT_EQUAL(TEST_MAX_FRAME_LENGTH, view.length[0] + view.length[1]);
+		usbComFrameViewCopy(&view, 0, copy, TEST_MAX_FRAME_LENGTH);
+		makeFrame(handled, TEST_MAX_FRAME_LENGTH, i);
+		TEST_ASSERT_MEMORY(handled, copy, TEST_MAX_FRAME_LENGTH);
+		usbComMMDVMFrameRelease(&view);
+	}
+	TEST_ASSERT_EQUAL(0, comRecvMMDVMFrameCount);
+	TEST_ASSERT(usbComMMDVMFramePeek(&view) == false);
+}
+
+// The ring can be filled up to the last byte
+static void testFull(void)
+{
+	uint8_t frame[TEST_MAX_FRAME_LENGTH];
+	int remaining = COM_REQUESTBUFFER_SIZE;
+	usbComFrameView_t view;
+
+	ringReset();
+
+	while (remaining > 0)
+	{
+		uint8_t length = MIN(remaining - 1, 200);
+
+		TEST_ASSERT(usbComMMDVMFrameStore(frame, makeFrame(frame, length, remaining)));
+		remaining -= length + 1;
+	}
+	TEST_ASSERT_EQUAL(comRecvMMDVMIndexOut, comRecvMMDVMIndexIn);
+	TEST_ASSERT(usbComMMDVMFrameStore(frame, TEST_MIN_FRAME_LENGTH) == false);
+	TEST_ASSERT_EQUAL(1, comRecvMMDVMOverruns);
+
+	while (usbComMMDVMFramePeek(&view))
+	{
+		usbComMMDVMFrameRelease(&view);
+	}
+	TEST_ASSERT(usbComMMDVMFrameStore(frame, TEST_MIN_FRAME_LENGTH));
+}
+
+int main(int argc, char **argv)
+{
+	testInit("testMMDVMFrames");
+
+	testAgainstReference();
+	testOverrun();
+	testFull();
+
+	return testDone();
+}
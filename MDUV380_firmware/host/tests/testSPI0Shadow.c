@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "application/source/interfaces/spi.c"
+#include "test.h"
+
+//
+// SPI0 shadow (interfaces/spi.c, bit-banged on the memory backed GPIOE): the scripts skip the configuration
+// registers it holds, it must only hold what the C6000 registers really contain.
+//
+
+static void testWrites(void)
+{
+	static const uint8_t array[] = { 0x11, 0x22, 0x33 };
+	static const uint8_t list[][2] = { { 0x50, 0xA0 }, { 0x52, 0xA2 } };
+	uint8_t value;
+
+	SPI0ShadowInvalidate();
+
+	TEST_ASSERT(SPI0ShadowGet(0x04, 0x10, &value) == false);
+	TEST_ASSERT_EQUAL(0, SPI0WritePageRegByte(0x04, 0x10, 0x6E));
+	TEST_ASSERT(SPI0ShadowGet(0x04, 0x10, &value) && (value == 0x6E));
+
+	SPI0WritePageRegByteArray(0x01, 0x30, array, sizeof(array));
+	TEST_ASSERT(SPI0ShadowGet(0x01, 0x30, &value) && (value == 0x11));
+	TEST_ASSERT(SPI0ShadowGet(0x01, 0x32, &value) && (value == 0x33));
+	TEST_ASSERT(SPI0ShadowGet(0x01, 0x33, &value) == false);
+
+	SPI0WritePageRegByteList(0x04, list, 2);
+	TEST_ASSERT(SPI0ShadowGet(0x04, 0x50, &value) && (value == 0xA0));
+	TEST_ASSERT(SPI0ShadowGet(0x04, 0x51, &value) == false);
+	TEST_ASSERT(SPI0ShadowGet(0x04, 0x52, &value) && (value == 0xA2));
+
+	// Only the configuration pages are shadowed
+	SPI0WritePageRegByte(0x03, 0x00, 0x7F);
+	TEST_ASSERT(SPI0ShadowGet(0x03, 0x00, &value) == false);
+}
+
+// Extended (page | 0x40, 11 bits address) writes don't reach the configuration registers
+static void testExtendedWrites(void)
+{
+	uint8_t value;
+
+	SPI0ShadowInvalidate();
+
+	SPI0WritePageRegByteExtended(0x01, 0x0020, 0x05);
+	SPI0WritePageRegByteExtended(0x01, 0x011B, 0x05);
+	TEST_ASSERT(SPI0ShadowGet(0x01, 0x20, &value) == false);
+	TEST_ASSERT(SPI0ShadowGet(0x01, 0x1B, &value) == false);
+
+	SPI0WritePageRegByte(0x01, 0x20, 0x42);
+	SPI0WritePageRegByteExtended(0x01, 0x0020, 0x05);
+	TEST_ASSERT(SPI0ShadowGet(0x01, 0x20, &value) && (value == 0x42));
+}
+
+// A write to the page 0x04 register 0x00 resets the chip (fully or partially), nothing is known afterwards
+static void testReset(void)
+{
+	static const uint8_t resetList[][2] = { { 0x10, 0xF3 }, { 0x00, 0xFF }, { 0x01, 0xB0 } };
+	static const uint8_t array[] = { 0x2A, 0x22 };
+	uint8_t value;
+
+	SPI0ShadowInvalidate();
+
+	SPI0WritePageRegByte(0x04, 0x26, 0xFD);
+	SPI0WritePageRegByte(0x01, 0x50, 0x00);
+	SPI0WritePageRegByte(0x04, 0x00, 0x2A);
+	TEST_ASSERT(SPI0ShadowGet(0x04, 0x26, &value) == false);
+	TEST_ASSERT(SPI0ShadowGet(0x01, 0x50, &value) == false);
+	TEST_ASSERT(SPI0ShadowGet(0x04, 0x00, &value) == false);
+
+	SPI0WritePageRegByteList(0x04, resetList, 3);
+	TEST_ASSERT(SPI0ShadowGet(0x04, 0x10, &value) == false);
+	TEST_ASSERT(SPI0ShadowGet(0x04, 0x01, &value) && (value == 0xB0));
+
+	SPI0WritePageRegByte(0x04, 0x26, 0xFD);
+	SPI0WritePageRegByteArray(0x04, 0x00, array, sizeof(array));
+	TEST_ASSERT(SPI0ShadowGet(0x04, 0x26, &value) == false);
+}
+
+int main(int argc, char **argv)
+{
+	testInit("testSPI0Shadow");
+
+	testWrites();
+	testExtendedWrites();
+	testReset();
+
+	return testDone();
+}
@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "application/source/hardware/SPI_Flash.c"
+#include "test.h"
+
+//
+// SPI flash driver (hardware/SPI_Flash.c), against the simulated W25Q128: the read cache must give what the chip holds,
+// without going to the chip for the cached pages, and must drop the pages the writes and erases modify.
+//
+
+#define TEST_AREA           0x00200000 // Away from the codeplug, nobody else uses it here
+#define TEST_AREA_SIZE      (4 * SPI_FLASH_SECTOR_SIZE)
+
+static uint8_t reference[TEST_AREA_SIZE];
+
+static uint32_t flashTransactions(void)
+{
+	uint32_t transactions, bytes;
+
+	simFlashGetStats(&transactions, &bytes);
+
+	return transactions;
+}
+
+static void testCacheHits(void)
+{
+	uint8_t buf[SPI_FLASH_PAGE_SIZE * 2];
+	uint32_t transactions;
+	uint32_t hits;
+
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA + 100, buf, 100));
+	TEST_ASSERT_MEMORY(reference + 100, buf, 100);
+
+	// Same page, or a part of it: no flash access
+	transactions = flashTransactions();
+	hits = SPI_Flash_getStats()->hits;
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA + 100, buf, 100));
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA, buf, SPI_FLASH_PAGE_SIZE));
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA + 255, buf, 1));
+	TEST_ASSERT_EQUAL(transactions, flashTransactions());
+	TEST_ASSERT_EQUAL(hits + 3, SPI_Flash_getStats()->hits);
+	TEST_ASSERT_MEMORY(reference + 255, buf, 1);
+
+	// Sequential miss: the next pages are read ahead, within the same command
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA + SPI_FLASH_PAGE_SIZE, buf, 10));
+	TEST_ASSERT_EQUAL(transactions + 1, flashTransactions());
+	TEST_ASSERT_EQUAL(SPI_FLASH_READ_AHEAD_PAGES, SPI_Flash_getStats()->readAheadPages);
+
+	transactions = flashTransactions();
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA + (2 * SPI_FLASH_PAGE_SIZE) + 10, buf, sizeof(buf) - 10));
+	TEST_ASSERT_EQUAL(transactions, flashTransactions());
+	TEST_ASSERT_MEMORY(reference + (2 * SPI_FLASH_PAGE_SIZE) + 10, buf, sizeof(buf) - 10);
+
+	// The least recently used page goes first
+	for (int i = 0; i < SPI_FLASH_CACHE_PAGES; i++)
+	{
+		TEST_ASSERT(SPI_Flash_read(TEST_AREA + ((8 + (2 * i)) * SPI_FLASH_PAGE_SIZE), buf, 1));
+	}
+	transactions = flashTransactions();
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA + (8 * SPI_FLASH_PAGE_SIZE), buf, 1));
+	TEST_ASSERT_EQUAL(transactions, flashTransactions());
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA, buf, 1));
+	TEST_ASSERT_EQUAL(transactions + 1, flashTransactions());
+}
+
+static void testInvalidation(void)
+{
+	uint8_t page[SPI_FLASH_PAGE_SIZE];
+	uint8_t buf[SPI_FLASH_PAGE_SIZE];
+	uint32_t invalidations;
+
+	// Cached, then programmed
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA, buf, sizeof(buf)));
+	invalidations = SPI_Flash_getStats()->invalidations;
+	memset(page, 0x5A, sizeof(page));
+	TEST_ASSERT(SPI_Flash_write(TEST_AREA + 16, page, 32));
+	memcpy(reference + 16, page, 32);
+	TEST_ASSERT(SPI_Flash_getStats()->invalidations > invalidations);
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA, buf, sizeof(buf)));
+	TEST_ASSERT_MEMORY(reference, buf, sizeof(buf));
+
+	// SPI_Flash_writePage()
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA + SPI_FLASH_SECTOR_SIZE, buf, sizeof(buf)));
+	for (int i = 0; i < SPI_FLASH_PAGE_SIZE; i++)
+	{
+		page[i] = reference[SPI_FLASH_SECTOR_SIZE + i] & 0x0F;
+	}
+	TEST_ASSERT(SPI_Flash_writePage(TEST_AREA + SPI_FLASH_SECTOR_SIZE, page));
+	memcpy(reference + SPI_FLASH_SECTOR_SIZE, page, sizeof(page));
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA + SPI_FLASH_SECTOR_SIZE, buf, sizeof(buf)));
+	TEST_ASSERT_MEMORY(reference + SPI_FLASH_SECTOR_SIZE, buf, sizeof(buf));
+
+	// Erased sector, any of its pages
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA + (2 * SPI_FLASH_SECTOR_SIZE) + 1000, buf, 100));
+	TEST_ASSERT(SPI_Flash_eraseSector(TEST_AREA + (2 * SPI_FLASH_SECTOR_SIZE)));
+	memset(reference + (2 * SPI_FLASH_SECTOR_SIZE), 0xFF, SPI_FLASH_SECTOR_SIZE);
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA + (2 * SPI_FLASH_SECTOR_SIZE) + 1000, buf, 100));
+	TEST_ASSERT_MEMORY(reference + (2 * SPI_FLASH_SECTOR_SIZE) + 1000, buf, 100);
+
+	// The page after the last sequential read isn't read ahead from stale data
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA + (3 * SPI_FLASH_SECTOR_SIZE) - SPI_FLASH_PAGE_SIZE, buf, sizeof(buf)));
+	memset(page, 0x00, sizeof(page));
+	TEST_ASSERT(SPI_Flash_write(TEST_AREA + (3 * SPI_FLASH_SECTOR_SIZE), page, sizeof(page)));
+	memcpy(reference + (3 * SPI_FLASH_SECTOR_SIZE), page, sizeof(page));
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA + (3 * SPI_FLASH_SECTOR_SIZE), buf, sizeof(buf)));
+	TEST_ASSERT_MEMORY(reference + (3 * SPI_FLASH_SECTOR_SIZE), buf, sizeof(buf));
+}
+
+// Random reads and writes, the reads must always give the reference content
+static void testAgainstReference(void)
+{
+	static uint8_t buf[TEST_AREA_SIZE];
+
+	for (int i = 0; i < 2000; i++)
+	{
+		int offset = (rand() % TEST_AREA_SIZE);
+		int maxSize = (((rand() % 4) == 0) ? TEST_AREA_SIZE : (2 * SPI_FLASH_PAGE_SIZE));
+		int size = (1 + (rand() % maxSize));
+
+		if (size > (TEST_AREA_SIZE - offset))
+		{
+			size = (TEST_AREA_SIZE - offset);
+		}
+
+		if ((rand() % 8) == 0)
+		{
+			for (int j = 0; j < size; j++)
+			{
+				buf[j] = rand();
+			}
+
+			TEST_ASSERT(SPI_Flash_write(TEST_AREA + offset, buf, size));
+			memcpy(reference + offset, buf, size);
+		}
+		else
+		{
+			TEST_ASSERT(SPI_Flash_read(TEST_AREA + offset, buf, size));
+			TEST_ASSERT_MEMORY(reference + offset, buf, size);
+		}
+	}
+
+	TEST_ASSERT(SPI_Flash_getStats()->hits > 0);
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA, buf, TEST_AREA_SIZE));
+	TEST_ASSERT_MEMORY(reference, buf, TEST_AREA_SIZE);
+}
+
+// Appending to an erased area, or rewriting the same content, needs no erase
+static void testBlankSectorWrites(void)
+{
+	uint32_t sectorAddress = TEST_AREA + (2 * SPI_FLASH_SECTOR_SIZE);
+	uint8_t buf[SPI_FLASH_PAGE_SIZE];
+	uint32_t foregroundErases;
+	uint32_t erasesAvoided;
+
+	TEST_ASSERT(SPI_Flash_eraseSector(sectorAddress));
+	memset(reference + (2 * SPI_FLASH_SECTOR_SIZE), 0xFF, SPI_FLASH_SECTOR_SIZE);
+	foregroundErases = SPI_Flash_getStats()->foregroundErases;
+	erasesAvoided = SPI_Flash_getStats()->erasesAvoided;
+
+	for (int i = 0; i < 4; i++)
+	{
+		memset(buf, 0x10 + i, 100);
+		TEST_ASSERT(SPI_Flash_write(sectorAddress + (i * 100), buf, 100));
+		memcpy(reference + (2 * SPI_FLASH_SECTOR_SIZE) + (i * 100), buf, 100);
+	}
+	TEST_ASSERT(SPI_Flash_write(sectorAddress + 300, buf, 100));
+
+	TEST_ASSERT_EQUAL(foregroundErases, SPI_Flash_getStats()->foregroundErases);
+	TEST_ASSERT_EQUAL(erasesAvoided + 4, SPI_Flash_getStats()->erasesAvoided);
+	TEST_ASSERT(SPI_Flash_read(sectorAddress, buf, sizeof(buf)));
+	TEST_ASSERT_MEMORY(reference + (2 * SPI_FLASH_SECTOR_SIZE), buf, sizeof(buf));
+
+	// Some bits back to 1
+	memset(buf, 0xF0, 10);
+	TEST_ASSERT(SPI_Flash_write(sectorAddress, buf, 10));
+	memcpy(reference + (2 * SPI_FLASH_SECTOR_SIZE), buf, 10);
+	TEST_ASSERT_EQUAL(foregroundErases + 1, SPI_Flash_getStats()->foregroundErases);
+	TEST_ASSERT(SPI_Flash_read(sectorAddress, buf, sizeof(buf)));
+	TEST_ASSERT_MEMORY(reference + (2 * SPI_FLASH_SECTOR_SIZE), buf, sizeof(buf));
+}
+
+// What the maintenance task does, without its wait for the radio to be idle
+static void runMaintenance(void)
+{
+	while (spi_flash_backgroundEraseStart())
+	{
+		do
+		{
+			simClockAdvance(SPI_FLASH_ERASE_POLL_PERIOD);
+		} while (spi_flash_backgroundEraseIsOver() == false);
+	}
+}
+
+static void testPooledErase(void)
+{
+	uint32_t sectorAddress = TEST_AREA + SPI_FLASH_SECTOR_SIZE;
+	uint8_t buf[SPI_FLASH_PAGE_SIZE];
+	uint32_t backgroundErases = SPI_Flash_getStats()->backgroundErases;
+	uint32_t foregroundErases = SPI_Flash_getStats()->foregroundErases;
+	uint32_t startTime;
+
+	TEST_ASSERT(SPI_Flash_read(sectorAddress, buf, sizeof(buf))); // Cached
+	TEST_ASSERT(SPI_Flash_eraseSectorInBackground(sectorAddress + 100));
+	TEST_ASSERT(SPI_Flash_eraseSectorInBackground(sectorAddress)); // Already queued
+	runMaintenance();
+	TEST_ASSERT_EQUAL(backgroundErases + 1, SPI_Flash_getStats()->backgroundErases);
+
+	// Pre-erased: no erase command, no wait
+	startTime = uwTick;
+	TEST_ASSERT(SPI_Flash_eraseSector(sectorAddress));
+	TEST_ASSERT_EQUAL(startTime, uwTick);
+	TEST_ASSERT_EQUAL(foregroundErases, SPI_Flash_getStats()->foregroundErases);
+	memset(reference + SPI_FLASH_SECTOR_SIZE, 0xFF, SPI_FLASH_SECTOR_SIZE);
+	TEST_ASSERT(SPI_Flash_read(sectorAddress, buf, sizeof(buf)));
+	TEST_ASSERT_MEMORY(reference + SPI_FLASH_SECTOR_SIZE, buf, sizeof(buf));
+
+	// Taken from the pool: the next erase is a real one
+	TEST_ASSERT(SPI_Flash_eraseSector(sectorAddress));
+	TEST_ASSERT_EQUAL(foregroundErases + 1, SPI_Flash_getStats()->foregroundErases);
+
+	// Programmed before the maintenance task got to it: the pending erase is dropped, the data kept
+	TEST_ASSERT(SPI_Flash_eraseSectorInBackground(sectorAddress));
+	memset(buf, 0x24, sizeof(buf));
+	TEST_ASSERT(SPI_Flash_write(sectorAddress, buf, sizeof(buf)));
+	memcpy(reference + SPI_FLASH_SECTOR_SIZE, buf, sizeof(buf));
+	runMaintenance();
+	TEST_ASSERT_EQUAL(backgroundErases + 1, SPI_Flash_getStats()->backgroundErases);
+	TEST_ASSERT(SPI_Flash_read(sectorAddress, buf, sizeof(buf)));
+	TEST_ASSERT_MEMORY(reference + SPI_FLASH_SECTOR_SIZE, buf, sizeof(buf));
+
+	// Full of pending erases, then the erased sectors nobody took give their entries away
+	for (int i = 0; i < SPI_FLASH_ERASE_POOL_SIZE; i++)
+	{
+		TEST_ASSERT(SPI_Flash_eraseSectorInBackground(TEST_AREA + TEST_AREA_SIZE + (i * SPI_FLASH_SECTOR_SIZE)));
+	}
+	TEST_ASSERT(SPI_Flash_eraseSectorInBackground(TEST_AREA + TEST_AREA_SIZE + (SPI_FLASH_ERASE_POOL_SIZE * SPI_FLASH_SECTOR_SIZE)) == false);
+	runMaintenance();
+	TEST_ASSERT_EQUAL(backgroundErases + 1 + SPI_FLASH_ERASE_POOL_SIZE, SPI_Flash_getStats()->backgroundErases);
+	TEST_ASSERT(SPI_Flash_eraseSectorInBackground(TEST_AREA + TEST_AREA_SIZE + (SPI_FLASH_ERASE_POOL_SIZE * SPI_FLASH_SECTOR_SIZE)));
+	runMaintenance();
+}
+
+// A read issued during a background erase suspends it, or waits for it within the sector being erased
+static void testReadDuringErase(void)
+{
+	uint32_t sectorAddress = TEST_AREA + (3 * SPI_FLASH_SECTOR_SIZE);
+	uint8_t buf[SPI_FLASH_PAGE_SIZE];
+	uint32_t eraseSuspends = SPI_Flash_getStats()->eraseSuspends;
+	uint32_t startTime;
+
+	TEST_ASSERT(SPI_Flash_eraseSectorInBackground(sectorAddress));
+	TEST_ASSERT(spi_flash_backgroundEraseStart());
+	simClockAdvance(SPI_FLASH_ERASE_POLL_PERIOD);
+
+	// Elsewhere: suspended, then resumed
+	startTime = uwTick;
+	TEST_ASSERT(SPI_Flash_read(TEST_AREA + 1000, buf, 100));
+	TEST_ASSERT_MEMORY(reference + 1000, buf, 100);
+	TEST_ASSERT_EQUAL(startTime, uwTick);
+	TEST_ASSERT_EQUAL(eraseSuspends + 1, SPI_Flash_getStats()->eraseSuspends);
+	TEST_ASSERT(spiFlashEraseIsSuspended == false);
+	TEST_ASSERT(spi_flash_busy());
+	TEST_ASSERT(spi_flash_backgroundEraseIsOver() == false);
+
+	// The registers can be read meanwhile
+	TEST_ASSERT_EQUAL(0x4018, SPI_Flash_readPartID());
+	TEST_ASSERT(spi_flash_busy());
+
+	// Same sector: waits for the end of the erase
+	TEST_ASSERT(SPI_Flash_read(sectorAddress + 10, buf, 100));
+	memset(reference + (3 * SPI_FLASH_SECTOR_SIZE), 0xFF, SPI_FLASH_SECTOR_SIZE);
+	TEST_ASSERT_MEMORY(reference + (3 * SPI_FLASH_SECTOR_SIZE) + 10, buf, 100);
+	TEST_ASSERT(uwTick > startTime);
+	TEST_ASSERT(spi_flash_backgroundEraseIsOver());
+
+	// Completed by the read, still pre-erased
+	startTime = uwTick;
+	TEST_ASSERT(SPI_Flash_eraseSector(sectorAddress));
+	TEST_ASSERT_EQUAL(startTime, uwTick);
+}
+
+static void testRegisters(void)
+{
+	TEST_ASSERT_EQUAL(0x4018, SPI_Flash_readPartID());
+	TEST_ASSERT_EQUAL(0xEF, SPI_Flash_readManufacturer());
+	TEST_ASSERT_EQUAL(0, (SPI_Flash_readStatusRegisters() & (SR_BUSY | SR_WEL | SR_SUS)));
+}
+
+int main(int argc, char **argv)
+{
+	testInit("testSPIFlash");
+	srand(1);
+
+	TEST_ASSERT(SPI_Flash_init());
+
+	for (int i = 0; i < TEST_AREA_SIZE; i++)
+	{
+		reference[i] = rand();
+	}
+	TEST_ASSERT(SPI_Flash_write(TEST_AREA, reference, TEST_AREA_SIZE));
+
+	testRegisters();
+	testCacheHits();
+	testInvalidation();
+	testAgainstReference();
+	testBlankSectorWrites();
+	testPooledErase();
+	testReadDuringErase();
+
+	return testDone();
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "application/source/interfaces/settingsStorage.c"
+#include "test.h"
+
+//
+// Settings write-back cache (interfaces/settingsStorage.c): the settings and VFOs are saved to the backup SRAM,
+// the flash is only written when they changed, and an unflushed record survives a reset.
+//
+
+#define TEST_SETTINGS_SIZE          256
+
+static uint8_t settings[TEST_SETTINGS_SIZE];
+static uint8_t vfos[SETTINGS_STORAGE_VFOS_SIZE];
+
+static uint32_t flashTransactions(void)
+{
+	uint32_t transactions, bytes;
+
+	simFlashGetStats(&transactions, &bytes);
+
+	return transactions;
+}
+
+// What the firmware sees after a reset: the backup SRAM is kept, the RAM isn't
+static void simulateReset(void)
+{
+	memset(&backupHeader, 0, sizeof(backupHeader));
+	memset(backupVFOs, 0, sizeof(backupVFOs));
+	backupIsValid = false;
+	ticksTimerReset(&flashCommitTimer);
+}
+
+static void testUnchangedWrites(void)
+{
+	uint8_t buf[TEST_SETTINGS_SIZE];
+	uint32_t transactions;
+
+	memset(settings, 0x5A, sizeof(settings));
+	memset(vfos, 0xFF, sizeof(vfos)); // Blank flash content
+	TEST_ASSERT(EEPROM_Write(SETTINGS_STORAGE_ADDRESS, settings, sizeof(settings)));
+
+	simulateReset();
+	TEST_ASSERT(settingsStorageRead(buf, sizeof(buf)));
+	TEST_ASSERT_MEMORY(settings, buf, sizeof(buf));
+
+	// Same settings, same VFOs as in the flash: no new record, nothing to commit
+	TEST_ASSERT(settingsStorageWrite(settings, sizeof(settings), vfos));
+	TEST_ASSERT_EQUAL(backupHeader.flashSequence, backupHeader.sequence);
+	TEST_ASSERT(settingsStorageFlushIsDue() == false);
+
+	transactions = flashTransactions();
+	TEST_ASSERT(settingsStorageFlush(settings, sizeof(settings)));
+	TEST_ASSERT_EQUAL(transactions, flashTransactions());
+}
+
+static void testVFOsCommit(void)
+{
+	uint8_t buf[SETTINGS_STORAGE_VFOS_SIZE];
+	uint32_t transactions;
+
+	// VFOs only change: they go to the backup SRAM, not to the flash
+	vfos[0] = 0x01;
+	vfos[CODEPLUG_CHANNEL_DATA_STRUCT_SIZE] = 0x02;
+	transactions = flashTransactions();
+	TEST_ASSERT(settingsStorageWrite(settings, sizeof(settings), vfos));
+	TEST_ASSERT_EQUAL(transactions, flashTransactions());
+	TEST_ASSERT_EQUAL(SETTINGS_STORAGE_VFOS_SIZE, backupHeader.vfosLength);
+	TEST_ASSERT(backupHeader.sequence != backupHeader.flashSequence);
+
+	// Saving again without the VFOs keeps them pending
+	TEST_ASSERT(settingsStorageWrite(settings, sizeof(settings), NULL));
+	TEST_ASSERT_EQUAL(SETTINGS_STORAGE_VFOS_SIZE, backupHeader.vfosLength);
+
+	TEST_ASSERT(settingsStorageFlush(settings, sizeof(settings)));
+	TEST_ASSERT(EEPROM_Read(CODEPLUG_ADDR_VFO_A_CHANNEL, buf, sizeof(buf)));
+	TEST_ASSERT_MEMORY(vfos, buf, sizeof(buf));
+	TEST_ASSERT_EQUAL(0, backupHeader.vfosLength);
+	TEST_ASSERT_EQUAL(backupHeader.flashSequence, backupHeader.sequence);
+
+	// Flushed content saved again: nothing to do
+	TEST_ASSERT(settingsStorageWrite(settings, sizeof(settings), vfos));
+	TEST_ASSERT_EQUAL(backupHeader.flashSequence, backupHeader.sequence);
+}
+
+// Changes that didn't reach the flash before a reset are committed on the next boot, VFOs included
+static void testUnflushedRecord(void)
+{
+	uint8_t buf[TEST_SETTINGS_SIZE];
+	uint8_t flashVFOs[SETTINGS_STORAGE_VFOS_SIZE];
+
+	settings[10] = 0xA5;
+	vfos[1] = 0x03;
+	TEST_ASSERT(settingsStorageWrite(settings, sizeof(settings), vfos));
+	TEST_ASSERT(settingsStorageFlushIsDue() == false);
+
+	simulateReset();
+	TEST_ASSERT(settingsStorageRead(buf, sizeof(buf)));
+	TEST_ASSERT_MEMORY(settings, buf, sizeof(buf));
+
+	TEST_ASSERT(EEPROM_Read(SETTINGS_STORAGE_ADDRESS, buf, sizeof(buf)));
+	TEST_ASSERT_MEMORY(settings, buf, sizeof(buf));
+	TEST_ASSERT(EEPROM_Read(CODEPLUG_ADDR_VFO_A_CHANNEL, flashVFOs, sizeof(flashVFOs)));
+	TEST_ASSERT_MEMORY(vfos, flashVFOs, sizeof(flashVFOs));
+
+	// In sync now, a further reset reads the flash
+	simulateReset();
+	TEST_ASSERT(settingsStorageRead(buf, sizeof(buf)));
+	TEST_ASSERT_EQUAL(0, backupHeader.sequence);
+}
+
+// A CPS write of the settings or VFOs area drops the pending record
+static void testDiscard(void)
+{
+	uint8_t buf[TEST_SETTINGS_SIZE];
+	uint8_t cpsSettings[TEST_SETTINGS_SIZE];
+
+	settings[20] = 0x77;
+	TEST_ASSERT(settingsStorageWrite(settings, sizeof(settings), NULL));
+
+	memset(cpsSettings, 0x33, sizeof(cpsSettings));
+	settingsStorageDiscardBackup();
+	TEST_ASSERT(EEPROM_Write(SETTINGS_STORAGE_ADDRESS, cpsSettings, sizeof(cpsSettings)));
+	TEST_ASSERT(settingsStorageFlush(settings, sizeof(settings)));
+
+	simulateReset();
+	TEST_ASSERT(settingsStorageRead(buf, sizeof(buf)));
+	TEST_ASSERT_MEMORY(cpsSettings, buf, sizeof(buf));
+}
+
+// The flash commit erases the settings sector in the foreground: it waits for the radio to be idle, but not forever
+static void testFlushWhenIdle(void)
+{
+	settings[30] = 0x42;
+	SPI_Flash_maintenanceSetRadioIdle(false);
+	TEST_ASSERT(settingsStorageWrite(settings, sizeof(settings), NULL));
+
+	simClockAdvance(FLASH_COMMIT_IDLE_TIME);
+	TEST_ASSERT(settingsStorageFlushIsDue() == false);
+
+	SPI_Flash_maintenanceSetRadioIdle(true);
+	TEST_ASSERT(settingsStorageFlushIsDue());
+
+	SPI_Flash_maintenanceSetRadioIdle(false);
+	simClockAdvance(FLASH_COMMIT_MAX_DELAY - FLASH_COMMIT_IDLE_TIME);
+	TEST_ASSERT(settingsStorageFlushIsDue());
+
+	TEST_ASSERT(settingsStorageFlush(settings, sizeof(settings)));
+	TEST_ASSERT(settingsStorageFlushIsDue() == false);
+}
+
+int main(int argc, char **argv)
+{
+	testInit("testSettingsStorage");
+
+	testUnchangedWrites();
+	testVFOsCommit();
+	testUnflushedRecord();
+	testDiscard();
+	testFlushWhenIdle();
+
+	return testDone();
+}
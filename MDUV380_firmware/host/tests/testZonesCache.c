@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2021-2024 Roger Clark, VK3KYY / G4KYF
+ *                         Daniel Caujolle-Bert, F1RMB
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *
+ * 4. Use of this source code or binary releases for commercial purposes is strictly forbidden. This includes, without limitation,
+ *    incorporation in a commercial product or incorporation into a product or project which allows commercial use.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ * ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "application/source/functions/codeplug.c"
+#include "test.h"
+
+//
+// Zones caches (functions/codeplug.c): the zone number -> zone list index rank/select and the decoded headers
+// must give what a linear scan of the in use bitmap and the zone records gives.
+//
+
+#define TEST_ZONE_RECORD_SIZE       (16 + (sizeof(uint16_t) * 80))
+
+static const int zonesInUse[] = { 0, 3, 9, 10, 31, 64, 200, 255 };
+#define TEST_ZONES_COUNT            (sizeof(zonesInUse) / sizeof(zonesInUse[0]))
+
+static uint32_t flashTransactions(void)
+{
+	uint32_t transactions, bytes;
+
+	simFlashGetStats(&transactions, &bytes);
+
+	return transactions;
+}
+
+// Zone record at each in use index, named after it, with (index % 7) + 1 channels
+static void writeZones(void)
+{
+	uint8_t bitmap[CODEPLUG_EX_ZONE_INUSE_PACKED_DATA_SIZE] = { 0 };
+	struct_codeplugZone_t zone;
+
+	for (size_t i = 0; i < TEST_ZONES_COUNT; i++)
+	{
+		int index = zonesInUse[i];
+
+		bitmap[index / 8] |= (1U << (index % 8));
+
+		memset(&zone, 0, sizeof(zone));
+		memset(zone.name, 0xFF, sizeof(zone.name));
+		snprintf(zone.name, sizeof(zone.name), "Zone %d", index);
+
+		for (int c = 0; c <= (index % 7); c++)
+		{
+			zone.channels[c] = 1 + c;
+		}
+
+		TEST_ASSERT(EEPROM_Write(CODEPLUG_ADDR_EX_ZONE_LIST + (index * TEST_ZONE_RECORD_SIZE), (uint8_t *)&zone, CODEPLUG_ZONE_DATA_OPENGD77_STRUCT_SIZE));
+	}
+
+	TEST_ASSERT(EEPROM_Write(CODEPLUG_ADDR_EX_ZONE_INUSE_PACKED_DATA, bitmap, sizeof(bitmap)));
+}
+
+static void testRankSelect(void)
+{
+	struct_codeplugZone_t zone;
+	char name[17];
+
+	// CCM isn't initialized at startup
+	memset(codeplugZonesIndexCache, 0xA5, sizeof(codeplugZonesIndexCache));
+	memset(codeplugZonesRankCache, 0xA5, sizeof(codeplugZonesRankCache));
+	memset(codeplugZoneHeadersCache, 0xA5, sizeof(codeplugZoneHeadersCache));
+
+	codeplugZonesInitCache();
+	TEST_ASSERT_EQUAL(TEST_ZONES_COUNT + 1, codeplugZonesGetCount());
+
+	for (size_t i = 0; i < TEST_ZONES_COUNT; i++)
+	{
+		TEST_ASSERT(codeplugZoneGetDataForNumber(i, &zone));
+		TEST_ASSERT_EQUAL(zonesInUse[i], zone.NOT_IN_CODEPLUGDATA_indexNumber);
+		TEST_ASSERT_EQUAL((zonesInUse[i] % 7) + 1, zone.NOT_IN_CODEPLUGDATA_numChannelsInZone);
+		TEST_ASSERT_EQUAL(i, codeplugZoneGetNumberForIndex(zonesInUse[i]));
+
+		snprintf(name, sizeof(name), "Zone %d", zonesInUse[i]);
+		TEST_ASSERT(strncmp(name, zone.name, strlen(name)) == 0);
+	}
+
+	// Not in use
+	TEST_ASSERT_EQUAL(-1, codeplugZoneGetNumberForIndex(1));
+	TEST_ASSERT_EQUAL(-1, codeplugZoneGetNumberForIndex(254));
+	TEST_ASSERT_EQUAL(-1, codeplugZoneGetNumberForIndex(256));
+	TEST_ASSERT(codeplugZoneGetDataForNumber(TEST_ZONES_COUNT + 1, &zone) == false);
+}
+
+static void testHeaders(void)
+{
+	codeplugZoneHeader_t header;
+	struct_codeplugZone_t zone;
+	uint32_t transactions;
+
+	codeplugZonesInitCache();
+
+	// First read goes to the flash, the next ones don't
+	TEST_ASSERT(codeplugZoneGetHeaderForNumber(2, &header));
+	transactions = flashTransactions();
+
+	for (int i = 0; i < 3; i++)
+	{
+		TEST_ASSERT(codeplugZoneGetHeaderForNumber(2, &header));
+	}
+	TEST_ASSERT_EQUAL(transactions, flashTransactions());
+	TEST_ASSERT_EQUAL(zonesInUse[2], header.indexNumber);
+	TEST_ASSERT_EQUAL((zonesInUse[2] % 7) + 1, header.numChannelsInZone);
+	TEST_ASSERT(strncmp("Zone 9", header.name, 6) == 0);
+
+	// Adding a channel updates the cached header
+	TEST_ASSERT(codeplugZoneGetDataForNumber(2, &zone));
+	TEST_ASSERT(codeplugZoneAddChannelToZoneAndSave(42, &zone));
+	TEST_ASSERT(codeplugZoneGetHeaderForNumber(2, &header));
+	TEST_ASSERT_EQUAL((zonesInUse[2] % 7) + 2, header.numChannelsInZone);
+
+	TEST_ASSERT(codeplugZoneGetDataForNumber(2, &zone));
+	TEST_ASSERT_EQUAL((zonesInUse[2] % 7) + 2, zone.NOT_IN_CODEPLUGDATA_numChannelsInZone);
+	TEST_ASSERT_EQUAL(42, zone.channels[(zonesInUse[2] % 7) + 1]);
+
+	// A new bitmap (CPS write) drops them
+	codeplugZonesInitCache();
+	TEST_ASSERT_EQUAL(0, codeplugZoneHeadersCacheValid[0]);
+}
+
+int main(int argc, char **argv)
+{
+	testInit("testZonesCache");
+
+	codeplugChannelsPerZone = 80;
+	writeZones();
+
+	testRankSelect();
+	testHeaders();
+
+	return testDone();
+}
@@ -0,0 +1,646 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+#
+# Copyright (C) 2024 Daniel Caujolle-Bert, F1RMB
+#                    Roger Clark, VK3KYY / G4KYF
+#
+# DMR ID database builder.
+#
+# Builds the version 2 database (see dmrIDv2Header_t, in user_interface/uiUtilities.h):
+# variable length records in 256 bytes blocks, a sparse block index (first ID of each block)
+# in the header, delta encoded IDs and canonical Huffman coded text (the code table is built
+# from the database content and stored in the header). In a block, the IDs and text lengths
+# come first and the texts are stored from the end, so a lookup only reads the IDs part and
+# the text it's after.
+# The legacy fixed length records formats can also be built ("Id": 4 bytes BCD IDs and raw text,
+# "IdN": 3 bytes IDs and 6 bits packed text), for comparison.
+#
+# The input is a RadioID.net style CSV (RADIO_ID,CALLSIGN,FIRST_NAME,...), the record text
+# is built with --text (Python format string using the CSV columns), or synthetic entries.
+#
+# The database is stored in two Flash areas, the first one is 256KB at 0x30000 (CPS address),
+# the second one at 0xB8000 (288KB), or over the voice prompts at 0x8F400 with --overwrite-vp.
+#
+# Examples:
+#   dmrid_db_builder.py --csv user.csv -o DMRIDs
+#       writes DMRIDs_1.bin and DMRIDs_2.bin, to be written at the printed addresses, e.g. with
+#       opengd77_cps_transfer.py -p /dev/ttyACM0 -i DMRIDs_1.bin -a 0x30000
+#   dmrid_db_builder.py --csv user.csv --flash-image flash.bin
+#       patches a Flash image (e.g. the host simulation one, host/Makefile)
+#   dmrid_db_builder.py --csv user.csv --benchmark
+#   dmrid_db_builder.py --synthetic 250000 --benchmark
+#
+# The benchmark runs the same lookup algorithms as the firmware (dmrIDLookup()) over the built
+# images, counting the SPI Flash transactions and bytes, converted to a duration with a model of
+# the SPI link (5.25MHz, HAL polling overhead per transaction). For version 2, that's the index
+# cache search (in RAM), one read of the index entries it leaves, then the block is read by
+# 32 bytes chunks until the ID is found or passed.
+#
+######################### Error codes #########################
+#  0:  No error
+# -1:  Missing or invalid input
+# -2:  Lookup verification failure
+###############################################################
+
+import argparse
+import csv
+import heapq
+import random
+import struct
+import sys
+
+
+AREA_1_ADDRESS = 0x30000
+AREA_1_SIZE = 0x40000
+AREA_2_ADDRESS = 0xB8000
+AREA_2_SIZE = 0x100000 - AREA_2_ADDRESS
+VP_ADDRESS = 0x8F400
+VP_AREA_2_SIZE = 0x100000 - VP_ADDRESS
+FLASH_ADDRESS_OFFSET = 128 * 1024  # CPS addresses to physical ones (STM32 radios)
+
+MAX_TEXT_LENGTH = 50               # MAX_DMR_ID_CONTACT_TEXT_LENGTH - 1
+ID_SLICES = 14
+MIN_ENTRIES_BEFORE_USING_SLICES = 40
+
+V1_HEADER_LENGTH = 12
+V1_LUT = " 0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz."
+
+V2_HEADER = struct.Struct("<4sIIIHBB16s96s")
+V2_BLOCK_SIZE = 256
+V2_INDEX_CACHE_SIZE = 256          # DMRID_V2_INDEX_CACHE_SIZE
+V2_READ_CHUNK_SIZE = 32            # DMRID_V2_READ_CHUNK_SIZE
+V2_MAX_CODE_LENGTH = 15
+V2_MAX_SYMBOLS = 96
+V2_FLAG_OVERWRITE_VP = 0x01
+V2_EOT = 0
+
+
+def int2bcd(value):
+    result = 0
+    shift = 0
+    while value:
+        result |= (value % 10) << shift
+        value //= 10
+        shift += 4
+    return result
+
+
+def cleanText(text):
+    text = " ".join(text.split())
+    return "".join(c if (0x20 <= ord(c) <= 0x7E) else "?" for c in text)
+
+
+def loadCSV(path, textFormat):
+    entries = {}
+
+    with open(path, "r", encoding="utf-8", errors="replace", newline="") as f:
+        reader = csv.DictReader(f)
+        for row in reader:
+            try:
+                dmrId = int(row["RADIO_ID"])
+            except (KeyError, ValueError):
+                continue
+
+            if 0 < dmrId <= 0xFFFFFF:
+                entries[dmrId] = cleanText(textFormat.format(**row))
+
+    return sorted(entries.items())
+
+
+def syntheticEntries(count, seed):
+    rng = random.Random(seed)
+    names = ["John", "Peter", "Roger", "Daniel", "Mike", "Andy", "Steve", "Paul", "David", "Chris",
+             "Mark", "Tom", "Jan", "Hans", "Pierre", "Jose", "Marco", "Ivan", "Kenji", "Bob"]
+    ids = sorted(rng.sample(range(1000000, 7500000), count))
+    entries = []
+
+    for dmrId in ids:
+        prefix = rng.choice(["", "", "K", "W", "N", "G", "F", "D", "VK", "PA", "EA", "IK", "JA"])
+        prefix = prefix or rng.choice("KWN") + rng.choice("ABCDEFGHIJKLMNOPQRSTUVWXYZ")
+        callsign = prefix + str(rng.randint(0, 9)) + "".join(rng.choice("ABCDEFGHIJKLMNOPQRSTUVWXYZ") for _ in range(rng.randint(2, 3)))
+        entries.append((dmrId, "{} {}".format(callsign, rng.choice(names))))
+
+    return entries
+
+
+#
+# Legacy format
+#
+def v1Pack(text):
+    codes = [V1_LUT.find(c) if V1_LUT.find(c) >= 0 else 0 for c in text]
+    while len(codes) % 4:
+        codes.append(0)
+
+    out = bytearray()
+    for i in range(0, len(codes), 4):
+        value = (codes[i] << 18) | (codes[i + 1] << 12) | (codes[i + 2] << 6) | codes[i + 3]
+        out += bytes([(value >> 16) & 0xFF, (value >> 8) & 0xFF, value & 0xFF])
+    return bytes(out)
+
+
+def v1Unpack(data):
+    out = []
+    for i in range(0, len(data), 3):
+        chunk = data[i:i + 3]
+        value = int.from_bytes(chunk.ljust(3, b"\x00"), "big")
+        for shift in ([18, 12] if len(chunk) == 2 else [18] if len(chunk) == 1 else [18, 12, 6, 0]):
+            out.append(V1_LUT[(value >> shift) & 0x3F])
+    return "".join(out).rstrip(" ")
+
+
+def buildV1(entries, textLength, packed, area2Size):
+    idLength = 3 if packed else 4
+    recordLength = idLength + (((textLength + 3) // 4) * 3 if packed else textLength)
+    recordsArea1 = (AREA_1_SIZE - V1_HEADER_LENGTH) // recordLength
+    capacity = recordsArea1 + (area2Size // recordLength)
+    entries = entries[:capacity]
+
+    records = bytearray()
+    for dmrId, text in entries:
+        text = text[:textLength]
+        if packed:
+            records += struct.pack("<I", dmrId)[:3] + v1Pack(text.ljust(textLength)).ljust(recordLength - 3, b"\x00")
+        else:
+            records += struct.pack("<I", int2bcd(dmrId)) + text.encode("ascii").ljust(textLength, b"\x00")
+
+    header = b"Id" + (b"N" if packed else b"4") + bytes([0x4A + recordLength]) + b"\x00" * 4 + struct.pack("<I", len(entries))
+    split = recordsArea1 * recordLength
+    return header + bytes(records[:split]), bytes(records[split:]), len(entries)
+
+
+#
+# Version 2
+#
+def huffmanCodeLengths(frequencies):
+    frequencies = dict(frequencies)
+
+    while True:
+        heap = [(freq, i, [symbol]) for i, (symbol, freq) in enumerate(sorted(frequencies.items()))]
+        lengths = {symbol: 0 for symbol in frequencies}
+        heapq.heapify(heap)
+        counter = len(heap)
+
+        if len(heap) == 1:
+            lengths[heap[0][2][0]] = 1
+
+        while len(heap) > 1:
+            f1, _, s1 = heapq.heappop(heap)
+            f2, _, s2 = heapq.heappop(heap)
+            for symbol in s1 + s2:
+                lengths[symbol] += 1
+            heapq.heappush(heap, (f1 + f2, counter, s1 + s2))
+            counter += 1
+
+        if max(lengths.values()) <= V2_MAX_CODE_LENGTH:
+            return lengths
+
+        # Flatten the distribution until the codes fit
+        frequencies = {symbol: (freq + 1) // 2 for symbol, freq in frequencies.items()}
+
+
+def canonicalCodes(lengths):
+    ordered = sorted(lengths, key=lambda symbol: (lengths[symbol], symbol))
+    codes = {}
+    code = 0
+    previousLength = lengths[ordered[0]]
+
+    for symbol in ordered:
+        code <<= (lengths[symbol] - previousLength)
+        codes[symbol] = (code, lengths[symbol])
+        previousLength = lengths[symbol]
+        code += 1
+
+    return ordered, codes
+
+
+class BitWriter:
+    def __init__(self):
+        self.data = bytearray()
+        self.bits = 0
+
+    def write(self, code, length):
+        for i in range(length - 1, -1, -1):
+            if (self.bits % 8) == 0:
+                self.data.append(0)
+            self.data[-1] |= ((code >> i) & 1) << (7 - (self.bits % 8))
+            self.bits += 1
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        b = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(b | 0x80)
+        else:
+            out.append(b)
+            return bytes(out)
+
+
+def v2DataOffset(numBlocks):
+    return ((V2_HEADER.size + (numBlocks * 4) + V2_BLOCK_SIZE - 1) // V2_BLOCK_SIZE) * V2_BLOCK_SIZE
+
+
+def v2Capacity(area2Size):
+    blocks = 0
+    while ((AREA_1_SIZE - v2DataOffset(blocks + 1)) // V2_BLOCK_SIZE) + (area2Size // V2_BLOCK_SIZE) >= (blocks + 1):
+        blocks += 1
+    return blocks
+
+
+def buildV2(entries, textLength, area2Size, overwriteVP):
+    frequencies = {V2_EOT: len(entries)}
+    for _, text in entries:
+        for c in text[:textLength]:
+            frequencies[ord(c)] = frequencies.get(ord(c), 0) + 1
+
+    lengths = huffmanCodeLengths(frequencies)
+    ordered, codes = canonicalCodes(lengths)
+
+    blocks = []
+    index = []
+    current = None
+    previousId = 0
+    maxBlocks = v2Capacity(area2Size)
+    numEntries = 0
+
+    for dmrId, text in entries:
+        writer = BitWriter()
+        for c in text[:textLength]:
+            writer.write(*codes[ord(c)])
+        writer.write(*codes[V2_EOT])
+
+        for attempt in range(2):
+            if current is None:
+                if len(blocks) == maxBlocks:
+                    break
+                current = [0, bytearray(), bytearray()]  # records count, (ID delta, text length) pairs, texts
+                blocks.append(current)
+                index.append(dmrId)
+                previousId = dmrId
+
+            pair = varint(dmrId - previousId) + bytes([len(writer.data)])
+            if (1 + len(current[1]) + len(pair) + len(current[2]) + len(writer.data) <= V2_BLOCK_SIZE) and (current[0] < 255):
+                current[1] += pair
+                current[2][:0] = writer.data
+                current[0] += 1
+                previousId = dmrId
+                numEntries += 1
+                break
+            current = None
+
+        if (current is None) and (len(blocks) == maxBlocks):
+            break
+
+    counts = [0] * (V2_MAX_CODE_LENGTH + 1)
+    for symbol in ordered:
+        counts[lengths[symbol]] += 1
+
+    lastId = entries[numEntries - 1][0] if numEntries else 0
+    header = V2_HEADER.pack(b"IDv2", numEntries, len(blocks), lastId, V2_BLOCK_SIZE, V2_FLAG_OVERWRITE_VP if overwriteVP else 0,
+                            len(ordered), bytes(counts), bytes(ordered).ljust(V2_MAX_SYMBOLS, b"\x00"))
+    dataOffset = v2DataOffset(len(blocks))
+    blocksArea1 = (AREA_1_SIZE - dataOffset) // V2_BLOCK_SIZE
+
+    area1 = bytearray(header + b"".join(struct.pack("<I", i) for i in index))
+    area1 = area1.ljust(dataOffset, b"\xFF")
+    area2 = bytearray()
+    for i, (count, pairs, texts) in enumerate(blocks):
+        block = (bytes([count]) + pairs).ljust(V2_BLOCK_SIZE - len(texts), b"\xFF") + texts
+        if i < blocksArea1:
+            area1 += block
+        else:
+            area2 += block
+
+    return bytes(area1), bytes(area2), numEntries
+
+
+#
+# Firmware lookups, over a Flash model
+#
+class Flash:
+    def __init__(self, area1, area2, area2Address, bytesPerSecond, transactionOverhead):
+        self.image = bytearray(b"\xFF" * 0x100000)
+        self.image[AREA_1_ADDRESS:AREA_1_ADDRESS + len(area1)] = area1
+        self.image[area2Address:area2Address + len(area2)] = area2
+        self.bytesPerSecond = bytesPerSecond
+        self.transactionOverhead = transactionOverhead
+        self.reset()
+
+    def reset(self):
+        self.transactions = 0
+        self.bytes = 0
+
+    def read(self, address, length):
+        self.transactions += 1
+        self.bytes += 4 + length  # command and address, then data
+        return bytes(self.image[address:address + length])
+
+    def duration(self):
+        return (self.transactions * self.transactionOverhead) + (self.bytes / self.bytesPerSecond)
+
+
+class V1Database:
+    def __init__(self, flash, area2Address):
+        self.flash = flash
+        self.area2Address = area2Address
+        header = flash.read(AREA_1_ADDRESS, V1_HEADER_LENGTH)
+        self.idLength = 3 if header[2:3] in (b"N", b"n") else 4
+        self.contactLength = header[3] - 0x4A
+        self.entries = struct.unpack_from("<I", header, 8)[0]
+        self.area1Size = self.contactLength * ((AREA_1_SIZE - V1_HEADER_LENGTH) // self.contactLength)
+        self.slices = [0] * ID_SLICES
+        self.idsPerSlice = 0
+
+        if self.entries:
+            self.slices[0] = self.readId(0)
+            self.slices[-1] = self.readId(self.entries - 1)
+            if self.entries > MIN_ENTRIES_BEFORE_USING_SLICES:
+                self.idsPerSlice = self.entries // (ID_SLICES - 1)
+                for i in range(ID_SLICES - 2):
+                    self.slices[i + 1] = self.readId((self.idsPerSlice * i) + self.idsPerSlice)
+
+    def readContact(self, offset, length):
+        if offset >= self.area1Size:
+            return self.flash.read(self.area2Address + (offset - self.area1Size), length)
+        return self.flash.read(AREA_1_ADDRESS + V1_HEADER_LENGTH + offset, length)
+
+    def readId(self, position):
+        return int.from_bytes(self.readContact(self.contactLength * position, self.idLength), "little")
+
+    def readText(self, position):
+        data = self.readContact((self.contactLength * position) + self.idLength, self.contactLength - self.idLength)
+        return v1Unpack(data) if self.idLength == 3 else data.split(b"\x00")[0].decode("ascii")
+
+    def lookup(self, dmrId):
+        target = int2bcd(dmrId) if self.idLength == 4 else dmrId
+
+        if (self.entries == 0) or (target < self.slices[0]) or (target > self.slices[-1]):
+            return None
+
+        start, end = 0, self.entries - 1
+        if self.entries > MIN_ENTRIES_BEFORE_USING_SLICES:
+            for i in range(ID_SLICES - 1):
+                if (target >= self.slices[i]) and ((target <= self.slices[i + 1]) if (i == ID_SLICES - 2) else (target < self.slices[i + 1])):
+                    if target == self.slices[i]:
+                        return self.readText(self.idsPerSlice * i)
+                    start = self.idsPerSlice * i
+                    end = (self.entries - 1) if (i == ID_SLICES - 2) else (self.idsPerSlice * (i + 1))
+                    break
+
+        while start <= end:
+            current = (start + end) >> 1
+            value = self.readId(current)
+            if value < target:
+                start = current + 1
+            elif value > target:
+                end = current - 1
+            else:
+                return self.readText(current)
+
+        return None
+
+
+class V2Database:
+    def __init__(self, flash, area2Address):
+        self.flash = flash
+        self.area2Address = area2Address
+        fields = V2_HEADER.unpack(flash.read(AREA_1_ADDRESS, V2_HEADER.size))
+        _, self.entries, self.blocks, self.lastId, _, _, numSymbols, counts, symbols = fields
+        self.counts = list(counts)
+        self.symbols = list(symbols[:numSymbols])
+        self.dataOffset = v2DataOffset(self.blocks)
+        self.blocksArea1 = (AREA_1_SIZE - self.dataOffset) // V2_BLOCK_SIZE
+        # First ID of every indexCacheStep block, in RAM
+        self.indexCacheStep = (self.blocks + V2_INDEX_CACHE_SIZE - 1) // V2_INDEX_CACHE_SIZE
+        self.indexCache = [self.readBlockFirstIds(block, 1)[0] for block in range(0, self.blocks, self.indexCacheStep)]
+        self.cachedBlock = None  # [number, loaded data, first ID, first ID of the next block]
+
+    def readBlockFirstIds(self, block, count):
+        return list(struct.unpack("<{}I".format(count), self.flash.read(AREA_1_ADDRESS + V2_HEADER.size + (block * 4), count * 4)))
+
+    def blockAddress(self, block):
+        if block < self.blocksArea1:
+            return AREA_1_ADDRESS + self.dataOffset + (block * V2_BLOCK_SIZE)
+        return self.area2Address + ((block - self.blocksArea1) * V2_BLOCK_SIZE)
+
+    def findBlock(self, dmrId):
+        """ Block number, its first ID and the first ID of the next one """
+        if (self.cachedBlock is not None) and (self.cachedBlock[2] <= dmrId < self.cachedBlock[3]):
+            return self.cachedBlock[0], self.cachedBlock[2], self.cachedBlock[3]
+
+        # Last index cache entry <= dmrId, then its blocks index entries (and the next one), in a single read
+        start, end = 0, len(self.indexCache) - 1
+        while start < end:
+            current = (start + end + 1) >> 1
+            if self.indexCache[current] <= dmrId:
+                start = current
+            else:
+                end = current - 1
+
+        first = start * self.indexCacheStep
+        ids = self.readBlockFirstIds(first, min(self.indexCacheStep + 1, self.blocks - first))
+        if len(ids) == (self.blocks - first):
+            ids.append(self.lastId + 1)
+
+        start, end = 0, len(ids) - 2
+        while start < end:
+            current = (start + end + 1) >> 1
+            if ids[current] <= dmrId:
+                start = current
+            else:
+                end = current - 1
+
+        return first + start, ids[start], ids[start + 1]
+
+    def loadBlock(self, block, firstId, endId, length):
+        """ The block is read by chunks, as far as the records are decoded """
+        if (self.cachedBlock is None) or (self.cachedBlock[0] != block):
+            self.cachedBlock = [block, bytearray(), firstId, endId]
+
+        data = self.cachedBlock[1]
+        while len(data) < min(length, V2_BLOCK_SIZE):
+            chunk = min(V2_READ_CHUNK_SIZE, V2_BLOCK_SIZE - len(data))
+            data += self.flash.read(self.blockAddress(block) + len(data), chunk)
+
+        return data if len(data) >= length else None
+
+    def decodeText(self, data):
+        out = []
+        bitPos = 0
+        numBits = len(data) * 8
+
+        while len(out) < MAX_TEXT_LENGTH:
+            code = first = index = 0
+            symbol = -1
+            for length in range(1, V2_MAX_CODE_LENGTH + 1):
+                if bitPos >= numBits:
+                    break
+                count = self.counts[length]
+                code |= (data[bitPos >> 3] >> (7 - (bitPos & 7))) & 1
+                bitPos += 1
+                if code - count < first:
+                    symbol = self.symbols[index + (code - first)]
+                    break
+                index += count
+                first = (first + count) << 1
+                code <<= 1
+
+            if symbol <= 0:
+                break
+            out.append(chr(symbol))
+
+        return "".join(out)
+
+    def lookup(self, dmrId):
+        if (self.entries == 0) or (dmrId < self.indexCache[0]) or (dmrId > self.lastId):
+            return None
+
+        block, current, endId = self.findBlock(dmrId)
+        data = self.loadBlock(block, current, endId, 1)
+        pos = 1
+        textEnd = V2_BLOCK_SIZE
+
+        for _ in range(data[0]):
+            delta = shift = 0
+            while True:
+                data = self.loadBlock(block, current, endId, pos + 1)
+                b = data[pos]
+                pos += 1
+                delta |= (b & 0x7F) << shift
+                shift += 7
+                if not b & 0x80:
+                    break
+            current += delta
+            data = self.loadBlock(block, current, endId, pos + 1)
+            length = data[pos]
+            pos += 1
+            textEnd -= length
+            if current == dmrId:
+                if textEnd + length <= len(data):
+                    return self.decodeText(data[textEnd:textEnd + length])
+                return self.decodeText(self.flash.read(self.blockAddress(block) + textEnd, length))
+            if current > dmrId:
+                break
+
+        return None
+
+
+def runBenchmark(name, database, flash, entries, textLength, lookups, seed, verify):
+    rng = random.Random(seed)
+    present = [rng.choice(entries) for _ in range(lookups)]
+    idRange = (entries[0][0], entries[-1][0])
+    known = set(dmrId for dmrId, _ in entries)
+    missing = []
+    while len(missing) < lookups:
+        dmrId = rng.randint(*idRange)
+        if dmrId not in known:
+            missing.append(dmrId)
+
+    failures = 0
+    results = []
+    for label, ids in (("found", present), ("missing", missing)):
+        durations = []
+        transactions = 0
+        for item in ids:
+            dmrId = item[0] if isinstance(item, tuple) else item
+            flash.reset()
+            text = database.lookup(dmrId)
+            durations.append(flash.duration())
+            transactions += flash.transactions
+
+            if isinstance(item, tuple):
+                expected = item[1][:textLength].rstrip(" ")
+                if text != expected:
+                    failures += 1
+                    if verify:
+                        print("{}: {} mismatch \"{}\" != \"{}\"".format(name, dmrId, text, expected))
+            elif text is not None:
+                failures += 1
+
+        durations.sort()
+        results.append("{} {:.1f} transactions, mean {:.0f} us, p95 {:.0f} us".format(
+            label, transactions / len(ids), (sum(durations) / len(durations)) * 1e6, durations[int(len(durations) * 0.95)] * 1e6))
+
+    print("{:>14} | {}".format(name, " | ".join(results)))
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description="DMR ID database builder")
+    parser.add_argument("--csv", help="RadioID.net style CSV (RADIO_ID,CALLSIGN,FIRST_NAME,...)")
+    parser.add_argument("--text", help="record text format (default: \"{CALLSIGN} {FIRST_NAME}\")", default="{CALLSIGN} {FIRST_NAME}")
+    parser.add_argument("--synthetic", type=int, help="use synthetic entries instead of a CSV")
+    parser.add_argument("--format", choices=["v2", "v1", "v1n"], default="v2", help="database format (default: v2)")
+    parser.add_argument("--text-length", type=int, default=None, help="maximum text length (default: 50 for v2, 16 for v1)")
+    parser.add_argument("--overwrite-vp", action="store_true", help="use the voice prompts area as the second area")
+    parser.add_argument("-o", "--output", help="output files prefix (<prefix>_1.bin and <prefix>_2.bin)")
+    parser.add_argument("--flash-image", help="patch a Flash image (physical addresses)")
+    parser.add_argument("--benchmark", action="store_true", help="compare the lookups in the legacy and version 2 formats")
+    parser.add_argument("--lookups", type=int, default=2000, help="benchmark lookups count, for each of the found/missing cases")
+    parser.add_argument("--spi-rate", type=float, default=5.25, help="benchmark SPI clock, in MHz (default: 5.25)")
+    parser.add_argument("--spi-overhead", type=float, default=4.0, help="benchmark overhead of each SPI transaction, in us (default: 4)")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    if args.csv:
+        entries = loadCSV(args.csv, args.text)
+    elif args.synthetic:
+        entries = syntheticEntries(args.synthetic, args.seed)
+    else:
+        parser.print_usage()
+        sys.exit(-1)
+
+    if not entries:
+        print("No entries")
+        sys.exit(-1)
+
+    area2Address = VP_ADDRESS if args.overwrite_vp else AREA_2_ADDRESS
+    area2Size = VP_AREA_2_SIZE if args.overwrite_vp else AREA_2_SIZE
+
+    if args.benchmark:
+        v1TextLength = args.text_length or 16
+        v2TextLength = args.text_length or MAX_TEXT_LENGTH
+        failures = 0
+        print("{} entries in the source, text up to {} chars (legacy formats: {})".format(len(entries), v2TextLength, v1TextLength))
+
+        for name, build in (("Id (4 bytes)", lambda: buildV1(entries, v1TextLength, False, area2Size)),
+                            ("IdN (3 bytes)", lambda: buildV1(entries, v1TextLength, True, area2Size)),
+                            ("IDv2", lambda: buildV2(entries, v2TextLength, area2Size, args.overwrite_vp))):
+            area1, area2, stored = build()
+            flash = Flash(area1, area2, area2Address, (args.spi_rate * 1e6) / 8, args.spi_overhead * 1e-6)
+            database = V2Database(flash, area2Address) if name == "IDv2" else V1Database(flash, area2Address)
+            size = len(area1) + len(area2)
+            print("{:>14} | {} entries stored, {} KB, {:.1f} bytes per entry".format(name, stored, size // 1024, size / stored))
+            textLength = v2TextLength if name == "IDv2" else v1TextLength
+            failures += runBenchmark(name, database, flash, entries[:stored], textLength, args.lookups, args.seed, True)
+
+        sys.exit(-2 if failures else 0)
+
+    textLength = args.text_length or (MAX_TEXT_LENGTH if args.format == "v2" else 16)
+    if args.format == "v2":
+        area1, area2, stored = buildV2(entries, textLength, area2Size, args.overwrite_vp)
+    else:
+        area1, area2, stored = buildV1(entries, textLength, args.format == "v1n", area2Size)
+
+    print("{} of {} entries stored, {} + {} bytes".format(stored, len(entries), len(area1), len(area2)))
+
+    if args.output:
+        for suffix, data, address in (("_1", area1, AREA_1_ADDRESS), ("_2", area2, area2Address)):
+            if data:
+                with open(args.output + suffix + ".bin", "wb") as f:
+                    f.write(data)
+                print("{}{}.bin: write at 0x{:X}".format(args.output, suffix, address))
+
+    if args.flash_image:
+        with open(args.flash_image, "r+b") as f:
+            for data, address in ((area1, AREA_1_ADDRESS), (area2, area2Address)):
+                f.seek(address + FLASH_ADDRESS_OFFSET)
+                f.write(data)
+        print("{} patched".format(args.flash_image))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,309 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+#
+# Copyright (C) 2024 Daniel Caujolle-Bert, F1RMB
+#                    Roger Clark, VK3KYY / G4KYF
+#
+# GPS track log export (interfaces/gpsTrackLog.h).
+#
+# The radio generates the GPX or NMEA text on the fly, it's streamed with CPS read requests
+# ('R', area 12 (GPX) or 13 (NMEA), the address being the position in the stream).
+# The log can also be decoded from a Flash dump (the log area starts at 14MB on the 16MB Flash chips),
+# which also prints the storage statistics.
+#
+# Examples:
+#   gps_track_export.py -p /dev/ttyACM0 -o track.gpx
+#   gps_track_export.py -p /dev/ttyACM0 --format nmea -o track.nmea
+#   gps_track_export.py --image flash.bin --offset 0xE00000 -o track.gpx
+#
+######################### Error codes #########################
+#  0:  No error
+# -1:  Missing file
+# -2:  Unable to connect the radio
+# -3:  Transfer failure
+###############################################################
+
+import argparse
+import struct
+import sys
+import time
+
+CPS_ACCESS_GPS_TRACK_LOG_GPX = 12
+CPS_ACCESS_GPS_TRACK_LOG_NMEA = 13
+READ_CHUNK_SIZE = 1024
+
+# Keep in sync with application/include/interfaces/gpsTrackLog.h
+SECTOR_SIZE = 4096
+PAGE_SIZE = 256
+SECTOR_MAGIC = 0x314C5447
+SECTOR_HEADER_SIZE = 8
+KEYFRAME_SIZE = 19
+VARINT_MAX_SIZE = 5
+LOG_SIZE = 2 * 1024 * 1024
+
+TAG_SESSION = 0x01
+TAG_KEYFRAME = 0x02
+TAG_DELTA = 0x80
+TAG_ERASED = 0xFF
+
+DELTA_HAS_TIME = 0x01
+DELTA_HAS_ALTITUDE = 0x02
+DELTA_HAS_SPEED = 0x04
+DELTA_HAS_COURSE = 0x08
+
+
+class TransferError(Exception):
+    pass
+
+
+def readRadio(port, nmea):
+    try:
+        import serial
+    except ImportError:
+        raise TransferError("pyserial is needed to talk to a radio")
+
+    link = serial.Serial(port=port, baudrate=115200, timeout=5.0)
+    area = CPS_ACCESS_GPS_TRACK_LOG_NMEA if nmea else CPS_ACCESS_GPS_TRACK_LOG_GPX
+    data = bytearray()
+    start = time.time()
+
+    link.write(b"C\x00")  # CPS screen, the logging is stopped (and flushed)
+    link.read(1)
+
+    while True:
+        link.write(struct.pack(">cBIH", b"R", area, len(data), READ_CHUNK_SIZE))
+        header = link.read(3)
+        if (len(header) != 3) or (header[0:1] != b"R"):
+            raise TransferError("export failed at position {}".format(len(data)))
+
+        length = struct.unpack(">H", header[1:3])[0]
+        chunk = link.read(length)
+        if len(chunk) != length:
+            raise TransferError("timeout while waiting for the radio")
+
+        data += chunk
+        if length < READ_CHUNK_SIZE:
+            break
+
+    link.write(b"C\x05")  # Close
+    link.read(1)
+    link.write(b"C\x07")  # Restore the GPS mode, the logging restarts in a new track segment
+    link.read(1)
+
+    elapsed = time.time() - start
+    print("{} bytes exported in {:.1f} s".format(len(data), elapsed), file=sys.stderr)
+    return bytes(data)
+
+
+def getVarint(data, offset):
+    value = 0
+    shift = 0
+    while True:
+        byte = data[offset]
+        offset += 1
+        value |= (byte & 0x7F) << shift
+        shift += 7
+        if not (byte & 0x80):
+            return value, offset
+
+
+def getSignedVarint(data, offset):
+    value, offset = getVarint(data, offset)
+    return (value >> 1) ^ -(value & 1), offset
+
+
+def recordLength(page, offset):
+    tag = page[offset]
+    available = PAGE_SIZE - offset
+
+    if tag == TAG_SESSION:
+        return 1
+    if tag == TAG_KEYFRAME:
+        return KEYFRAME_SIZE if available >= KEYFRAME_SIZE else 0
+    if (tag & 0xF0) == TAG_DELTA:
+        length = 1
+        for _ in range(2 + bin(tag & 0x0F).count("1")):
+            varintLength = 0
+            while True:
+                if (length >= available) or (varintLength == VARINT_MAX_SIZE):
+                    return 0
+                varintLength += 1
+                length += 1
+                if not (page[offset + length - 1] & 0x80):
+                    break
+        return length
+    return 0
+
+
+def sectorSequence(log, sector):
+    magic, sequence = struct.unpack_from("<II", log, sector * SECTOR_SIZE)
+    return sequence if magic == SECTOR_MAGIC else None
+
+
+def decodeLog(log, stats):
+    """Yields None for a new track segment, or (time, latitude, longitude, altitude, speed, course) points, oldest first."""
+    sectors = len(log) // SECTOR_SIZE
+    newest = None
+    for sector in range(sectors):
+        sequence = sectorSequence(log, sector)
+        if (sequence is not None) and ((newest is None) or (0 < ((sequence - newest[1]) & 0xFFFFFFFF) < 0x80000000)):
+            newest = (sector, sequence)
+
+    if newest is None:
+        return
+
+    for i in range(sectors):
+        sector = (newest[0] + 1 + i) % sectors
+        if sectorSequence(log, sector) is None:
+            continue
+
+        stats["sectors"] += 1
+        point = None
+        for pageOffset in range(0, SECTOR_SIZE, PAGE_SIZE):
+            page = log[sector * SECTOR_SIZE + pageOffset:sector * SECTOR_SIZE + pageOffset + PAGE_SIZE]
+            offset = SECTOR_HEADER_SIZE if pageOffset == 0 else 0
+            end = False
+
+            while offset < PAGE_SIZE:
+                tag = page[offset]
+                if tag == TAG_ERASED:
+                    end = True
+                    break
+
+                length = recordLength(page, offset)
+                if length == 0:
+                    break  # Padding
+
+                stats["bytes"] += length
+                if tag == TAG_SESSION:
+                    yield None
+                elif tag == TAG_KEYFRAME:
+                    point = list(struct.unpack_from("<IiihHH", page, offset + 1))
+                    stats["points"] += 1
+                    yield tuple(point)
+                elif point is not None:
+                    p = offset + 1
+                    timeDelta = 1
+                    if tag & DELTA_HAS_TIME:
+                        timeDelta, p = getVarint(page, p)
+                    point[0] += timeDelta
+                    for field, flag in ((1, None), (2, None), (3, DELTA_HAS_ALTITUDE), (4, DELTA_HAS_SPEED), (5, DELTA_HAS_COURSE)):
+                        if (flag is None) or (tag & flag):
+                            delta, p = getSignedVarint(page, p)
+                            point[field] += delta
+                    stats["points"] += 1
+                    yield tuple(point)
+
+                offset += length
+
+            if end:
+                break
+
+
+def formatDegrees(value):
+    return "{}{}.{:05d}".format("-" if value < 0 else "", abs(value) // 100000, abs(value) % 100000)
+
+
+def formatGPX(items):
+    out = ['<?xml version="1.0" encoding="UTF-8"?>\n<gpx version="1.0" creator="OpenGD77" xmlns="http://www.topografix.com/GPX/1/0">\n<trk>\n']
+    segmentIsOpen = False
+
+    for item in items:
+        if item is None:
+            if segmentIsOpen:
+                out.append("</trkseg>\n")
+            segmentIsOpen = False
+            continue
+
+        t, latitude, longitude, altitude, speed, course = item
+        speed = (speed * 5144) // 10000
+        out.append('{}<trkpt lat="{}" lon="{}"><ele>{}</ele><time>{}</time><course>{}.{:02d}</course><speed>{}.{:02d}</speed></trkpt>\n'.format(
+            "" if segmentIsOpen else "<trkseg>\n", formatDegrees(latitude), formatDegrees(longitude), altitude,
+            time.strftime("%Y-%m-%dT%H:%M:%SZ", time.gmtime(t)), course // 100, course % 100, speed // 100, speed % 100))
+        segmentIsOpen = True
+
+    out.append("{}</trk>\n</gpx>\n".format("</trkseg>\n" if segmentIsOpen else ""))
+    return "".join(out).encode()
+
+
+def nmeaSentence(body):
+    checksum = 0
+    for c in body[1:]:
+        checksum ^= ord(c)
+    return "{}*{:02X}\r\n".format(body, checksum)
+
+
+def nmeaCoordinate(value, isLongitude):
+    minutes = (abs(value) % 100000) * 6
+    return "{:0{}d}{:02d}.{:04d},{}".format(abs(value) // 100000, 3 if isLongitude else 2, minutes // 10000, minutes % 10000,
+                                           ("W" if value < 0 else "E") if isLongitude else ("S" if value < 0 else "N"))
+
+
+def formatNMEA(items):
+    out = []
+    for item in items:
+        if item is None:
+            continue
+
+        t, latitude, longitude, altitude, speed, course = item
+        tm = time.gmtime(t)
+        hms = time.strftime("%H%M%S", tm)
+        position = "{},{}".format(nmeaCoordinate(latitude, False), nmeaCoordinate(longitude, True))
+        out.append(nmeaSentence("$GPRMC,{}.00,A,{},{}.{:02d},{}.{:02d},{},,,A".format(hms, position, speed // 100, speed % 100,
+                                                                                    course // 100, course % 100, time.strftime("%d%m%y", tm))))
+        out.append(nmeaSentence("$GPGGA,{}.00,{},1,,,{},M,,M,,".format(hms, position, altitude)))
+    return "".join(out).encode()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="GPS track log export")
+    parser.add_argument("-p", "--port", help="radio serial port (e.g. /dev/ttyACM0 or COM3).", default=None)
+    parser.add_argument("--image", help="decode the log from a Flash dump instead.", default=None)
+    parser.add_argument("--offset", help="(image) log area offset in the dump (default: 0xE00000).", type=lambda x: int(x, 0), default=0xE00000)
+    parser.add_argument("--size", help="(image) log area size (default: 2MB).", type=lambda x: int(x, 0), default=LOG_SIZE)
+    parser.add_argument("--format", help="output format (default: gpx).", choices=["gpx", "nmea"], default="gpx")
+    parser.add_argument("-o", "--output", help="output file (default: stdout).", default=None)
+    args = parser.parse_args()
+
+    if args.image:
+        try:
+            with open(args.image, "rb") as f:
+                f.seek(args.offset)
+                log = f.read(args.size)
+        except OSError as e:
+            print("Error: {}".format(e), file=sys.stderr)
+            return -1
+
+        stats = {"sectors": 0, "bytes": 0, "points": 0}
+        items = list(decodeLog(log, stats))
+        data = formatGPX(items) if args.format == "gpx" else formatNMEA(items)
+
+        if stats["points"]:
+            print("{} points in {} sectors, {:.2f} bytes per point ({} bytes as {})".format(
+                stats["points"], stats["sectors"], stats["bytes"] / stats["points"], len(data), args.format.upper()), file=sys.stderr)
+    else:
+        if args.port is None:
+            print("Error: a serial port or --image is needed", file=sys.stderr)
+            return -2
+
+        try:
+            data = readRadio(args.port, args.format == "nmea")
+        except TransferError as e:
+            print("Error: {}".format(e), file=sys.stderr)
+            return -3
+        except OSError as e:
+            print("Error: {}".format(e), file=sys.stderr)
+            return -2
+
+    if args.output:
+        with open(args.output, "wb") as f:
+            f.write(data)
+    else:
+        sys.stdout.buffer.write(data)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
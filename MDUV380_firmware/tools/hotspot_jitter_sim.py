@@ -0,0 +1,210 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+#
+# Copyright (C) 2024 Daniel Caujolle-Bert, F1RMB
+#                    Roger Clark, VK3KYY / G4KYF
+#
+# Host simulation of the hotspot network to RF TX buffering (functions/hotspot.c):
+# inter-arrival jitter estimator, adaptive prebuffering, and late/lost frames concealment
+# (previous frame repeated once, then silence).
+#
+# The network stream is either a recorded one (one arrival time in ms per line, e.g. the timestamps
+# of the DMR data frames written by MMDVMHost to the modem, first column of a CSV is used),
+# or synthetic transmissions with a jittered network delay and frame losses. Gaps longer than
+# 20 frames split the stream in transmissions, the jitter estimate is kept from one to the next.
+#
+# Examples:
+#   hotspot_jitter_sim.py --jitter 25 --loss 0.01 --streams 100
+#   hotspot_jitter_sim.py --arrivals capture.txt --sweep
+#
+# With --sweep, the adaptive prebuffering is compared against fixed prebuffering values,
+# to trade the added latency against the concealed frames.
+#
+
+import argparse
+import random
+import sys
+
+
+FRAME_PERIOD = 60              # ms, one DMR voice burst
+BUFFER_COUNT = 48              # HOTSPOT_BUFFER_COUNT
+PREBUFFER_MIN = 1              # TX_BUFFER_MIN_BEFORE_TRANSMISSION
+PREBUFFER_MAX = BUFFER_COUNT // 2
+JITTER_INITIAL = 60 << 4       # ms * 16
+STREAM_GAP = FRAME_PERIOD * 20  # longer gaps split the stream in transmissions
+
+
+class JitterEstimator:
+    def __init__(self):
+        self.jitter = JITTER_INITIAL
+        self.lastArrival = None
+
+    def arrival(self, now):
+        if self.lastArrival is not None:
+            interval = now - self.lastArrival
+            deviation = abs(interval - FRAME_PERIOD) << 4
+
+            if interval < (FRAME_PERIOD * 20):
+                if deviation > self.jitter:
+                    self.jitter += (deviation - self.jitter) // 4
+                else:
+                    self.jitter -= (self.jitter - deviation) // 16
+
+        self.lastArrival = now
+
+    def prebufferFrames(self):
+        frames = PREBUFFER_MIN + ((3 * self.jitter) + ((FRAME_PERIOD << 4) - 1)) // (FRAME_PERIOD << 4)
+        return max(PREBUFFER_MIN, min(frames, PREBUFFER_MAX))
+
+
+def playStream(arrivals, estimator, stats, delays, fixedPrebuffer):
+    queue = []
+    nextSlot = None
+    concealing = False
+    missing = 0
+    index = 0
+
+    while (index < len(arrivals)) or queue:
+        # Next event: frame arrival or TX slot
+        if (nextSlot is None) or ((index < len(arrivals)) and (arrivals[index] <= nextSlot)):
+            now = arrivals[index]
+            index += 1
+            estimator.arrival(now)
+
+            if len(queue) >= BUFFER_COUNT:
+                stats["dropped"] += 1
+                continue
+
+            if concealing:
+                stats["late"] += 1
+                concealing = False
+
+            stats["frames"] += 1
+            queue.append(now)
+
+            prebuffer = fixedPrebuffer if fixedPrebuffer is not None else estimator.prebufferFrames()
+            if (nextSlot is None) and (len(queue) > prebuffer):
+                nextSlot = now
+
+            # Stream shorter than the prebuffering
+            if (index >= len(arrivals)) and (nextSlot is None):
+                nextSlot = now
+        else:
+            if queue:
+                delays.append(nextSlot - queue.pop(0))
+                missing = 0
+            else:
+                stats["repeat" if missing == 0 else "silence"] += 1
+                missing += 1
+                concealing = True
+
+            nextSlot += FRAME_PERIOD
+
+
+def simulate(streams, fixedPrebuffer=None):
+    estimator = JitterEstimator()
+    stats = {"frames": 0, "late": 0, "dropped": 0, "repeat": 0, "silence": 0}
+    delays = []
+
+    for arrivals in streams:
+        playStream(arrivals, estimator, stats, delays, fixedPrebuffer)
+
+    delays.sort()
+    stats["jitterMs"] = estimator.jitter >> 4
+    stats["prebuffer"] = fixedPrebuffer if fixedPrebuffer is not None else estimator.prebufferFrames()
+    stats["meanDelay"] = (sum(delays) / len(delays)) if delays else 0
+    stats["p95Delay"] = delays[int(len(delays) * 0.95)] if delays else 0
+    stats["maxDelay"] = delays[-1] if delays else 0
+    return stats
+
+
+def syntheticStreams(numStreams, streamFrames, jitter, loss, seed):
+    rng = random.Random(seed)
+    streams = []
+    start = 0
+
+    for s in range(numStreams):
+        arrivals = []
+        previous = start
+
+        for i in range(streamFrames):
+            if rng.random() < loss:
+                continue
+
+            # Network delay: gaussian jitter, with occasional spikes
+            delay = max(0.0, rng.gauss(jitter, jitter))
+            if rng.random() < 0.01:
+                delay += jitter * 6
+
+            previous = max(previous, int(start + (i * FRAME_PERIOD) + delay)) # frames are delivered in order on the serial link
+            arrivals.append(previous)
+
+        streams.append(arrivals)
+        start = previous + STREAM_GAP
+
+    return streams
+
+
+def splitStreams(arrivals):
+    streams = [[]]
+
+    for arrival in arrivals:
+        if streams[-1] and ((arrival - streams[-1][-1]) >= STREAM_GAP):
+            streams.append([])
+        streams[-1].append(arrival)
+
+    return streams
+
+
+def loadArrivals(path):
+    arrivals = []
+
+    with open(path, "r") as f:
+        for line in f:
+            line = line.strip()
+            if line and not line.startswith("#"):
+                arrivals.append(int(float(line.split(",")[0])))
+
+    arrivals.sort()
+    return arrivals
+
+
+def printStats(label, stats):
+    print("{:>10} | prebuffer {:2d} | delay mean {:6.1f} p95 {:5d} max {:5d} ms | late {:4d} dropped {:4d} repeated {:4d} silence {:4d}".format(
+        label, stats["prebuffer"], stats["meanDelay"], stats["p95Delay"], stats["maxDelay"],
+        stats["late"], stats["dropped"], stats["repeat"], stats["silence"]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Hotspot network to RF TX buffering simulation")
+    parser.add_argument("--arrivals", help="recorded arrival times (ms), one per line")
+    parser.add_argument("--streams", type=int, default=40, help="synthetic transmissions count")
+    parser.add_argument("--frames", type=int, default=50, help="synthetic transmission length (frames)")
+    parser.add_argument("--jitter", type=float, default=20.0, help="synthetic network jitter (ms)")
+    parser.add_argument("--loss", type=float, default=0.0, help="synthetic frame loss ratio")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--fixed", type=int, help="use a fixed prebuffering (frames) instead of the adaptive one")
+    parser.add_argument("--sweep", action="store_true", help="compare the adaptive prebuffering with fixed values")
+    args = parser.parse_args()
+
+    if args.arrivals:
+        streams = splitStreams(loadArrivals(args.arrivals))
+    else:
+        streams = syntheticStreams(args.streams, args.frames, args.jitter, args.loss, args.seed)
+
+    if not streams[0]:
+        print("No frames")
+        sys.exit(-1)
+
+    if args.sweep:
+        for prebuffer in range(0, 11):
+            printStats("fixed", simulate(streams, prebuffer))
+
+    stats = simulate(streams, args.fixed)
+    printStats("fixed" if args.fixed is not None else "adaptive", stats)
+    print("jitter estimate: {} ms, frames: {}".format(stats["jitterMs"], stats["frames"]))
+
+
+if __name__ == "__main__":
+    main()
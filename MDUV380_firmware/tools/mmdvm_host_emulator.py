@@ -0,0 +1,527 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+#
+# Copyright (C) 2024 Daniel Caujolle-Bert, F1RMB
+#                    Roger Clark, VK3KYY / G4KYF
+#
+# MMDVMHost stand-in, to exercise the hotspot mode of the OpenGD77 STM32 firmwares (functions/hotspot.c)
+# without MMDVMHost, and catch protocol or performance regressions.
+#
+# It talks to the radio over the CDC serial port (needs pyserial), and runs scripted scenarios:
+#  - conformance: version/status/config/mode/frequency/QSO info exchanges, including invalid requests,
+#                 and asserts on the ACK/NAK and reply contents.
+#  - voice:       network to RF voice transmissions (Voice LC header, voice bursts at the 60ms DMR rate,
+#                 terminator), polling the status like MMDVMHost does. It reports the TX on/off timings
+#                 from the status replies and the TX buffer high-water mark.
+#  - flood:       pushes voice bursts as fast as the modem accepts them (DMR space from the status),
+#                 and reports the frames per second and round-trip times.
+#  - listen:      RF to network direction, counts the DMR frames sent by the radio while something is
+#                 transmitting on the hotspot frequency/colour code.
+#
+# Examples:
+#   mmdvm_host_emulator.py -p /dev/ttyACM0 --scenario conformance
+#   mmdvm_host_emulator.py -p /dev/ttyACM0 --scenario voice --streams 5 --frames 100 --jitter 20
+#   mmdvm_host_emulator.py -p /dev/ttyACM0 --scenario listen --duration 30
+#
+# The radio has to be in hotspot mode (MMDVM), it transmits during the voice and flood scenarios:
+# use a dummy load, and a frequency you are allowed to transmit on.
+#
+# The same scenarios run without a radio in the host build (host/tests/testHotspot.c, "make test"),
+# against emulated HR-C6000, trx and USB layers.
+#
+######################### Error codes #########################
+#  0:  No error
+# -2:  Unable to connect the radio
+# -3:  Protocol failure (at least one check failed)
+###############################################################
+
+import argparse
+import random
+import sys
+import threading
+import time
+
+
+MMDVM_FRAME_START = 0xE0
+MMDVM_GET_VERSION = 0x00
+MMDVM_GET_STATUS = 0x01
+MMDVM_SET_CONFIG = 0x02
+MMDVM_SET_MODE = 0x03
+MMDVM_SET_FREQ = 0x04
+MMDVM_DMR_DATA2 = 0x1A
+MMDVM_DMR_LOST2 = 0x1B
+MMDVM_DMR_SHORTLC = 0x1C
+MMDVM_DMR_START = 0x1D
+MMDVM_ACK = 0x70
+MMDVM_NAK = 0x7F
+MMDVM_QSO_INFO = 0x91
+
+STATE_IDLE = 0
+STATE_DMR = 2
+STATE_DSTAR = 1
+
+DT_VOICE_LC_HEADER = 0x01
+DT_TERMINATOR_WITH_LC = 0x02
+MMDVM_DATA_SYNC = 0x40
+MMDVM_VOICE_SYNC = 0x20
+
+FRAME_PERIOD = 0.060   # one DMR voice burst
+STATUS_PERIOD = 0.250  # MMDVMHost polls the status every 250ms
+HOTSPOT_BUFFER_COUNT = 48
+
+AMBE_SILENCE = bytes([0xB9, 0xE8, 0x81, 0x52, 0x61, 0x73, 0x00, 0x2A, 0x6B, 0xB9, 0xE8, 0x81, 0x52,
+                      0x61, 0x73, 0x00, 0x2A, 0x6B, 0xB9, 0xE8, 0x81, 0x52, 0x61, 0x73, 0x00, 0x2A, 0x6B])
+BS_VOICE_SYNC = 0x755FD7DF75F7
+BS_DATA_SYNC = 0xDFF57D75DF5D
+VOICE_LC_HEADER_CRC_MASK = bytes([0x96, 0x96, 0x96])
+TERMINATOR_WITH_LC_CRC_MASK = bytes([0x99, 0x99, 0x99])
+
+
+class ProtocolError(Exception):
+    pass
+
+
+#
+# DMR full LC encoding (ETSI TS 102 361-1): RS(12,9) + BPTC(196,96), as done by DMRFullLC_encode()
+#
+GF_EXP = [0] * 512
+GF_LOG = [0] * 256
+
+def _gfInit():
+    x = 1
+    for i in range(255):
+        GF_EXP[i] = x
+        GF_LOG[x] = i
+        x <<= 1
+        if x & 0x100:
+            x ^= 0x11D
+    for i in range(255, 512):
+        GF_EXP[i] = GF_EXP[i - 255]
+
+_gfInit()
+
+
+def _gfMult(a, b):
+    if (a == 0) or (b == 0):
+        return 0
+    return GF_EXP[GF_LOG[a] + GF_LOG[b]]
+
+
+def reedSolomon129(data):
+    factors = (64, 56, 14)
+    parity = [0, 0, 0]
+    for i in range(9):
+        tmp = data[i] ^ parity[2]
+        parity[2] = parity[1] ^ _gfMult(factors[2], tmp)
+        parity[1] = parity[0] ^ _gfMult(factors[1], tmp)
+        parity[0] = _gfMult(factors[0], tmp)
+    return parity
+
+
+def _bits(data):
+    return [((b >> (7 - i)) & 1) for b in data for i in range(8)]
+
+
+def _bytes(bits):
+    return bytes(sum(bit << (7 - i) for i, bit in enumerate(bits[n:n + 8])) for n in range(0, len(bits), 8))
+
+
+def bptc19696Encode(lcData):
+    ranges = ((4, 11), (16, 26), (31, 41), (46, 56), (61, 71), (76, 86), (91, 101), (106, 116), (121, 131))
+    bits = _bits(lcData)
+    deInterleaved = [0] * 196
+    position = 0
+
+    for start, end in ranges:
+        for a in range(start, end + 1):
+            deInterleaved[a] = bits[position]
+            position += 1
+
+    # Hamming (15,11,3) rows
+    for i in range(9):
+        r = deInterleaved[(i * 15) + 1:(i * 15) + 16]
+        r[11] = r[0] ^ r[1] ^ r[2] ^ r[3] ^ r[5] ^ r[7] ^ r[8]
+        r[12] = r[1] ^ r[2] ^ r[3] ^ r[4] ^ r[6] ^ r[8] ^ r[9]
+        r[13] = r[2] ^ r[3] ^ r[4] ^ r[5] ^ r[7] ^ r[9] ^ r[10]
+        r[14] = r[0] ^ r[1] ^ r[2] ^ r[4] ^ r[6] ^ r[7] ^ r[10]
+        deInterleaved[(i * 15) + 1:(i * 15) + 16] = r
+
+    # Hamming (13,9,3) columns
+    for i in range(15):
+        c = [deInterleaved[i + 1 + (j * 15)] for j in range(13)]
+        c[9] = c[0] ^ c[1] ^ c[3] ^ c[5] ^ c[6]
+        c[10] = c[0] ^ c[1] ^ c[2] ^ c[4] ^ c[6] ^ c[7]
+        c[11] = c[0] ^ c[1] ^ c[2] ^ c[3] ^ c[5] ^ c[7] ^ c[8]
+        c[12] = c[0] ^ c[2] ^ c[4] ^ c[5] ^ c[8]
+        for j in range(13):
+            deInterleaved[i + 1 + (j * 15)] = c[j]
+
+    raw = [0] * 196
+    for i in range(196):
+        raw[(i * 181) % 196] = deInterleaved[i]
+
+    # Info bits go around the 48 bits sync/slot type of the 33 bytes burst
+    burst = bytearray(33)
+    burst[0:13] = _bytes(raw[0:96] + [0] * 8)[0:13]
+    byteData = _bytes(raw[96:100] + [0] * 4)[0]
+    burst[12] = (burst[12] & 0x3F) | (byteData & 0xC0)
+    burst[20] = (burst[20] & 0xFC) | ((byteData >> 4) & 0x03)
+    burst[21:33] = _bytes(raw[100:196])
+    return burst
+
+
+def fullLC(srcId, dstId, privateCall, dataType):
+    lc = bytearray(12)
+    lc[0] = 0x03 if privateCall else 0x00
+    lc[3:6] = dstId.to_bytes(3, "big")
+    lc[6:9] = srcId.to_bytes(3, "big")
+    parity = reedSolomon129(lc)
+    mask = VOICE_LC_HEADER_CRC_MASK if (dataType == DT_VOICE_LC_HEADER) else TERMINATOR_WITH_LC_CRC_MASK
+    lc[9] = parity[2] ^ mask[0]
+    lc[10] = parity[1] ^ mask[1]
+    lc[11] = parity[0] ^ mask[2]
+    return lc
+
+
+def _setSync(burst, sync):
+    syncBytes = (sync << 4).to_bytes(7, "big") # 48 bits, starting at the low nibble of byte 13
+    burst[13] = (burst[13] & 0xF0) | (syncBytes[0] & 0x0F)
+    burst[14:19] = syncBytes[1:6]
+    burst[19] = (burst[19] & 0x0F) | (syncBytes[6] & 0xF0)
+
+
+def dataBurst(srcId, dstId, privateCall, dataType):
+    burst = bptc19696Encode(fullLC(srcId, dstId, privateCall, dataType))
+    _setSync(burst, BS_DATA_SYNC)
+    return mmdvmFrame(MMDVM_DMR_DATA2, bytes([MMDVM_DATA_SYNC | dataType]) + bytes(burst))
+
+
+def voiceBurst(sequence, ambe=AMBE_SILENCE):
+    burst = bytearray(33)
+    burst[0:13] = ambe[0:13]
+    burst[13] = ambe[13] & 0xF0
+    burst[19] = ambe[13] & 0x0F
+    burst[20:33] = ambe[14:27]
+    if sequence == 0:
+        _setSync(burst, BS_VOICE_SYNC)
+    # Null embedded signalling for the B to F bursts, the LC comes from the header
+    return mmdvmFrame(MMDVM_DMR_DATA2, bytes([MMDVM_VOICE_SYNC if (sequence == 0) else sequence]) + bytes(burst))
+
+
+def mmdvmFrame(command, payload=b""):
+    return bytes([MMDVM_FRAME_START, 3 + len(payload), command]) + payload
+
+
+#
+# Link
+#
+class ModemLink(object):
+    def __init__(self, port):
+        try:
+            import serial
+        except ImportError:
+            raise ProtocolError("pyserial is needed to talk to a radio")
+        self.serial = serial.Serial(port=port, baudrate=115200, timeout=0.05)
+        self.lock = threading.Condition()
+        self.frames = []
+        self.running = True
+        self.received = {}
+        self.reader = threading.Thread(target=self._readLoop, daemon=True)
+        self.reader.start()
+
+    def close(self):
+        self.running = False
+        self.reader.join()
+        self.serial.close()
+
+    def _readLoop(self):
+        buffer = bytearray()
+        while self.running:
+            buffer += self.serial.read(512)
+            while len(buffer) >= 3:
+                if buffer[0] != MMDVM_FRAME_START:
+                    del buffer[0]
+                    continue
+                if len(buffer) < buffer[1]:
+                    break
+                frame = bytes(buffer[0:buffer[1]])
+                del buffer[0:buffer[1]]
+                with self.lock:
+                    self.received[frame[2]] = self.received.get(frame[2], 0) + 1
+                    self.frames.append((time.monotonic(), frame))
+                    self.lock.notify_all()
+
+    def send(self, frame):
+        self.serial.write(frame)
+
+    def waitFor(self, commands, timeout=1.0):
+        """ Wait for the next reply which command is in commands, the other frames are kept """
+        deadline = time.monotonic() + timeout
+        with self.lock:
+            while True:
+                for index, (stamp, frame) in enumerate(self.frames):
+                    if frame[2] in commands:
+                        del self.frames[index]
+                        return stamp, frame
+                remaining = deadline - time.monotonic()
+                if remaining <= 0:
+                    raise ProtocolError("no reply from the modem (waiting for {})".format(["0x{:02X}".format(c) for c in commands]))
+                self.lock.wait(remaining)
+
+    def drain(self, command=None):
+        with self.lock:
+            drained = [f for f in self.frames if (command is None) or (f[1][2] == command)]
+            self.frames = [f for f in self.frames if not ((command is None) or (f[1][2] == command))]
+            return drained
+
+    def request(self, command, payload=b"", timeout=1.0):
+        """ Send a request and wait for its reply (ACK/NAK or the same command) """
+        sent = time.monotonic()
+        self.send(mmdvmFrame(command, payload))
+        stamp, frame = self.waitFor((command, MMDVM_ACK, MMDVM_NAK), timeout)
+        return frame, stamp - sent
+
+
+#
+# Scenarios
+#
+class Checks(object):
+    def __init__(self):
+        self.failures = 0
+        self.count = 0
+
+    def check(self, condition, text):
+        self.count += 1
+        if not condition:
+            self.failures += 1
+        print("  [{}] {}".format("PASS" if condition else "FAIL", text))
+
+
+def status(link):
+    frame, rtt = link.request(MMDVM_GET_STATUS)
+    if (frame[2] != MMDVM_GET_STATUS) or (len(frame) < 13):
+        raise ProtocolError("invalid status reply")
+    return {"modes": frame[3], "state": frame[4], "tx": bool(frame[5] & 0x01), "rxOverflow": bool(frame[5] & 0x04),
+            "txOverflow": bool(frame[5] & 0x08), "dmrSpace": frame[8], "rtt": rtt}
+
+
+def configPayload(mode=STATE_DMR, colourCode=1, txDelay=10):
+    payload = bytearray(17)
+    payload[0] = 0x00      # flags
+    payload[1] = 0x02      # DMR enabled
+    payload[2] = txDelay   # 10ms units
+    payload[3] = mode
+    payload[6] = colourCode
+    return bytes(payload)
+
+
+def freqPayload(rxHz, txHz, power=255):
+    return bytes([0]) + rxHz.to_bytes(4, "little") + txHz.to_bytes(4, "little") + bytes([power])
+
+
+def expectAck(checks, link, command, payload, text):
+    frame, rtt = link.request(command, payload)
+    checks.check((frame[2] == MMDVM_ACK) and (frame[3] == command), "{} -> ACK ({:.1f} ms)".format(text, rtt * 1000))
+
+
+def expectNak(checks, link, command, payload, text):
+    frame, rtt = link.request(command, payload)
+    checks.check((frame[2] == MMDVM_NAK) and (frame[3] == command), "{} -> NAK".format(text))
+
+
+def scenarioConformance(link, args, checks):
+    print("Conformance")
+    frame, rtt = link.request(MMDVM_GET_VERSION)
+    checks.check((frame[2] == MMDVM_GET_VERSION) and (frame[3] == 1), "GET_VERSION, protocol version 1 ({:.1f} ms)".format(rtt * 1000))
+    print("    {}".format(frame[4:].decode("ascii", "replace")))
+
+    st = status(link)
+    checks.check(st["modes"] & 0x02, "GET_STATUS, DMR enabled ({:.1f} ms)".format(st["rtt"] * 1000))
+    checks.check(st["dmrSpace"] <= HOTSPOT_BUFFER_COUNT, "GET_STATUS, DMR space {}".format(st["dmrSpace"]))
+
+    expectAck(checks, link, MMDVM_SET_CONFIG, configPayload(colourCode=args.colour_code), "SET_CONFIG, DMR")
+    expectNak(checks, link, MMDVM_SET_CONFIG, configPayload()[0:8], "SET_CONFIG, too short")
+    expectNak(checks, link, MMDVM_SET_CONFIG, configPayload(colourCode=16), "SET_CONFIG, invalid colour code")
+    expectNak(checks, link, MMDVM_SET_CONFIG, configPayload(mode=STATE_DSTAR), "SET_CONFIG, unsupported mode")
+    expectAck(checks, link, MMDVM_SET_FREQ, freqPayload(args.frequency, args.frequency, args.power), "SET_FREQ {} Hz".format(args.frequency))
+    expectNak(checks, link, MMDVM_SET_FREQ, freqPayload(145900000, 145900000), "SET_FREQ, satellite band")
+    expectNak(checks, link, MMDVM_SET_MODE, bytes([STATE_DSTAR]), "SET_MODE, unsupported mode")
+    expectAck(checks, link, MMDVM_SET_MODE, bytes([STATE_DMR]), "SET_MODE, DMR")
+    expectAck(checks, link, MMDVM_SET_MODE, bytes([STATE_IDLE]), "SET_MODE, IDLE")
+    expectAck(checks, link, MMDVM_SET_MODE, bytes([STATE_DMR]), "SET_MODE, DMR again")
+
+    st = status(link)
+    checks.check(st["state"] == STATE_DMR, "GET_STATUS, modem state DMR")
+
+    frame, rtt = link.request(0x55)
+    checks.check((frame[2] == MMDVM_NAK) and (frame[3] == 0x55), "unknown command -> NAK")
+
+
+def sendVoiceStream(link, args, frames, srcId, dstId, pacing=True):
+    """ Send a transmission, polling the status at MMDVMHost rate. Returns the timings """
+    result = {"txOn": None, "txOff": None, "minSpace": HOTSPOT_BUFFER_COUNT, "naks": 0, "statusRtt": [], "overflow": False}
+    queue = [dataBurst(srcId, dstId, args.private, DT_VOICE_LC_HEADER)]
+    queue += [voiceBurst(i % 6) for i in range(frames)]
+    queue += [dataBurst(srcId, dstId, args.private, DT_TERMINATOR_WITH_LC)]
+
+    start = time.monotonic()
+    nextStatus = start
+    deadline = start + (len(queue) * FRAME_PERIOD) + 10.0
+
+    for index, frame in enumerate(queue):
+        due = start + (index * FRAME_PERIOD)
+        if pacing and (args.jitter > 0):
+            due += max(0.0, random.gauss(0, args.jitter / 1000.0))
+
+        while True:
+            now = time.monotonic()
+            if now >= nextStatus:
+                st = status(link)
+                result["statusRtt"].append(st["rtt"])
+                result["minSpace"] = min(result["minSpace"], st["dmrSpace"])
+                result["overflow"] |= st["txOverflow"]
+                if st["tx"] and (result["txOn"] is None):
+                    result["txOn"] = now - start
+                nextStatus += STATUS_PERIOD
+            if (not pacing) or (now >= due):
+                break
+            time.sleep(min(due - now, nextStatus - now, 0.005))
+
+        link.send(frame)
+        if not pacing:
+            # Stay below the modem capacity, as MMDVMHost does from the DMR space
+            while status(link)["dmrSpace"] < 2:
+                pass
+
+    lastFrame = time.monotonic()
+    while time.monotonic() < deadline:
+        st = status(link)
+        now = time.monotonic()
+        result["minSpace"] = min(result["minSpace"], st["dmrSpace"])
+        if st["tx"] and (result["txOn"] is None):
+            result["txOn"] = now - start
+        if (not st["tx"]) and (result["txOn"] is not None):
+            result["txOff"] = now - lastFrame
+            break
+        time.sleep(STATUS_PERIOD)
+
+    for stamp, frame in link.drain(MMDVM_NAK):
+        result["naks"] += 1
+    link.drain(MMDVM_ACK)
+    result["duration"] = lastFrame - start
+    result["fps"] = len(queue) / result["duration"]
+    return result
+
+
+def _printStream(index, r):
+    rtt = sorted(r["statusRtt"]) if r["statusRtt"] else [0]
+    print("  stream {}: {:.1f} frames/s, TX on after {}, TX off {} after the last frame, buffer high-water {}/{}, status RTT median {:.1f} ms max {:.1f} ms, {} NAK".format(
+        index, r["fps"],
+        "{:.0f} ms".format(r["txOn"] * 1000) if r["txOn"] is not None else "never",
+        "{:.0f} ms".format(r["txOff"] * 1000) if r["txOff"] is not None else "never",
+        HOTSPOT_BUFFER_COUNT - r["minSpace"], HOTSPOT_BUFFER_COUNT,
+        rtt[len(rtt) // 2] * 1000, rtt[-1] * 1000, r["naks"]))
+
+
+def _prepareDMR(link, args, checks):
+    expectAck(checks, link, MMDVM_SET_FREQ, freqPayload(args.frequency, args.frequency, args.power), "SET_FREQ {} Hz".format(args.frequency))
+    expectAck(checks, link, MMDVM_SET_CONFIG, configPayload(colourCode=args.colour_code), "SET_CONFIG, DMR")
+    expectAck(checks, link, MMDVM_SET_MODE, bytes([STATE_DMR]), "SET_MODE, DMR")
+
+
+def scenarioVoice(link, args, checks):
+    print("Voice, network to RF ({} streams of {} frames, {} ms jitter)".format(args.streams, args.frames, args.jitter))
+    _prepareDMR(link, args, checks)
+
+    for i in range(args.streams):
+        r = sendVoiceStream(link, args, args.frames, args.src_id, args.dst_id)
+        _printStream(i, r)
+        checks.check(r["txOn"] is not None, "stream {}: the radio transmitted".format(i))
+        checks.check(r["naks"] == 0, "stream {}: no NAK".format(i))
+        checks.check(not r["overflow"], "stream {}: no TX overflow".format(i))
+        time.sleep(args.gap)
+
+
+def scenarioFlood(link, args, checks):
+    print("Flood, network to RF ({} frames, no pacing)".format(args.frames))
+    _prepareDMR(link, args, checks)
+
+    r = sendVoiceStream(link, args, args.frames, args.src_id, args.dst_id, pacing=False)
+    _printStream(0, r)
+    checks.check(r["naks"] == 0, "no NAK")
+
+
+def scenarioListen(link, args, checks):
+    print("Listen, RF to network ({} s)".format(args.duration))
+    _prepareDMR(link, args, checks)
+
+    link.drain()
+    end = time.monotonic() + args.duration
+    streams = []
+    lost = 0
+    nextStatus = time.monotonic()
+
+    while time.monotonic() < end:
+        if time.monotonic() >= nextStatus:
+            status(link)
+            nextStatus += STATUS_PERIOD
+        for stamp, frame in link.drain():
+            if frame[2] == MMDVM_DMR_DATA2:
+                if (not streams) or ((stamp - streams[-1][-1]) > 1.0):
+                    streams.append([])
+                streams[-1].append(stamp)
+            elif frame[2] == MMDVM_DMR_LOST2:
+                lost += 1
+        time.sleep(0.01)
+
+    for i, stamps in enumerate(streams):
+        duration = (stamps[-1] - stamps[0]) if len(stamps) > 1 else 0
+        intervals = [b - a for a, b in zip(stamps, stamps[1:])]
+        print("  stream {}: {} frames, {:.1f} frames/s, max inter-frame gap {:.0f} ms".format(
+            i, len(stamps), (len(stamps) - 1) / duration if duration else 0, max(intervals) * 1000 if intervals else 0))
+    print("  {} stream(s), {} DMR lost".format(len(streams), lost))
+
+
+SCENARIOS = {"conformance": scenarioConformance, "voice": scenarioVoice, "flood": scenarioFlood, "listen": scenarioListen}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="MMDVMHost stand-in for the OpenGD77 hotspot mode")
+    parser.add_argument("-p", "--port", required=True, help="CDC serial port of the radio")
+    parser.add_argument("--scenario", action="append", choices=sorted(SCENARIOS.keys()), help="scenario(s) to run (default: conformance)")
+    parser.add_argument("--frequency", type=int, default=439000000, help="RX/TX frequency (Hz)")
+    parser.add_argument("--power", type=int, default=0, help="RF power (0..255)")
+    parser.add_argument("--colour-code", type=int, default=1)
+    parser.add_argument("--src-id", type=int, default=1234567)
+    parser.add_argument("--dst-id", type=int, default=9)
+    parser.add_argument("--private", action="store_true", help="private call instead of a talkgroup call")
+    parser.add_argument("--streams", type=int, default=3, help="voice transmissions count")
+    parser.add_argument("--frames", type=int, default=60, help="voice bursts per transmission")
+    parser.add_argument("--jitter", type=float, default=0.0, help="network jitter added to the voice bursts (ms)")
+    parser.add_argument("--gap", type=float, default=2.0, help="delay between transmissions (s)")
+    parser.add_argument("--duration", type=float, default=30.0, help="listen duration (s)")
+    args = parser.parse_args()
+
+    try:
+        link = ModemLink(args.port)
+    except Exception as e:
+        print("Unable to connect the radio: {}".format(e))
+        sys.exit(-2)
+
+    checks = Checks()
+    try:
+        for scenario in (args.scenario or ["conformance"]):
+            SCENARIOS[scenario](link, args, checks)
+        link.request(MMDVM_SET_MODE, bytes([STATE_IDLE]))
+    except ProtocolError as e:
+        checks.check(False, str(e))
+    finally:
+        link.close()
+
+    print("{}/{} checks passed".format(checks.count - checks.failures, checks.count))
+    sys.exit(-3 if checks.failures else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,597 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+#
+# Copyright (C) 2024 Daniel Caujolle-Bert, F1RMB
+#                    Roger Clark, VK3KYY / G4KYF
+#
+# Reference client for the pipelined CPS transfers ('P' command) of the OpenGD77 STM32 firmwares.
+#
+# It can talk to a radio (CDC serial port, through pyserial, or directly on POSIX systems), to the host
+# simulator (MDUV380_firmware/host, "mduv380_host --usb" runs usb_com.c behind a pseudo terminal),
+# or to a simulated radio (--loopback). The latter is a Python model of usb_com.c, over a Flash image
+# with erase/program semantics and a timing model of the USB link and the SPI Flash, in order to compare
+# the legacy stop-and-wait transfer with the pipelined one (KB/s).
+#
+# The serial port handling is its own: opengd77_stm32_firmware_loader.py only talks to the DFU bootloader (pyusb).
+#
+# Examples:
+#   opengd77_cps_transfer.py --loopback --compare -i codeplug.bin -a 0x0
+#   opengd77_cps_transfer.py -p /dev/ttyACM0 -i DMRIDs.bin -a 0x30000 --verify
+#   opengd77_cps_transfer.py -p /dev/ttyACM0 -i codeplug.bin -a 0x0 --sync
+#   opengd77_cps_transfer.py -p /dev/pts/3 -i codeplug.bin -a 0x0 --verify   (mduv380_host --usb)
+#
+# With --sync, the CRC32 of each sector is first fetched from the radio (digest request, protocol version 2),
+# then only the sectors which differ are written.
+#
+######################### Error codes #########################
+#  0:  No error
+# -1:  Missing file
+# -2:  Unable to connect the radio
+# -3:  Transfer failure
+# -4:  Verification failure
+###############################################################
+
+import argparse
+import os
+import select
+import struct
+import sys
+import time
+import zlib
+from collections import deque
+
+
+PIPELINE_HEADER = struct.Struct(">cBHIHI")       # 'P', op, sequence, address, length, crc32
+PIPELINE_REPLY_HEADER = struct.Struct(">cBHBH")  # 'P', op, sequence, status, length
+
+OP_OPEN = 0
+OP_WRITE_FLASH = 1
+OP_COMMIT = 2
+OP_READ_FLASH = 3
+OP_DIGEST = 4
+
+STATUS_OK = 0
+STATUS_SEQUENCE_ERROR = 1
+STATUS_CRC_ERROR = 2
+STATUS_BAD_REQUEST = 3
+STATUS_FLASH_ERROR = 4
+STATUS_NAMES = ["OK", "SEQUENCE_ERROR", "CRC_ERROR", "BAD_REQUEST", "FLASH_ERROR"]
+
+SECTOR_SIZE = 4096
+PAGE_SIZE = 256
+LEGACY_MAX_DATA_LENGTH = 1024   # what the CPS uses with the 'X' command
+MAX_DIGEST_RANGES = 128
+DIGEST_RANGE = struct.Struct(">II")
+
+
+class TransferError(Exception):
+    pass
+
+
+def crc32(data):
+    return zlib.crc32(data) & 0xFFFFFFFF
+
+
+def pipelineRequest(op, sequence, address=0, length=0, payload=b""):
+    return PIPELINE_HEADER.pack(b"P", op, sequence & 0xFFFF, address, length, crc32(payload)) + payload
+
+
+#
+# Simulated radio, mirrors usb_com.c
+#
+class SimulatedRadio(object):
+    def __init__(self, image, usbLatency, usbBytesPerSecond, eraseTime, pageProgramTime, readBytesPerSecond):
+        self.flash = bytearray(image)
+        self.usbLatency = usbLatency
+        self.usbBytesPerSecond = usbBytesPerSecond
+        self.eraseTime = eraseTime
+        self.pageProgramTime = pageProgramTime
+        self.readBytesPerSecond = readBytesPerSecond
+        self.sector = -1
+        self.sectorBuffer = bytearray(SECTOR_SIZE)
+        self.modifiedPages = 0
+        self.needsErase = False
+        self.pipelineIsOpen = False
+        self.nextSequence = 0
+        self.stats = [0, 0, 0]  # erased, programmed only, unchanged
+        self.busyTime = 0.0     # processing time of the last request
+        self.legacyCompare = False  # legacy firmwares always erase and program the whole sector with 'X'
+
+    def _read(self, address, length):
+        self.busyTime += length / self.readBytesPerSecond
+        return bytes(self.flash[address:address + length])
+
+    def _loadSector(self, sector):
+        self.sector = sector
+        self.modifiedPages = 0
+        self.needsErase = False
+        self.sectorBuffer[:] = self._read(sector * SECTOR_SIZE, SECTOR_SIZE)
+        return True
+
+    def _stage(self, address, data):
+        for i, value in enumerate(data):
+            if ((address + i) // SECTOR_SIZE) != self.sector:
+                continue
+            offset = (address + i) % SECTOR_SIZE
+            previous = self.sectorBuffer[offset]
+            if previous != value:
+                self.modifiedPages |= (1 << (offset // PAGE_SIZE))
+                if (previous & value) != value:
+                    self.needsErase = True
+                self.sectorBuffer[offset] = value
+
+    def _commit(self, compareBeforeErase=True):
+        base = self.sector * SECTOR_SIZE
+        if compareBeforeErase and self.modifiedPages == 0:
+            self.stats[2] += 1
+        else:
+            erase = (self.needsErase or not compareBeforeErase)
+            if erase:
+                self.flash[base:base + SECTOR_SIZE] = b"\xff" * SECTOR_SIZE
+                self.busyTime += self.eraseTime
+                self.stats[0] += 1
+            else:
+                self.stats[1] += 1
+            for page in range(SECTOR_SIZE // PAGE_SIZE):
+                chunk = self.sectorBuffer[page * PAGE_SIZE:(page + 1) * PAGE_SIZE]
+                if erase:
+                    program = (not compareBeforeErase) or any(b != 0xFF for b in chunk)
+                else:
+                    program = bool(self.modifiedPages & (1 << page))
+                if program:
+                    start = base + page * PAGE_SIZE
+                    self.flash[start:start + PAGE_SIZE] = bytes(a & b for a, b in zip(self.flash[start:start + PAGE_SIZE], chunk))
+                    self.busyTime += self.pageProgramTime
+        self.modifiedPages = 0
+        self.needsErase = False
+        self.sector = -1
+        return True
+
+    def handle(self, request):
+        self.busyTime = 0.0
+        command = request[0:1]
+
+        if command == b"X":
+            op = request[1]
+            ok = False
+            if op == 1 and self.sector == -1:
+                ok = self._loadSector((request[2] << 16) | (request[3] << 8) | request[4])
+            elif op == 2 and self.sector >= 0:
+                address, length = struct.unpack(">IH", request[2:8])
+                self._stage(address, request[8:8 + length])
+                ok = True
+            elif op == 3 and self.sector >= 0:
+                ok = self._commit(compareBeforeErase=self.legacyCompare)
+            return (b"X" + bytes([op])) if ok else b"-"
+
+        if command != b"P":
+            return b"-"
+
+        _, op, sequence, address, length, crc = PIPELINE_HEADER.unpack(request[:PIPELINE_HEADER.size])
+        payload = request[PIPELINE_HEADER.size:]
+        status = STATUS_OK
+        data = b""
+
+        if op == OP_OPEN:
+            self.pipelineIsOpen = True
+            self.nextSequence = sequence
+            self.stats = [0, 0, 0]
+
+        if not self.pipelineIsOpen or sequence != self.nextSequence:
+            status = STATUS_SEQUENCE_ERROR
+        else:
+            self.nextSequence = (self.nextSequence + 1) & 0xFFFF
+            if op == OP_OPEN:
+                self.sector = -1
+                data = struct.pack(">BH", 2, 1024)
+            elif op == OP_WRITE_FLASH:
+                if length == 0 or length > 1024 or (address // SECTOR_SIZE) != ((address + length - 1) // SECTOR_SIZE):
+                    status = STATUS_BAD_REQUEST
+                elif crc32(payload[:length]) != crc:
+                    status = STATUS_CRC_ERROR
+                else:
+                    if self.sector != address // SECTOR_SIZE:
+                        if self.sector >= 0:
+                            self._commit()
+                        self._loadSector(address // SECTOR_SIZE)
+                    self._stage(address, payload[:length])
+            elif op == OP_COMMIT:
+                if self.sector >= 0:
+                    self._commit()
+                data = struct.pack(">HHH", *self.stats)
+            elif op == OP_READ_FLASH:
+                if length == 0 or length > 1024:
+                    status = STATUS_BAD_REQUEST
+                else:
+                    if self.sector >= 0:
+                        self._commit()
+                    data = self._read(address, length)
+            elif op == OP_DIGEST:
+                if length == 0 or (length % DIGEST_RANGE.size) != 0 or (length // DIGEST_RANGE.size) > MAX_DIGEST_RANGES:
+                    status = STATUS_BAD_REQUEST
+                elif crc32(payload[:length]) != crc:
+                    status = STATUS_CRC_ERROR
+                else:
+                    if self.sector >= 0:
+                        self._commit()
+                    data = b"".join(struct.pack(">I", crc32(self._read(a, l)))
+                                    for a, l in DIGEST_RANGE.iter_unpack(payload[:length]))
+            else:
+                status = STATUS_BAD_REQUEST
+
+        if op == OP_OPEN and status != STATUS_OK:
+            self.pipelineIsOpen = False
+
+        return PIPELINE_REPLY_HEADER.pack(b"P", op, sequence, status, len(data)) + data + struct.pack(">I", crc32(data))
+
+
+class LoopbackLink(object):
+    """ Runs the requests through a SimulatedRadio and keeps a virtual clock.
+        A request is sent once the link and the window allow it, the radio handles them
+        one after the other, replies are received after the link latency. """
+
+    def __init__(self, radio, window):
+        self.radio = radio
+        self.window = window
+        self.hostTime = 0.0
+        self.radioFreeTime = 0.0
+        self.replyTimes = deque()
+        self.pending = deque()
+
+    def _wire(self, length):
+        return length / self.radio.usbBytesPerSecond
+
+    def send(self, request):
+        # Wait for a free slot in the window
+        if len(self.replyTimes) >= self.window:
+            self.hostTime = max(self.hostTime, self.replyTimes.popleft())
+        sendTime = self.hostTime
+        self.hostTime = sendTime + self._wire(len(request))
+        start = max(self.hostTime + (self.radio.usbLatency / 2), self.radioFreeTime)
+        reply = self.radio.handle(request)
+        self.radioFreeTime = start + self.radio.busyTime
+        replyTime = self.radioFreeTime + (self.radio.usbLatency / 2) + self._wire(len(reply))
+        self.replyTimes.append(replyTime)
+        self.pending.append((replyTime, reply))
+
+    def receive(self):
+        replyTime, reply = self.pending.popleft()
+        if replyTime in self.replyTimes:
+            self.replyTimes.remove(replyTime)
+        self.hostTime = max(self.hostTime, replyTime)
+        return reply
+
+    def elapsed(self):
+        return self.hostTime
+
+
+class PosixPort(object):
+    """ The few pyserial calls used, on a raw POSIX tty (CDC ACM device or pseudo terminal) """
+
+    def __init__(self, port, timeout):
+        import termios
+        import tty
+        self.timeout = timeout
+        self.fd = os.open(port, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(self.fd, termios.TCSANOW)
+
+    def write(self, data):
+        view = memoryview(data)
+        while len(view) > 0:
+            view = view[os.write(self.fd, view):]
+
+    def read(self, length):
+        data = b""
+        deadline = time.time() + self.timeout
+        while len(data) < length:
+            remaining = deadline - time.time()
+            if remaining <= 0 or not select.select([self.fd], [], [], remaining)[0]:
+                break
+            data += os.read(self.fd, length - len(data))
+        return data
+
+
+class SerialLink(object):
+    def __init__(self, port):
+        try:
+            import serial
+            self.serial = serial.Serial(port=port, baudrate=115200, timeout=5.0)
+        except ImportError:
+            if os.name != "posix":
+                raise TransferError("pyserial is needed to talk to a radio")
+            try:
+                self.serial = PosixPort(port, 5.0)
+            except OSError as e:
+                raise TransferError(str(e))
+        self.startTime = time.time()
+        self.window = 0
+
+    def send(self, request):
+        self.serial.write(request)
+
+    def _readExactly(self, length):
+        data = self.serial.read(length)
+        if len(data) != length:
+            raise TransferError("timeout while waiting for the radio")
+        return data
+
+    def receive(self):
+        first = self._readExactly(1)
+        if first == b"P":
+            header = first + self._readExactly(PIPELINE_REPLY_HEADER.size - 1)
+            length = PIPELINE_REPLY_HEADER.unpack(header)[4]
+            return header + self._readExactly(length + 4)
+        if first in (b"X", b"W"):
+            return first + self._readExactly(1)
+        return first
+
+    def elapsed(self):
+        return time.time() - self.startTime
+
+
+#
+# Transfers
+#
+def legacyWrite(link, address, data):
+    """ Stop-and-wait 'X' transfer, as done by the CPS """
+    offset = 0
+    while offset < len(data):
+        sector = (address + offset) // SECTOR_SIZE
+        sectorEnd = min((sector + 1) * SECTOR_SIZE, address + len(data))
+
+        link.send(b"X\x01" + struct.pack(">I", sector)[1:])
+        if link.receive() != b"X\x01":
+            raise TransferError("sector 0x{:X} prepare failed".format(sector))
+
+        while (address + offset) < sectorEnd:
+            length = min(LEGACY_MAX_DATA_LENGTH, sectorEnd - (address + offset))
+            link.send(b"X\x02" + struct.pack(">IH", address + offset, length) + data[offset:offset + length])
+            if link.receive() != b"X\x02":
+                raise TransferError("data send failed at 0x{:X}".format(address + offset))
+            offset += length
+
+        link.send(b"X\x03")
+        if link.receive() != b"X\x03":
+            raise TransferError("sector 0x{:X} write failed".format(sector))
+
+
+class PipelinedClient(object):
+    def __init__(self, link, window):
+        self.link = link
+        self.window = window
+        self.sequence = 0
+        self.maxDataLength = 0
+        self.version = 0
+        self.outstanding = deque()
+
+    def _check(self, reply, expectedOp, expectedSequence):
+        if len(reply) < (PIPELINE_REPLY_HEADER.size + 4) or reply[0:1] != b"P":
+            raise TransferError("unexpected reply {!r}".format(reply[:8]))
+        _, op, sequence, status, length = PIPELINE_REPLY_HEADER.unpack(reply[:PIPELINE_REPLY_HEADER.size])
+        data = reply[PIPELINE_REPLY_HEADER.size:PIPELINE_REPLY_HEADER.size + length]
+        crc = struct.unpack(">I", reply[PIPELINE_REPLY_HEADER.size + length:PIPELINE_REPLY_HEADER.size + length + 4])[0]
+        if op != expectedOp or sequence != expectedSequence:
+            raise TransferError("out of order reply (op {} seq {}, expected op {} seq {})".format(op, sequence, expectedOp, expectedSequence))
+        if crc != crc32(data):
+            raise TransferError("corrupted reply data (seq {})".format(sequence))
+        return status, data
+
+    def _transact(self, op, address=0, length=0, payload=b""):
+        sequence = self.sequence
+        self.sequence = (self.sequence + 1) & 0xFFFF
+        self.link.send(pipelineRequest(op, sequence, address, length, payload))
+        return self._check(self.link.receive(), op, sequence)
+
+    def open(self):
+        self.sequence = 0
+        status, data = self._transact(OP_OPEN)
+        if status != STATUS_OK or len(data) < 3:
+            raise TransferError("the radio doesn't support pipelined transfers")
+        self.version, self.maxDataLength = struct.unpack(">BH", data[:3])
+
+    def _drain(self, keep):
+        while len(self.outstanding) > keep:
+            op, sequence, address, payload = self.outstanding.popleft()
+            status, _ = self._check(self.link.receive(), op, sequence)
+            if status == STATUS_CRC_ERROR:
+                # Resend once the window has been drained, sequence numbers keep going
+                self._drain(0)
+                if self._transact(op, address, len(payload), payload)[0] != STATUS_OK:
+                    raise TransferError("block 0x{:X} failed twice".format(address))
+            elif status != STATUS_OK:
+                raise TransferError("block 0x{:X}: {}".format(address, STATUS_NAMES[status] if status < len(STATUS_NAMES) else status))
+
+    def _send(self, address, data):
+        offset = 0
+        while offset < len(data):
+            current = address + offset
+            length = min(self.maxDataLength, len(data) - offset, SECTOR_SIZE - (current % SECTOR_SIZE))
+            payload = bytes(data[offset:offset + length])
+            sequence = self.sequence
+            self.sequence = (self.sequence + 1) & 0xFFFF
+            self.link.send(pipelineRequest(OP_WRITE_FLASH, sequence, current, length, payload))
+            self.outstanding.append((OP_WRITE_FLASH, sequence, current, payload))
+            self._drain(self.window - 1)
+            offset += length
+
+    def commit(self):
+        self._drain(0)
+        status, data = self._transact(OP_COMMIT)
+        if status != STATUS_OK:
+            raise TransferError("commit failed: {}".format(STATUS_NAMES[status]))
+        return struct.unpack(">HHH", data[:6])
+
+    def write(self, address, data):
+        self._send(address, data)
+        return self.commit()
+
+    def digest(self, ranges):
+        if self.version < 2:
+            raise TransferError("the radio doesn't support digest requests")
+        crcs = []
+        requests = deque()
+        offset = 0
+        while offset < len(ranges) or requests:
+            while offset < len(ranges) and len(requests) < self.window:
+                batch = ranges[offset:offset + MAX_DIGEST_RANGES]
+                payload = b"".join(DIGEST_RANGE.pack(a, l) for a, l in batch)
+                sequence = self.sequence
+                self.sequence = (self.sequence + 1) & 0xFFFF
+                self.link.send(pipelineRequest(OP_DIGEST, sequence, 0, len(payload), payload))
+                requests.append(sequence)
+                offset += len(batch)
+            status, data = self._check(self.link.receive(), OP_DIGEST, requests.popleft())
+            if status != STATUS_OK:
+                raise TransferError("digest failed: {}".format(STATUS_NAMES[status]))
+            crcs += [c for (c,) in struct.iter_unpack(">I", data)]
+        return crcs
+
+    def sync(self, address, data):
+        """ Writes only the sectors which differ, returns the commit counters and the number of sectors sent """
+        ranges = []
+        offset = 0
+        while offset < len(data):
+            length = min(len(data) - offset, SECTOR_SIZE - ((address + offset) % SECTOR_SIZE))
+            ranges.append((address + offset, length))
+            offset += length
+
+        sent = 0
+        for (rangeAddress, length), crc in zip(ranges, self.digest(ranges)):
+            offset = rangeAddress - address
+            if crc != crc32(data[offset:offset + length]):
+                self._send(rangeAddress, data[offset:offset + length])
+                sent += 1
+        return self.commit(), sent
+
+    def read(self, address, length):
+        result = bytearray()
+        requests = deque()
+        offset = 0
+        while offset < length or requests:
+            while offset < length and len(requests) < self.window:
+                chunk = min(self.maxDataLength, length - offset)
+                sequence = self.sequence
+                self.sequence = (self.sequence + 1) & 0xFFFF
+                self.link.send(pipelineRequest(OP_READ_FLASH, sequence, address + offset, chunk))
+                requests.append(sequence)
+                offset += chunk
+            status, data = self._check(self.link.receive(), OP_READ_FLASH, requests.popleft())
+            if status != STATUS_OK:
+                raise TransferError("read failed: {}".format(STATUS_NAMES[status]))
+            result += data
+        return bytes(result)
+
+
+def runLoopback(args, image, address, data):
+    results = []
+    modes = [("legacy", 1)] if args.compare else []
+    modes += [("sync", args.window)] if args.sync else [("pipelined", args.window)]
+
+    for mode, window in modes:
+        radio = SimulatedRadio(image, args.usb_latency / 1000.0, args.usb_rate * 1024.0,
+                               args.erase_time / 1000.0, args.program_time / 1000.0, args.read_rate * 1024.0)
+        link = LoopbackLink(radio, window)
+
+        if mode == "legacy":
+            legacyWrite(link, address, data)
+            stats = None
+        else:
+            client = PipelinedClient(link, window)
+            client.open()
+            if mode == "sync":
+                stats, sent = client.sync(address, data)
+                mode = "sync ({} sent)".format(sent)
+            else:
+                stats = client.write(address, data)
+
+        if bytes(radio.flash[address:address + len(data)]) != bytes(data):
+            raise TransferError("{}: simulated Flash content differs from the input".format(mode))
+
+        results.append((mode, window, link.elapsed(), stats))
+
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="OpenGD77 STM32 pipelined CPS transfer client")
+    parser.add_argument("-p", "--port", help="radio serial port (e.g. /dev/ttyACM0 or COM3).", default=None)
+    parser.add_argument("-i", "--input", help="file to write to the radio Flash.", required=True)
+    parser.add_argument("-a", "--address", help="Flash address (default: 0x30000).", type=lambda x: int(x, 0), default=0x30000)
+    parser.add_argument("-w", "--window", help="number of outstanding requests (default: 8).", type=int, default=8)
+    parser.add_argument("--sync", help="only write the sectors whose CRC32 differs on the radio.", action="store_true", default=False)
+    parser.add_argument("--verify", help="read the data back once written.", action="store_true", default=False)
+    parser.add_argument("--loopback", help="use a simulated radio instead of a serial port.", action="store_true", default=False)
+    parser.add_argument("--compare", help="(loopback) also run the legacy transfer and compare the throughput.", action="store_true", default=False)
+    parser.add_argument("--base-image", help="(loopback) initial Flash content, to simulate an incremental write.", default=None)
+    parser.add_argument("--flash-size", help="(loopback) Flash size in bytes (default: 16MB).", type=lambda x: int(x, 0), default=16 * 1024 * 1024)
+    parser.add_argument("--usb-latency", help="(loopback) USB round trip in ms (default: 2).", type=float, default=2.0)
+    parser.add_argument("--usb-rate", help="(loopback) USB CDC throughput in KB/s (default: 800).", type=float, default=800.0)
+    parser.add_argument("--erase-time", help="(loopback) sector erase time in ms (default: 45).", type=float, default=45.0)
+    parser.add_argument("--program-time", help="(loopback) page program time in ms (default: 0.7).", type=float, default=0.7)
+    parser.add_argument("--read-rate", help="(loopback) SPI Flash read rate in KB/s (default: 2000).", type=float, default=2000.0)
+    args = parser.parse_args()
+
+    try:
+        with open(args.input, "rb") as f:
+            data = f.read()
+    except OSError as e:
+        print("Error: {}".format(e))
+        return -1
+
+    try:
+        if args.loopback:
+            image = bytearray(b"\xff" * args.flash_size)
+            if args.base_image:
+                with open(args.base_image, "rb") as f:
+                    base = f.read()
+                image[args.address:args.address + len(base)] = base
+
+            for mode, window, elapsed, stats in runLoopback(args, image, args.address, data):
+                line = "{:<16} window {:>2}: {:8.3f} s, {:8.1f} KB/s".format(mode, window, elapsed, (len(data) / 1024.0) / elapsed)
+                if stats:
+                    line += " (sectors erased {}, programmed only {}, unchanged {})".format(*stats)
+                print(line)
+            return 0
+
+        if args.port is None:
+            print("Error: a serial port or --loopback is needed")
+            return -2
+
+        link = SerialLink(args.port)
+        client = PipelinedClient(link, args.window)
+
+        link.send(b"C\x00")  # CPS screen
+        link.receive()
+        client.open()
+        start = time.time()
+        if args.sync:
+            stats, sent = client.sync(args.address, data)
+            print("{} sector(s) differed".format(sent))
+        else:
+            stats = client.write(args.address, data)
+        elapsed = time.time() - start
+        print("written {} bytes in {:.3f} s, {:.1f} KB/s (sectors erased {}, programmed only {}, unchanged {})".format(
+            len(data), elapsed, (len(data) / 1024.0) / elapsed, *stats))
+
+        result = 0
+        if args.verify:
+            start = time.time()
+            readBack = client.read(args.address, len(data))
+            elapsed = time.time() - start
+            print("read back in {:.3f} s, {:.1f} KB/s".format(elapsed, (len(data) / 1024.0) / elapsed))
+            if readBack != data:
+                print("Error: verification failed")
+                result = -4
+
+        link.send(b"C\x05")  # Close
+        link.receive()
+        return result
+
+    except TransferError as e:
+        print("Error: {}".format(e))
+        return -3
+
+
+if __name__ == "__main__":
+    sys.exit(main())
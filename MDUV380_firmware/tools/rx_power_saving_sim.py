@@ -0,0 +1,289 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+#
+# Copyright (C) 2024 Daniel Caujolle-Bert, F1RMB
+#                    Roger Clark, VK3KYY / G4KYF
+#
+# Host simulation of the RX power saving (functions/rxPowerSaving.c): fixed RX on/off periods
+# against the activity adaptive off period, over a channel activity trace.
+#
+# The trace is either a recorded one (one transmission per line: start (s), duration (s), CSV),
+# or synthetic QSOs (several overs, short gaps) with a busy/quiet daily profile, plus kerchunks.
+#
+# A transmission is missed if it ends before any RX on period could see it, and late if it's
+# detected more than --late ms after its start. A call is the first voice transmission (2s or more)
+# after 30s of silence, it's lost if it's missed or late (the start of the call isn't heard).
+# The battery gain is the average current against the RX always on (eco level 0).
+#
+# Examples:
+#   rx_power_saving_sim.py --hours 24 --qsos 6
+#   rx_power_saving_sim.py --trace activity.csv --level 3 --sweep
+#
+# With --sweep, the adaptive policy is run for several worst case latencies (RX_ACTIVITY_MAX_LATENCY).
+#
+
+import argparse
+import random
+import sys
+
+
+# Keep in sync with functions/rxPowerSaving.c
+SCORE_EVENT = 256
+SCORE_DECAY_PERIOD = 60000
+RECENT_PERIOD = 30000
+OFF_SCALE_MIN = 4
+OFF_SCALE_BASE = 8
+OFF_SCALE_MAX = 32
+OFF_SCALE_QUIET_STEP = 2
+MAX_LATENCY = 1000
+RSSI_NOISE_SAMPLE_PERIOD = 25
+
+CALL_SILENCE = 30000
+CALL_MIN_LENGTH = 2000
+
+
+def rxDuration(level):
+    return 130 - (10 * level)
+
+
+def fixedOffPeriod(level):
+    return rxDuration(level) * (1 << (level - 1))
+
+
+def holdPeriod(level):
+    # The ECO timer runs twice (INACTIVE, then WAIT_START) after the last activity, before the RX goes off
+    return 2 * ((12 - (min(level, 4) * 2)) * 1000)
+
+
+class FixedPolicy:
+    def __init__(self, level):
+        self.level = level
+
+    def activity(self, start, end):
+        pass
+
+    def offPeriod(self, now):
+        return fixedOffPeriod(self.level)
+
+
+class AdaptivePolicy:
+    def __init__(self, level, maxLatency):
+        self.level = level
+        self.maxLatency = maxLatency
+        self.score = 0
+        self.hasActivity = False
+        self.lastActivityTime = 0
+        self.lastDecayTime = 0
+
+    def _decay(self, now):
+        periods = (now - self.lastDecayTime) // SCORE_DECAY_PERIOD
+        for _ in range(periods):
+            if self.score == 0:
+                break
+            self.score -= (self.score + 15) >> 4
+        self.lastDecayTime += periods * SCORE_DECAY_PERIOD
+
+    def activity(self, start, end):
+        self._decay(start)
+        self.score = min(self.score + SCORE_EVENT, 0xFFFF)
+        self.hasActivity = True
+        self.lastActivityTime = end
+
+    def offPeriod(self, now):
+        self._decay(now)
+        quietTime = now - self.lastActivityTime
+
+        if self.hasActivity and (quietTime < RECENT_PERIOD):
+            scale = OFF_SCALE_MIN
+        else:
+            scale = min(OFF_SCALE_BASE + ((quietTime // 60000) * OFF_SCALE_QUIET_STEP), OFF_SCALE_MAX)
+            scale -= min(self.score // SCORE_EVENT, scale - OFF_SCALE_MIN)
+
+        fixed = fixedOffPeriod(self.level)
+        maxOffPeriod = self.maxLatency - (2 * RSSI_NOISE_SAMPLE_PERIOD)
+        return max(rxDuration(self.level), min((fixed * scale) // OFF_SCALE_BASE, max(fixed, maxOffPeriod)))
+
+
+def simulate(transmissions, duration, level, policy, settle, late):
+    onPeriod = rxDuration(level)
+    stats = {"missed": 0, "late": 0, "calls": 0, "callsLost": 0}
+    delays = []
+    onTime = 0
+    t = 0
+    holdEnd = holdPeriod(level) # starts with the RX on
+    i = 0
+    previousEnd = -CALL_SILENCE
+
+    def account(index, delay):
+        start, end = transmissions[index]
+        isCall = ((start - previousEnd) >= CALL_SILENCE) and ((end - start) >= CALL_MIN_LENGTH)
+        stats["calls"] += isCall
+        if delay is None:
+            stats["missed"] += 1
+            stats["callsLost"] += isCall
+        else:
+            delays.append(delay)
+            if delay > late:
+                stats["late"] += 1
+                stats["callsLost"] += isCall
+        return end
+
+    while t < duration:
+        if holdEnd is not None:
+            # RX on: everything starting meanwhile is heard straight away, and postpones the power saving
+            while (i < len(transmissions)) and (transmissions[i][0] < holdEnd):
+                start, end = transmissions[i]
+                policy.activity(max(start, t), end)
+                previousEnd = account(i, max(0, t - start))
+                holdEnd = max(holdEnd, end + holdPeriod(level))
+                i += 1
+
+            holdEnd = min(holdEnd, duration)
+            onTime += holdEnd - t
+            t = holdEnd
+            holdEnd = None
+            continue
+
+        onStart = t + policy.offPeriod(t)
+        onEnd = onStart + onPeriod
+        listenStart = onStart + settle # RSSI/noise sampling after the power up
+
+        # Over before the RX could sample it
+        while (i < len(transmissions)) and (transmissions[i][1] <= listenStart):
+            previousEnd = account(i, None)
+            i += 1
+
+        if (i < len(transmissions)) and (transmissions[i][0] < onEnd):
+            detection = max(transmissions[i][0], listenStart)
+            onTime += detection - onStart
+            t = detection
+            holdEnd = detection
+        else:
+            onTime += min(onEnd, duration) - min(onStart, duration)
+            t = onEnd
+
+    delays.sort()
+    count = len(transmissions)
+    stats["count"] = count
+    stats["duty"] = onTime / duration
+    stats["missedRatio"] = stats["missed"] / count if count else 0
+    stats["lateRatio"] = stats["late"] / count if count else 0
+    stats["callsLostRatio"] = stats["callsLost"] / stats["calls"] if stats["calls"] else 0
+    stats["meanDelay"] = (sum(delays) / len(delays)) if delays else 0
+    stats["p95Delay"] = delays[int(len(delays) * 0.95)] if delays else 0
+    return stats
+
+
+def syntheticTrace(hours, qsosPerHour, kerchunksPerHour, seed):
+    rng = random.Random(seed)
+    duration = int(hours * 3600000)
+    transmissions = []
+
+    # QSOs: Poisson arrivals, twice the mean rate in the evening and a tenth of it at night
+    t = 0
+    while True:
+        hour = (t // 3600000) % 24
+        rate = qsosPerHour * (2.0 if 17 <= hour < 22 else (0.1 if (hour < 7) else 1.0))
+        t += int(rng.expovariate(rate / 3600000.0)) if rate > 0 else duration
+        if t >= duration:
+            break
+
+        start = t
+        for over in range(max(1, int(rng.expovariate(1 / 6.0)) + 1)):
+            length = int(rng.uniform(3000, 30000))
+            transmissions.append((start, start + length))
+            start += length + int(rng.uniform(800, 5000))
+        t = start
+
+    # Kerchunks and short data bursts
+    t = 0
+    while kerchunksPerHour > 0:
+        t += int(rng.expovariate(kerchunksPerHour / 3600000.0))
+        if t >= duration:
+            break
+        transmissions.append((t, t + int(rng.uniform(300, 1500))))
+
+    return mergeTransmissions(transmissions), duration
+
+
+def mergeTransmissions(transmissions):
+    merged = []
+
+    for start, end in sorted(transmissions):
+        if merged and (start <= merged[-1][1]):
+            merged[-1] = (merged[-1][0], max(merged[-1][1], end))
+        else:
+            merged.append((start, end))
+
+    return merged
+
+
+def loadTrace(path):
+    transmissions = []
+
+    with open(path, "r") as f:
+        for line in f:
+            line = line.strip()
+            if line and not line.startswith("#"):
+                fields = line.split(",")
+                start = int(float(fields[0]) * 1000)
+                transmissions.append((start, start + int(float(fields[1]) * 1000)))
+
+    transmissions = mergeTransmissions(transmissions)
+    return transmissions, (transmissions[-1][1] + 60000) if transmissions else 0
+
+
+def averageCurrent(stats, rxCurrent, offCurrent):
+    return (stats["duty"] * rxCurrent) + ((1.0 - stats["duty"]) * offCurrent)
+
+
+def printStats(label, stats, rxCurrent, offCurrent):
+    current = averageCurrent(stats, rxCurrent, offCurrent)
+    print("{:>18} | RX on {:5.1f}% | {:5.1f} mA, battery x{:4.2f} | missed {:5.2f}% late {:5.2f}% | calls lost {:5.2f}% | delay mean {:5.0f} p95 {:5d} ms".format(
+        label, stats["duty"] * 100, current, rxCurrent / current, stats["missedRatio"] * 100, stats["lateRatio"] * 100,
+        stats["callsLostRatio"] * 100, stats["meanDelay"], stats["p95Delay"]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="RX power saving (eco level) simulation")
+    parser.add_argument("--trace", help="recorded activity: start (s), duration (s) per line")
+    parser.add_argument("--hours", type=float, default=24.0, help="synthetic trace duration")
+    parser.add_argument("--qsos", type=float, default=4.0, help="synthetic QSOs per hour")
+    parser.add_argument("--kerchunks", type=float, default=3.0, help="synthetic short transmissions per hour")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--level", type=int, choices=range(1, 6), help="only simulate this eco level")
+    parser.add_argument("--max-latency", type=int, default=MAX_LATENCY, help="adaptive worst case off period (ms)")
+    parser.add_argument("--settle", type=int, default=(2 * RSSI_NOISE_SAMPLE_PERIOD), help="time to sample the RSSI/noise after the RX power up (ms)")
+    parser.add_argument("--late", type=int, default=1000, help="detection delay above which a transmission is late (ms)")
+    parser.add_argument("--rx-current", type=float, default=75.0, help="current with the RX on (mA)")
+    parser.add_argument("--off-current", type=float, default=35.0, help="current with the RX off (mA)")
+    parser.add_argument("--sweep", action="store_true", help="run the adaptive policy for several worst case latencies")
+    args = parser.parse_args()
+
+    if args.trace:
+        transmissions, duration = loadTrace(args.trace)
+    else:
+        transmissions, duration = syntheticTrace(args.hours, args.qsos, args.kerchunks, args.seed)
+
+    if not transmissions:
+        print("No activity")
+        sys.exit(-1)
+
+    busy = sum(end - start for start, end in transmissions)
+    print("{} transmissions over {:.1f} h, channel busy {:.1f}%".format(len(transmissions), duration / 3600000.0, busy * 100.0 / duration))
+
+    for level in ([args.level] if args.level else range(1, 6)):
+        fixed = simulate(transmissions, duration, level, FixedPolicy(level), args.settle, args.late)
+        printStats("level {} fixed".format(level), fixed, args.rx_current, args.off_current)
+
+        latencies = [500, 1000, 1500, 2000] if args.sweep else [args.max_latency]
+        for latency in latencies:
+            adaptive = simulate(transmissions, duration, level, AdaptivePolicy(level, latency), args.settle, args.late)
+            printStats("adaptive {:>4} ms".format(latency), adaptive, args.rx_current, args.off_current)
+            print("{:>18} | battery x{:4.2f} against fixed".format("", averageCurrent(fixed, args.rx_current, args.off_current) /
+                                                                    averageCurrent(adaptive, args.rx_current, args.off_current)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+#
+# Copyright (C) 2024 Daniel Caujolle-Bert, F1RMB
+#                    Roger Clark, VK3KYY / G4KYF
+#
+# Decoder for the hot path tracing stream (interfaces/trace.h), built with USING_TRACE defined.
+#
+# The events are read from the RTT up-buffer 1 ("Trace"), either from a raw capture file, e.g.
+#   JLinkRTTLogger -Device STM32F405VG -If SWD -Speed 4000 -RTTChannel 1 trace.bin
+# or from an OpenOCD RTT TCP server:
+#   rtt setup 0x20000000 0x20000 "SEGGER RTT"
+#   rtt start
+#   rtt server start 9091 1
+# or from the host simulator (host/, make TRACE=1):
+#   mduv380_host-trace --flash flash.bin --script script.txt --trace trace.bin
+#
+# Each event is 8 bytes, little endian: DWT cycles (u32), sequence (u16), id (u8), type (u8).
+# The cycles are converted with the last core clock event, and unwrapped assuming that
+# consecutive events are less than 2^32 cycles apart (~25s at 168MHz).
+# The DWT counter is stopped while the CPU sleeps (WFI), the timeline doesn't include
+# the idle sleep periods, but the traced durations are exact.
+#
+# Examples:
+#   trace_decode.py trace.bin
+#   trace_decode.py --tcp localhost:9091 --duration 30 --chrome trace.json
+#
+# The JSON file can be loaded in chrome://tracing or https://ui.perfetto.dev
+#
+
+import argparse
+import json
+import socket
+import struct
+import sys
+import time
+
+
+# Keep in sync with traceId_t, in application/include/interfaces/trace.h
+TRACE_NAMES = [
+    "hrc6000TimeslotInterruptHandler",
+    "hrc6000SysInterruptHandler",
+    "codecDecode",
+    "codecEncode",
+    "displayRenderRows",
+    "SPI_Flash_read",
+    "SPI_Flash_write",
+    "I2C write",
+    "I2C read",
+]
+
+TRACE_EVENT_BEGIN = 0
+TRACE_EVENT_END = 1
+TRACE_EVENT_CLOCK = 2
+
+EVENT_FORMAT = "<IHBB"
+EVENT_SIZE = struct.calcsize(EVENT_FORMAT)
+DEFAULT_CLOCK_MHZ = 168
+
+
+def traceName(eventId):
+    return TRACE_NAMES[eventId] if eventId < len(TRACE_NAMES) else "id{}".format(eventId)
+
+
+def readFile(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def readTCP(address, duration):
+    host, port = address.rsplit(":", 1)
+    data = bytearray()
+    end = (time.time() + duration) if duration else None
+
+    with socket.create_connection((host, int(port))) as sock:
+        sock.settimeout(0.5)
+        print("Capturing from {}, Ctrl-C to stop".format(address), file=sys.stderr)
+
+        try:
+            while (end is None) or (time.time() < end):
+                try:
+                    chunk = sock.recv(65536)
+                except socket.timeout:
+                    continue
+
+                if not chunk:
+                    break
+                data += chunk
+        except KeyboardInterrupt:
+            pass
+
+    return bytes(data)
+
+
+class Decoder:
+    def __init__(self):
+        self.mhz = DEFAULT_CLOCK_MHZ
+        self.lastCycles = None
+        self.timeUs = 0.0
+        self.lastSequence = None
+        self.lost = 0
+        self.unmatched = 0
+        self.open = {}        # id -> stack of begin times
+        self.durations = {}   # id -> list of durations (us)
+        self.timeline = []
+
+    def event(self, cycles, sequence, eventId, eventType):
+        if self.lastSequence is not None:
+            gap = (sequence - self.lastSequence - 1) & 0xFFFF
+            if gap:
+                # Ends of the pending sections may be lost, don't match across the gap
+                self.lost += gap
+                self.unmatched += sum(len(s) for s in self.open.values())
+                self.open.clear()
+        self.lastSequence = sequence
+
+        if self.lastCycles is not None:
+            self.timeUs += ((cycles - self.lastCycles) & 0xFFFFFFFF) / self.mhz
+        self.lastCycles = cycles
+
+        if eventType == TRACE_EVENT_CLOCK:
+            if eventId:
+                self.mhz = eventId
+            self.timeline.append({"name": "clock {} MHz".format(eventId), "ph": "i", "s": "g", "ts": self.timeUs, "pid": 0, "tid": "clock"})
+        elif eventType == TRACE_EVENT_BEGIN:
+            self.open.setdefault(eventId, []).append(self.timeUs)
+        elif eventType == TRACE_EVENT_END:
+            stack = self.open.get(eventId)
+            if stack:
+                begin = stack.pop()
+                self.durations.setdefault(eventId, []).append(self.timeUs - begin)
+                self.timeline.append({"name": traceName(eventId), "ph": "X", "ts": begin, "dur": self.timeUs - begin, "pid": 0, "tid": traceName(eventId)})
+            else:
+                self.unmatched += 1
+
+    def decode(self, data):
+        for offset in range(0, len(data) - (len(data) % EVENT_SIZE), EVENT_SIZE):
+            self.event(*struct.unpack_from(EVENT_FORMAT, data, offset))
+
+
+def percentile(values, ratio):
+    return values[min(len(values) - 1, int(len(values) * ratio))]
+
+
+def printHistograms(decoder, width):
+    for eventId in sorted(decoder.durations):
+        values = sorted(decoder.durations[eventId])
+        print("{}: count {} | min {:.1f} mean {:.1f} p50 {:.1f} p95 {:.1f} p99 {:.1f} max {:.1f} us".format(
+            traceName(eventId), len(values), values[0], sum(values) / len(values),
+            percentile(values, 0.5), percentile(values, 0.95), percentile(values, 0.99), values[-1]))
+
+        # Log2 buckets, in microseconds
+        buckets = {}
+        for v in values:
+            bucket = max(0, int(v).bit_length() - 1)
+            buckets[bucket] = buckets.get(bucket, 0) + 1
+
+        peak = max(buckets.values())
+        for bucket in range(min(buckets), max(buckets) + 1):
+            count = buckets.get(bucket, 0)
+            print("  {:>8} us | {:<{}} {}".format("<{}".format(1 << (bucket + 1)), "#" * ((count * width + peak - 1) // peak), width, count))
+        print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Hot path tracing stream decoder")
+    parser.add_argument("capture", nargs="?", help="raw capture of the RTT trace channel")
+    parser.add_argument("--tcp", help="read from an RTT TCP server (host:port) instead of a file")
+    parser.add_argument("--duration", type=float, help="TCP capture duration (s)")
+    parser.add_argument("--save", help="save the TCP capture to a file")
+    parser.add_argument("--chrome", help="write a Chrome trace (JSON) timeline")
+    parser.add_argument("--width", type=int, default=50, help="histograms width")
+    args = parser.parse_args()
+
+    if args.tcp:
+        data = readTCP(args.tcp, args.duration)
+        if args.save:
+            with open(args.save, "wb") as f:
+                f.write(data)
+    elif args.capture:
+        data = readFile(args.capture)
+    else:
+        parser.print_usage()
+        sys.exit(-1)
+
+    decoder = Decoder()
+    decoder.decode(data)
+
+    if not decoder.durations:
+        print("No complete trace section ({} bytes)".format(len(data)))
+    else:
+        printHistograms(decoder, args.width)
+
+    print("events: {}, lost: {}, unmatched: {}, duration: {:.3f} s".format(
+        len(data) // EVENT_SIZE, decoder.lost, decoder.unmatched, decoder.timeUs / 1e6))
+
+    if args.chrome:
+        with open(args.chrome, "w") as f:
+            json.dump({"traceEvents": decoder.timeline, "displayTimeUnit": "ns"}, f)
+
+
+if __name__ == "__main__":
+    main()